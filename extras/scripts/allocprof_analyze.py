@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+"""
+Analyzes the allocation profile written by an ALLOC_PROFILER build
+(DATA_PATH/allocprof.bin, see source/utils/allocprof.h for the format).
+
+Usage:
+  allocprof_analyze.py [--top N] [--window S] <allocprof.bin>
+
+The profile is split in stages at allocprof_mark() labels or, when there
+are none and --window is given, every S seconds. For each stage it reports
+allocation counts, peak and final live bytes, and the newlib heap snapshots
+(and, for SLAB_ALLOC builds, the bytes held in slab objects).
+Then it lists the top allocating call sites of the whole profile and the
+suspected leaks: call sites whose live blocks keep growing from one stage
+to the next, and those holding the most memory at the end.
+
+Frees of blocks allocated before recording started are ignored.
+"""
+
+import bisect
+import struct
+import sys
+from collections import defaultdict
+
+MAGIC = 0x46505041  # "APPF"
+VERSION = 1
+HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<IIII")
+
+(OP_ALLOC, OP_FREE, OP_NEW, OP_DELETE, OP_MARK, OP_SNAPSHOT, OP_DROPPED,
+ OP_SYMBOL, OP_SLAB) = range(1, 10)
+
+
+class Record:
+    __slots__ = ("time", "ptr", "size", "site", "op", "label")
+
+    def __init__(self, time, ptr, size, site, op, label=None):
+        self.time = time
+        self.ptr = ptr
+        self.size = size
+        self.site = site
+        self.op = op
+        self.label = label
+
+
+class Symbols:
+    def __init__(self, symbols):
+        symbols.sort()
+        self.starts = [s[0] for s in symbols]
+        self.symbols = symbols
+
+    def name(self, site):
+        if site == 0:
+            return "(outside the .so)"
+        i = bisect.bisect_right(self.starts, site) - 1
+        if i >= 0:
+            start, size, name = self.symbols[i]
+            end = start + size if size else (self.starts[i + 1] if i + 1 < len(self.starts) else None)
+            if end is None or site < end:
+                return "%s+0x%x" % (name, site - start)
+        return "0x%x" % site
+
+
+def load(path):
+    """Returns (records, symbols, dropped). Times are in seconds."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    magic, version, record_size, time_unit, _ = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION or record_size != RECORD.size:
+        raise SystemExit("%s is not an allocation profile" % path)
+    scale = time_unit / 1e9
+
+    records = []
+    symbols = []
+    dropped = 0
+    pos = HEADER.size
+    while pos + RECORD.size <= len(data):
+        time, ptr, size, site_op = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        op, arg = site_op & 0xF, site_op >> 4
+        if op in (OP_SYMBOL, OP_MARK):
+            name = data[pos:pos + arg].decode("utf-8", "replace")
+            pos += (arg + RECORD.size - 1) // RECORD.size * RECORD.size
+            if op == OP_SYMBOL:
+                symbols.append((ptr, size, name))
+            else:
+                records.append(Record(time * scale, 0, 0, 0, op, name))
+        elif op == OP_DROPPED:
+            dropped += size
+        else:
+            records.append(Record(time * scale, ptr, size, arg, op))
+
+    return records, Symbols(symbols), dropped
+
+
+def split_stages(records, window_s):
+    """Returns a list of (label, records)."""
+    if any(r.op == OP_MARK for r in records):
+        stages = [("(start)", [])]
+        for r in records:
+            if r.op == OP_MARK:
+                stages.append((r.label, []))
+            else:
+                stages[-1][1].append(r)
+        return [s for s in stages if s[1]]
+
+    if not window_s or not records:
+        return [("(whole profile)", records)]
+
+    stages = []
+    start = records[0].time
+    for r in records:
+        index = int((r.time - start) / window_s)
+        while len(stages) <= index:
+            stages.append(("%.0fs-%.0fs" % (len(stages) * window_s, (len(stages) + 1) * window_s), []))
+        stages[index][1].append(r)
+    return [s for s in stages if s[1]]
+
+
+def kb(n):
+    return n / 1024.0
+
+
+def analyze(records, symbols, dropped, top, window_s):
+    if dropped:
+        print("warning: %d records were dropped while recording, numbers are low\n" % dropped)
+
+    live = {}  # ptr -> (size, site, stage index)
+    live_bytes = 0
+    site_allocs = defaultdict(lambda: [0, 0])  # site -> [count, bytes]
+    site_live_at = []  # per stage end: site -> live blocks
+
+    stages = split_stages(records, window_s)
+    print("%-24s %9s %9s %10s %10s %10s %10s %10s %10s"
+          % ("stage", "allocs", "frees", "alloc KB", "peak KB", "end KB", "heap KB", "claimed KB", "slab KB"))
+    for index, (label, stage) in enumerate(stages):
+        allocs = frees = allocated = 0
+        peak = live_bytes
+        heap_used = heap_claimed = slab_used = 0
+        for r in stage:
+            if r.op in (OP_ALLOC, OP_NEW):
+                old = live.pop(r.ptr, None)
+                if old:
+                    live_bytes -= old[0]
+                live[r.ptr] = (r.size, r.site, index)
+                live_bytes += r.size
+                peak = max(peak, live_bytes)
+                allocs += 1
+                allocated += r.size
+                site_allocs[r.site][0] += 1
+                site_allocs[r.site][1] += r.size
+            elif r.op in (OP_FREE, OP_DELETE):
+                old = live.pop(r.ptr, None)
+                if old:
+                    live_bytes -= old[0]
+                    frees += 1
+            elif r.op == OP_SNAPSHOT:
+                heap_used = max(heap_used, r.ptr)
+                heap_claimed = max(heap_claimed, r.size)
+            elif r.op == OP_SLAB:
+                slab_used = max(slab_used, r.ptr)
+
+        counts = defaultdict(int)
+        for _, site, _ in live.values():
+            counts[site] += 1
+        site_live_at.append(counts)
+
+        print("%-24s %9d %9d %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f"
+              % (label[:24], allocs, frees, kb(allocated), kb(peak), kb(live_bytes),
+                 kb(heap_used), kb(heap_claimed), kb(slab_used)))
+
+    print("\n== top call sites (by bytes allocated)")
+    print("%10s %9s  %s" % ("KB", "allocs", "site"))
+    for site, (count, size) in sorted(site_allocs.items(), key=lambda kv: kv[1][1], reverse=True)[:top]:
+        print("%10.0f %9d  %s" % (kb(size), count, symbols.name(site)))
+
+    if len(stages) >= 3:
+        growing = []
+        for site in site_live_at[-1]:
+            series = [counts.get(site, 0) for counts in site_live_at]
+            if all(b > a for a, b in zip(series[1:], series[2:])):
+                growing.append((site, series))
+        print("\n== suspected leaks: live blocks grow at every stage boundary")
+        for site, series in sorted(growing, key=lambda g: g[1][-1], reverse=True)[:top]:
+            print("  %s: %s" % (symbols.name(site), " -> ".join(str(n) for n in series)))
+        if not growing:
+            print("  (none)")
+
+    remaining = defaultdict(lambda: [0, 0])
+    for size, site, stage in live.values():
+        if stage > 0:
+            remaining[site][0] += 1
+            remaining[site][1] += size
+    print("\n== still live at the end, allocated after the first stage")
+    print("%10s %9s  %s" % ("KB", "blocks", "site"))
+    for site, (count, size) in sorted(remaining.items(), key=lambda kv: kv[1][1], reverse=True)[:top]:
+        print("%10.0f %9d  %s" % (kb(size), count, symbols.name(site)))
+
+
+def main(argv):
+    args = argv[1:]
+    top = 20
+    window_s = None
+
+    opts = {"--top": None, "--window": None}
+    rest = []
+    i = 0
+    while i < len(args):
+        if args[i] in opts and i + 1 < len(args):
+            opts[args[i]] = args[i + 1]
+            i += 2
+        else:
+            rest.append(args[i])
+            i += 1
+    if opts["--top"]:
+        top = int(opts["--top"])
+    if opts["--window"]:
+        window_s = float(opts["--window"])
+
+    if len(rest) != 1:
+        print(__doc__)
+        return 1
+
+    records, symbols, dropped = load(rest[0])
+    analyze(records, symbols, dropped, top, window_s)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""
+Replays a file-access trace against models of the FIOS2 RAM cache to pick
+the setting_fiosCacheBlockKB / setting_fiosCacheBlocks / setting_fiosCachePaths
+values for config.txt.
+
+Usage:
+  fios_cache_sim.py [--block-kb 64,128,256] [--blocks 32,64,128]
+                    [--paths ux0:data/soulcalibur/] <trace>
+
+The trace is either the debug log of a DEBUG_SOLOADER build, from which the
+"[fios] read <path> <offset> <size>" lines are used, or a text file with one
+"<path> <offset> <size>" read per line. The model is the same LRU over
+(file, block) pairs that lib/fios/fios.c keeps at runtime, with the blocks
+split evenly between the cached paths.
+"""
+
+import re
+import sys
+from collections import OrderedDict
+
+DEFAULT_PATHS = "ux0:data/soulcalibur/"
+DEFAULT_BLOCK_KB = [32, 64, 128, 256, 512]
+DEFAULT_BLOCKS = [32, 64, 128, 256]
+MAX_CACHE_BYTES = 64 * 1024 * 1024
+
+LOG_LINE = re.compile(r"\[fios\] read (\S+) (\d+) (\d+)")
+
+
+def load_trace(path):
+    reads = []
+    with open(path, "r", errors="replace") as f:
+        for line in f:
+            m = LOG_LINE.search(line)
+            if m:
+                reads.append((m.group(1), int(m.group(2)), int(m.group(3))))
+                continue
+            parts = line.split()
+            if len(parts) == 3 and parts[1].isdigit() and parts[2].isdigit():
+                reads.append((parts[0], int(parts[1]), int(parts[2])))
+    return reads
+
+
+class Cache:
+    def __init__(self, prefix, block_count):
+        self.prefix = prefix
+        self.block_count = block_count
+        self.blocks = OrderedDict()
+
+    def touch(self, key):
+        """Returns (hit, evicted)."""
+        if key in self.blocks:
+            self.blocks.move_to_end(key)
+            return True, False
+        evicted = len(self.blocks) >= self.block_count
+        if evicted:
+            self.blocks.popitem(last=False)
+        self.blocks[key] = True
+        return False, evicted
+
+
+def simulate(reads, prefixes, block_size, block_count):
+    caches = []
+    for i, prefix in enumerate(prefixes):
+        n = block_count // len(prefixes) + (1 if i < block_count % len(prefixes) else 0)
+        if n > 0:
+            caches.append(Cache(prefix, n))
+
+    stats = dict(reads=0, hits=0, misses=0, evictions=0, requested=0, cached=0)
+    for path, offset, size in reads:
+        cache = next((c for c in caches if path.startswith(c.prefix)), None)
+        if cache is None or size == 0:
+            continue
+        stats["reads"] += 1
+        stats["requested"] += size
+        end = offset + size
+        for block in range(offset // block_size, (end - 1) // block_size + 1):
+            start = block * block_size
+            overlap = min(end, start + block_size) - max(offset, start)
+            hit, evicted = cache.touch((path, block))
+            if hit:
+                stats["hits"] += 1
+                stats["cached"] += overlap
+            else:
+                stats["misses"] += 1
+            if evicted:
+                stats["evictions"] += 1
+    return stats
+
+
+def parse_list(value):
+    return [int(v) for v in value.split(",") if v]
+
+
+def main(argv):
+    args = argv[1:]
+    block_kb = DEFAULT_BLOCK_KB
+    blocks = DEFAULT_BLOCKS
+    paths = DEFAULT_PATHS
+
+    while len(args) > 1 and args[0].startswith("--"):
+        opt, value = args[0], args[1]
+        if opt == "--block-kb":
+            block_kb = parse_list(value)
+        elif opt == "--blocks":
+            blocks = parse_list(value)
+        elif opt == "--paths":
+            paths = value
+        else:
+            break
+        args = args[2:]
+
+    if len(args) != 1:
+        print(__doc__)
+        return 1
+
+    reads = load_trace(args[0])
+    prefixes = [p for p in paths.split(";") if p][:4]
+    if not reads or not prefixes:
+        print("no reads on cached paths in %s" % args[0])
+        return 1
+
+    print("%d reads, %d files" % (len(reads), len(set(r[0] for r in reads))))
+    print("%8s %7s %8s %9s %9s %10s %10s"
+          % ("block KB", "blocks", "size MB", "hit rate", "bytes hit", "misses", "evictions"))
+
+    results = []
+    for kb in block_kb:
+        for count in blocks:
+            if kb * 1024 * count > MAX_CACHE_BYTES:
+                continue
+            s = simulate(reads, prefixes, kb * 1024, count)
+            lookups = s["hits"] + s["misses"]
+            hit_rate = s["hits"] / lookups if lookups else 0.0
+            byte_rate = s["cached"] / s["requested"] if s["requested"] else 0.0
+            results.append((byte_rate, kb, count))
+            print("%8d %7d %8.1f %8.1f%% %8.1f%% %10d %10d"
+                  % (kb, count, kb * count / 1024.0, hit_rate * 100, byte_rate * 100,
+                     s["misses"], s["evictions"]))
+
+    if results:
+        # Smallest cache within 1% of the best byte hit rate.
+        best = max(r[0] for r in results)
+        rate, kb, count = min((r for r in results if r[0] >= best - 0.01), key=lambda r: r[1] * r[2])
+        print("\nsuggested: setting_fiosCacheBlockKB %d, setting_fiosCacheBlocks %d (%.1f%% of bytes from cache)"
+              % (kb, count, rate * 100))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
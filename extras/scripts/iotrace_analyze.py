@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+"""
+Analyzes the binary I/O trace written by an IO_TRACE build
+(DATA_PATH/iotrace.bin, see source/utils/iotrace.h for the format).
+
+Usage:
+  iotrace_analyze.py summary [--gap S] [--top N] <iotrace.bin>
+  iotrace_analyze.py export  [--gap S] [--stage N] <iotrace.bin>
+
+`summary` splits the trace in stages, at iotrace_mark() labels or, when
+there are none, at pauses of more than S seconds (default 1.5) without any
+open or read. For each stage it reports bytes read, read sizes, latency and
+seek patterns, then lists the hottest files of the whole trace.
+
+`export` prints the reads of one stage (or all of them) as
+"<path> <offset> <size>" lines, the input format of fios_cache_sim.py.
+"""
+
+import struct
+import sys
+from collections import defaultdict
+
+MAGIC = 0x52544F49  # "IOTR"
+VERSION = 1
+HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<QQIIII")
+
+OP_NAME, OP_OPEN, OP_CLOSE, OP_READ, OP_SEEK, OP_MARK, OP_DROPPED = range(7)
+
+SIZE_BUCKETS = [(4 << 10, "<4K"), (32 << 10, "<32K"), (128 << 10, "<128K"),
+                (1 << 20, "<1M"), (None, ">=1M")]
+
+
+class Event:
+    __slots__ = ("time", "offset", "thread", "path", "op", "size", "latency")
+
+    def __init__(self, time, offset, thread, path, op, size, latency):
+        self.time = time
+        self.offset = offset
+        self.thread = thread
+        self.path = path
+        self.op = op
+        self.size = size
+        self.latency = latency
+
+
+def load(path):
+    """Returns (events, names, dropped). Times are in microseconds."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    magic, version, record_size, time_unit, _ = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION or record_size != RECORD.size:
+        raise SystemExit("%s is not an I/O trace" % path)
+    scale = time_unit / 1000.0
+
+    names = {0: "?"}
+    events = []
+    dropped = 0
+    pos = HEADER.size
+    while pos + RECORD.size <= len(data):
+        time, offset, thread, path_op, size, latency = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        op, path_id = path_op & 0xFF, path_op >> 8
+        if op == OP_NAME:
+            names[path_id] = data[pos:pos + size].decode("utf-8", "replace")
+            pos += (size + RECORD.size - 1) // RECORD.size * RECORD.size
+        elif op == OP_DROPPED:
+            dropped += size
+        else:
+            events.append(Event(time * scale, offset, thread, names.get(path_id, "?"),
+                                op, size, latency * scale))
+
+    events.sort(key=lambda e: e.time)
+    return events, names, dropped
+
+
+def split_stages(events, gap_s):
+    """Returns a list of (label, events)."""
+    if any(e.op == OP_MARK for e in events):
+        stages = [("(start)", [])]
+        for e in events:
+            if e.op == OP_MARK:
+                stages.append((e.path, []))
+            else:
+                stages[-1][1].append(e)
+        return [s for s in stages if s[1]]
+
+    stages = []
+    last_access = None
+    for e in events:
+        if e.op in (OP_OPEN, OP_READ):
+            if last_access is None or e.time - last_access > gap_s * 1e6:
+                stages.append(("stage %d" % (len(stages) + 1), []))
+            last_access = e.time
+        if stages:
+            stages[-1][1].append(e)
+    return stages
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+
+def seek_patterns(events):
+    """Classifies reads by where they start relative to the previous read
+    of the same file."""
+    ends = {}
+    counts = dict(first=0, sequential=0, forward=0, backward=0)
+    for e in events:
+        if e.op != OP_READ:
+            continue
+        prev = ends.get(e.path)
+        if prev is None:
+            counts["first"] += 1
+        elif e.offset == prev:
+            counts["sequential"] += 1
+        elif e.offset > prev:
+            counts["forward"] += 1
+        else:
+            counts["backward"] += 1
+        ends[e.path] = e.offset + e.size
+    return counts
+
+
+def size_histogram(reads):
+    hist = [0] * len(SIZE_BUCKETS)
+    for e in reads:
+        for i, (limit, _) in enumerate(SIZE_BUCKETS):
+            if limit is None or e.size < limit:
+                hist[i] += 1
+                break
+    return hist
+
+
+def mb(n):
+    return n / 1048576.0
+
+
+def summary(events, dropped, gap_s, top):
+    stages = split_stages(events, gap_s)
+    if dropped:
+        print("warning: %d records were dropped while recording\n" % dropped)
+
+    for label, stage in stages:
+        reads = [e for e in stage if e.op == OP_READ]
+        opens = [e for e in stage if e.op == OP_OPEN]
+        if not reads and not opens:
+            continue
+        duration = (stage[-1].time - stage[0].time) / 1e6
+        total = sum(e.size for e in reads)
+        io_time = sum(e.latency for e in reads + opens) / 1e6
+        latencies = [e.latency for e in reads]
+        seeks = seek_patterns(stage)
+        hist = size_histogram(reads)
+
+        print("== %s: %.2fs, %d opens, %d reads, %.2f MB, %d files, %d threads"
+              % (label, duration, len(opens), len(reads), mb(total),
+                 len(set(e.path for e in reads)), len(set(e.thread for e in reads))))
+        print("   time in I/O %.2fs (%.1f MB/s), read latency p50 %dus p95 %dus max %dus"
+              % (io_time, mb(total) / io_time if io_time else 0,
+                 percentile(latencies, 0.5), percentile(latencies, 0.95),
+                 max(latencies) if latencies else 0))
+        print("   read sizes: " + "  ".join("%s %d" % (SIZE_BUCKETS[i][1], n) for i, n in enumerate(hist)))
+        print("   seeks: %d first reads, %d sequential, %d forward, %d backward, %d explicit"
+              % (seeks["first"], seeks["sequential"], seeks["forward"], seeks["backward"],
+                 sum(1 for e in stage if e.op == OP_SEEK)))
+
+    files = defaultdict(lambda: dict(bytes=0, reads=0, opens=0, latency=0.0, ranges=set()))
+    for e in events:
+        if e.op == OP_READ:
+            f = files[e.path]
+            f["bytes"] += e.size
+            f["reads"] += 1
+            f["latency"] += e.latency
+            f["ranges"].add((e.offset, e.size))
+        elif e.op == OP_OPEN:
+            files[e.path]["opens"] += 1
+
+    print("\n== hot files (by bytes read)")
+    print("%10s %7s %6s %8s %8s  %s" % ("MB", "reads", "opens", "I/O s", "reread", "path"))
+    hot = sorted(files.items(), key=lambda kv: kv[1]["bytes"], reverse=True)[:top]
+    for path, f in hot:
+        unique = sum(size for _, size in f["ranges"])
+        reread = 1.0 - unique / f["bytes"] if f["bytes"] else 0.0
+        print("%10.2f %7d %6d %8.2f %7.0f%%  %s"
+              % (mb(f["bytes"]), f["reads"], f["opens"], f["latency"] / 1e6, reread * 100, path))
+
+
+def export(events, gap_s, stage_index):
+    stages = split_stages(events, gap_s)
+    if stage_index is not None:
+        if not 1 <= stage_index <= len(stages):
+            raise SystemExit("there are %d stages" % len(stages))
+        stages = [stages[stage_index - 1]]
+    for _, stage in stages:
+        for e in stage:
+            if e.op == OP_READ and e.size > 0:
+                print("%s %d %d" % (e.path, e.offset, e.size))
+
+
+def main(argv):
+    args = argv[1:]
+    gap_s = 1.5
+    top = 20
+    stage = None
+
+    opts = {"--gap": None, "--top": None, "--stage": None}
+    rest = []
+    i = 0
+    while i < len(args):
+        if args[i] in opts and i + 1 < len(args):
+            opts[args[i]] = args[i + 1]
+            i += 2
+        else:
+            rest.append(args[i])
+            i += 1
+    if opts["--gap"]:
+        gap_s = float(opts["--gap"])
+    if opts["--top"]:
+        top = int(opts["--top"])
+    if opts["--stage"]:
+        stage = int(opts["--stage"])
+
+    if len(rest) != 2 or rest[0] not in ("summary", "export"):
+        print(__doc__)
+        return 1
+
+    events, _, dropped = load(rest[1])
+    if rest[0] == "summary":
+        summary(events, dropped, gap_s, top)
+    else:
+        export(events, gap_s, stage)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,440 @@
+#!/usr/bin/env python3
+"""
+Packs the extracted assets/ directory into a single assets.pak archive that
+AAssetManager reads through one shared file handle (see
+lib/AFakeNative/utils/asset_pack.h for the layout).
+
+Usage:
+  pack_assets.py pack     [--compress] [--chunk-size N] [--order TRACE [--gap S]]
+                          <assets dir> <assets.pak>
+  pack_assets.py bench    <assets dir> <assets.pak>
+  pack_assets.py simulate [--gap S] <assets dir> <trace>
+
+With --compress, assets are stored as independently deflated chunks of N
+bytes (default 65536) so the loader can seek inside them. Assets that don't
+shrink by at least 10% are stored as is.
+
+With --order, assets are stored in the order they were first opened or read
+in TRACE, stage by stage, followed by the ones the trace never touched. TRACE
+is an iotrace.bin from an IO_TRACE build or the output of
+`iotrace_analyze.py export`, and stages are split like iotrace_analyze.py
+does (marks, or pauses of more than S seconds). The stages are recorded in
+the archive, so that when the game opens the first asset of one, the loader
+reads the rest of it in a few large sequential reads.
+
+`simulate` replays the asset reads of a trace against a simple memory card
+model (per-command cost, extra cost for non-sequential requests, 32 KB
+blocks, bandwidth) for loose files and for archives packed by name, in trace
+order, and in trace order with stage loading, and reports requests,
+non-sequential requests, bytes transferred and estimated time.
+
+`bench` opens and reads every asset once as a loose file and once through
+the archive index, and reports files/s and MB/s for both. For compressed
+archives it also reports the MB/s read from the archive and decompressed.
+This is Python file I/O only; tests/asset_bench.cpp times the same layouts
+through AAssetManager itself.
+"""
+
+import os
+import struct
+import sys
+import time
+import zlib
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import iotrace_analyze
+
+MAGIC = 0x4B415041  # "APAK"
+VERSION = 1
+HEADER = struct.Struct("<IIII")
+ENTRY = struct.Struct("<IIQIIII")
+CHUNK_HEADER = struct.Struct("<II")
+ALIGNMENT = 16
+DEFAULT_CHUNK_SIZE = 64 * 1024
+
+COMPRESSION_NONE = 0
+COMPRESSION_DEFLATE = 1
+
+STAGES_NAME = ".stages"
+ASSETS_DIR = "/assets/"
+DEFAULT_GAP = 1.5
+STAGE_READ_SIZE = 1024 * 1024  # as in AAssetManager.cpp
+PREFETCH_MAX_BYTES = 32 * 1024 * 1024
+
+
+def fnv1a(name):
+    h = 2166136261
+    for b in name.encode("utf-8"):
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def list_assets(root):
+    names = []
+    for dirpath, _, files in os.walk(root):
+        for f in files:
+            full = os.path.join(dirpath, f)
+            names.append(os.path.relpath(full, root).replace(os.sep, "/"))
+    return sorted(names)
+
+
+def align(n):
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1)
+
+
+def compress_chunked(data, chunk_size):
+    chunks = [zlib.compress(data[i:i + chunk_size], 9) for i in range(0, len(data), chunk_size)]
+    offsets = []
+    pos = CHUNK_HEADER.size + 4 * (len(chunks) + 1)
+    for c in chunks:
+        offsets.append(pos)
+        pos += len(c)
+    offsets.append(pos)
+    return (CHUNK_HEADER.pack(chunk_size, len(chunks))
+            + struct.pack("<%dI" % len(offsets), *offsets)
+            + b"".join(chunks))
+
+
+def decompress_chunked(stored):
+    chunk_size, count = CHUNK_HEADER.unpack_from(stored, 0)
+    offsets = struct.unpack_from("<%dI" % (count + 1), stored, CHUNK_HEADER.size)
+    return b"".join(zlib.decompress(stored[offsets[i]:offsets[i + 1]]) for i in range(count))
+
+
+def pack(root, out_path, order=None, compress=False, chunk_size=DEFAULT_CHUNK_SIZE, extra=None):
+    """Writes the archive. Asset data is stored in `order` (default: by name),
+    the index is always sorted by (hash, name). `extra` maps names to data
+    stored uncompressed after the assets."""
+    extra = extra or {}
+    names = (order if order is not None else list_assets(root)) + list(extra)
+
+    name_table = bytearray()
+    name_offsets = {}
+    for n in names:
+        name_offsets[n] = len(name_table)
+        name_table += n.encode("utf-8") + b"\0"
+
+    data_start = align(HEADER.size + ENTRY.size * len(names) + len(name_table))
+
+    entries = {}
+    with open(out_path, "wb") as out:
+        out.seek(data_start)
+        for n in names:
+            if n in extra:
+                data = extra[n]
+            else:
+                with open(os.path.join(root, n), "rb") as f:
+                    data = f.read()
+            stored, compression = data, COMPRESSION_NONE
+            if compress and data and n not in extra:
+                packed = compress_chunked(data, chunk_size)
+                if len(packed) < len(data) * 0.9:
+                    stored, compression = packed, COMPRESSION_DEFLATE
+            offset = out.tell()
+            out.write(stored)
+            out.write(b"\0" * (align(len(stored)) - len(stored)))
+            entries[n] = (offset, len(data), len(stored), compression)
+
+        index = sorted(names, key=lambda n: (fnv1a(n), n.encode("utf-8")))
+        out.seek(0)
+        out.write(HEADER.pack(MAGIC, VERSION, len(names), len(name_table)))
+        for n in index:
+            offset, size, stored, compression = entries[n]
+            out.write(ENTRY.pack(fnv1a(n), name_offsets[n], offset, size, stored, compression, 0))
+        out.write(name_table)
+
+    raw = sum(e[1] for e in entries.values())
+    stored = sum(e[2] for e in entries.values())
+    print("packed %d assets into %s (%.1f MB -> %.1f MB)"
+          % (len(names), out_path, raw / 1048576.0, stored / 1048576.0))
+
+
+def asset_name(path):
+    """Name relative to assets/ of a traced path, or None."""
+    i = path.find(ASSETS_DIR)
+    return path[i + len(ASSETS_DIR):] if i >= 0 else None
+
+
+def load_trace(trace_path, gap_s):
+    """Returns [(label, [(op, asset name, offset, size)])], keeping only
+    asset opens and reads."""
+    with open(trace_path, "rb") as f:
+        binary = f.read(4) == struct.pack("<I", iotrace_analyze.MAGIC)
+
+    stages = []
+    if binary:
+        events, _, _ = iotrace_analyze.load(trace_path)
+        for label, stage in iotrace_analyze.split_stages(events, gap_s):
+            ops = [(e.op, asset_name(e.path), e.offset, e.size) for e in stage
+                   if e.op in (iotrace_analyze.OP_OPEN, iotrace_analyze.OP_READ)]
+            stages.append((label, [o for o in ops if o[1] is not None]))
+    else:
+        ops = []
+        with open(trace_path, "r", errors="replace") as f:
+            for line in f:
+                parts = line.split()
+                if len(parts) == 3 and parts[1].isdigit() and parts[2].isdigit():
+                    name = asset_name(parts[0])
+                    if name is not None:
+                        ops.append((iotrace_analyze.OP_READ, name, int(parts[1]), int(parts[2])))
+        stages.append(("trace", ops))
+    return [s for s in stages if s[1]]
+
+
+def trace_order(root, stages):
+    """Returns (order, [(label, names)]): every asset of `root` in first-access
+    order, stage by stage, then the untouched ones by name."""
+    existing = set(list_assets(root))
+    seen = set()
+    order = []
+    groups = []
+    for label, ops in stages:
+        names = []
+        for _, name, _, _ in ops:
+            if name in existing and name not in seen:
+                seen.add(name)
+                names.append(name)
+        order += names
+        groups.append((label, names))
+    order += [n for n in sorted(existing) if n not in seen]
+    return order, groups
+
+
+def stages_table(groups):
+    text = ""
+    for label, names in groups:
+        if len(names) < 2:
+            continue
+        text += "[%s]\n" % label.replace("\n", " ")
+        text += "".join(n + "\n" for n in names)
+    return text.encode("utf-8")
+
+
+def read_index(pak_path):
+    with open(pak_path, "rb") as f:
+        magic, version, count, names_size = HEADER.unpack(f.read(HEADER.size))
+        if magic != MAGIC or version != VERSION:
+            raise SystemExit("%s is not an asset archive" % pak_path)
+        raw = [ENTRY.unpack(f.read(ENTRY.size)) for _ in range(count)]
+        names = f.read(names_size)
+    index = {}
+    for hash_, name_off, offset, size, stored, compression, _ in raw:
+        end = names.index(b"\0", name_off)
+        index[names[name_off:end].decode("utf-8")] = (offset, size, stored, compression)
+    return index
+
+
+def bench(root, pak_path):
+    names = list_assets(root)
+
+    t = time.perf_counter()
+    total = 0
+    for n in names:
+        with open(os.path.join(root, n), "rb") as f:
+            total += len(f.read())
+    loose = time.perf_counter() - t
+
+    t = time.perf_counter()
+    index = read_index(pak_path)
+    fd = os.open(pak_path, os.O_RDONLY)
+    stored_total = 0
+    inflate_time = 0.0
+    for n in names:
+        offset, size, stored, compression = index[n]
+        data = os.pread(fd, stored, offset)
+        stored_total += len(data)
+        if compression == COMPRESSION_DEFLATE:
+            ti = time.perf_counter()
+            data = decompress_chunked(data)
+            inflate_time += time.perf_counter() - ti
+        if len(data) != size:
+            raise SystemExit("%s: size mismatch in archive" % n)
+    os.close(fd)
+    packed = time.perf_counter() - t
+
+    mb = total / (1024 * 1024)
+    stored_mb = stored_total / (1024 * 1024)
+    print("%d assets, %.1f MB (%.1f MB stored)" % (len(names), mb, stored_mb))
+    print("loose:  %.3fs  %8.0f files/s  %7.1f MB/s" % (loose, len(names) / loose, mb / loose))
+    print("packed: %.3fs  %8.0f files/s  %7.1f MB/s" % (packed, len(names) / packed, mb / packed))
+    if inflate_time > 0:
+        print("        %7.1f MB/s read from archive, %7.1f MB/s decompressed"
+              % (stored_mb / packed, mb / inflate_time))
+    print("note: drop the page cache between runs for cold numbers")
+
+
+class BlockDevice:
+    """Memory card model: reads whole blocks, keeps the last block read, and
+    pays a command cost per request plus a penalty when a request doesn't
+    start where the previous one ended."""
+
+    BLOCK = 32 * 1024
+    COMMAND_MS = 0.25
+    SEEK_MS = 0.6
+    MB_PER_S = 40.0
+
+    def __init__(self):
+        self.requests = 0
+        self.seeks = 0
+        self.bytes = 0
+        self.ms = 0.0
+        self.next_block = None
+        self.cached_block = None
+
+    def read(self, offset, size):
+        if size <= 0:
+            return
+        first = offset // self.BLOCK
+        last = (offset + size - 1) // self.BLOCK
+        if first == self.cached_block:
+            first += 1
+        if first > last:
+            return
+        self.requests += 1
+        if first != self.next_block:
+            self.seeks += 1
+            self.ms += self.SEEK_MS
+        n = (last - first + 1) * self.BLOCK
+        self.bytes += n
+        self.ms += self.COMMAND_MS + n / (self.MB_PER_S * 1048576.0) * 1000.0
+        self.next_block = last + 1
+        self.cached_block = last
+
+
+def layout(names, sizes, start, alignment):
+    offsets = {}
+    pos = start
+    for n in names:
+        pos = (pos + alignment - 1) // alignment * alignment
+        offsets[n] = pos
+        pos += sizes[n]
+    return offsets
+
+
+def replay(stages, offsets, sizes, open_blocks=0, stage_groups=None):
+    """Replays `stages` against a fresh device. Returns (device, [ms per stage]).
+    With open_blocks, every open also reads that many far-away blocks
+    (directory lookups of loose files, which are assumed to be stored back to
+    back in name order, a best case). With stage_groups, opening the first
+    asset of a group reads the rest of it in STAGE_READ_SIZE requests and
+    serves it from memory, like the loader does."""
+    dev = BlockDevice()
+    starts = {}
+    for _, names in stage_groups or []:
+        if len(names) >= 2:
+            starts[names[0]] = names[1:]
+    in_memory = set()
+    per_stage = []
+    fs_block = 1 << 40
+
+    for _, ops in stages:
+        before = dev.ms
+        for op, name, offset, size in ops:
+            if name not in offsets:
+                continue
+            if op == iotrace_analyze.OP_OPEN:
+                for _ in range(open_blocks):
+                    fs_block += 7
+                    dev.read(fs_block * BlockDevice.BLOCK, 1)
+            if name in starts:
+                # First access of the first asset of a stage: the loader
+                # reads the rest of it ahead
+                rest, budget = [], PREFETCH_MAX_BYTES
+                for n in starts.pop(name):
+                    if n in in_memory:
+                        continue
+                    if sizes[n] > budget:
+                        break
+                    budget -= sizes[n]
+                    rest.append(n)
+                if rest:
+                    pos = offsets[rest[0]]
+                    end = max(offsets[n] + sizes[n] for n in rest)
+                    while pos < end:
+                        n = min(STAGE_READ_SIZE, end - pos)
+                        dev.read(pos, n)
+                        pos += n
+                    in_memory.update(rest)
+            if op == iotrace_analyze.OP_READ and name not in in_memory:
+                dev.read(offsets[name] + offset, min(size, max(0, sizes[name] - offset)))
+        per_stage.append(dev.ms - before)
+    return dev, per_stage
+
+
+def simulate(root, trace_path, gap_s):
+    stages = load_trace(trace_path, gap_s)
+    if not stages:
+        raise SystemExit("no asset reads in %s" % trace_path)
+
+    names = list_assets(root)
+    sizes = {n: os.path.getsize(os.path.join(root, n)) for n in names}
+    order, groups = trace_order(root, stages)
+    index_size = HEADER.size + ENTRY.size * len(names) + sum(len(n) + 1 for n in names)
+
+    scenarios = [
+        ("loose files", layout(names, sizes, 0, BlockDevice.BLOCK), 2, None),
+        ("packed by name", layout(names, sizes, index_size, ALIGNMENT), 0, None),
+        ("packed in trace order", layout(order, sizes, index_size, ALIGNMENT), 0, None),
+        ("trace order + stages", layout(order, sizes, index_size, ALIGNMENT), 0, groups),
+    ]
+
+    reads = sum(1 for _, ops in stages for o in ops if o[0] == iotrace_analyze.OP_READ)
+    print("%d stages, %d asset reads, %d assets touched of %d"
+          % (len(stages), reads, sum(len(g[1]) for g in groups), len(names)))
+    print("device: %d KB blocks, %.2f ms/command, %.2f ms/seek, %.0f MB/s\n"
+          % (BlockDevice.BLOCK // 1024, BlockDevice.COMMAND_MS, BlockDevice.SEEK_MS, BlockDevice.MB_PER_S))
+    print("%-24s %9s %9s %9s %10s" % ("layout", "requests", "seeks", "MB", "est. time"))
+
+    results = []
+    for label, offsets, open_blocks, stage_groups in scenarios:
+        dev, per_stage = replay(stages, offsets, sizes, open_blocks, stage_groups)
+        results.append(per_stage)
+        print("%-24s %9d %9d %9.1f %9.2fs"
+              % (label, dev.requests, dev.seeks, dev.bytes / 1048576.0, dev.ms / 1000.0))
+
+    print("\n%-24s %10s %10s" % ("stage", "loose", "stages"))
+    for i, (label, _) in enumerate(stages):
+        print("%-24s %9.2fs %9.2fs" % (label[:24], results[0][i] / 1000.0, results[-1][i] / 1000.0))
+
+
+def main(argv):
+    args = argv[1:]
+    compress = False
+    chunk_size = DEFAULT_CHUNK_SIZE
+    trace = None
+    gap_s = DEFAULT_GAP
+    if "--compress" in args:
+        args.remove("--compress")
+        compress = True
+    if "--chunk-size" in args:
+        i = args.index("--chunk-size")
+        chunk_size = int(args[i + 1])
+        del args[i:i + 2]
+    if "--order" in args:
+        i = args.index("--order")
+        trace = args[i + 1]
+        del args[i:i + 2]
+    if "--gap" in args:
+        i = args.index("--gap")
+        gap_s = float(args[i + 1])
+        del args[i:i + 2]
+
+    if len(args) != 3 or args[0] not in ("pack", "bench", "simulate"):
+        print(__doc__)
+        return 1
+    if args[0] == "pack":
+        order, extra = None, None
+        if trace:
+            order, groups = trace_order(args[1], load_trace(trace, gap_s))
+            extra = {STAGES_NAME: stages_table(groups)}
+        pack(args[1], args[2], order=order, compress=compress, chunk_size=chunk_size, extra=extra)
+    elif args[0] == "bench":
+        bench(args[1], args[2])
+    else:
+        simulate(args[1], args[2], gap_s)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
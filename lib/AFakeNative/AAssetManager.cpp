@@ -1,25 +1,311 @@
 #include "AAssetManager.h"
 #include "AFakeNative_Utils.h"
+#include "AFakeNative/utils/asset_pack.h"
 
 #include <pthread.h>
 #include <malloc.h>
 #include <cstring>
 #include <cstdio>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <psp2/io/fcntl.h>
 #include <libc_bridge/libc_bridge.h>
+#include <fios/fios.h>
+#include "utils/allocprof.h"
+#include "utils/iotrace.h"
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#define ASSETS_PATH DATA_PATH "assets/"
+
+// Size of each of the two read-ahead buffers of a sequentially read asset.
+#define READAHEAD_CHUNK_SIZE (128 * 1024)
+
+// Consecutive reads starting where the previous one ended before an asset is
+// considered to be read sequentially.
+#define READAHEAD_SEQUENTIAL_READS 2
+
+// Memory that can be held by prefetched assets nobody opened yet.
+#define PREFETCH_MAX_BYTES (32 * 1024 * 1024)
+
+// Largest single read issued when loading a stage of the asset archive.
+#define STAGE_READ_SIZE (1024 * 1024)
+
+#define IO_QUEUE_SIZE 64
 
 typedef struct assetManager {
     int dummy = 0; // TODO: mb we will need to store something here in future
     pthread_mutex_t mLock;
 } assetManager;
 
+// Whole-asset buffer returned by AAsset_getBuffer. Loaded once and shared by
+// all open assets of the same file until the last one of them is closed.
+typedef struct assetBuffer {
+    std::string filename;
+    void * data;
+    int64_t length;
+    int refs;
+    bool prefetched; // loaded by AAssetManager_prefetch and not opened yet
+} assetBuffer;
+
+enum {
+    READAHEAD_EMPTY,
+    READAHEAD_PENDING,
+    READAHEAD_READY,
+};
+
+typedef struct readAheadBuffer {
+    int state;      // guarded by g_ioLock
+    int64_t offset;
+    int size;       // valid bytes once READY
+    uint8_t * data;
+} readAheadBuffer;
+
+// Read-ahead state of an asset. The I/O thread uses its own readers so it
+// never touches the FILE / stream used on the game thread.
+typedef struct readAhead {
+    readAheadBuffer buffers[2];
+    int64_t nextOffset;       // where the next scheduled buffer starts
+    assetPackStream * stream; // packed assets
+    SceUID fd;                // loose files
+} readAhead;
+
 typedef struct aAsset {
     char * filename;
-    FILE* f;
+    FILE* f;                      // loose file, or NULL if the asset is packed
+    const assetPackEntry * entry; // packed asset, or NULL if it is a loose file
+    assetPackStream * stream;     // reader for `entry`
+    int64_t length;
+    int64_t pos;
+    assetBuffer * buffer;
+
+    int mode;
+    int64_t lastReadEnd;
+    int sequentialReads;
+    bool filePosValid; // false once reads were served without moving `f`
+    readAhead * ra;
+    uint32_t traceId;
 } asset;
 
+typedef struct aAssetDir {
+    std::vector<std::string> names;
+    size_t next;
+} assetDir;
+
 static AAssetManager * g_AAssetManager = nullptr;
 
+static pthread_mutex_t g_bufferLock = PTHREAD_MUTEX_INITIALIZER;
+static std::unordered_map<std::string, assetBuffer *> g_buffers; // guarded by g_bufferLock
+static std::vector<assetBuffer *> g_prefetched;                  // guarded by g_bufferLock, oldest first
+static int64_t g_prefetchedBytes = 0;                            // guarded by g_bufferLock
+
+enum {
+    IO_JOB_READAHEAD,
+    IO_JOB_PREFETCH,
+    IO_JOB_STAGE,
+};
+
+typedef struct ioJob {
+    int type;
+    aAsset * asset;          // IO_JOB_READAHEAD
+    readAheadBuffer * buffer;
+    char * filename;         // IO_JOB_PREFETCH
+    const assetPackStage * stage; // IO_JOB_STAGE
+} ioJob;
+
+static pthread_mutex_t g_ioLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_ioWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_ioDone = PTHREAD_COND_INITIALIZER;
+static ioJob g_ioQueue[IO_QUEUE_SIZE]; // guarded by g_ioLock
+static size_t g_ioQueueHead = 0;
+static size_t g_ioQueueCount = 0;
+static AAssetIoStats g_ioStats;        // guarded by g_ioLock
+static const assetPackStage * g_lastStage = nullptr; // guarded by g_ioLock
+
+static void loadPrefetch(const char * filename);
+static void loadStage(const assetPackStage * stage);
+static void queueStage(const assetPackStage * stage);
+
+// Must be called with g_ioLock held. Returns false if the queue is full.
+static bool queueJobLocked(const ioJob& job) {
+    if (g_ioQueueCount == IO_QUEUE_SIZE) return false;
+    g_ioQueue[(g_ioQueueHead + g_ioQueueCount) % IO_QUEUE_SIZE] = job;
+    g_ioQueueCount++;
+    pthread_cond_signal(&g_ioWork);
+    return true;
+}
+
+static int readAheadSource(readAhead * ra, int64_t offset, void * buf, size_t count) {
+    if (ra->stream) return asset_pack_stream_read(ra->stream, (uint64_t) offset, buf, count);
+    return sceIoPread(ra->fd, buf, count, offset);
+}
+
+static void * io_thread(void * arg) {
+    while (true) {
+        pthread_mutex_lock(&g_ioLock);
+        while (g_ioQueueCount == 0) {
+            pthread_cond_wait(&g_ioWork, &g_ioLock);
+        }
+        ioJob job = g_ioQueue[g_ioQueueHead];
+        g_ioQueueHead = (g_ioQueueHead + 1) % IO_QUEUE_SIZE;
+        g_ioQueueCount--;
+        pthread_mutex_unlock(&g_ioLock);
+
+        if (job.type == IO_JOB_READAHEAD) {
+            readAheadBuffer * b = job.buffer;
+            int ret = readAheadSource(job.asset->ra, b->offset, b->data, READAHEAD_CHUNK_SIZE);
+
+            pthread_mutex_lock(&g_ioLock);
+            b->size = ret > 0 ? ret : 0;
+            b->state = READAHEAD_READY;
+            g_ioStats.readAheadBytes += b->size;
+            pthread_cond_broadcast(&g_ioDone);
+            pthread_mutex_unlock(&g_ioLock);
+        } else if (job.type == IO_JOB_PREFETCH) {
+            loadPrefetch(job.filename);
+            free(job.filename);
+        } else if (job.type == IO_JOB_STAGE) {
+            loadStage(job.stage);
+        }
+    }
+    return nullptr;
+}
+
+// Must be called with g_ioLock held.
+static void scheduleReadAheadLocked(aAsset * a, readAheadBuffer * b) {
+    b->offset = a->ra->nextOffset;
+    b->size = 0;
+    if (b->offset >= a->length) {
+        b->state = READAHEAD_EMPTY;
+        return;
+    }
+
+    ioJob job = {.type = IO_JOB_READAHEAD, .asset = a, .buffer = b, .filename = nullptr};
+    if (queueJobLocked(job)) {
+        b->state = READAHEAD_PENDING;
+        a->ra->nextOffset += READAHEAD_CHUNK_SIZE;
+    } else {
+        b->state = READAHEAD_EMPTY;
+    }
+}
+
+// Must be called with g_ioLock held.
+static void waitReadAheadIdleLocked(aAsset * a) {
+    for (auto & b : a->ra->buffers) {
+        while (b.state == READAHEAD_PENDING) {
+            pthread_cond_wait(&g_ioDone, &g_ioLock);
+        }
+    }
+}
+
+static bool startReadAhead(aAsset * a) {
+    auto * ra = (readAhead *) calloc(1, sizeof(readAhead));
+    ra->fd = -1;
+
+    if (a->entry) {
+        ra->stream = asset_pack_stream_open(a->entry);
+    } else {
+        ra->fd = sceIoOpen(a->filename, SCE_O_RDONLY, 0);
+    }
+    ra->buffers[0].data = (uint8_t *) malloc(READAHEAD_CHUNK_SIZE);
+    ra->buffers[1].data = (uint8_t *) malloc(READAHEAD_CHUNK_SIZE);
+
+    if ((!ra->stream && ra->fd < 0) || !ra->buffers[0].data || !ra->buffers[1].data) {
+        asset_pack_stream_close(ra->stream);
+        if (ra->fd >= 0) sceIoClose(ra->fd);
+        free(ra->buffers[0].data);
+        free(ra->buffers[1].data);
+        free(ra);
+        return false;
+    }
+
+    a->ra = ra;
+    return true;
+}
+
+static void stopReadAhead(aAsset * a) {
+    readAhead * ra = a->ra;
+    if (!ra) return;
+
+    pthread_mutex_lock(&g_ioLock);
+    waitReadAheadIdleLocked(a);
+    pthread_mutex_unlock(&g_ioLock);
+
+    asset_pack_stream_close(ra->stream);
+    if (ra->fd >= 0) sceIoClose(ra->fd);
+    free(ra->buffers[0].data);
+    free(ra->buffers[1].data);
+    free(ra);
+    a->ra = nullptr;
+}
+
+/*
+ * Serves a sequential read from the read-ahead buffers, refilling each buffer
+ * in the background as soon as it has been consumed. Returns the number of
+ * bytes read or -1 if read-ahead can't be used for this asset.
+ */
+static int readAheadRead(aAsset * a, void * buf, size_t count) {
+    if (!a->ra && !startReadAhead(a)) return -1;
+    readAhead * ra = a->ra;
+
+    auto * out = (uint8_t *) buf;
+    size_t done = 0;
+    int64_t pos = a->pos;
+
+    pthread_mutex_lock(&g_ioLock);
+    while (done < count && pos < a->length) {
+        readAheadBuffer * b = nullptr;
+        for (auto & candidate : ra->buffers) {
+            if (candidate.state != READAHEAD_EMPTY && candidate.offset <= pos
+                && pos < candidate.offset + READAHEAD_CHUNK_SIZE) {
+                b = &candidate;
+            }
+        }
+
+        if (!b) {
+            // Nothing buffered here (first read or the game jumped): restart
+            // both buffers from the current position.
+            g_ioStats.readAheadMisses++;
+            waitReadAheadIdleLocked(a);
+            ra->nextOffset = pos;
+            scheduleReadAheadLocked(a, &ra->buffers[0]);
+            scheduleReadAheadLocked(a, &ra->buffers[1]);
+            if (ra->buffers[0].state != READAHEAD_PENDING) break;
+            continue;
+        }
+
+        while (b->state == READAHEAD_PENDING) {
+            pthread_cond_wait(&g_ioDone, &g_ioLock);
+        }
+
+        if (pos >= b->offset + b->size) break; // short read, EOF or error
+
+        size_t n = (size_t) (b->offset + b->size - pos);
+        if (n > count - done) n = count - done;
+        memcpy(out + done, b->data + (pos - b->offset), n);
+        done += n;
+        pos += (int64_t) n;
+        g_ioStats.readAheadHits++;
+
+        if (pos >= b->offset + b->size) {
+            scheduleReadAheadLocked(a, b);
+        }
+    }
+    pthread_mutex_unlock(&g_ioLock);
+
+    if (done == 0 && pos < a->length) {
+        // I/O queue full or background read failed, let the caller read directly
+        return -1;
+    }
+
+    a->pos = pos;
+    a->filePosValid = false;
+    return (int) done;
+}
+
 AAssetManager * AAssetManager_create() {
     if (g_AAssetManager) return g_AAssetManager;
 
@@ -30,43 +316,163 @@ AAssetManager * AAssetManager_create() {
     g_AAssetManager = (AAssetManager *) malloc(sizeof(assetManager));
     memcpy(g_AAssetManager, &am, sizeof(assetManager));
 
+    if (asset_pack_init(ASSET_PACK_PATH)) {
+        ALOGD("[AAssetManager] Using packed assets from %s", ASSET_PACK_PATH);
+    }
+
+    pthread_t t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64*1024);
+    pthread_create(&t, &attr, io_thread, nullptr);
+    pthread_detach(t);
+
     return g_AAssetManager;
 }
 
+// Must be called with g_bufferLock held. Makes `a` share `b`, taking it off
+// the prefetched list so that it can no longer be evicted.
+static void claimBufferLocked(aAsset * a, assetBuffer * b) {
+    if (b->prefetched) {
+        b->prefetched = false;
+        g_prefetched.erase(std::find(g_prefetched.begin(), g_prefetched.end(), b));
+        g_prefetchedBytes -= b->length;
+
+        pthread_mutex_lock(&g_ioLock);
+        g_ioStats.prefetchHits++;
+        pthread_mutex_unlock(&g_ioLock);
+    }
+    b->refs++;
+    a->buffer = b;
+}
+
+// Shares a buffer already loaded for this asset, prefetched or opened by
+// someone else, so that reads are served from memory.
+static void attachLoadedBuffer(aAsset * a) {
+    pthread_mutex_lock(&g_bufferLock);
+    auto it = g_buffers.find(a->filename);
+    if (it != g_buffers.end()) {
+        claimBufferLocked(a, it->second);
+    }
+    pthread_mutex_unlock(&g_bufferLock);
+}
+
+// Assets are traced under their loose file path, packed or not.
+static uint32_t assetTraceId(const aAsset * a) {
+#ifdef IO_TRACE
+    if (a->entry) return iotrace_path_id((std::string(ASSETS_PATH) + a->filename).c_str());
+    return iotrace_path_id(a->filename);
+#else
+    return 0;
+#endif
+}
+
+static void initAssetState(aAsset * a, int mode, uint64_t openStart) {
+    a->traceId = assetTraceId(a);
+    iotrace_record(IOTRACE_OP_OPEN, a->traceId, 0, 1, openStart);
+    a->pos = 0;
+    a->buffer = nullptr;
+    a->mode = mode;
+    a->lastReadEnd = 0;
+    a->sequentialReads = 0;
+    a->filePosValid = true;
+    a->ra = nullptr;
+    attachLoadedBuffer(a);
+}
+
 AAsset* AAssetManager_open(AAssetManager* mgr, const char* filename, int mode) {
-    std::string realp = std::string(DATA_PATH) + std::string("assets/") + std::string(filename);
+    uint64_t start = iotrace_now();
+
+    // Packed assets are resolved through the in-memory index, without
+    // touching the filesystem at all.
+    const assetPackEntry * entry = asset_pack_find(filename);
+    if (entry) {
+        assetPackStream * stream = asset_pack_stream_open(entry);
+        if (!stream) return nullptr;
+
+        auto * a = (aAsset *) malloc(sizeof(aAsset));
+        a->filename = strdup(filename);
+        a->f = nullptr;
+        a->entry = entry;
+        a->stream = stream;
+        a->length = entry->size;
+        initAssetState(a, mode, start);
+
+        // First asset of a stage recorded at packing time: load the rest of
+        // it in the background with a few large sequential reads.
+        const assetPackStage * stage = asset_pack_stage_starting_with(entry);
+        if (stage) queueStage(stage);
+
+        return (AAsset *) a;
+    }
+
+    std::string realp = std::string(ASSETS_PATH) + std::string(filename);
+
+    struct stat st{};
+    if (stat(realp.c_str(), &st) != 0 || S_ISDIR(st.st_mode)) {
+        ALOGD("[AAssetManager] AAssetManager_open(%p, %s, %i): not found", mgr, realp.c_str(), mode);
+        return nullptr;
+    }
 
     auto * a = (aAsset *) malloc(sizeof(aAsset));
     a->filename = (char *) malloc(realp.length() + 1);
     strcpy(a->filename, realp.c_str());
+    a->entry = nullptr;
+    a->stream = nullptr;
+    a->length = st.st_size;
 
 #ifdef USE_SCELIBC_IO
     a->f = sceLibcBridge_fopen((const char *)a->filename, "r");
 #else
-    a->f = fopen((cost char *)a->filename, "r");
+    a->f = fopen((const char *)a->filename, "r");
 #endif
 
     if (!a->f) {
         free(a->filename);
         free(a);
         a = nullptr;
+    } else {
+        initAssetState(a, mode, start);
     }
 
     ALOGD("[AAssetManager] AAssetManager_open(%p, %s, %i): %p", mgr, realp.c_str(), mode, a);
     return (AAsset *) a;
 }
 
+static void releaseBuffer(assetBuffer * b) {
+    pthread_mutex_lock(&g_bufferLock);
+    if (--b->refs == 0) {
+        g_buffers.erase(b->filename);
+        free(b->data);
+        delete b;
+    }
+    pthread_mutex_unlock(&g_bufferLock);
+}
+
 void AAsset_close(AAsset* asset) {
     //ALOGD("AAsset_close(%p)", asset);
 
     if (asset) {
         auto * a = (aAsset *) asset;
+        iotrace_record(IOTRACE_OP_CLOSE, a->traceId, 0, 0, iotrace_now());
+        stopReadAhead(a);
+        if (a->buffer) releaseBuffer(a->buffer);
+        asset_pack_stream_close(a->stream);
         free(a->filename);
-        fclose(a->f);
+        if (a->f) {
+#ifdef USE_SCELIBC_IO
+            sceLibcBridge_fclose(a->f);
+#else
+            fclose(a->f);
+#endif
+        }
         free(a);
     }
 }
 
+static int readDirect(aAsset * a, void * buf, size_t count);
+static int readAsset(aAsset * a, void * buf, size_t count);
+
 int AAsset_read(AAsset* asset, void* buf, size_t count) {
     //ALOGD("AAsset_read(%p, %p, %i)", asset, buf, count);
 
@@ -75,14 +481,76 @@ int AAsset_read(AAsset* asset, void* buf, size_t count) {
     }
 
     auto * a = (aAsset *) asset;
+#ifdef IO_TRACE
+    uint64_t start = iotrace_now();
+    int64_t offset = a->pos;
+    int ret = readAsset(a, buf, count);
+    iotrace_record(IOTRACE_OP_READ, a->traceId, (uint64_t) offset, ret > 0 ? (uint32_t) ret : 0, start);
+    return ret;
+#else
+    return readAsset(a, buf, count);
+#endif
+}
+
+static int readAsset(aAsset * a, void * buf, size_t count) {
+    if (a->buffer) {
+        // Already have everything in memory, no need to go to the card again.
+        int64_t remaining = a->length - a->pos;
+        if (remaining <= 0) return 0;
+        if ((int64_t) count > remaining) count = (size_t) remaining;
+        memcpy(buf, (const char *) a->buffer->data + a->pos, count);
+        a->pos += (int64_t) count;
+        return (int) count;
+    }
+
+    if (a->pos == a->lastReadEnd) {
+        a->sequentialReads++;
+    } else {
+        a->sequentialReads = 0;
+    }
+
+    bool sequential = a->mode == AASSET_MODE_STREAMING
+                      || (a->mode != AASSET_MODE_RANDOM && a->sequentialReads >= READAHEAD_SEQUENTIAL_READS);
+    if (sequential && a->length > READAHEAD_CHUNK_SIZE) {
+        int ret = readAheadRead(a, buf, count);
+        if (ret >= 0) {
+            a->lastReadEnd = a->pos;
+            return ret;
+        }
+    }
+
+    int ret = readDirect(a, buf, count);
+    if (ret > 0) a->lastReadEnd = a->pos;
+    return ret;
+}
+
+static int readDirect(aAsset * a, void * buf, size_t count) {
+    if (a->entry) {
+        int ret = asset_pack_stream_read(a->stream, (uint64_t) a->pos, buf, count);
+        if (ret > 0) a->pos += ret;
+        return ret;
+    }
+
+    if (!a->filePosValid) {
+#ifdef USE_SCELIBC_IO
+        sceLibcBridge_fseek(a->f, (long) a->pos, SEEK_SET);
+#else
+        fseek(a->f, (long) a->pos, SEEK_SET);
+#endif
+        a->filePosValid = true;
+    }
 
 #ifdef USE_SCELIBC_IO
     size_t ret = sceLibcBridge_fread(buf, 1, count, a->f);
+#ifdef FIOS_CACHE_MODEL
+    if (ret > 0) fios_cache_account(a->filename, (uint64_t) a->pos, ret);
+#endif
 #else
     size_t ret = fread(buf, 1, count, a->f);
 #endif
 
     if (ret > 0) {
+        a->pos += (int64_t) ret;
         return (int) ret;
     } else {
 #ifdef USE_SCELIBC_IO
@@ -97,20 +565,410 @@ int AAsset_read(AAsset* asset, void* buf, size_t count) {
     }
 }
 
-off_t AAsset_seek(AAsset* asset, off_t offset, int whence) {
-    //ALOGD("AAsset_seek(%p, %d, %i)", asset, offset, whence);
+int64_t AAsset_seek64(AAsset* asset, int64_t offset, int whence) {
+    //ALOGD("AAsset_seek64(%p, %lld, %i)", asset, offset, whence);
 
     if (!asset) {
-        return (off_t) -1;
+        return -1;
     }
 
     auto * a = (aAsset *) asset;
 
+    int64_t newPos;
+    switch (whence) {
+        case SEEK_SET: newPos = offset; break;
+        case SEEK_CUR: newPos = a->pos + offset; break;
+        case SEEK_END: newPos = a->length + offset; break;
+        default: return -1;
+    }
+
+    if (newPos < 0 || newPos > a->length) {
+        return -1;
+    }
+
+    // Reads from the shared buffer or the archive don't use a file position
+    if (!a->buffer && a->f) {
 #ifdef USE_SCELIBC_IO
-    auto ret = (off_t) sceLibcBridge_fseek(a->f, offset, whence);
+        int ret = sceLibcBridge_fseek(a->f, (long) newPos, SEEK_SET);
 #else
-    auto ret = (off_t) fseek(a->f, offset, whence);
+        int ret = fseek(a->f, (long) newPos, SEEK_SET);
 #endif
+        if (ret != 0) return -1;
+        a->filePosValid = true;
+    }
 
-    return ret;
+    iotrace_record(IOTRACE_OP_SEEK, a->traceId, (uint64_t) newPos, 0, iotrace_now());
+    a->pos = newPos;
+    return newPos;
+}
+
+off_t AAsset_seek(AAsset* asset, off_t offset, int whence) {
+    return (off_t) AAsset_seek64(asset, offset, whence);
+}
+
+const void* AAsset_getBuffer(AAsset* asset) {
+    if (!asset) return nullptr;
+    auto * a = (aAsset *) asset;
+
+    if (a->buffer) return a->buffer->data;
+
+    // Prefetched, or opened by someone else, since this asset was opened
+    pthread_mutex_lock(&g_bufferLock);
+    auto it = g_buffers.find(a->filename);
+    if (it != g_buffers.end()) {
+        claimBufferLocked(a, it->second);
+        pthread_mutex_unlock(&g_bufferLock);
+        return a->buffer->data;
+    }
+    pthread_mutex_unlock(&g_bufferLock);
+
+    // Not loaded by anyone yet: read the whole file through our own handle.
+    // Allocate at least one byte so empty assets still get a valid pointer.
+    void * data = malloc(a->length > 0 ? (size_t) a->length : 1);
+    if (!data) {
+        ALOGE("[AAssetManager] AAsset_getBuffer(%p): can't allocate %lld bytes", asset, a->length);
+        return nullptr;
+    }
+
+    int64_t read;
+    if (a->entry) {
+        read = asset_pack_stream_read(a->stream, 0, data, (size_t) a->length);
+    } else {
+#ifdef USE_SCELIBC_IO
+        sceLibcBridge_fseek(a->f, 0, SEEK_SET);
+        read = (int64_t) sceLibcBridge_fread(data, 1, (size_t) a->length, a->f);
+#ifdef FIOS_CACHE_MODEL
+        if (read > 0) fios_cache_account(a->filename, 0, (size_t) read);
+#endif
+#else
+        fseek(a->f, 0, SEEK_SET);
+        read = (int64_t) fread(data, 1, (size_t) a->length, a->f);
+#endif
+    }
+
+    if (read != a->length) {
+        ALOGE("[AAssetManager] AAsset_getBuffer(%p): short read of %s", asset, a->filename);
+        free(data);
+        a->filePosValid = false;
+        return nullptr;
+    }
+
+    pthread_mutex_lock(&g_bufferLock);
+    it = g_buffers.find(a->filename);
+    if (it != g_buffers.end()) {
+        // Loaded by a prefetch or another open asset while we were reading
+        free(data);
+        claimBufferLocked(a, it->second);
+    } else {
+        auto * b = new assetBuffer;
+        b->filename = a->filename;
+        b->data = data;
+        b->length = a->length;
+        b->refs = 1;
+        b->prefetched = false;
+        g_buffers[b->filename] = b;
+        a->buffer = b;
+    }
+    pthread_mutex_unlock(&g_bufferLock);
+    return a->buffer->data;
+}
+
+int64_t AAsset_getLength64(AAsset* asset) {
+    if (!asset) return -1;
+    return ((aAsset *) asset)->length;
+}
+
+off_t AAsset_getLength(AAsset* asset) {
+    return (off_t) AAsset_getLength64(asset);
+}
+
+int64_t AAsset_getRemainingLength64(AAsset* asset) {
+    if (!asset) return -1;
+    auto * a = (aAsset *) asset;
+    return a->length - a->pos;
+}
+
+off_t AAsset_getRemainingLength(AAsset* asset) {
+    return (off_t) AAsset_getRemainingLength64(asset);
+}
+
+int AAsset_openFileDescriptor64(AAsset* asset, int64_t* outStart, int64_t* outLength) {
+    if (!asset) return -1;
+    auto * a = (aAsset *) asset;
+
+    if (a->entry && a->entry->compression != ASSET_PACK_COMPRESSION_NONE) {
+        return -1;
+    }
+
+    const char * path = a->entry ? ASSET_PACK_PATH : a->filename;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ALOGE("[AAssetManager] AAsset_openFileDescriptor(%p): can't open %s", asset, path);
+        return -1;
+    }
+
+    if (outStart) *outStart = a->entry ? (int64_t) a->entry->offset : 0;
+    if (outLength) *outLength = a->length;
+    return fd;
+}
+
+int AAsset_openFileDescriptor(AAsset* asset, off_t* outStart, off_t* outLength) {
+    int64_t start, length;
+    int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+    if (fd >= 0) {
+        if (outStart) *outStart = (off_t) start;
+        if (outLength) *outLength = (off_t) length;
+    }
+    return fd;
+}
+
+int AAsset_isAllocated(AAsset* asset) {
+    return asset && ((aAsset *) asset)->buffer != nullptr;
+}
+
+AAssetDir* AAssetManager_openDir(AAssetManager* mgr, const char* dirName) {
+    std::string dirp = std::string(ASSETS_PATH) + std::string(dirName ? dirName : "");
+
+    auto * d = new aAssetDir;
+    d->next = 0;
+
+    DIR * dir = opendir(dirp.c_str());
+    if (dir) {
+        struct dirent * entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            // Like on Android, only files are listed, not subdirectories
+            std::string path = dirp + "/" + entry->d_name;
+            struct stat st{};
+            if (stat(path.c_str(), &st) == 0 && !S_ISDIR(st.st_mode)) {
+                d->names.emplace_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+
+    // Packed assets directly inside dirName
+    std::string prefix = (dirName && dirName[0]) ? std::string(dirName) + "/" : std::string();
+    const assetPackEntry * e;
+    for (size_t i = 0; (e = asset_pack_entry(i)) != nullptr; i++) {
+        const char * name = asset_pack_name(e);
+        if (strcmp(name, ASSET_PACK_STAGES_NAME) == 0) continue;
+        if (strncmp(name, prefix.c_str(), prefix.length()) != 0) continue;
+        if (strchr(name + prefix.length(), '/')) continue;
+        d->names.emplace_back(name + prefix.length());
+    }
+
+    std::sort(d->names.begin(), d->names.end());
+    d->names.erase(std::unique(d->names.begin(), d->names.end()), d->names.end());
+
+    ALOGD("[AAssetManager] AAssetManager_openDir(%p, %s): %i files", mgr, dirp.c_str(), (int) d->names.size());
+    return (AAssetDir *) d;
+}
+
+const char* AAssetDir_getNextFileName(AAssetDir* assetDir) {
+    if (!assetDir) return nullptr;
+    auto * d = (aAssetDir *) assetDir;
+
+    if (d->next >= d->names.size()) return nullptr;
+    return d->names[d->next++].c_str();
+}
+
+void AAssetDir_rewind(AAssetDir* assetDir) {
+    if (!assetDir) return;
+    ((aAssetDir *) assetDir)->next = 0;
+}
+
+void AAssetDir_close(AAssetDir* assetDir) {
+    delete (aAssetDir *) assetDir;
+}
+
+// Adds a buffer loaded ahead of time, taking ownership of `data`. Returns
+// false (and frees `data`) if the asset got loaded in the meantime.
+static bool addPrefetched(const std::string& key, void * data, int64_t length) {
+    pthread_mutex_lock(&g_bufferLock);
+    if (g_buffers.find(key) != g_buffers.end()) {
+        // Opened and loaded by the game in the meantime
+        pthread_mutex_unlock(&g_bufferLock);
+        free(data);
+        return false;
+    }
+
+    auto * b = new assetBuffer;
+    b->filename = key;
+    b->data = data;
+    b->length = length;
+    b->refs = 0;
+    b->prefetched = true;
+    g_buffers[key] = b;
+    g_prefetched.push_back(b);
+    g_prefetchedBytes += length;
+
+    // Oldest first, sparing the one just added and any an open asset uses
+    uint64_t evicted = 0;
+    auto it = g_prefetched.begin();
+    while (g_prefetchedBytes > PREFETCH_MAX_BYTES && it != g_prefetched.end()) {
+        assetBuffer * old = *it;
+        if (old == b || old->refs > 0) {
+            ++it;
+            continue;
+        }
+        it = g_prefetched.erase(it);
+        g_prefetchedBytes -= old->length;
+        g_buffers.erase(old->filename);
+        free(old->data);
+        delete old;
+        evicted++;
+    }
+    pthread_mutex_unlock(&g_bufferLock);
+
+    pthread_mutex_lock(&g_ioLock);
+    g_ioStats.prefetchBytes += length;
+    g_ioStats.prefetchEvicted += evicted;
+    pthread_mutex_unlock(&g_ioLock);
+    return true;
+}
+
+static void loadPrefetch(const char * filename) {
+    // Same keys as AAssetManager_open uses for shared buffers
+    const assetPackEntry * entry = asset_pack_find(filename);
+    std::string key = entry ? std::string(filename) : std::string(ASSETS_PATH) + filename;
+
+    pthread_mutex_lock(&g_bufferLock);
+    bool loaded = g_buffers.find(key) != g_buffers.end();
+    pthread_mutex_unlock(&g_bufferLock);
+    if (loaded) return;
+
+    void * data = nullptr;
+    int64_t length = 0;
+    if (entry) {
+        assetPackStream * stream = asset_pack_stream_open(entry);
+        length = entry->size;
+        data = malloc(length > 0 ? (size_t) length : 1);
+        if (stream && data && asset_pack_stream_read(stream, 0, data, (size_t) length) != length) {
+            free(data);
+            data = nullptr;
+        }
+        asset_pack_stream_close(stream);
+    } else {
+        SceUID fd = sceIoOpen(key.c_str(), SCE_O_RDONLY, 0);
+        if (fd >= 0) {
+            length = sceIoLseek(fd, 0, SCE_SEEK_END);
+            data = malloc(length > 0 ? (size_t) length : 1);
+            if (data && sceIoPread(fd, data, (SceSize) length, 0) != length) {
+                free(data);
+                data = nullptr;
+            }
+            sceIoClose(fd);
+        }
+    }
+
+    if (!data) {
+        ALOGW("[AAssetManager] prefetch of %s failed", filename);
+        return;
+    }
+
+    addPrefetched(key, data, length);
+}
+
+static void queueStage(const assetPackStage * stage) {
+    bool entered = false;
+    pthread_mutex_lock(&g_ioLock);
+    // Only when entering another stage: reopening the first asset of the
+    // current one must not reload what the game already consumed.
+    if (g_lastStage != stage) {
+        ioJob job = {.type = IO_JOB_STAGE, .asset = nullptr, .buffer = nullptr, .filename = nullptr, .stage = stage};
+        if (queueJobLocked(job)) {
+            g_lastStage = stage;
+            g_ioStats.stageLoads++;
+            entered = true;
+        }
+    }
+    pthread_mutex_unlock(&g_ioLock);
+
+    // Split the I/O trace and the allocation profile by stage, from the game
+    // thread so the marks land before the reads and allocations of the stage.
+    if (entered) {
+        iotrace_mark(stage->label);
+        allocprof_mark(stage->label);
+    }
+}
+
+// Loads the assets of `stage` (but the first one, which is being opened) as
+// prefetched buffers. Assets are stored back to back, so they are read in
+// runs of up to STAGE_READ_SIZE bytes, as long as they fit in the prefetch
+// budget.
+static void loadStage(const assetPackStage * stage) {
+    size_t i = 1;
+    while (i < stage->count) {
+        pthread_mutex_lock(&g_bufferLock);
+        while (i < stage->count && g_buffers.find(asset_pack_name(stage->entries[i])) != g_buffers.end()) i++;
+
+        size_t first = i;
+        int64_t budget = PREFETCH_MAX_BYTES - g_prefetchedBytes;
+        uint64_t runStart = first < stage->count ? stage->entries[first]->offset : 0;
+        uint64_t runEnd = runStart;
+        int64_t runSize = 0;
+        while (i < stage->count) {
+            const assetPackEntry * e = stage->entries[i];
+            uint64_t end = e->offset + e->storedSize;
+            bool contiguous = e->offset >= runEnd && e->offset - runEnd < 64;
+            if (i > first && (!contiguous || end - runStart > STAGE_READ_SIZE)) break;
+            if (runSize + e->size > budget) break;
+            if (i > first && g_buffers.find(asset_pack_name(e)) != g_buffers.end()) break;
+            runEnd = end;
+            runSize += e->size;
+            i++;
+        }
+        pthread_mutex_unlock(&g_bufferLock);
+
+        if (i == first) {
+            if (i < stage->count) {
+                ALOGD("[AAssetManager] stage %s: prefetch budget reached", stage->label);
+            }
+            return;
+        }
+
+        size_t spanSize = (size_t) (runEnd - runStart);
+        auto * span = (uint8_t *) malloc(spanSize > 0 ? spanSize : 1);
+        if (!span || asset_pack_read_raw(runStart, span, spanSize) != (int) spanSize) {
+            ALOGW("[AAssetManager] stage %s: read of %u bytes failed", stage->label, (unsigned) spanSize);
+            free(span);
+            return;
+        }
+
+        pthread_mutex_lock(&g_ioLock);
+        g_ioStats.stageReads++;
+        g_ioStats.stageBytes += spanSize;
+        pthread_mutex_unlock(&g_ioLock);
+
+        for (size_t k = first; k < i; k++) {
+            const assetPackEntry * e = stage->entries[k];
+            void * data = malloc(e->size > 0 ? e->size : 1);
+            if (!data || !asset_pack_decode(e, span + (e->offset - runStart), data)) {
+                free(data);
+                continue;
+            }
+            addPrefetched(asset_pack_name(e), data, e->size);
+        }
+        free(span);
+    }
+}
+
+void AAssetManager_prefetch(AAssetManager* mgr, const char* filename) {
+    if (!filename) return;
+
+    pthread_mutex_lock(&g_ioLock);
+    ioJob job = {.type = IO_JOB_PREFETCH, .asset = nullptr, .buffer = nullptr, .filename = strdup(filename)};
+    if (queueJobLocked(job)) {
+        g_ioStats.prefetchRequests++;
+    } else {
+        free(job.filename);
+    }
+    pthread_mutex_unlock(&g_ioLock);
+}
+
+void AAssetManager_getIoStats(AAssetIoStats* outStats) {
+    if (!outStats) return;
+    pthread_mutex_lock(&g_ioLock);
+    *outStats = g_ioStats;
+    pthread_mutex_unlock(&g_ioLock);
 }
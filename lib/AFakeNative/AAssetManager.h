@@ -3,6 +3,7 @@
 
 #include <sys/cdefs.h>
 #include <sys/types.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -88,6 +89,138 @@ int AAsset_read(AAsset* asset, void* buf, size_t count);
  */
 off_t AAsset_seek(AAsset* asset, off_t offset, int whence);
 
+/**
+ * Seek to the specified offset within the asset data.  'whence' uses the
+ * same constants as lseek()/fseek().
+ *
+ * Uses 64-bit data type for large files as opposed to the 32-bit type used
+ * by AAsset_seek.
+ *
+ * Returns the new position on success, or (int64_t) -1 on error.
+ */
+int64_t AAsset_seek64(AAsset* asset, int64_t offset, int whence);
+
+/**
+ * Get a pointer to a buffer holding the entire contents of the asset.
+ *
+ * The buffer is loaded on first use and shared read-only between all open
+ * assets of the same file; it stays valid until the asset is closed.
+ *
+ * Returns NULL on failure.
+ */
+const void* AAsset_getBuffer(AAsset* asset);
+
+/**
+ * Report the total size of the asset data.
+ */
+off_t AAsset_getLength(AAsset* asset);
+
+/**
+ * Report the total size of the asset data. Reports the size using a 64-bit
+ * number insted of 32-bit as AAsset_getLength.
+ */
+int64_t AAsset_getLength64(AAsset* asset);
+
+/**
+ * Report the total amount of asset data that can be read from the current position.
+ */
+off_t AAsset_getRemainingLength(AAsset* asset);
+
+/**
+ * Report the total amount of asset data that can be read from the current position.
+ *
+ * Uses a 64-bit number instead of a 32-bit number as AAsset_getRemainingLength does.
+ */
+int64_t AAsset_getRemainingLength64(AAsset* asset);
+
+/**
+ * Open a new file descriptor that can be used to read the asset data. If the
+ * start or length cannot be represented by a 32-bit number, it will be
+ * truncated. If the file is large, use AAsset_openFileDescriptor64 instead.
+ *
+ * Returns < 0 if direct fd access is not possible (for example, if the asset is
+ * compressed).
+ */
+int AAsset_openFileDescriptor(AAsset* asset, off_t* outStart, off_t* outLength);
+
+/**
+ * Open a new file descriptor that can be used to read the asset data.
+ *
+ * Uses a 64-bit number for the offset and length instead of 32-bit instead of
+ * as AAsset_openFileDescriptor does.
+ *
+ * Returns < 0 if direct fd access is not possible (for example, if the asset is
+ * compressed).
+ */
+int AAsset_openFileDescriptor64(AAsset* asset, int64_t* outStart, int64_t* outLength);
+
+/**
+ * Returns whether this asset's internal buffer is allocated in ordinary RAM (i.e. not
+ * mmapped).
+ */
+int AAsset_isAllocated(AAsset* asset);
+
+/**
+ * Open the named directory within the asset hierarchy.  The directory can then
+ * be inspected with the AAssetDir functions.  To open the top-level directory,
+ * pass in "" as the dirName.
+ *
+ * The object returned here should be freed by calling AAssetDir_close().
+ */
+AAssetDir* AAssetManager_openDir(AAssetManager* mgr, const char* dirName);
+
+/**
+ * Iterate over the files in an asset directory.  A NULL string is returned
+ * when all the file names have been returned.
+ *
+ * The returned file name is suitable for passing to AAssetManager_open().
+ *
+ * The string returned here is owned by the AssetDir implementation and is not
+ * guaranteed to remain valid if any other calls are made on this AAssetDir
+ * instance.
+ */
+const char* AAssetDir_getNextFileName(AAssetDir* assetDir);
+
+/**
+ * Reset the iteration state of AAssetDir_getNextFileName() to the beginning.
+ */
+void AAssetDir_rewind(AAssetDir* assetDir);
+
+/**
+ * Close an opened AAssetDir, freeing any related resources.
+ */
+void AAssetDir_close(AAssetDir* assetDir);
+
+/**
+ * [Non-Standard]: Loads an asset into memory on the background I/O thread, so
+ * that a later AAssetManager_open() of it is served without touching the
+ * memory card. Meant to warm up the next assets while the game is idle (e.g.
+ * in menus). Prefetched assets nobody opened are dropped, oldest first, once
+ * they take more than 32 MB.
+ */
+void AAssetManager_prefetch(AAssetManager* mgr, const char* filename);
+
+/**
+ * [Non-Standard]: Counters of the asset read-ahead and prefetch machinery.
+ */
+typedef struct AAssetIoStats {
+    uint64_t readAheadHits;    // reads (or parts of them) served from read-ahead buffers
+    uint64_t readAheadMisses;  // sequential reads that had to restart read-ahead
+    uint64_t readAheadBytes;   // bytes read in the background for read-ahead
+    uint64_t prefetchRequests; // AAssetManager_prefetch() calls queued
+    uint64_t prefetchHits;     // opens served by a prefetched asset
+    uint64_t prefetchEvicted;  // prefetched assets dropped before being opened
+    uint64_t prefetchBytes;    // bytes loaded by prefetching
+    uint64_t stageLoads;       // archive stages loaded ahead (see pack_assets.py --order)
+    uint64_t stageReads;       // large sequential reads issued for them
+    uint64_t stageBytes;       // bytes read for them
+} AAssetIoStats;
+
+/**
+ * [Non-Standard]: Copies the current asset I/O counters into `outStats`.
+ */
+void AAssetManager_getIoStats(AAssetIoStats* outStats);
+
 #ifdef __cplusplus
 };
 #endif
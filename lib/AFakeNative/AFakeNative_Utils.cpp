@@ -1,13 +1,15 @@
 #include "AFakeNative_Utils.h"
 
-#include <sys/time.h>
 #include <psp2/kernel/clib.h>
 
+#include "utils/clock.h"
+
 uint64_t AFN_timeMillis() {
-    struct timeval te{};
-    gettimeofday(&te, nullptr);
-    long long milliseconds = te.tv_sec*1000LL + te.tv_usec/1000;
-    return milliseconds;
+    return clock_monotonic_ms();
+}
+
+int64_t AFN_timeNanos() {
+    return (int64_t) clock_monotonic_ns();
 }
 
 void LOG_ALWAYS_FATAL_IF(bool cond, const char * fmt, ...) {
@@ -18,6 +18,9 @@
 
 uint64_t AFN_timeMillis();
 
+/* Monotonic time in nanoseconds, the time base of input event timestamps. */
+int64_t AFN_timeNanos();
+
 void LOG_ALWAYS_FATAL_IF(bool cond, const char * fmt, ...);
 void LOG_ALWAYS_FATAL(const char * fmt, ...);
 void ALOGE(const char * fmt, ...);
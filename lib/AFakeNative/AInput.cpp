@@ -10,6 +10,44 @@
 
 static AInputQueue * g_AInputQueue = nullptr;
 
+// Number of events preallocated for the queue. If the game holds on to more
+// events than this, AInputEvent_create falls back to the heap.
+#define INPUT_EVENT_POOL_SIZE 64
+
+// Number of events that can wait to be read by the game before move events
+// start getting dropped. Key and pointer down/up events are never dropped, the
+// queue grows on the heap if it is full of them.
+#define INPUT_QUEUE_CAPACITY 64
+
+// Maximum number of historical samples kept in a coalesced move event.
+#define INPUT_EVENT_MAX_HISTORY 8
+
+typedef struct inputEventSample {
+    int64_t time;
+    float x[10];
+    float y[10];
+    float z[10];
+    float rz[10];
+    float hat_x[10];
+    float hat_y[10];
+    float lt[10];
+    float rt[10];
+} inputEventSample;
+
+// What every AInputEvent actually points to. `event` must stay the first
+// member so that AInputEvent pointers can be used as inputEvent pointers.
+typedef struct pooledInputEvent {
+    inputEvent event;
+    size_t historySize;
+    inputEventSample history[INPUT_EVENT_MAX_HISTORY];
+    bool pooled;
+} pooledInputEvent;
+
+static pooledInputEvent g_eventPool[INPUT_EVENT_POOL_SIZE];
+static pooledInputEvent * g_eventPoolFree[INPUT_EVENT_POOL_SIZE];
+static size_t g_eventPoolFreeCount = 0;
+static pthread_mutex_t g_eventPoolLock = PTHREAD_MUTEX_INITIALIZER;
+
 typedef struct inputQueue {
     int mDispatchFd;
     std::vector<ALooper*> mAppLoopers;
@@ -18,7 +56,11 @@ typedef struct inputQueue {
     //PooledInputEventFactory mPooledInputEventFactory;
     // Guards the pending and finished event vectors
     pthread_mutex_t mLock;
-    std::vector<AInputEvent*> mPendingEvents;
+    // Ring buffer of events not yet read by the game.
+    pooledInputEvent ** mPendingEvents;
+    size_t mPendingCapacity;
+    size_t mPendingHead;
+    size_t mPendingCount;
     //std::vector<key_value_pair_t<AInputEvent*, bool> > mFinishedEvents;
 
 } inputQueue;
@@ -26,7 +68,20 @@ typedef struct inputQueue {
 AInputQueue * AInputQueue_create() {
     if (g_AInputQueue) return g_AInputQueue;
 
-    auto * iq = reinterpret_cast<inputQueue *>(malloc(sizeof(inputQueue)));
+    auto * iq = new inputQueue;
+    iq->mPendingEvents = reinterpret_cast<pooledInputEvent **>(malloc(sizeof(pooledInputEvent *) * INPUT_QUEUE_CAPACITY));
+    iq->mPendingCapacity = INPUT_QUEUE_CAPACITY;
+    iq->mPendingHead = 0;
+    iq->mPendingCount = 0;
+
+    pthread_mutex_lock(&g_eventPoolLock);
+    for (size_t i = 0; i < INPUT_EVENT_POOL_SIZE; i++) {
+        g_eventPool[i].pooled = true;
+        g_eventPoolFree[i] = &g_eventPool[i];
+    }
+    g_eventPoolFreeCount = INPUT_EVENT_POOL_SIZE;
+    pthread_mutex_unlock(&g_eventPoolLock);
+
     iq->mDispatchFd = pseudo_eventfd(0, PSEUDO_EFD_NONBLOCK | PSEUDO_EFD_SEMAPHORE);
 
     if (iq->mDispatchFd < 0) {
@@ -92,12 +147,13 @@ int32_t AInputQueue_getEvent(AInputQueue* queue, AInputEvent** outEvent) {
 
     pthread_mutex_lock(&q->mLock);
     *outEvent = NULL;
-    if (!q->mPendingEvents.empty()) {
-        *outEvent = q->mPendingEvents[0];
-        q->mPendingEvents.erase(q->mPendingEvents.begin());
+    if (q->mPendingCount > 0) {
+        *outEvent = reinterpret_cast<AInputEvent *>(q->mPendingEvents[q->mPendingHead]);
+        q->mPendingHead = (q->mPendingHead + 1) % q->mPendingCapacity;
+        q->mPendingCount--;
     }
 
-    if (q->mPendingEvents.empty()) {
+    if (q->mPendingCount == 0) {
         uint64_t byteread;
         ssize_t nRead;
         do {
@@ -118,17 +174,135 @@ int32_t AInputQueue_preDispatchEvent(AInputQueue* queue, AInputEvent* event) {
     return false;
 }
 
+static void releaseEvent(pooledInputEvent * e) {
+    if (!e->pooled) {
+        free(e);
+        return;
+    }
+
+    pthread_mutex_lock(&g_eventPoolLock);
+    g_eventPoolFree[g_eventPoolFreeCount++] = e;
+    pthread_mutex_unlock(&g_eventPoolLock);
+}
+
 void AInputQueue_finishEvent(AInputQueue* queue, AInputEvent* event, int handled) {
-    if (event) free(event);
+    if (event) releaseEvent(reinterpret_cast<pooledInputEvent *>(event));
+}
+
+static bool isMoveEvent(const inputEvent * e) {
+    return e->type == AINPUT_EVENT_TYPE_MOTION
+           && (e->motion_action & AMOTION_EVENT_ACTION_MASK) == AMOTION_EVENT_ACTION_MOVE;
+}
+
+static bool canCoalesce(const inputEvent * prev, const inputEvent * next) {
+    if (!isMoveEvent(prev) || !isMoveEvent(next)) return false;
+    if (prev->source != next->source || prev->motion_ptrcount != next->motion_ptrcount) return false;
+    for (int i = 0; i < next->motion_ptrcount; i++) {
+        if (prev->motion_ptridx[i] != next->motion_ptridx[i]) return false;
+    }
+    return true;
+}
+
+static void saveSample(inputEventSample * s, const inputEvent * e) {
+    s->time = e->event_time;
+    memcpy(s->x, e->motion_x, sizeof(s->x));
+    memcpy(s->y, e->motion_y, sizeof(s->y));
+    memcpy(s->z, e->motion_z, sizeof(s->z));
+    memcpy(s->rz, e->motion_rz, sizeof(s->rz));
+    memcpy(s->hat_x, e->motion_hat_x, sizeof(s->hat_x));
+    memcpy(s->hat_y, e->motion_hat_y, sizeof(s->hat_y));
+    memcpy(s->lt, e->motion_lt, sizeof(s->lt));
+    memcpy(s->rt, e->motion_rt, sizeof(s->rt));
+}
+
+// Turns the current coordinates of `prev` into its newest historical sample
+// and makes the coordinates of `next` the current ones.
+static void coalesceEvent(pooledInputEvent * prev, const pooledInputEvent * next) {
+    if (prev->historySize == INPUT_EVENT_MAX_HISTORY) {
+        // Drop the oldest sample, the game is far behind anyway.
+        memmove(&prev->history[0], &prev->history[1], sizeof(inputEventSample) * (INPUT_EVENT_MAX_HISTORY - 1));
+        prev->historySize--;
+    }
+    saveSample(&prev->history[prev->historySize++], &prev->event);
+    int64_t downTime = prev->event.down_time;
+    prev->event = next->event;
+    prev->event.down_time = downTime;
+}
+
+static pooledInputEvent ** pendingAt(inputQueue * q, size_t i) {
+    return &q->mPendingEvents[(q->mPendingHead + i) % q->mPendingCapacity];
+}
+
+// Removes the oldest move event still waiting to be read and returns it, or
+// NULL if only key and pointer down/up events are waiting.
+static pooledInputEvent * evictOldestMove(inputQueue * q) {
+    for (size_t i = 0; i < q->mPendingCount; i++) {
+        pooledInputEvent * e = *pendingAt(q, i);
+        if (!isMoveEvent(&e->event)) continue;
+        for (size_t j = i; j + 1 < q->mPendingCount; j++) {
+            *pendingAt(q, j) = *pendingAt(q, j + 1);
+        }
+        q->mPendingCount--;
+        return e;
+    }
+    return nullptr;
+}
+
+static bool growPending(inputQueue * q) {
+    size_t capacity = q->mPendingCapacity * 2;
+    auto ** events = reinterpret_cast<pooledInputEvent **>(malloc(sizeof(pooledInputEvent *) * capacity));
+    if (!events) return false;
+    for (size_t i = 0; i < q->mPendingCount; i++) {
+        events[i] = *pendingAt(q, i);
+    }
+    free(q->mPendingEvents);
+    q->mPendingEvents = events;
+    q->mPendingCapacity = capacity;
+    q->mPendingHead = 0;
+    return true;
 }
 
 void AInputQueue_enqueueEvent(AInputQueue* queue, AInputEvent* event) {
     if (!queue || !event) return;
     auto * q = reinterpret_cast<inputQueue *>(queue);
+    auto * e = reinterpret_cast<pooledInputEvent *>(event);
 
     pthread_mutex_lock(&q->mLock);
-    q->mPendingEvents.push_back(event);
-    if (q->mPendingEvents.size() == 1) {
+    if (q->mPendingCount > 0) {
+        pooledInputEvent * last = *pendingAt(q, q->mPendingCount - 1);
+        if (canCoalesce(&last->event, &e->event)) {
+            coalesceEvent(last, e);
+            pthread_mutex_unlock(&q->mLock);
+            releaseEvent(e);
+            return;
+        }
+    }
+
+    if (q->mPendingCount == q->mPendingCapacity) {
+        // Make room by dropping a move, the game still gets the ones after
+        // it. A down or up the game never sees would leave it with a key or
+        // pointer stuck, so those are kept even if the queue has to grow.
+        pooledInputEvent * dropped = evictOldestMove(q);
+        if (!dropped && isMoveEvent(&e->event)) {
+            ALOGW("AInputQueue (%p) : queue is full, dropping move event", q);
+            dropped = e;
+        } else if (!dropped && !growPending(q)) {
+            ALOGE("AInputQueue (%p) : queue is full and can't grow, dropping event", q);
+            dropped = e;
+        } else if (dropped) {
+            ALOGW("AInputQueue (%p) : queue is full, dropping oldest move event", q);
+        }
+        if (dropped == e) {
+            pthread_mutex_unlock(&q->mLock);
+            releaseEvent(e);
+            return;
+        }
+        if (dropped) releaseEvent(dropped);
+    }
+
+    *pendingAt(q, q->mPendingCount) = e;
+    q->mPendingCount++;
+    if (q->mPendingCount == 1) {
         uint64_t payload = 1;
         int res = TEMP_FAILURE_RETRY(pseudo_write(q->mDispatchFd, &payload, sizeof(payload)));
         if (res < 0 && errno != EAGAIN) {
@@ -143,9 +317,22 @@ void AInputQueue_enqueueEvent(AInputQueue* queue, AInputEvent* event) {
  */
 
 AInputEvent *AInputEvent_create(const inputEvent *e) {
-    auto * ret = reinterpret_cast<AInputEvent *>(malloc(sizeof(inputEvent)));
-    memcpy(ret, e, sizeof(inputEvent));
-    return ret;
+    pooledInputEvent * ret = nullptr;
+
+    pthread_mutex_lock(&g_eventPoolLock);
+    if (g_eventPoolFreeCount > 0) {
+        ret = g_eventPoolFree[--g_eventPoolFreeCount];
+    }
+    pthread_mutex_unlock(&g_eventPoolLock);
+
+    if (!ret) {
+        ret = reinterpret_cast<pooledInputEvent *>(malloc(sizeof(pooledInputEvent)));
+        ret->pooled = false;
+    }
+
+    ret->event = *e;
+    ret->historySize = 0;
+    return reinterpret_cast<AInputEvent *>(ret);
 }
 
 int32_t AInputEvent_getType(const AInputEvent* event) {
@@ -160,6 +347,37 @@ int32_t AInputEvent_getSource(const AInputEvent* event) {
     return e->source;
 }
 
+int64_t AKeyEvent_getDownTime(const AInputEvent* key_event) {
+    if (!key_event) return 0;
+    auto * e = reinterpret_cast<const inputEvent *>(key_event);
+    return e->down_time;
+}
+
+int64_t AKeyEvent_getEventTime(const AInputEvent* key_event) {
+    if (!key_event) return 0;
+    auto * e = reinterpret_cast<const inputEvent *>(key_event);
+    return e->event_time;
+}
+
+int64_t AMotionEvent_getDownTime(const AInputEvent* motion_event) {
+    if (!motion_event) return 0;
+    auto * e = reinterpret_cast<const inputEvent *>(motion_event);
+    return e->down_time;
+}
+
+int64_t AMotionEvent_getEventTime(const AInputEvent* motion_event) {
+    if (!motion_event) return 0;
+    auto * e = reinterpret_cast<const inputEvent *>(motion_event);
+    return e->event_time;
+}
+
+int64_t AMotionEvent_getHistoricalEventTime(const AInputEvent* motion_event, size_t history_index) {
+    if (!motion_event) return 0;
+    auto * e = reinterpret_cast<const pooledInputEvent *>(motion_event);
+    if (history_index >= e->historySize) return e->event.event_time;
+    return e->history[history_index].time;
+}
+
 int32_t AKeyEvent_getAction(const AInputEvent* key_event) {
     if (!key_event) return 0;
     auto * e = reinterpret_cast<const inputEvent *>(key_event);
@@ -250,8 +468,51 @@ int32_t axis, size_t pointer_index) {
     }
 }
 
+size_t AMotionEvent_getHistorySize(const AInputEvent* motion_event) {
+    if (!motion_event) return 0;
+    auto * e = reinterpret_cast<const pooledInputEvent *>(motion_event);
+    return e->historySize;
+}
+
 float AMotionEvent_getHistoricalAxisValue(const AInputEvent* motion_event,
                                           int32_t axis, size_t pointer_index, size_t history_index) {
-    // FIXME: Actual history impl here
-    return AMotionEvent_getAxisValue(motion_event, axis, pointer_index);
+    if (!motion_event) return 0;
+    auto * e = reinterpret_cast<const pooledInputEvent *>(motion_event);
+    if (history_index >= e->historySize) {
+        // Out of range, the newest known value is the best answer we have.
+        return AMotionEvent_getAxisValue(motion_event, axis, pointer_index);
+    }
+    if (pointer_index >= 10) pointer_index = 9;
+
+    const inputEventSample * s = &e->history[history_index];
+    switch (axis) {
+        case AMOTION_EVENT_AXIS_X:
+            return s->x[pointer_index];
+        case AMOTION_EVENT_AXIS_Y:
+            return s->y[pointer_index];
+        case AMOTION_EVENT_AXIS_Z:
+            return s->z[pointer_index];
+        case AMOTION_EVENT_AXIS_RZ:
+            return s->rz[pointer_index];
+        case AMOTION_EVENT_AXIS_HAT_X:
+            return s->hat_x[pointer_index];
+        case AMOTION_EVENT_AXIS_HAT_Y:
+            return s->hat_y[pointer_index];
+        case AMOTION_EVENT_AXIS_LTRIGGER:
+            return s->lt[pointer_index];
+        case AMOTION_EVENT_AXIS_RTRIGGER:
+            return s->rt[pointer_index];
+        default:
+            return AMotionEvent_getAxisValue(motion_event, axis, pointer_index);
+    }
+}
+
+float AMotionEvent_getHistoricalX(const AInputEvent* motion_event, size_t pointer_index,
+                                  size_t history_index) {
+    return AMotionEvent_getHistoricalAxisValue(motion_event, AMOTION_EVENT_AXIS_X, pointer_index, history_index);
+}
+
+float AMotionEvent_getHistoricalY(const AInputEvent* motion_event, size_t pointer_index,
+                                  size_t history_index) {
+    return AMotionEvent_getHistoricalAxisValue(motion_event, AMOTION_EVENT_AXIS_Y, pointer_index, history_index);
 }
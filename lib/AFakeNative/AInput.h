@@ -617,10 +617,16 @@ typedef struct inputEvent {
     float motion_hat_y[10];
     float motion_lt[10];
     float motion_rt[10];
+
+    // AFN_timeNanos() time the event happened at, and for key events and
+    // pointer gestures the time the key or the first pointer went down.
+    int64_t event_time;
+    int64_t down_time;
 } inputEvent;
 
 /**
- * [Non-Standard]: Create new AInputEvent object
+ * [Non-Standard]: Create new AInputEvent object. Events are taken from a fixed
+ * pool and given back to it by AInputQueue_finishEvent().
  */
 AInputEvent *AInputEvent_create(const inputEvent *e);
 
@@ -630,6 +636,40 @@ int32_t AInputEvent_getType(const AInputEvent* event);
 /** Get the input event source. */
 int32_t AInputEvent_getSource(const AInputEvent *event);
 
+/**
+ * Get the time of the most recent key down event, in the
+ * java.lang.System.nanoTime() time base.  If this is a down event,
+ * this will be the same as eventTime.
+ * Note that when chording keys, this value is the down time of the most recently
+ * pressed key, which may not be the same physical key of this event.
+ */
+int64_t AKeyEvent_getDownTime(const AInputEvent* key_event);
+
+/**
+ * Get the time this event occurred, in the
+ * java.lang.System.nanoTime() time base.
+ */
+int64_t AKeyEvent_getEventTime(const AInputEvent* key_event);
+
+/**
+ * Get the time when the user originally pressed down to start a stream of
+ * position events, in the java.lang.System.nanoTime() time base.
+ */
+int64_t AMotionEvent_getDownTime(const AInputEvent* motion_event);
+
+/**
+ * Get the time when this specific event was generated,
+ * in the java.lang.System.nanoTime() time base.
+ */
+int64_t AMotionEvent_getEventTime(const AInputEvent* motion_event);
+
+/**
+ * Returns the time that a historical movement occurred between this event
+ * and the previous event, in the java.lang.System.nanoTime() time base.
+ */
+int64_t AMotionEvent_getHistoricalEventTime(const AInputEvent* motion_event,
+                                            size_t history_index);
+
 /** Get the key event action. */
 int32_t AKeyEvent_getAction(const AInputEvent *key_event);
 
@@ -695,6 +735,28 @@ float AMotionEvent_getAxisValue(const AInputEvent* motion_event,
 float AMotionEvent_getHistoricalAxisValue(const AInputEvent* motion_event,
                                           int32_t axis, size_t pointer_index, size_t history_index);
 
+/**
+ * Get the number of historical points in this event.  These are movements that
+ * have occurred between this event and the previous event.  This only applies
+ * to AMOTION_EVENT_ACTION_MOVE events -- all other actions will have a size of 0.
+ * Historical samples are indexed from oldest to newest.
+ */
+size_t AMotionEvent_getHistorySize(const AInputEvent* motion_event);
+
+/**
+ * Get the historical X coordinate of this event for the given pointer index that
+ * occurred between this event and the previous motion event.
+ */
+float AMotionEvent_getHistoricalX(const AInputEvent* motion_event, size_t pointer_index,
+                                  size_t history_index);
+
+/**
+ * Get the historical Y coordinate of this event for the given pointer index that
+ * occurred between this event and the previous motion event.
+ */
+float AMotionEvent_getHistoricalY(const AInputEvent* motion_event, size_t pointer_index,
+                                  size_t history_index);
+
 struct AInputQueue;
 /**
  * Input queue
@@ -710,7 +772,9 @@ typedef struct AInputQueue AInputQueue;
 AInputQueue *AInputQueue_create();
 
 /**
- * [Non-Standard]: Enqueue new input event
+ * [Non-Standard]: Enqueue new input event. A move event that directly follows
+ * a pending move event for the same source and pointers is merged into it, the
+ * older coordinates are kept as history samples.
  */
 void AInputQueue_enqueueEvent(AInputQueue *queue, AInputEvent *event);
 
@@ -4,8 +4,8 @@
 #include <cstdlib>
 #include <climits>
 #include <vector>
+#include <algorithm>
 #include <cstring>
-#include <unordered_map>
 #include <sys/unistd.h>
 
 #include "AFakeNative_Utils.h"
@@ -15,6 +15,20 @@
 // Maximum number of file descriptors for which to retrieve poll events each iteration.
 static const int EPOLL_MAX_EVENTS = 16;
 
+// Number of message envelopes preallocated for each looper.
+static const size_t MESSAGE_POOL_SIZE = 32;
+
+// Maximum number of file descriptors a looper can monitor besides its WakeEventFd.
+// Games only register a few of them (input queue, sensor queue, app glue pipe).
+static const size_t LOOPER_MAX_REQUESTS = 16;
+
+// Frame pacing: bounds for the measured swap interval and the safety margin
+// kept between the end of a paced poll and the predicted next swap.
+static const uint64_t FRAME_PACING_DEFAULT_INTERVAL = 16;
+static const uint64_t FRAME_PACING_MIN_INTERVAL = 8;
+static const uint64_t FRAME_PACING_MAX_INTERVAL = 100;
+static const uint64_t FRAME_PACING_MARGIN = 2;
+
 constexpr uint64_t WAKE_EVENT_FD_SEQ = 1;
 
 pthread_key_t key;
@@ -43,6 +57,11 @@ struct Response {
     Request request;
 };
 
+struct RequestEntry {
+    SequenceNumber seq;
+    Request request;
+};
+
 
 /**
  * A message that can be posted to a Looper.
@@ -55,36 +74,26 @@ struct Message {
     int what;
 };
 
-/**
- * Interface for a Looper message handler.
- *
- * The Looper holds a strong reference to the message handler whenever it has
- * a message to deliver to it.  Make sure to call Looper::removeMessages
- * to remove any pending messages destined for the handler so that the handler
- * can be destroyed.
- */
-class MessageHandler {
-protected:
-    virtual ~MessageHandler();
-
-public:
-    /**
-     * Handles a message.
-     */
-    virtual void handleMessage(const Message& message) = 0;
-};
-
 struct MessageEnvelope {
-    MessageEnvelope() : uptime(0) { }
+    MessageEnvelope() : uptime(0), seq(0), handler(nullptr), data(nullptr) { }
 
-    MessageEnvelope(uint64_t u, MessageHandler * h, const Message& m)
-            : uptime(u), handler(h), message(m) {}
+    MessageEnvelope(uint64_t u, uint64_t s, ALooper_messageHandlerFunc h, void * d, const Message& m)
+            : uptime(u), seq(s), handler(h), data(d), message(m) {}
 
     uint64_t uptime;
-    MessageHandler * handler;
+    uint64_t seq; // keeps FIFO order between messages due at the same uptime
+    ALooper_messageHandlerFunc handler;
+    void * data;
     Message message;
 };
 
+// Orders the envelope heap so that the earliest due message is at the front.
+struct MessageEnvelopeLater {
+    bool operator()(const MessageEnvelope& a, const MessageEnvelope& b) const {
+        if (a.uptime != b.uptime) return a.uptime > b.uptime;
+        return a.seq > b.seq;
+    }
+};
 
 struct internal_ALooper {
     bool mAllowNonCallbacks; // immutable
@@ -92,7 +101,10 @@ struct internal_ALooper {
     int mWakeEventFd;  // immutable
     pthread_mutex_t mLock;
 
+    // Binary min-heap ordered by MessageEnvelopeLater. Storage is reserved upfront
+    // and reused, so posting and delivering messages doesn't touch the allocator.
     std::vector<MessageEnvelope>* mMessageEnvelopes; // guarded by mLock
+    uint64_t mNextMessageSeq; // guarded by mLock
     bool mSendingMessage; // guarded by mLock
 
     // Whether we are currently waiting for work.  Not protected by a lock,
@@ -102,10 +114,11 @@ struct internal_ALooper {
     int mEpollFd;  // guarded by mLock but only modified on the looper thread
     bool mEpollRebuildRequired; // guarded by mLock
 
-    // Locked maps of fds and sequence numbers monitoring requests.
-    // Both maps must be kept in sync at all times.
-    std::unordered_map<SequenceNumber, Request>* mRequests;               // guarded by mLock
-    std::unordered_map<int /*fd*/, SequenceNumber>* mSequenceNumberByFd;  // guarded by mLock
+    // Fd monitoring requests along with their sequence numbers. Kept in a flat
+    // array instead of maps: there are only a few of them, so lookups by fd or
+    // by sequence number are a short scan and registering never allocates.
+    RequestEntry mRequests[LOOPER_MAX_REQUESTS]; // guarded by mLock
+    size_t mRequestCount;                        // guarded by mLock
 
     // The sequence number to use for the next fd that is added to the looper.
     // The sequence number 0 is reserved for the WakeEventFd.
@@ -113,7 +126,8 @@ struct internal_ALooper {
 
     // This state is only used privately by pollOnce and does not require a lock since
     // it runs on a single thread.
-    std::vector<Response>* mResponses;
+    Response mResponses[EPOLL_MAX_EVENTS];
+    size_t mResponseCount;
     size_t mResponseIndex;
     uint64_t mNextMessageUptime; // set to LLONG_MAX when none
 };
@@ -145,16 +159,18 @@ ALooper* ALooper_prepare(int opts) {
     auto * ial = (internal_ALooper *) malloc(sizeof(internal_ALooper));
     ial->mAllowNonCallbacks = opts == ALOOPER_PREPARE_ALLOW_NON_CALLBACKS;
     ial->mSendingMessage = false;
+    ial->mNextMessageSeq = 0;
     ial->mPolling = false;
+    ial->mEpollFd = -1;
     ial->mEpollRebuildRequired = false;
     ial->mNextRequestSeq = WAKE_EVENT_FD_SEQ + 1;
+    ial->mRequestCount = 0;
+    ial->mResponseCount = 0;
     ial->mResponseIndex = 0;
     ial->mNextMessageUptime = LLONG_MAX;
     ial->mWakeEventFd = pseudo_eventfd(0, PSEUDO_EFD_NONBLOCK | PSEUDO_EFD_CLOEXEC);
-    ial->mSequenceNumberByFd = new std::unordered_map<int /*fd*/, SequenceNumber>;
-    ial->mRequests = new std::unordered_map<SequenceNumber, Request>;
-    ial->mResponses = new std::vector<Response>;
     ial->mMessageEnvelopes = new std::vector<MessageEnvelope>;
+    ial->mMessageEnvelopes->reserve(MESSAGE_POOL_SIZE);
 
     LOG_ALWAYS_FATAL_IF(ial->mWakeEventFd < 0, "Could not make wake event fd: %s", strerror(errno));
 
@@ -209,21 +225,37 @@ void scheduleEpollRebuildLocked(internal_ALooper * self) {
     }
 }
 
-int removeSequenceNumberLocked(internal_ALooper * self, SequenceNumber seq) {
+RequestEntry * findRequestBySeqLocked(internal_ALooper * self, SequenceNumber seq) {
+    for (size_t i = 0; i < self->mRequestCount; i++) {
+        if (self->mRequests[i].seq == seq) return &self->mRequests[i];
+    }
+    return nullptr;
+}
+
+RequestEntry * findRequestByFdLocked(internal_ALooper * self, int fd) {
+    for (size_t i = 0; i < self->mRequestCount; i++) {
+        if (self->mRequests[i].request.fd == fd) return &self->mRequests[i];
+    }
+    return nullptr;
+}
 
+void eraseRequestLocked(internal_ALooper * self, RequestEntry * entry) {
+    // Order doesn't matter, move the last entry into the freed slot.
+    *entry = self->mRequests[--self->mRequestCount];
+}
 
-    const auto& request_it = self->mRequests->find(seq);
-    if (request_it == self->mRequests->end()) {
+int removeSequenceNumberLocked(internal_ALooper * self, SequenceNumber seq) {
+    RequestEntry * entry = findRequestBySeqLocked(self, seq);
+    if (!entry) {
         return 0;
     }
-    const int fd = request_it->second.fd;
+    const int fd = entry->request.fd;
 #if DEBUG_CALLBACKS
     ALOGD("%p ~ removeFd - fd=%d, seq=%u", self, fd, seq);
 #endif
-    // Always remove the FD from the request map even if an error occurs while
+    // Always remove the FD from the request list even if an error occurs while
     // updating the epoll set so that we avoid accidentally leaking callbacks.
-    self->mRequests->erase(request_it);
-    self->mSequenceNumberByFd->erase(self->mSequenceNumberByFd->find(fd));
+    eraseRequestLocked(self, entry);
 
     int epollResult = pseudo_epoll_ctl(self->mEpollFd, PSEUDO_EPOLL_CTL_DEL, fd, nullptr);
     if (epollResult < 0) {
@@ -275,7 +307,9 @@ void rebuildEpollLocked(internal_ALooper * self) {
     LOG_ALWAYS_FATAL_IF(result != 0, "Could not add wake event fd to epoll instance: %s",
                         strerror(errno));
 
-    for (const auto& [seq, request] : * self->mRequests) {
+    for (size_t i = 0; i < self->mRequestCount; i++) {
+        const SequenceNumber seq = self->mRequests[i].seq;
+        const Request& request = self->mRequests[i].request;
         pseudo_epoll_event eventItem = createEpollEvent(request.getEpollEvents(), seq);
 
         int epollResult = pseudo_epoll_ctl(self->mEpollFd, PSEUDO_EPOLL_CTL_ADD, request.fd, &eventItem);
@@ -304,20 +338,19 @@ int pollInner (int timeoutMillis) {
     // Adjust the timeout based on when the next message is due.
     if (timeoutMillis != 0 && self->mNextMessageUptime != LLONG_MAX) {
         uint64_t now = AFN_timeMillis();
-        uint64_t messageTimeoutMillis = self->mNextMessageUptime - now;
-        if (messageTimeoutMillis >= 0
-            && (timeoutMillis < 0 || messageTimeoutMillis < timeoutMillis)) {
+        uint64_t messageTimeoutMillis = self->mNextMessageUptime > now ? self->mNextMessageUptime - now : 0;
+        if (timeoutMillis < 0 || messageTimeoutMillis < (uint64_t) timeoutMillis) {
             timeoutMillis = (int) messageTimeoutMillis;
         }
 #if DEBUG_POLL_AND_WAKE
-        ALOGD("ALooper (%p) ~ pollOnce - next message in %lluns, adjusted timeout: timeoutMillis=%d",
-                self, self->mNextMessageUptime - now, timeoutMillis);
+        ALOGD("ALooper (%p) ~ pollOnce - next message in %llums, adjusted timeout: timeoutMillis=%d",
+                self, messageTimeoutMillis, timeoutMillis);
 #endif
     }
 
     // Poll.
     int result = ALOOPER_POLL_WAKE;
-    self->mResponses->clear();
+    self->mResponseCount = 0;
     self->mResponseIndex = 0;
 
     // We are about to idle.
@@ -378,16 +411,16 @@ int pollInner (int timeoutMillis) {
                 printf("Ignoring unexpected epoll events 0x%x on wake event fd.", epollEvents);
             }
         } else {
-            const auto& request_it = self->mRequests->find(seq);
-            if (request_it != self->mRequests->end()) {
-                const auto& request = request_it->second;
+            const RequestEntry * entry = findRequestBySeqLocked(self, seq);
+            if (entry) {
+                const Request& request = entry->request;
                 int events = 0;
                 if (epollEvents & PSEUDO_EPOLLIN) events |= ALOOPER_EVENT_INPUT;
                 if (epollEvents & PSEUDO_EPOLLOUT) events |= ALOOPER_EVENT_OUTPUT;
                 if (epollEvents & PSEUDO_EPOLLERR) events |= ALOOPER_EVENT_ERROR;
                 if (epollEvents & PSEUDO_EPOLLHUP) events |= ALOOPER_EVENT_HANGUP;
-                Response r = {.seq = seq, .events = events, .request = request};
-                self->mResponses->emplace_back(r);
+                // At most EPOLL_MAX_EVENTS events are returned, so this always fits.
+                self->mResponses[self->mResponseCount++] = {.seq = seq, .events = events, .request = request};
             } else {
                 printf("Ignoring unexpected epoll events 0x%x for sequence number %llu that is no longer registered.",
                         epollEvents, seq);
@@ -398,34 +431,32 @@ int pollInner (int timeoutMillis) {
 
     // Invoke pending message callbacks.
     self->mNextMessageUptime = LLONG_MAX;
-    while (self->mMessageEnvelopes->size() != 0) {
+    while (!self->mMessageEnvelopes->empty()) {
         uint64_t now = AFN_timeMillis();
-        const MessageEnvelope& messageEnvelope = self->mMessageEnvelopes->at(0);
-        if (messageEnvelope.uptime <= now) {
-            // Remove the envelope from the list.
-            // We keep a strong reference to the handler until the call to handleMessage
-            // finishes.  Then we drop it so that the handler can be deleted *before*
-            // we reacquire our lock.
-            { // obtain handler
-                MessageHandler * handler = messageEnvelope.handler;
-                Message message = messageEnvelope.message;
-                self->mMessageEnvelopes->erase(self->mMessageEnvelopes->begin());
-                self->mSendingMessage = true;
-                pthread_mutex_unlock(&self->mLock);
+        const MessageEnvelope& head = self->mMessageEnvelopes->front();
+        if (head.uptime <= now) {
+            // Remove the envelope from the heap before invoking the handler, the handler
+            // may post or remove messages itself once we release our lock.
+            MessageEnvelope messageEnvelope = head;
+            std::pop_heap(self->mMessageEnvelopes->begin(), self->mMessageEnvelopes->end(),
+                          MessageEnvelopeLater());
+            self->mMessageEnvelopes->pop_back();
+
+            self->mSendingMessage = true;
+            pthread_mutex_unlock(&self->mLock);
 
 #if DEBUG_POLL_AND_WAKE || DEBUG_CALLBACKS
-                ALOGD("%p ~ pollOnce - sending message: handler=%p, what=%d",
-                        self, handler, message.what);
+            ALOGD("%p ~ pollOnce - sending message: handler=%p, what=%d",
+                    self, messageEnvelope.handler, messageEnvelope.message.what);
 #endif
-                handler->handleMessage(message);
-            } // release handler
+            messageEnvelope.handler(messageEnvelope.message.what, messageEnvelope.data);
 
             pthread_mutex_lock(&self->mLock);
             self->mSendingMessage = false;
             result = ALOOPER_POLL_CALLBACK;
         } else {
-            // The last message left at the head of the queue determines the next wakeup time.
-            self->mNextMessageUptime = messageEnvelope.uptime;
+            // The message left at the head of the heap determines the next wakeup time.
+            self->mNextMessageUptime = head.uptime;
             break;
         }
     }
@@ -434,8 +465,8 @@ int pollInner (int timeoutMillis) {
     pthread_mutex_unlock(&self->mLock);
 
     // Invoke all response callbacks.
-    for (size_t i = 0; i < self->mResponses->size(); i++) {
-        Response& response = self->mResponses->at(i);
+    for (size_t i = 0; i < self->mResponseCount; i++) {
+        Response& response = self->mResponses[i];
         if (response.request.ident == ALOOPER_POLL_CALLBACK) {
             int fd = response.request.fd;
             int events = response.events;
@@ -470,8 +501,8 @@ int ALooper_pollOnce(int timeoutMillis, int* outFd, int* outEvents, void** outDa
 
     int result = 0;
     for (;;) {
-        while (self->mResponseIndex < self->mResponses->size()) {
-            const Response& response = self->mResponses->at(self->mResponseIndex++);
+        while (self->mResponseIndex < self->mResponseCount) {
+            const Response& response = self->mResponses[self->mResponseIndex++];
             int ident = response.request.ident;
             if (ident >= 0) {
                 int fd = response.request.fd;
@@ -504,43 +535,111 @@ int ALooper_pollOnce(int timeoutMillis, int* outFd, int* outEvents, void** outDa
 
 }
 
+// Frame pacing state. There is a single render thread, so this is global and
+// only applies to the looper of the thread that presents frames.
+static volatile bool gFramePacingEnabled = false;
+static ALooper * volatile gFramePacingLooper = nullptr;
+static volatile uint64_t gLastFrameSwapMillis = 0;
+static volatile uint64_t gFrameIntervalMillis = FRAME_PACING_DEFAULT_INTERVAL;
+static volatile uint64_t gFrameWorkMillis = 0;
+static volatile uint64_t gLastPacedPollMillis = 0;
+
+/*
+ * Time left until a paced poll should return, given the last swap, the
+ * measured swap interval and the time the game needs between returning from
+ * the poll and presenting the next frame. Returns 0 when the deadline has
+ * already passed or no frame was presented yet.
+ */
+static int framePacedTimeout(uint64_t now, uint64_t lastSwap, uint64_t interval, uint64_t work) {
+    if (lastSwap == 0) return 0;
+
+    uint64_t budget = work + FRAME_PACING_MARGIN;
+    if (budget >= interval) return 0;
+
+    uint64_t deadline = lastSwap + interval - budget;
+    if (deadline <= now) return 0;
+
+    return (int) (deadline - now);
+}
+
+void ALooper_setFramePacing(int enabled) {
+    gFramePacingEnabled = enabled != 0;
+}
+
+void ALooper_onFrameSwap() {
+    uint64_t now = AFN_timeMillis();
+
+    if (gLastFrameSwapMillis != 0) {
+        uint64_t interval = now - gLastFrameSwapMillis;
+        if (interval >= FRAME_PACING_MIN_INTERVAL && interval <= FRAME_PACING_MAX_INTERVAL) {
+            // Smooth out single-frame hitches so that they don't shift the deadline much.
+            gFrameIntervalMillis = (gFrameIntervalMillis * 3 + interval) / 4;
+        }
+    }
+
+    if (gLastPacedPollMillis > gLastFrameSwapMillis) {
+        // Game logic and rendering done between the last paced poll and this swap.
+        uint64_t work = now - gLastPacedPollMillis;
+        gFrameWorkMillis = (gFrameWorkMillis == 0) ? work : (gFrameWorkMillis * 3 + work) / 4;
+    }
+
+    gLastFrameSwapMillis = now;
+    gFramePacingLooper = ALooper_forThread();
+}
+
+uint64_t ALooper_getLastFrameSwapMillis() {
+    return gLastFrameSwapMillis;
+}
+
 int ALooper_pollAll(int timeoutMillis, int* outFd, int* outEvents, void** outData) {
     LOOPER_GET_SELF
 
 #if DEBUG_POLL_AND_WAKE
     ALOGD("ALooper_pollAll ~ ALooper (0x%x) ~ timeout %i ~ started from func 0x%x\n", self, timeoutMillis, __builtin_return_address(0));
 #endif
+
+    if (gFramePacingEnabled && timeoutMillis >= 0 && __self == gFramePacingLooper) {
+        // Keep draining events until just before the game has to start working
+        // on the next frame, so the frame is built from the freshest input.
+        uint64_t now = AFN_timeMillis();
+        int pacedTimeout = framePacedTimeout(now, gLastFrameSwapMillis, gFrameIntervalMillis, gFrameWorkMillis);
+        if (timeoutMillis == 0 || pacedTimeout < timeoutMillis) {
+            timeoutMillis = pacedTimeout;
+        }
+    }
+
+    int result = ALOOPER_POLL_TIMEOUT;
     if (timeoutMillis <= 0) {
-        int result;
         do {
             result = ALooper_pollOnce(timeoutMillis, outFd, outEvents, outData);
         } while (result == ALOOPER_POLL_CALLBACK);
-#if DEBUG_POLL_AND_WAKE
-        ALOGD("ALooper_pollAll ret %i reataddr 0x%x\n", result, __builtin_return_address(0));
-#endif
-        return result;
     } else {
         uint64_t endTime = AFN_timeMillis() + timeoutMillis;
 
         for (;;) {
-            int result = ALooper_pollOnce(timeoutMillis, outFd, outEvents, outData);
+            result = ALooper_pollOnce(timeoutMillis, outFd, outEvents, outData);
             if (result != ALOOPER_POLL_CALLBACK) {
-#if DEBUG_POLL_AND_WAKE
-                ALOGD("ALooper_pollAll ret %i reataddr 0x%x\n", result, __builtin_return_address(0));
-#endif
-                return result;
+                break;
             }
 
+            // Only wait for what is left of the original timeout.
             uint64_t now = AFN_timeMillis();
-            if (endTime - now <= 0) {
-#if DEBUG_POLL_AND_WAKE
-                ALOGD("ALooper_pollAll ret -3 [ALOOPER_POLL_TIMEOUT] reataddr 0x%x\n", __builtin_return_address(0));
-#endif
-                return ALOOPER_POLL_TIMEOUT;
+            if (now >= endTime) {
+                result = ALOOPER_POLL_TIMEOUT;
+                break;
             }
+            timeoutMillis = (int) (endTime - now);
         }
     }
 
+    if (__self == gFramePacingLooper && result == ALOOPER_POLL_TIMEOUT) {
+        gLastPacedPollMillis = AFN_timeMillis();
+    }
+
+#if DEBUG_POLL_AND_WAKE
+    ALOGD("ALooper_pollAll ret %i reataddr 0x%x\n", result, __builtin_return_address(0));
+#endif
+    return result;
 }
 
 int ALooper_addFd(ALooper* looper, int fd, int ident, int events,
@@ -580,16 +679,21 @@ int ALooper_addFd(ALooper* looper, int fd, int ident, int events,
     request.callback = callback;
     request.data = data;
     pseudo_epoll_event eventItem = createEpollEvent(request.getEpollEvents(), seq);
-    auto seq_it = self->mSequenceNumberByFd->find(fd);
-    if (seq_it == self->mSequenceNumberByFd->end()) {
+    RequestEntry * entry = findRequestByFdLocked(self, fd);
+    if (!entry) {
+        if (self->mRequestCount == LOOPER_MAX_REQUESTS) {
+            ALOGE("Error adding fd %d: looper already monitors %d fds", fd, (int) LOOPER_MAX_REQUESTS);
+            pthread_mutex_unlock(&self->mLock);
+            return -1;
+        }
+
         int epollResult = pseudo_epoll_ctl(self->mEpollFd, PSEUDO_EPOLL_CTL_ADD, fd, &eventItem);
         if (epollResult < 0) {
             ALOGE("Error adding epoll events for fd %d: %s", fd, strerror(errno));
             pthread_mutex_unlock(&self->mLock);
             return -1;
         }
-        self->mRequests->emplace(seq, request);
-        self->mSequenceNumberByFd->emplace(std::make_pair(fd, seq));
+        self->mRequests[self->mRequestCount++] = {.seq = seq, .request = request};
     } else {
         int epollResult = pseudo_epoll_ctl(self->mEpollFd, PSEUDO_EPOLL_CTL_MOD, fd, &eventItem);
         if (epollResult < 0) {
@@ -626,10 +730,8 @@ int ALooper_addFd(ALooper* looper, int fd, int ident, int events,
                 return -1;
             }
         }
-        const SequenceNumber oldSeq = seq_it->second;
-        self->mRequests->erase(oldSeq);
-        self->mRequests->emplace(seq, request);
-        seq_it->second = seq;
+        entry->seq = seq;
+        entry->request = request;
     }
     pthread_mutex_unlock(&self->mLock);
     return 1;
@@ -641,12 +743,83 @@ int ALooper_removeFd(ALooper* looper, int fd) {
 
     pthread_mutex_lock(&self->mLock);
 
-    const auto& it = self->mSequenceNumberByFd->find(fd);
-    if (it == self->mSequenceNumberByFd->end()) {
+    const RequestEntry * entry = findRequestByFdLocked(self, fd);
+    if (!entry) {
         pthread_mutex_unlock(&self->mLock);
         return 0;
     }
-    int ret = removeSequenceNumberLocked(self,it->second);
+    int ret = removeSequenceNumberLocked(self, entry->seq);
     pthread_mutex_unlock(&self->mLock);
     return ret;
 }
+
+int ALooper_sendMessageAtTime(ALooper* looper, uint64_t uptimeMillis,
+                              ALooper_messageHandlerFunc handler, int what, void* data) {
+    if (!looper || !handler) return -1;
+    auto * self = (internal_ALooper *) looper;
+
+#if DEBUG_CALLBACKS
+    ALOGD("%p ~ sendMessageAtTime - uptime=%llu, handler=%p, what=%d",
+            self, uptimeMillis, handler, what);
+#endif
+
+    pthread_mutex_lock(&self->mLock);
+
+    const uint64_t seq = self->mNextMessageSeq++;
+    self->mMessageEnvelopes->emplace_back(uptimeMillis, seq, handler, data, Message(what));
+    std::push_heap(self->mMessageEnvelopes->begin(), self->mMessageEnvelopes->end(),
+                   MessageEnvelopeLater());
+
+    // Only the new head of the queue can move the next wakeup time earlier.
+    bool isHead = self->mMessageEnvelopes->front().seq == seq;
+    if (isHead) {
+        self->mNextMessageUptime = uptimeMillis;
+    }
+
+    // Optimization: If the Looper is currently sending a message, then we can skip
+    // the call to wake() because the next thing the Looper will do after processing
+    // messages is to decide when the next wakeup time should be.
+    bool needWake = isHead && !self->mSendingMessage;
+    pthread_mutex_unlock(&self->mLock);
+
+    if (needWake) {
+        wake(self);
+    }
+    return 1;
+}
+
+int ALooper_sendMessageDelayed(ALooper* looper, uint64_t delayMillis,
+                               ALooper_messageHandlerFunc handler, int what, void* data) {
+    return ALooper_sendMessageAtTime(looper, AFN_timeMillis() + delayMillis, handler, what, data);
+}
+
+int ALooper_sendMessage(ALooper* looper, ALooper_messageHandlerFunc handler, int what, void* data) {
+    return ALooper_sendMessageAtTime(looper, AFN_timeMillis(), handler, what, data);
+}
+
+int ALooper_removeMessages(ALooper* looper, ALooper_messageHandlerFunc handler, int what) {
+    if (!looper) return -1;
+    auto * self = (internal_ALooper *) looper;
+
+#if DEBUG_CALLBACKS
+    ALOGD("%p ~ removeMessages - handler=%p, what=%d", self, handler, what);
+#endif
+
+    pthread_mutex_lock(&self->mLock);
+
+    auto * envelopes = self->mMessageEnvelopes;
+    auto last = std::remove_if(envelopes->begin(), envelopes->end(),
+                               [handler, what](const MessageEnvelope& e) {
+        return e.handler == handler && (what < 0 || e.message.what == what);
+    });
+    int removed = (int) (envelopes->end() - last);
+    if (removed > 0) {
+        envelopes->erase(last, envelopes->end());
+        std::make_heap(envelopes->begin(), envelopes->end(), MessageEnvelopeLater());
+        // The removed messages may have included the head
+        self->mNextMessageUptime = envelopes->empty() ? LLONG_MAX : envelopes->front().uptime;
+    }
+
+    pthread_mutex_unlock(&self->mLock);
+    return removed;
+}
@@ -1,6 +1,8 @@
 #ifndef ANDROID_LOOPER_H
 #define ANDROID_LOOPER_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -217,6 +219,71 @@ int ALooper_addFd(ALooper* looper, int fd, int ident, int events,
  */
 int ALooper_removeFd(ALooper* looper, int fd);
 
+/**
+ * [Non-Standard]: For message-based event loops, this is the prototype of the
+ * function that is called on the looper thread when a message becomes due.
+ * It is given the message identifier and the data pointer that was originally
+ * supplied to ALooper_sendMessage*().
+ */
+typedef void (*ALooper_messageHandlerFunc)(int what, void* data);
+
+/**
+ * [Non-Standard]: Enqueues a message to be processed by the looper once the
+ * AFN_timeMillis() clock reaches `uptimeMillis`. Messages due at the same time
+ * are delivered in the order they were sent.
+ *
+ * Returns 1 if the message was enqueued or -1 if an error occurred.
+ *
+ * This method can be called on any thread.
+ */
+int ALooper_sendMessageAtTime(ALooper* looper, uint64_t uptimeMillis,
+                              ALooper_messageHandlerFunc handler, int what, void* data);
+
+/**
+ * [Non-Standard]: Like ALooper_sendMessageAtTime(), but the message is due
+ * `delayMillis` milliseconds from now.
+ */
+int ALooper_sendMessageDelayed(ALooper* looper, uint64_t delayMillis,
+                               ALooper_messageHandlerFunc handler, int what, void* data);
+
+/**
+ * [Non-Standard]: Enqueues a message to be processed by the looper as soon
+ * as possible.
+ */
+int ALooper_sendMessage(ALooper* looper, ALooper_messageHandlerFunc handler, int what, void* data);
+
+/**
+ * [Non-Standard]: Removes all pending messages for the given handler with the
+ * given identifier. A negative `what` removes all messages for the handler.
+ *
+ * Returns the number of removed messages or -1 if an error occurred.
+ */
+int ALooper_removeMessages(ALooper* looper, ALooper_messageHandlerFunc handler, int what);
+
+/**
+ * [Non-Standard]: Enables or disables frame pacing for the looper of the
+ * render thread. When enabled, ALooper_pollAll() with a non-negative timeout
+ * keeps draining events until shortly before the predicted next swap (minus
+ * the time the game usually needs to build a frame) instead of returning
+ * right away, so input is read as late as possible before rendering.
+ *
+ * Disabled by default.
+ */
+void ALooper_setFramePacing(int enabled);
+
+/**
+ * [Non-Standard]: Must be called by the render thread right after each frame
+ * is presented. Used to predict the next swap for frame pacing.
+ */
+void ALooper_onFrameSwap();
+
+/**
+ * [Non-Standard]: Returns the AFN_timeMillis() time of the last presented
+ * frame, or 0 if no frame was presented yet.
+ */
+uint64_t ALooper_getLastFrameSwapMillis();
+
+
 
 #ifdef __cplusplus
 };
@@ -295,16 +295,21 @@ int pseudo_epoll_wait(int epfd, struct pseudo_epoll_event *events, int maxevents
             }
         }
 
-        if (timeout == 0) goto done;
-        if (eventsReported >= maxevents) goto done;
-        if (timeout == -1 && eventsReported > 0) goto done;
+        // Like epoll, return as soon as anything is ready. Scanning again
+        // would only report the same fds twice.
+        if (timeout == 0 || eventsReported > 0) goto done;
 
+        // Sleep in steps of at most 10 ms, the last one cut to what is left
+        // of the timeout so a deadline isn't overshot by most of a step.
+        useconds_t step = 10000;
         if (timeout != -1) {
-            if (AFN_timeMillis() - time_started > timeout) goto done;
+            uint64_t elapsed = AFN_timeMillis() - time_started;
+            if (elapsed >= (uint64_t) timeout) goto done;
+            if ((uint64_t) timeout - elapsed < 10) step = ((uint64_t) timeout - elapsed) * 1000;
         }
 
         _unlock();
-        usleep(10000); // give a chance for other threads to add new FDs to pool
+        usleep(step); // give a chance for other threads to add new FDs to pool
         _lock();
     }
 
@@ -0,0 +1,324 @@
+#include "asset_pack.h"
+#include "AFakeNative/AFakeNative_Utils.h"
+
+#include <psp2/io/fcntl.h>
+#include <zlib.h>
+#include <cstdlib>
+#include <cstring>
+
+static SceUID pack_fd = -1;
+static assetPackHeader pack_header;
+static assetPackEntry * pack_entries = nullptr;
+static char * pack_names = nullptr;
+static assetPackStage * pack_stages = nullptr;
+static size_t pack_stageCount = 0;
+
+static uint32_t fnv1a(const char * s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool readFully(void * buf, size_t size, SceOff offset) {
+    return sceIoPread(pack_fd, buf, size, offset) == (int) size;
+}
+
+// Parses the ".stages" entry, if any. Its text is kept as the label storage.
+static void loadStages() {
+    const assetPackEntry * e = asset_pack_find(ASSET_PACK_STAGES_NAME);
+    if (!e || e->compression != ASSET_PACK_COMPRESSION_NONE) return;
+
+    auto * text = (char *) malloc(e->size + 1);
+    if (!text || asset_pack_read(e, 0, text, e->size) != (int) e->size) {
+        free(text);
+        return;
+    }
+    text[e->size] = '\0';
+
+    size_t lines = 0, stages = 0;
+    for (char * p = text; *p; p++) {
+        if (*p == '\n') lines++;
+        if (*p == '[' && (p == text || p[-1] == '\n')) stages++;
+    }
+
+    pack_stages = (assetPackStage *) calloc(stages, sizeof(assetPackStage));
+    auto ** entries = (const assetPackEntry **) calloc(lines + 1, sizeof(assetPackEntry *));
+    if (!pack_stages || !entries) {
+        free(pack_stages);
+        free(entries);
+        free(text);
+        pack_stages = nullptr;
+        return;
+    }
+
+    assetPackStage * stage = nullptr;
+    char * line = text;
+    while (*line) {
+        char * end = strchr(line, '\n');
+        if (end) *end = '\0';
+
+        size_t len = strlen(line);
+        if (line[0] == '[' && len > 1 && line[len - 1] == ']') {
+            line[len - 1] = '\0';
+            stage = &pack_stages[pack_stageCount++];
+            stage->label = line + 1;
+            stage->entries = entries;
+        } else if (stage && len > 0) {
+            const assetPackEntry * member = asset_pack_find(line);
+            if (member) {
+                *entries++ = member;
+                stage->count++;
+            }
+        }
+
+        if (!end) break;
+        line = end + 1;
+    }
+}
+
+bool asset_pack_init(const char * path) {
+    if (pack_fd >= 0) return true;
+
+    pack_fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+    if (pack_fd < 0) {
+        return false;
+    }
+
+    if (!readFully(&pack_header, sizeof(pack_header), 0)
+        || pack_header.magic != ASSET_PACK_MAGIC
+        || pack_header.version != ASSET_PACK_VERSION) {
+        ALOGE("[asset_pack] %s is not a valid asset archive, ignoring it", path);
+        sceIoClose(pack_fd);
+        pack_fd = -1;
+        return false;
+    }
+
+    size_t entriesSize = sizeof(assetPackEntry) * pack_header.count;
+    pack_entries = (assetPackEntry *) malloc(entriesSize);
+    pack_names = (char *) malloc(pack_header.namesSize + 1);
+
+    if (!pack_entries || !pack_names
+        || !readFully(pack_entries, entriesSize, sizeof(assetPackHeader))
+        || !readFully(pack_names, pack_header.namesSize, (SceOff) (sizeof(assetPackHeader) + entriesSize))) {
+        ALOGE("[asset_pack] failed to load the index of %s, ignoring it", path);
+        free(pack_entries);
+        free(pack_names);
+        pack_entries = nullptr;
+        pack_names = nullptr;
+        sceIoClose(pack_fd);
+        pack_fd = -1;
+        return false;
+    }
+    pack_names[pack_header.namesSize] = '\0';
+
+    loadStages();
+
+    ALOGD("[asset_pack] loaded %s: %u assets, %u stages", path, pack_header.count, (unsigned) pack_stageCount);
+    return true;
+}
+
+bool asset_pack_loaded() {
+    return pack_fd >= 0;
+}
+
+const char * asset_pack_name(const assetPackEntry * e) {
+    return pack_names + e->nameOffset;
+}
+
+const assetPackEntry * asset_pack_entry(size_t index) {
+    if (pack_fd < 0 || index >= pack_header.count) return nullptr;
+    return &pack_entries[index];
+}
+
+const assetPackEntry * asset_pack_find(const char * name) {
+    if (pack_fd < 0) return nullptr;
+
+    uint32_t hash = fnv1a(name);
+
+    // Lower bound on the hash, then compare names among the (rare) collisions.
+    size_t lo = 0, hi = pack_header.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pack_entries[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (size_t i = lo; i < pack_header.count && pack_entries[i].hash == hash; i++) {
+        if (strcmp(asset_pack_name(&pack_entries[i]), name) == 0) {
+            return &pack_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+int asset_pack_read(const assetPackEntry * e, uint64_t offset, void * buf, size_t count) {
+    if (pack_fd < 0 || !e) return -1;
+    if (offset >= e->storedSize) return 0;
+    if (count > e->storedSize - offset) count = (size_t) (e->storedSize - offset);
+
+    // sceIoPread doesn't move a shared file position, so every asset can use
+    // the same handle concurrently.
+    return sceIoPread(pack_fd, buf, count, (SceOff) (e->offset + offset));
+}
+
+int asset_pack_read_raw(uint64_t offset, void * buf, size_t count) {
+    if (pack_fd < 0) return -1;
+    return sceIoPread(pack_fd, buf, count, (SceOff) offset);
+}
+
+bool asset_pack_decode(const assetPackEntry * e, const void * stored, void * out) {
+    if (e->compression == ASSET_PACK_COMPRESSION_NONE) {
+        memcpy(out, stored, e->size);
+        return true;
+    }
+    if (e->compression != ASSET_PACK_COMPRESSION_DEFLATE || e->storedSize < sizeof(assetPackChunkHeader)) {
+        return false;
+    }
+
+    auto * in = (const uint8_t *) stored;
+    assetPackChunkHeader chunks;
+    memcpy(&chunks, in, sizeof(chunks));
+    if (chunks.chunkSize == 0
+        || sizeof(chunks) + sizeof(uint32_t) * ((uint64_t) chunks.chunkCount + 1) > e->storedSize) {
+        return false;
+    }
+
+    auto * offsets = (const uint32_t *) (in + sizeof(chunks));
+    uint64_t done = 0;
+    for (uint32_t i = 0; i < chunks.chunkCount; i++) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > e->storedSize || done >= e->size) {
+            return false;
+        }
+        uLongf expected = (uLongf) ((e->size - done < chunks.chunkSize) ? e->size - done : chunks.chunkSize);
+        uLongf outSize = expected;
+        if (uncompress((uint8_t *) out + done, &outSize, in + offsets[i], offsets[i + 1] - offsets[i]) != Z_OK
+            || outSize != expected) {
+            ALOGE("[asset_pack] %s: chunk %u is corrupted", asset_pack_name(e), i);
+            return false;
+        }
+        done += expected;
+    }
+    return done == e->size;
+}
+
+const assetPackStage * asset_pack_stage_starting_with(const assetPackEntry * e) {
+    for (size_t i = 0; i < pack_stageCount; i++) {
+        if (pack_stages[i].count > 0 && pack_stages[i].entries[0] == e) {
+            return &pack_stages[i];
+        }
+    }
+    return nullptr;
+}
+
+struct assetPackStream {
+    const assetPackEntry * e;
+    assetPackChunkHeader chunks;
+    uint32_t * chunkOffsets; // chunkCount + 1 entries
+    uint8_t * packed;        // one compressed chunk
+    uint8_t * chunk;         // one decompressed chunk
+    int64_t cachedChunk;     // index of the chunk held in `chunk`, or -1
+};
+
+assetPackStream * asset_pack_stream_open(const assetPackEntry * e) {
+    auto * s = (assetPackStream *) calloc(1, sizeof(assetPackStream));
+    s->e = e;
+    s->cachedChunk = -1;
+
+    if (e->compression == ASSET_PACK_COMPRESSION_NONE) {
+        return s;
+    }
+
+    if (e->compression != ASSET_PACK_COMPRESSION_DEFLATE
+        || asset_pack_read(e, 0, &s->chunks, sizeof(s->chunks)) != sizeof(s->chunks)
+        || s->chunks.chunkSize == 0) {
+        ALOGE("[asset_pack] %s: unsupported or broken compressed asset", asset_pack_name(e));
+        free(s);
+        return nullptr;
+    }
+
+    size_t offsetsSize = sizeof(uint32_t) * (s->chunks.chunkCount + 1);
+    s->chunkOffsets = (uint32_t *) malloc(offsetsSize);
+    if (asset_pack_read(e, sizeof(s->chunks), s->chunkOffsets, offsetsSize) != (int) offsetsSize) {
+        ALOGE("[asset_pack] %s: can't read the chunk index", asset_pack_name(e));
+        free(s->chunkOffsets);
+        free(s);
+        return nullptr;
+    }
+
+    uint32_t maxPacked = 0;
+    for (uint32_t i = 0; i < s->chunks.chunkCount; i++) {
+        uint32_t size = s->chunkOffsets[i + 1] - s->chunkOffsets[i];
+        if (size > maxPacked) maxPacked = size;
+    }
+    s->packed = (uint8_t *) malloc(maxPacked);
+    s->chunk = (uint8_t *) malloc(s->chunks.chunkSize);
+
+    return s;
+}
+
+void asset_pack_stream_close(assetPackStream * s) {
+    if (!s) return;
+    free(s->chunkOffsets);
+    free(s->packed);
+    free(s->chunk);
+    free(s);
+}
+
+// Decompresses chunk `index` into `dst`, which must hold chunkSize bytes.
+static bool decompressChunk(assetPackStream * s, uint32_t index, uint8_t * dst, uLongf expected) {
+    uint32_t packedSize = s->chunkOffsets[index + 1] - s->chunkOffsets[index];
+    if (asset_pack_read(s->e, s->chunkOffsets[index], s->packed, packedSize) != (int) packedSize) {
+        return false;
+    }
+
+    uLongf outSize = expected;
+    if (uncompress(dst, &outSize, s->packed, packedSize) != Z_OK || outSize != expected) {
+        ALOGE("[asset_pack] %s: chunk %u is corrupted", asset_pack_name(s->e), index);
+        return false;
+    }
+    return true;
+}
+
+int asset_pack_stream_read(assetPackStream * s, uint64_t offset, void * buf, size_t count) {
+    if (!s) return -1;
+    if (s->e->compression == ASSET_PACK_COMPRESSION_NONE) {
+        return asset_pack_read(s->e, offset, buf, count);
+    }
+
+    if (offset >= s->e->size) return 0;
+    if (count > s->e->size - offset) count = (size_t) (s->e->size - offset);
+
+    const uint32_t chunkSize = s->chunks.chunkSize;
+    auto * out = (uint8_t *) buf;
+    size_t done = 0;
+
+    while (done < count) {
+        uint64_t pos = offset + done;
+        auto index = (uint32_t) (pos / chunkSize);
+        uint64_t chunkStart = (uint64_t) index * chunkSize;
+        auto chunkLen = (uint32_t) ((s->e->size - chunkStart < chunkSize) ? s->e->size - chunkStart : chunkSize);
+        auto inChunk = (uint32_t) (pos - chunkStart);
+        size_t n = chunkLen - inChunk;
+        if (n > count - done) n = count - done;
+
+        if (inChunk == 0 && n == chunkLen && index != s->cachedChunk) {
+            // Whole chunk wanted: decompress straight into the caller's buffer.
+            if (!decompressChunk(s, index, out + done, chunkLen)) return done > 0 ? (int) done : -1;
+        } else {
+            if (index != s->cachedChunk) {
+                if (!decompressChunk(s, index, s->chunk, chunkLen)) {
+                    s->cachedChunk = -1;
+                    return done > 0 ? (int) done : -1;
+                }
+                s->cachedChunk = index;
+            }
+            memcpy(out + done, s->chunk + inChunk, n);
+        }
+        done += n;
+    }
+
+    return (int) done;
+}
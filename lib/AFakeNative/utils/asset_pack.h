@@ -0,0 +1,131 @@
+/*
+ * utils/asset_pack.h
+ *
+ * Read-only packed asset archive, built from the extracted assets/ directory
+ * by extras/scripts/pack_assets.py.
+ *
+ * Layout (little-endian):
+ *   assetPackHeader
+ *   assetPackEntry[count], sorted by (hash, name)
+ *   names: NUL-terminated asset names, referenced by assetPackEntry.nameOffset
+ *   asset data, referenced by assetPackEntry.offset
+ *
+ * Compressed assets are split in chunks of `chunkSize` uncompressed bytes
+ * (the last one may be shorter), each compressed on its own so that reads
+ * can start anywhere. Their stored data is:
+ *   assetPackChunkHeader
+ *   uint32_t chunkOffsets[chunkCount + 1], from the start of the stored data
+ *   compressed chunks
+ *
+ * Archives packed in the order of an I/O trace also hold a ".stages" entry
+ * listing runs of assets that were first read together and are stored back
+ * to back: for each run, a "[label]" line followed by the names of its
+ * assets in storage order, one per line.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef AFAKENATIVE_ASSET_PACK_H
+#define AFAKENATIVE_ASSET_PACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ASSET_PACK_PATH DATA_PATH "assets.pak"
+#define ASSET_PACK_MAGIC 0x4B415041 // "APAK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_STAGES_NAME ".stages"
+
+enum {
+    ASSET_PACK_COMPRESSION_NONE = 0,
+    ASSET_PACK_COMPRESSION_DEFLATE = 1, // zlib stream per chunk
+};
+
+typedef struct assetPackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t namesSize;
+} assetPackHeader;
+
+typedef struct assetPackEntry {
+    uint32_t hash;        // FNV-1a of the name
+    uint32_t nameOffset;  // in the names table
+    uint64_t offset;      // of the stored data, from the start of the archive
+    uint32_t size;        // uncompressed size
+    uint32_t storedSize;  // size of the stored data
+    uint32_t compression; // one of ASSET_PACK_COMPRESSION_*
+    uint32_t reserved;
+} assetPackEntry;
+
+typedef struct assetPackChunkHeader {
+    uint32_t chunkSize;
+    uint32_t chunkCount;
+} assetPackChunkHeader;
+
+static_assert(sizeof(assetPackHeader) == 16, "assetPackHeader layout");
+static_assert(sizeof(assetPackEntry) == 32, "assetPackEntry layout");
+
+/*
+ * Loads the index of the archive at `path`, keeping the archive open.
+ * Returns false if there is no (valid) archive; assets are then read as
+ * loose files.
+ */
+bool asset_pack_init(const char * path);
+
+/* Whether an archive is loaded. */
+bool asset_pack_loaded();
+
+/* Looks up an asset by its name relative to assets/. */
+const assetPackEntry * asset_pack_find(const char * name);
+
+/* Name of an entry. */
+const char * asset_pack_name(const assetPackEntry * e);
+
+/* Iterates over all entries, in index order. Returns NULL past the end. */
+const assetPackEntry * asset_pack_entry(size_t index);
+
+/*
+ * Reads up to `count` bytes of the stored data of `e`, starting at `offset`.
+ * Safe to call from any thread. Returns the number of bytes read or < 0.
+ */
+int asset_pack_read(const assetPackEntry * e, uint64_t offset, void * buf, size_t count);
+
+/*
+ * Reads up to `count` bytes of the archive itself, starting at `offset`.
+ * Safe to call from any thread. Returns the number of bytes read or < 0.
+ */
+int asset_pack_read_raw(uint64_t offset, void * buf, size_t count);
+
+/*
+ * Decodes the whole stored data of `e`, held in memory at `stored`, into
+ * `out`, which must hold e->size bytes.
+ */
+bool asset_pack_decode(const assetPackEntry * e, const void * stored, void * out);
+
+typedef struct assetPackStage {
+    const char * label;
+    const assetPackEntry ** entries; // in storage order
+    size_t count;
+} assetPackStage;
+
+/* Returns the stage whose first asset is `e`, or NULL. */
+const assetPackStage * asset_pack_stage_starting_with(const assetPackEntry * e);
+
+/*
+ * Reader for the uncompressed contents of an entry, decompressing chunks on
+ * the fly when needed. Not thread-safe, use one per open asset.
+ */
+typedef struct assetPackStream assetPackStream;
+
+assetPackStream * asset_pack_stream_open(const assetPackEntry * e);
+void asset_pack_stream_close(assetPackStream * s);
+
+/*
+ * Reads up to `count` uncompressed bytes starting at `offset`.
+ * Returns the number of bytes read, 0 at the end or < 0 on error.
+ */
+int asset_pack_stream_read(assetPackStream * s, uint64_t offset, void * buf, size_t count);
+
+#endif // AFAKENATIVE_ASSET_PACK_H
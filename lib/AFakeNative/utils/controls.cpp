@@ -17,6 +17,8 @@
 #include <psp2/kernel/clib.h>
 #include "../keycodes.h"
 #include "../AInput.h"
+#include "../ALooper.h"
+#include "../AFakeNative_Utils.h"
 
 extern "C" {
 	float L_INNER_DEADZONE __attribute__((weak)) = 0.20f;
@@ -24,6 +26,11 @@ extern "C" {
 
 	int AInput_enableLeftStick __attribute__((weak)) = 1;
 	int AInput_enableRightStick __attribute__((weak)) = 1;
+
+	// How often the input thread wakes up to collect buffered pad/touch samples.
+	int AInput_samplingRateHz __attribute__((weak)) = 120;
+	// If set, sampling ticks are kept in phase with the game's frame swaps.
+	int AInput_alignToFrame __attribute__((weak)) = 0;
 }
 
 #define L_OUTER_DEADZONE 0.99f
@@ -40,6 +47,9 @@ extern "C" {
 #define LSTICK_PTR_ID 88
 #define RSTICK_PTR_ID 89
 
+// Max number of buffered samples read from the pad/touch drivers per tick.
+#define INPUT_SAMPLE_BUFFER 16
+
 
 AInputQueue * inputQueue;
 
@@ -70,11 +80,98 @@ void controls_init(AInputQueue * queue) {
 	pthread_detach(t);
 }
 
+/*
+ * Picks the samples newer than `lastStamp` out of a driver buffer and writes
+ * their indices to `order`, oldest first. Returns the number of new samples.
+ */
+template<typename T>
+int newSamplesInOrder(const T * samples, int count, uint64_t lastStamp, int * order) {
+	int n = 0;
+	for (int i = 0; i < count; i++) {
+		if (samples[i].timeStamp <= lastStamp) continue;
+
+		int j = n++;
+		while (j > 0 && samples[order[j - 1]].timeStamp > samples[i].timeStamp) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+	return n;
+}
+
+/*
+ * Timestamp of the newest sample in a driver buffer, 0 if it is empty.
+ */
+template<typename T>
+uint64_t newestSampleStamp(const T * samples, int count) {
+	uint64_t newest = 0;
+	for (int i = 0; i < count; i++) {
+		if (samples[i].timeStamp > newest) newest = samples[i].timeStamp;
+	}
+	return newest;
+}
+
+/*
+ * Converts a driver timestamp (microseconds) into the AFN_timeNanos() time
+ * base, using the newest sample of the batch as the reference for "now".
+ */
+int64_t sampleTime(uint64_t stamp, uint64_t newestStamp, int64_t now) {
+	return now - (int64_t)(newestStamp - stamp) * 1000LL;
+}
+
+/*
+ * Time to sleep until the next sampling tick, in microseconds. When
+ * `lastSwapUs` is known, ticks are placed at whole periods after it.
+ */
+uint64_t nextSampleDelay(uint64_t nowUs, uint64_t periodUs, uint64_t lastSwapUs) {
+	if (lastSwapUs == 0 || lastSwapUs > nowUs) return periodUs;
+	uint64_t sincePhase = (nowUs - lastSwapUs) % periodUs;
+	return periodUs - sincePhase;
+}
+
+static SceCtrlData pad_samples[INPUT_SAMPLE_BUFFER];
+static SceTouchData touch_samples[INPUT_SAMPLE_BUFFER];
+static uint64_t pad_last_stamp = 0;
+static uint64_t touch_last_stamp = 0;
+
 void * controls_poll(void * arg) {
+	int order[INPUT_SAMPLE_BUFFER];
+
+	// Whatever the drivers buffered before we started was never meant for
+	// the game, start from the newest sample so it isn't replayed.
+	int count = sceCtrlPeekBufferPositiveExt2(0, pad_samples, INPUT_SAMPLE_BUFFER);
+	pad_last_stamp = newestSampleStamp(pad_samples, count);
+	count = sceTouchPeek(SCE_TOUCH_PORT_FRONT, touch_samples, INPUT_SAMPLE_BUFFER);
+	touch_last_stamp = newestSampleStamp(touch_samples, count);
+
 	while (1) {
-		pollPad();
-		pollTouch();
-		sceKernelDelayThread(16666);
+		// Read everything the drivers buffered since the last tick so that
+		// short presses and fast swipes between ticks are not lost.
+		int64_t now = AFN_timeNanos();
+		count = sceCtrlPeekBufferPositiveExt2(0, pad_samples, INPUT_SAMPLE_BUFFER);
+		int n = (count > 0) ? newSamplesInOrder(pad_samples, count, pad_last_stamp, order) : 0;
+		for (int i = 0; i < n; i++) {
+			const SceCtrlData * s = &pad_samples[order[i]];
+			pollPad(s, sampleTime(s->timeStamp, pad_samples[order[n - 1]].timeStamp, now));
+		}
+		if (n > 0) pad_last_stamp = pad_samples[order[n - 1]].timeStamp;
+
+		now = AFN_timeNanos();
+		count = sceTouchPeek(SCE_TOUCH_PORT_FRONT, touch_samples, INPUT_SAMPLE_BUFFER);
+		n = (count > 0) ? newSamplesInOrder(touch_samples, count, touch_last_stamp, order) : 0;
+		for (int i = 0; i < n; i++) {
+			const SceTouchData * s = &touch_samples[order[i]];
+			pollTouch(s, sampleTime(s->timeStamp, touch_samples[order[n - 1]].timeStamp, now));
+		}
+		if (n > 0) touch_last_stamp = touch_samples[order[n - 1]].timeStamp;
+
+		int rate = AInput_samplingRateHz;
+		if (rate < 30) rate = 30;
+		if (rate > 1000) rate = 1000;
+
+		uint64_t lastSwapUs = AInput_alignToFrame ? ALooper_getLastFrameSwapMillis() * 1000 : 0;
+		sceKernelDelayThread(nextSampleDelay(AFN_timeMillis() * 1000, 1000000 / rate, lastSwapUs));
 	}
 }
 
@@ -114,14 +211,15 @@ void removeById(inputEvent * e, int id) {
 static int curr_max_id = 0;
 static int id_start = 0;
 
-void pollTouch() {
+void pollTouch(const SceTouchData * sample, int64_t time) {
 	int finger_id = 0;
 
 	memcpy(&touch_old, &touch, sizeof(touch_old));
 
 	int numPointersMoved = 0;
 
-	sceTouchPeek(SCE_TOUCH_PORT_FRONT, &touch, 1);
+	memcpy(&touch, sample, sizeof(touch));
+	ev.event_time = time;
 	if (touch.reportNum > 0) {
 		for (int i = 0; i < touch.reportNum; i++) {
 			int finger_down = 0;
@@ -152,6 +250,9 @@ void pollTouch() {
 
 				// Get global event state to have up-to-date indices and coordinates,
 				// but send a copy to not send MOVE too early / too often
+				if (numPointersDown == 0) {
+					ev.down_time = time;
+				}
 				inputEvent ev_ptrdown = ev;
 				if (numPointersDown == 0) {
 					ev_ptrdown.motion_action = AMOTION_EVENT_ACTION_DOWN;
@@ -256,7 +357,7 @@ int sticksDown = 0;
 float x_old = 0.0f, y_old = 0.0f, z_old = 0.0f, rz_old = 0.0f, hat_x_old = 0.0f, hat_y_old = 0.0f;
 bool ltPressed_old = false, rtPressed_old = false;
 
-void sendJoyEvent(float x, float y, float z, float rz, float hat_x, float hat_y, bool ltPressed, bool rtPressed) {
+void sendJoyEvent(float x, float y, float z, float rz, float hat_x, float hat_y, bool ltPressed, bool rtPressed, int64_t time) {
 	if (x != x_old || y != y_old || z != z_old || rz != rz_old || hat_x != hat_x_old || hat_y != hat_y_old || ltPressed != ltPressed_old || rtPressed != rtPressed_old) {
 		stickInputEvent.source = AINPUT_SOURCE_JOYSTICK;
 		stickInputEvent.motion_ptrcount = sticksDown + 1;
@@ -270,6 +371,8 @@ void sendJoyEvent(float x, float y, float z, float rz, float hat_x, float hat_y,
 		stickInputEvent.motion_rt[0] = rtPressed ? 1.0 : 0.0;
 		stickInputEvent.motion_ptridx[0] = 0;
 		stickInputEvent.type = AINPUT_EVENT_TYPE_MOTION;
+		stickInputEvent.event_time = time;
+		stickInputEvent.down_time = time;
 
 		stickInputEvent.motion_action = AMOTION_EVENT_ACTION_MOVE;
 		AInputEvent* aie = AInputEvent_create(&stickInputEvent);
@@ -286,9 +389,10 @@ void sendJoyEvent(float x, float y, float z, float rz, float hat_x, float hat_y,
 	}
 }
 
-void pollPad() {
-	SceCtrlData pad;
-	sceCtrlPeekBufferPositiveExt2(0, &pad, 1);
+static int64_t key_down_time = 0;
+
+void pollPad(const SceCtrlData * sample, int64_t time) {
+	SceCtrlData pad = *sample;
 
 	old_buttons = current_buttons;
 	current_buttons = pad.buttons;
@@ -311,6 +415,7 @@ void pollPad() {
 				e.keycode = AKEYCODE_BUTTON_Y;
 				e.action = AKEY_EVENT_ACTION_DOWN;
 				e.type = AINPUT_EVENT_TYPE_KEY;
+				e.event_time = e.down_time = key_down_time = time;
 
 				AInputEvent* aie = AInputEvent_create(&e);
 				AInputQueue_enqueueEvent(inputQueue, aie);
@@ -328,6 +433,7 @@ void pollPad() {
 				e.keycode = i.android_button;
 				e.action = AKEY_EVENT_ACTION_DOWN;
 				e.type = AINPUT_EVENT_TYPE_KEY;
+				e.event_time = e.down_time = key_down_time = time;
 
 				AInputEvent* aie = AInputEvent_create(&e);
 				AInputQueue_enqueueEvent(inputQueue, aie);
@@ -343,6 +449,8 @@ void pollPad() {
 					e.keycode = AKEYCODE_BUTTON_Y;
 					e.action = AKEY_EVENT_ACTION_UP;
 					e.type = AINPUT_EVENT_TYPE_KEY;
+					e.event_time = time;
+					e.down_time = key_down_time;
 
 					AInputEvent *aie = AInputEvent_create(&e);
 					AInputQueue_enqueueEvent(inputQueue, aie);
@@ -360,6 +468,8 @@ void pollPad() {
 					e.keycode = i.android_button;
 					e.action = AKEY_EVENT_ACTION_UP;
 					e.type = AINPUT_EVENT_TYPE_KEY;
+					e.event_time = time;
+					e.down_time = key_down_time;
 
 					AInputEvent *aie = AInputEvent_create(&e);
 					AInputQueue_enqueueEvent(inputQueue, aie);
@@ -398,5 +508,6 @@ void pollPad() {
 				 0,
 				 0,
 				 current_buttons & SCE_CTRL_L1,
-				 current_buttons & SCE_CTRL_R1);
+				 current_buttons & SCE_CTRL_R1,
+				 time);
 }
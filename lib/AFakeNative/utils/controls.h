@@ -41,8 +41,8 @@ typedef struct {
 
 void controls_init(AInputQueue * queue);
 void * controls_poll(void * arg);
-void pollTouch();
-void pollPad();
+void pollTouch(const SceTouchData * sample, int64_t time);
+void pollPad(const SceCtrlData * sample, int64_t time);
 void pollAccel();
 void runSilentStartHelper();
 
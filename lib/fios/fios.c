@@ -7,22 +7,139 @@
  */
 
 #include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <psp2/kernel/clib.h>
+#include <psp2/kernel/threadmgr.h>
 
 #include "fios.h"
 
 #define MAX_PATH_LENGTH 256
 #define RAMCACHEBLOCKSIZE (128 * 1024)
 #define RAMCACHEBLOCKNUM 64
+#define RAMCACHEMINBLOCKSIZE (16 * 1024)
+#define RAMCACHEMAXBLOCKSIZE (1024 * 1024)
+#define RAMCACHEMAXSIZE (64 * 1024 * 1024)
 
 static int64_t g_OpStorage[SCE_FIOS_OP_STORAGE_SIZE(64, MAX_PATH_LENGTH) / sizeof(int64_t) + 1];
 static int64_t g_ChunkStorage[SCE_FIOS_CHUNK_STORAGE_SIZE(1024) / sizeof(int64_t) + 1];
 static int64_t g_FHStorage[SCE_FIOS_FH_STORAGE_SIZE(1024, MAX_PATH_LENGTH) / sizeof(int64_t) + 1];
 static int64_t g_DHStorage[SCE_FIOS_DH_STORAGE_SIZE(32, MAX_PATH_LENGTH) / sizeof(int64_t) + 1];
 
-static SceFiosRamCacheContext g_RamCacheContext = SCE_FIOS_RAM_CACHE_CONTEXT_INITIALIZER;
-static char *g_RamCacheWorkBuffer;
+typedef struct fiosModelBlock {
+    uint32_t pathHash;
+    uint32_t index;
+    uint32_t lastUse; // 0: free
+} fiosModelBlock;
 
-int fios_init(void) {
+typedef struct fiosRamCache {
+    char path[MAX_PATH_LENGTH];
+    size_t pathLength;
+    int blockCount;
+    char *workBuffer;
+    SceFiosRamCacheContext context;
+    fiosModelBlock *model;
+} fiosRamCache;
+
+static fiosRamCache g_RamCaches[FIOS_MAX_CACHE_PATHS];
+static int g_RamCacheCount;
+static size_t g_RamCacheBlockSize;
+
+static SceKernelLwMutexWork g_ModelLock;
+static uint32_t g_ModelClock;
+static fiosCacheStats g_Stats;
+
+static int isPowerOfTwo(size_t v) {
+    return v && !(v & (v - 1));
+}
+
+static uint32_t pathHash(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Splits `paths` into g_RamCaches. Returns the number of paths.
+static int parsePaths(const char *paths) {
+    int count = 0;
+    const char *p = paths;
+
+    while (p && *p && count < FIOS_MAX_CACHE_PATHS) {
+        const char *end = strchr(p, ';');
+        size_t len = end ? (size_t) (end - p) : strlen(p);
+        if (len > 0 && len < MAX_PATH_LENGTH) {
+            memcpy(g_RamCaches[count].path, p, len);
+            g_RamCaches[count].path[len] = '\0';
+            g_RamCaches[count].pathLength = len;
+            count++;
+        }
+        p = end ? end + 1 : NULL;
+    }
+
+    return count;
+}
+
+static int addRamCaches(const fiosCacheConfig *config) {
+    size_t blockSize = config->blockSize;
+    int blockCount = config->blockCount;
+
+    if (!isPowerOfTwo(blockSize) || blockSize < RAMCACHEMINBLOCKSIZE || blockSize > RAMCACHEMAXBLOCKSIZE) {
+        sceClibPrintf("[fios] bad RAM cache block size %u, using %u\n", blockSize, RAMCACHEBLOCKSIZE);
+        blockSize = RAMCACHEBLOCKSIZE;
+    }
+    if (blockCount < 0) {
+        blockCount = RAMCACHEBLOCKNUM;
+    }
+    if ((size_t) blockCount * blockSize > RAMCACHEMAXSIZE) {
+        blockCount = (int) (RAMCACHEMAXSIZE / blockSize);
+        sceClibPrintf("[fios] RAM cache capped to %i blocks\n", blockCount);
+    }
+
+    int paths = parsePaths(config->paths);
+    if (blockCount == 0 || paths == 0)
+        return 0;
+
+    g_RamCacheBlockSize = blockSize;
+
+    for (int i = 0; i < paths; i++) {
+        fiosRamCache *c = &g_RamCaches[i];
+        c->blockCount = blockCount / paths + (i < blockCount % paths ? 1 : 0);
+        if (c->blockCount == 0)
+            break;
+
+        c->workBuffer = memalign(8, c->blockCount * blockSize);
+        c->model = calloc(c->blockCount, sizeof(fiosModelBlock));
+        if (!c->workBuffer || !c->model) {
+            free(c->workBuffer);
+            free(c->model);
+            return -1;
+        }
+
+        SceFiosRamCacheContext context = SCE_FIOS_RAM_CACHE_CONTEXT_INITIALIZER;
+        c->context = context;
+        c->context.pPath = c->path;
+        c->context.pWorkBuffer = c->workBuffer;
+        c->context.workBufferSize = c->blockCount * blockSize;
+        c->context.blockSize = blockSize;
+
+        int res = sceFiosIOFilterAdd(i, sceFiosIOFilterCache, &c->context);
+        if (res < 0) {
+            free(c->workBuffer);
+            free(c->model);
+            return res;
+        }
+
+        g_RamCacheCount = i + 1;
+        sceClibPrintf("[fios] RAM cache on %s: %i x %u KB\n", c->path, c->blockCount, blockSize / 1024);
+    }
+
+    return 0;
+}
+
+int fios_init(const fiosCacheConfig *config) {
     int res;
 
     SceFiosParams params = SCE_FIOS_PARAMS_INITIALIZER;
@@ -48,22 +165,108 @@ int fios_init(void) {
     if (res < 0)
         return res;
 
-    g_RamCacheWorkBuffer = memalign(8, RAMCACHEBLOCKNUM * RAMCACHEBLOCKSIZE);
-    if (!g_RamCacheWorkBuffer)
-        return -1;
+    sceKernelCreateLwMutex(&g_ModelLock, "fios_cache_model", 0, 0, NULL);
 
-    g_RamCacheContext.pPath = DATA_PATH;
-    g_RamCacheContext.pWorkBuffer = g_RamCacheWorkBuffer;
-    g_RamCacheContext.workBufferSize = RAMCACHEBLOCKNUM * RAMCACHEBLOCKSIZE;
-    g_RamCacheContext.blockSize = RAMCACHEBLOCKSIZE;
-    res = sceFiosIOFilterAdd(0, sceFiosIOFilterCache, &g_RamCacheContext);
-    if (res < 0)
-        return res;
-
-    return 0;
+    fiosCacheConfig defaults = { RAMCACHEBLOCKSIZE, RAMCACHEBLOCKNUM, DATA_PATH };
+    return addRamCaches(config ? config : &defaults);
 }
 
 void fios_terminate(void) {
     sceFiosTerminate();
-    free(g_RamCacheWorkBuffer);
+    for (int i = 0; i < g_RamCacheCount; i++) {
+        free(g_RamCaches[i].workBuffer);
+        free(g_RamCaches[i].model);
+    }
+    g_RamCacheCount = 0;
+}
+
+static fiosRamCache *findCache(const char *path) {
+    for (int i = 0; i < g_RamCacheCount; i++) {
+        if (strncmp(path, g_RamCaches[i].path, g_RamCaches[i].pathLength) == 0)
+            return &g_RamCaches[i];
+    }
+    return NULL;
+}
+
+int fios_cache_covers(const char *path) {
+    return path && findCache(path) != NULL;
+}
+
+// Looks up one block in the model, loading it over the least recently used
+// one on a miss. Returns whether it was a hit. Called with g_ModelLock held.
+static int touchBlock(fiosRamCache *c, uint32_t hash, uint32_t index) {
+    fiosModelBlock *victim = &c->model[0];
+
+    g_ModelClock++;
+    for (int i = 0; i < c->blockCount; i++) {
+        fiosModelBlock *b = &c->model[i];
+        if (b->lastUse != 0 && b->pathHash == hash && b->index == index) {
+            b->lastUse = g_ModelClock;
+            return 1;
+        }
+        if (b->lastUse < victim->lastUse)
+            victim = b;
+    }
+
+    if (victim->lastUse != 0)
+        g_Stats.evictions++;
+    victim->pathHash = hash;
+    victim->index = index;
+    victim->lastUse = g_ModelClock;
+    return 0;
+}
+
+void fios_cache_account(const char *path, uint64_t offset, size_t size) {
+    if (!path || size == 0)
+        return;
+
+    fiosRamCache *c = findCache(path);
+    if (!c)
+        return;
+
+#ifdef DEBUG_SOLOADER
+    // Parsed by extras/scripts/fios_cache_sim.py.
+    sceClibPrintf("[fios] read %s %llu %u\n", path, offset, size);
+#endif
+
+    uint32_t hash = pathHash(path);
+    uint64_t end = offset + size;
+    uint64_t first = offset / g_RamCacheBlockSize;
+    uint64_t last = (end - 1) / g_RamCacheBlockSize;
+
+    sceKernelLockLwMutex(&g_ModelLock, 1, NULL);
+    g_Stats.reads++;
+    g_Stats.bytesRequested += size;
+    for (uint64_t block = first; block <= last; block++) {
+        uint64_t blockStart = block * g_RamCacheBlockSize;
+        uint64_t blockEnd = blockStart + g_RamCacheBlockSize;
+        uint64_t from = offset > blockStart ? offset : blockStart;
+        uint64_t to = end < blockEnd ? end : blockEnd;
+
+        if (touchBlock(c, hash, (uint32_t) block)) {
+            g_Stats.blockHits++;
+            g_Stats.bytesFromCache += to - from;
+        } else {
+            g_Stats.blockMisses++;
+        }
+    }
+    sceKernelUnlockLwMutex(&g_ModelLock, 1);
+}
+
+void fios_get_cache_stats(fiosCacheStats *stats) {
+    if (g_RamCacheCount == 0) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    sceKernelLockLwMutex(&g_ModelLock, 1, NULL);
+    *stats = g_Stats;
+    sceKernelUnlockLwMutex(&g_ModelLock, 1);
+}
+
+void fios_reset_cache_stats(void) {
+    if (g_RamCacheCount == 0)
+        return;
+    sceKernelLockLwMutex(&g_ModelLock, 1, NULL);
+    memset(&g_Stats, 0, sizeof(g_Stats));
+    sceKernelUnlockLwMutex(&g_ModelLock, 1);
 }
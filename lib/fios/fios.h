@@ -77,6 +77,44 @@ void sceFiosTerminate();
 int sceFiosIOFilterAdd(int index, void *pFilterCallback, void *pFilterContext);
 void sceFiosIOFilterCache();
 
-int fios_init(void);
+/*
+ * RAM cache geometry. `paths` is a ';'-separated list of path prefixes to
+ * cache (at most FIOS_MAX_CACHE_PATHS); the `blockCount` blocks are split
+ * evenly between them. blockCount 0 disables the RAM cache.
+ */
+#define FIOS_MAX_CACHE_PATHS 4
+
+typedef struct fiosCacheConfig {
+    size_t blockSize;
+    int blockCount;
+    const char *paths;
+} fiosCacheConfig;
+
+/*
+ * FIOS doesn't report what its RAM cache does, so these come from an LRU
+ * model of the same geometry fed with the reads made on cached paths
+ * (see fios_cache_account()). Only builds with FIOS_CACHE_MODEL feed it;
+ * otherwise the counts stay 0. Counts are in cache blocks unless stated.
+ */
+typedef struct fiosCacheStats {
+    uint64_t reads;          // read calls on cached paths
+    uint64_t blockHits;
+    uint64_t blockMisses;
+    uint64_t evictions;
+    uint64_t bytesRequested; // bytes
+    uint64_t bytesFromCache; // bytes, part of bytesRequested
+} fiosCacheStats;
+
+int fios_init(const fiosCacheConfig *config);
+void fios_terminate(void);
+
+/* Whether reads of `path` go through one of the RAM caches. */
+int fios_cache_covers(const char *path);
+
+/* Records a read of `size` bytes at `offset` of `path` in the cache model. */
+void fios_cache_account(const char *path, uint64_t offset, size_t size);
+
+void fios_get_cache_stats(fiosCacheStats *stats);
+void fios_reset_cache_stats(void);
 
 #endif
\ No newline at end of file
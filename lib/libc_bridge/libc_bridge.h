@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <setjmp.h>
+#include <wchar.h>
 
 #ifdef __cplusplus
 extern "C" {
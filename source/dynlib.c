@@ -47,6 +47,7 @@
 
 #include <so_util/so_util.h>
 
+#include "utils/allocprof.h"
 #include "utils/glutil.h"
 #include "utils/utils.h"
 #include "utils/logger.h"
@@ -57,11 +58,13 @@
 
 #include "reimpl/env.h"
 #include "reimpl/errno.h"
+#include "reimpl/fastmath.h"
 #include "reimpl/io.h"
 #include "reimpl/ioctl.h"
 #include "reimpl/log.h"
 #include "reimpl/mem.h"
 #include "reimpl/pthr.h"
+#include "reimpl/slab.h"
 #include "reimpl/sys.h"
 
 #include <AFakeNative/ALooper.h>
@@ -160,31 +163,6 @@ int sigaction(int signal, const struct sigaction* bionic_new_action, struct siga
 	return 0;
 }
 
-int AAsset_getBuffer() {
-	log_error("unimpl: AAsset_getBuffer");
-	return 0;
-}
-int AAsset_getLength() {
-	log_error("unimpl: AAsset_getLength");
-	return 0;
-}
-int AAsset_openFileDescriptor() {
-	log_error("unimpl: AAsset_openFileDescriptor");
-	return 0;
-}
-int AAssetDir_close() {
-	log_error("unimpl: AAssetDir_close");
-	return 0;
-}
-int AAssetDir_getNextFileName() {
-	log_error("unimpl: AAssetDir_getNextFileName");
-	return 0;
-}
-
-int AAssetManager_openDir() {
-	log_error("unimpl: AAssetManager_openDir");
-	return 0;
-}
 int AInputEvent_getDeviceId() {
 	//log_error("unimpl: AInputEvent_getDeviceId");
 	return 0;
@@ -201,18 +179,6 @@ int AMotionEvent_getFlags() {
 	//log_error("unimpl: AMotionEvent_getFlags");
 	return 0;
 }
-int AMotionEvent_getHistoricalX() {
-	log_error("unimpl: AMotionEvent_getHistoricalX");
-	return 0;
-}
-int AMotionEvent_getHistoricalY() {
-	log_error("unimpl: AMotionEvent_getHistoricalY");
-	return 0;
-}
-int AMotionEvent_getHistorySize() {
-	//log_error("unimpl: AMotionEvent_getHistorySize");
-	return 0;
-}
 int AMotionEvent_getMetaState() {
 	//log_error("unimpl: AMotionEvent_getMetaState");
 	return 0;
@@ -269,10 +235,22 @@ so_default_dynlib default_dynlib[] = {
 		{ "_ZTVN10__cxxabiv117__class_type_infoE", (uintptr_t)&_ZTVN10__cxxabiv117__class_type_infoE },
 		{ "_ZTVN10__cxxabiv120__si_class_type_infoE", (uintptr_t)&_ZTVN10__cxxabiv120__si_class_type_infoE },
 		{ "_ZTVN10__cxxabiv121__vmi_class_type_infoE", (uintptr_t)&_ZTVN10__cxxabiv121__vmi_class_type_infoE },
+		#if defined(ALLOC_PROFILER)
+		{ "_ZdaPv", (uintptr_t)&allocprof_delete },
+		{ "_ZdlPv", (uintptr_t)&allocprof_delete },
+		{ "_Znaj", (uintptr_t)&allocprof_new },
+		{ "_Znwj", (uintptr_t)&allocprof_new },
+		#elif defined(SLAB_ALLOC)
+		{ "_ZdaPv", (uintptr_t)&slab_free },
+		{ "_ZdlPv", (uintptr_t)&slab_free },
+		{ "_Znaj", (uintptr_t)&slab_new },
+		{ "_Znwj", (uintptr_t)&slab_new },
+		#else
 		{ "_ZdaPv", (uintptr_t)&_ZdaPv },
 		{ "_ZdlPv", (uintptr_t)&_ZdlPv },
 		{ "_Znaj", (uintptr_t)&_Znaj },
 		{ "_Znwj", (uintptr_t)&_Znwj },
+		#endif
 		{ "__aeabi_atexit", (uintptr_t)&__aeabi_atexit },
 		{ "__aeabi_d2lz", (uintptr_t)&__aeabi_d2lz },
 		{ "__aeabi_dadd", (uintptr_t)&__aeabi_dadd },
@@ -339,14 +317,21 @@ so_default_dynlib default_dynlib[] = {
 		// ANative
 		{ "AAssetDir_close", (uintptr_t)&AAssetDir_close },
 		{ "AAssetDir_getNextFileName", (uintptr_t)&AAssetDir_getNextFileName },
+		{ "AAssetDir_rewind", (uintptr_t)&AAssetDir_rewind },
 		{ "AAssetManager_open", (uintptr_t)&AAssetManager_open },
 		{ "AAssetManager_openDir", (uintptr_t)&AAssetManager_openDir },
 		{ "AAsset_close", (uintptr_t)&AAsset_close },
 		{ "AAsset_getBuffer", (uintptr_t)&AAsset_getBuffer },
 		{ "AAsset_getLength", (uintptr_t)&AAsset_getLength },
+		{ "AAsset_getLength64", (uintptr_t)&AAsset_getLength64 },
+		{ "AAsset_getRemainingLength", (uintptr_t)&AAsset_getRemainingLength },
+		{ "AAsset_getRemainingLength64", (uintptr_t)&AAsset_getRemainingLength64 },
+		{ "AAsset_isAllocated", (uintptr_t)&AAsset_isAllocated },
 		{ "AAsset_openFileDescriptor", (uintptr_t)&AAsset_openFileDescriptor },
+		{ "AAsset_openFileDescriptor64", (uintptr_t)&AAsset_openFileDescriptor64 },
 		{ "AAsset_read", (uintptr_t)&AAsset_read },
 		{ "AAsset_seek", (uintptr_t)&AAsset_seek },
+		{ "AAsset_seek64", (uintptr_t)&AAsset_seek64 },
 		{ "AConfiguration_delete", (uintptr_t)&AConfiguration_delete },
 		{ "AConfiguration_fromAssetManager", (uintptr_t)&AConfiguration_fromAssetManager },
 		{ "AConfiguration_getCountry", (uintptr_t)&AConfiguration_getCountry },
@@ -361,6 +346,8 @@ so_default_dynlib default_dynlib[] = {
 		{ "AInputQueue_getEvent", (uintptr_t)&AInputQueue_getEvent },
 		{ "AInputQueue_preDispatchEvent", (uintptr_t)&AInputQueue_preDispatchEvent },
 		{ "AKeyEvent_getAction", (uintptr_t)&AKeyEvent_getAction },
+		{ "AKeyEvent_getDownTime", (uintptr_t)&AKeyEvent_getDownTime },
+		{ "AKeyEvent_getEventTime", (uintptr_t)&AKeyEvent_getEventTime },
 		{ "AKeyEvent_getFlags", (uintptr_t)&AKeyEvent_getFlags },
 		{ "AKeyEvent_getKeyCode", (uintptr_t)&AKeyEvent_getKeyCode },
 		{ "AKeyEvent_getMetaState", (uintptr_t)&AKeyEvent_getMetaState },
@@ -369,7 +356,10 @@ so_default_dynlib default_dynlib[] = {
 		{ "ALooper_prepare", (uintptr_t)&ALooper_prepare },
 		{ "AMotionEvent_getAction", (uintptr_t)&AMotionEvent_getAction },
 		{ "AMotionEvent_getAxisValue", (uintptr_t)&AMotionEvent_getAxisValue },
+		{ "AMotionEvent_getDownTime", (uintptr_t)&AMotionEvent_getDownTime },
+		{ "AMotionEvent_getEventTime", (uintptr_t)&AMotionEvent_getEventTime },
 		{ "AMotionEvent_getFlags", (uintptr_t)&AMotionEvent_getFlags },
+		{ "AMotionEvent_getHistoricalEventTime", (uintptr_t)&AMotionEvent_getHistoricalEventTime },
 		{ "AMotionEvent_getHistoricalX", (uintptr_t)&AMotionEvent_getHistoricalX },
 		{ "AMotionEvent_getHistoricalY", (uintptr_t)&AMotionEvent_getHistoricalY },
 		{ "AMotionEvent_getHistorySize", (uintptr_t)&AMotionEvent_getHistorySize },
@@ -424,16 +414,16 @@ so_default_dynlib default_dynlib[] = {
 		{ "asinf", (uintptr_t)&asinf },
 		{ "atan", (uintptr_t)&atan },
 		{ "atan2", (uintptr_t)&atan2 },
-		{ "atan2f", (uintptr_t)&atan2f },
-		{ "atanf", (uintptr_t)&atanf },
+		{ "atan2f", (uintptr_t)&fastmath_atan2f },
+		{ "atanf", (uintptr_t)&fastmath_atanf },
 		{ "ceil", (uintptr_t)&ceil },
 		{ "ceilf", (uintptr_t)&ceilf },
 		{ "cos", (uintptr_t)&cos },
-		{ "cosf", (uintptr_t)&cosf },
+		{ "cosf", (uintptr_t)&fastmath_cosf },
 		{ "exp", (uintptr_t)&exp },
 		{ "exp2", (uintptr_t)&exp2 },
 		{ "exp2f", (uintptr_t)&exp2f },
-		{ "expf", (uintptr_t)&expf },
+		{ "expf", (uintptr_t)&fastmath_expf },
 		{ "floor", (uintptr_t)&floor },
 		{ "floorf", (uintptr_t)&floorf },
 		{ "fmod", (uintptr_t)&fmod },
@@ -444,7 +434,7 @@ so_default_dynlib default_dynlib[] = {
 		{ "log", (uintptr_t)&log },
 		{ "log10", (uintptr_t)&log10 },
 		{ "log10f", (uintptr_t)&log10f },
-		{ "logf", (uintptr_t)&logf },
+		{ "logf", (uintptr_t)&fastmath_logf },
 		{ "lrint", (uintptr_t)&lrint },
 		{ "lrintf", (uintptr_t)&lrintf },
 		{ "lround", (uintptr_t)&lround },
@@ -452,7 +442,7 @@ so_default_dynlib default_dynlib[] = {
 		{ "modf", (uintptr_t)&modf },
 		{ "modff", (uintptr_t)&modff },
 		{ "pow", (uintptr_t)&pow },
-		{ "powf", (uintptr_t)&powf },
+		{ "powf", (uintptr_t)&fastmath_powf },
 		{ "rint", (uintptr_t)&rint },
 		{ "rintf", (uintptr_t)&rintf },
 		{ "round", (uintptr_t)&round },
@@ -461,11 +451,11 @@ so_default_dynlib default_dynlib[] = {
 		{ "scalbnf", (uintptr_t)&scalbnf },
 		{ "sin", (uintptr_t)&sin },
 		{ "sincos", (uintptr_t)&sincos },
-		{ "sincosf", (uintptr_t)&sincosf },
-		{ "sinf", (uintptr_t)&sinf },
+		{ "sincosf", (uintptr_t)&fastmath_sincosf },
+		{ "sinf", (uintptr_t)&fastmath_sinf },
 		{ "sinh", (uintptr_t)&sinh },
 		{ "sqrt", (uintptr_t)&sqrt },
-		{ "sqrtf", (uintptr_t)&sqrtf },
+		{ "sqrtf", (uintptr_t)&fastmath_sqrtf },
 		{ "tan", (uintptr_t)&tan },
 		{ "tanf", (uintptr_t)&tanf },
 		{ "tanh", (uintptr_t)&tanh },
@@ -504,10 +494,22 @@ so_default_dynlib default_dynlib[] = {
 		
 
 		// Memory
+		#if defined(ALLOC_PROFILER)
+		{ "calloc", (uintptr_t)&allocprof_calloc },
+		{ "free", (uintptr_t)&allocprof_free },
+		{ "malloc", (uintptr_t)&allocprof_malloc },
+		{ "memalign", (uintptr_t)&allocprof_memalign },
+		#elif defined(SLAB_ALLOC)
+		{ "calloc", (uintptr_t)&slab_calloc },
+		{ "free", (uintptr_t)&slab_free },
+		{ "malloc", (uintptr_t)&slab_malloc },
+		{ "memalign", (uintptr_t)&slab_memalign },
+		#else
 		{ "calloc", (uintptr_t)&calloc },
 		{ "free", (uintptr_t)&free },
 		{ "malloc", (uintptr_t)&malloc },
 		{ "memalign", (uintptr_t)&memalign },
+		#endif
 		{ "memcmp", (uintptr_t)&memcmp },
 		{ "memcpy", (uintptr_t)&memcpy },
 		{ "memmem", (uintptr_t)&memmem },
@@ -515,7 +517,13 @@ so_default_dynlib default_dynlib[] = {
 		{ "memset", (uintptr_t)&memset },
 		{ "mmap", (uintptr_t)&mmap },
 		{ "munmap", (uintptr_t)&munmap },
+		#if defined(ALLOC_PROFILER)
+		{ "realloc", (uintptr_t)&allocprof_realloc },
+		#elif defined(SLAB_ALLOC)
+		{ "realloc", (uintptr_t)&slab_realloc },
+		#else
 		{ "realloc", (uintptr_t)&realloc },
+		#endif
 		{ "valloc", (uintptr_t)&valloc },
 		
 
@@ -525,6 +533,9 @@ so_default_dynlib default_dynlib[] = {
 		{ "fclose", (uintptr_t)&fclose_soloader },
 		{ "fcntl", (uintptr_t)&fcntl_soloader },
 		{ "fopen", (uintptr_t)&fopen_soloader },
+		{ "fread", (uintptr_t)&fread_soloader },
+		{ "freopen", (uintptr_t)&freopen_soloader },
+		{ "fseek", (uintptr_t)&fseek_soloader },
 		{ "fstat", (uintptr_t)&fstat_soloader },
 		{ "ioctl", (uintptr_t)&ioctl_soloader },
 		{ "open", (uintptr_t)&open_soloader },
@@ -543,9 +554,6 @@ so_default_dynlib default_dynlib[] = {
 			{ "fgets", (uintptr_t)&sceLibcBridge_fgets },
 			{ "fputc", (uintptr_t)&sceLibcBridge_fputc },
 			{ "fputs", (uintptr_t)&sceLibcBridge_fputs },
-			{ "fread", (uintptr_t)&sceLibcBridge_fread },
-			{ "freopen", (uintptr_t)&sceLibcBridge_freopen },
-			{ "fseek", (uintptr_t)&sceLibcBridge_fseek },
 			{ "fsetpos", (uintptr_t)&sceLibcBridge_fsetpos },
 			{ "ftell", (uintptr_t)&sceLibcBridge_ftell },
 			{ "fwrite", (uintptr_t)&sceLibcBridge_fwrite },
@@ -568,9 +576,6 @@ so_default_dynlib default_dynlib[] = {
 			{ "fgets", (uintptr_t)&fgets },
 			{ "fputc", (uintptr_t)&fputc },
 			{ "fputs", (uintptr_t)&fputs },
-			{ "fread", (uintptr_t)&fread },
-			{ "freopen", (uintptr_t)&freopen },
-			{ "fseek", (uintptr_t)&fseek },
 			{ "fsetpos", (uintptr_t)&fsetpos },
 			{ "ftell", (uintptr_t)&ftell },
 			{ "fwrite", (uintptr_t)&fwrite },
@@ -585,7 +590,7 @@ so_default_dynlib default_dynlib[] = {
 			{ "ungetwc", (uintptr_t)&ungetwc },
 		#endif
 
-		{ "access", (uintptr_t)&access },
+		{ "access", (uintptr_t)&access_soloader },
 		{ "chdir", (uintptr_t)&chdir },
 		{ "chmod", (uintptr_t)&chmod },
 		{ "dup", (uintptr_t)&dup },
@@ -596,16 +601,16 @@ so_default_dynlib default_dynlib[] = {
 		{ "getcwd", (uintptr_t)&getcwd },
 		{ "lseek", (uintptr_t)&lseek },
 		//{ "lstat", (uintptr_t)&lstat },
-		{ "mkdir", (uintptr_t)&mkdir },
+		{ "mkdir", (uintptr_t)&mkdir_soloader },
 		{ "pipe", (uintptr_t)&pseudo_pipe },
 		{ "read", (uintptr_t)&pseudo_read },
 		{ "realpath", (uintptr_t)&realpath },
-		{ "remove", (uintptr_t)&remove },
-		{ "rename", (uintptr_t)&rename },
+		{ "remove", (uintptr_t)&remove_soloader },
+		{ "rename", (uintptr_t)&rename_soloader },
 		{ "rewind", (uintptr_t)&rewind },
-		{ "rmdir", (uintptr_t)&rmdir },
-		{ "truncate", (uintptr_t)&truncate },
-		{ "unlink", (uintptr_t)&unlink },
+		{ "rmdir", (uintptr_t)&rmdir_soloader },
+		{ "truncate", (uintptr_t)&truncate_soloader },
+		{ "unlink", (uintptr_t)&unlink_soloader },
 		{ "write", (uintptr_t)&pseudo_write },
 
 
@@ -775,7 +780,7 @@ so_default_dynlib default_dynlib[] = {
 		{ "eglInitialize", (uintptr_t)&eglInitialize },
 		{ "eglMakeCurrent", (uintptr_t)&eglMakeCurrent },
 		{ "eglQuerySurface", (uintptr_t)&eglQuerySurface },
-		{ "eglSwapBuffers", (uintptr_t)&eglSwapBuffers },
+		{ "eglSwapBuffers", (uintptr_t)&eglSwapBuffers_soloader },
 		{ "eglTerminate", (uintptr_t)&eglTerminate },
 
 
@@ -914,10 +919,10 @@ so_default_dynlib default_dynlib[] = {
 
 		// Time
 		{ "clock", (uintptr_t)&clock },
-		//{ "clock_getres", (uintptr_t)&clock_getres },
-		{ "clock_gettime", (uintptr_t)&clock_gettime },
+		{ "clock_getres", (uintptr_t)&clock_getres_soloader },
+		{ "clock_gettime", (uintptr_t)&clock_gettime_soloader },
 		{ "difftime", (uintptr_t)&difftime },
-		{ "gettimeofday", (uintptr_t)&gettimeofday },
+		{ "gettimeofday", (uintptr_t)&gettimeofday_soloader },
 		{ "gmtime", (uintptr_t)&gmtime },
 		{ "gmtime_r", (uintptr_t)&gmtime_r },
 		{ "localtime", (uintptr_t)&localtime },
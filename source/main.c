@@ -42,6 +42,8 @@ int main() {
 	
 	soloader_init_all();
 
+	ALooper_setFramePacing(setting_framePacing);
+
 	int (*ANativeActivity_onCreate)(ANativeActivity *activity, void *savedState,
 									size_t savedStateSize) = (void *) so_symbol(&so_mod, "ANativeActivity_onCreate");
 
@@ -30,14 +30,14 @@ SC_INLINE int oflags_newlib_to_oflags_musl(int flags)
     return out;
 }
 
-SC_INLINE dirent64_bionic * dirent_newlib_to_dirent_bionic(const struct dirent* dirent_newlib)
+SC_INLINE void dirent_newlib_to_dirent_bionic(const struct dirent* src, dirent64_bionic* dst)
 {
-    dirent64_bionic * ret = malloc(sizeof(dirent64_bionic));
-    strncpy(ret->d_name, dirent_newlib->d_name, sizeof(ret->d_name));
-    ret->d_off = 0;
-    ret->d_reclen = 0;
-    ret->d_type = SCE_S_ISDIR(dirent_newlib->d_stat.st_mode) ? DT_DIR : DT_REG;
-    return ret;
+    strncpy(dst->d_name, src->d_name, sizeof(dst->d_name) - 1);
+    dst->d_name[sizeof(dst->d_name) - 1] = '\0';
+    dst->d_ino = 0;
+    dst->d_off = 0;
+    dst->d_reclen = sizeof(dirent64_bionic);
+    dst->d_type = SCE_S_ISDIR(src->d_stat.st_mode) ? DT_DIR : DT_REG;
 }
 
 SC_INLINE void stat_newlib_to_stat_bionic(const struct stat * src, stat64_bionic * dst)
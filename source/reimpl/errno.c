@@ -1,142 +1,183 @@
 #include "reimpl/errno.h"
 
+#include <stdint.h>
 #include <sys/errno.h>
 #include <string.h>
 #include "_errno_bionic.h"
 #include "utils/logger.h"
 
-typedef struct {
-	int errno_newlib;
-	int errno_bionic;
-	const char * strerror;
-} newlib_errno_to_bionic_errno;
-
-static newlib_errno_to_bionic_errno errno_translation[] = {
-	{ 0, 0, "Success" },
-	{ EPERM, EPERM_BIONIC, "Operation not permitted" },
-	{ ENOENT, ENOENT_BIONIC, "No such file or directory" },
-	{ ESRCH, ESRCH_BIONIC, "No such process" },
-	{ EINTR, EINTR_BIONIC, "Interrupted system call" },
-	{ EIO, EIO_BIONIC, "I/O error" },
-	{ ENXIO, ENXIO_BIONIC, "No such device or address" },
-	{ E2BIG, E2BIG_BIONIC, "Argument list too long" },
-	{ ENOEXEC, ENOEXEC_BIONIC, "Exec format error" },
-	{ EBADF, EBADF_BIONIC, "Bad file descriptor" },
-	{ ECHILD, ECHILD_BIONIC, "No child processes" },
-	{ EAGAIN, EAGAIN_BIONIC, "Try again" },
-	{ ENOMEM, ENOMEM_BIONIC, "Out of memory" },
-	{ EACCES, EACCES_BIONIC, "Permission denied" },
-	{ EFAULT, EFAULT_BIONIC, "Bad address" },
-	{ ENOTBLK, ENOTBLK_BIONIC, "Block device required" },
-	{ EBUSY, EBUSY_BIONIC, "Device or resource busy" },
-	{ EEXIST, EEXIST_BIONIC, "File exists" },
-	{ EXDEV, EXDEV_BIONIC, "Cross-device link" },
-	{ ENODEV, ENODEV_BIONIC, "No such device" },
-	{ ENOTDIR, ENOTDIR_BIONIC, "Not a directory" },
-	{ EISDIR, EISDIR_BIONIC, "Is a directory" },
-	{ EINVAL, EINVAL_BIONIC, "Invalid argument" },
-	{ ENFILE, ENFILE_BIONIC, "File table overflow" },
-	{ EMFILE, EMFILE_BIONIC, "Too many open files" },
-	{ ENOTTY, ENOTTY_BIONIC, "Inappropriate ioctl for device" },
-	{ ETXTBSY, ETXTBSY_BIONIC, "Text file busy" },
-	{ EFBIG, EFBIG_BIONIC, "File too large" },
-	{ ENOSPC, ENOSPC_BIONIC, "No space left on device" },
-	{ ESPIPE, ESPIPE_BIONIC, "Illegal seek" },
-	{ EROFS, EROFS_BIONIC, "Read-only file system" },
-	{ EMLINK, EMLINK_BIONIC, "Too many links" },
-	{ EPIPE, EPIPE_BIONIC, "Broken pipe" },
-	{ EDOM, EDOM_BIONIC, "Math argument out of domain of func" },
-	{ ERANGE, ERANGE_BIONIC, "Math result not representable" },
-	{ ENOMSG, ENOMSG_BIONIC, "No message of desired type" },
-	{ EIDRM, EIDRM_BIONIC, "Identifier removed" },
-	{ EDEADLK, EDEADLK_BIONIC, "Resource deadlock would occur" },
-	{ ENOLCK, ENOLCK_BIONIC, "No record locks available" },
-	{ ENOSTR, ENOSTR_BIONIC, "Device not a stream" },
-	{ ENODATA, ENODATA_BIONIC, "No data available" },
-	{ ETIME, ETIME_BIONIC, "Timer expired" },
-	{ ENOSR, ENOSR_BIONIC, "Out of streams resources" },
-	{ EREMOTE, EREMOTE_BIONIC, "Object is remote" },
-	{ ENOLINK, ENOLINK_BIONIC, "Link has been severed" },
-	{ EPROTO, EPROTO_BIONIC, "Protocol error" },
-	{ EMULTIHOP, EMULTIHOP_BIONIC, "Multihop attempted" },
-	{ EBADMSG, EBADMSG_BIONIC, "Not a data message" },
-	// { EFTYPE, 0, "" }, // EFTYPE is only for newlib internal usage
-	{ ENOSYS, ENOSYS_BIONIC, "Function not implemented" },
-	{ ENOTEMPTY, ENOTEMPTY_BIONIC, "Directory not empty" },
-	{ ENAMETOOLONG, ENAMETOOLONG_BIONIC, "File name too long" },
-	{ ELOOP, ELOOP_BIONIC, "Too many symbolic links encountered" },
-	{ EOPNOTSUPP, EOPNOTSUPP_BIONIC, "Operation not supported on transport endpoint" },
-	{ EPFNOSUPPORT, EPFNOSUPPORT_BIONIC, "Protocol family not supported" },
-	{ ECONNRESET, ECONNRESET_BIONIC, "Connection reset by peer" },
-	{ ENOBUFS, ENOBUFS_BIONIC, "No buffer space available" },
-	{ EAFNOSUPPORT, EAFNOSUPPORT_BIONIC, "Address family not supported by protocol" },
-	{ EPROTOTYPE, EPROTOTYPE_BIONIC, "Protocol wrong type for socket" },
-	{ ENOTSOCK, ENOTSOCK_BIONIC, "Socket operation on non-socket" },
-	{ ENOPROTOOPT, ENOPROTOOPT_BIONIC, "Protocol not available" },
-	{ ESHUTDOWN, ESHUTDOWN_BIONIC, "Cannot send after transport endpoint shutdown" },
-	{ ECONNREFUSED, ECONNREFUSED_BIONIC, "Connection refused" },
-	{ EADDRINUSE, EADDRINUSE_BIONIC, "Address already in use" },
-	{ ECONNABORTED, ECONNABORTED_BIONIC, "Software caused connection abort" },
-	{ ENETUNREACH, ENETUNREACH_BIONIC, "Network is unreachable" },
-	{ ENETDOWN, ENETDOWN_BIONIC, "Network is down" },
-	{ ETIMEDOUT, ETIMEDOUT_BIONIC, "Connection timed out" },
-	{ EHOSTDOWN, EHOSTDOWN_BIONIC, "Host is down" },
-	{ EHOSTUNREACH, EHOSTUNREACH_BIONIC, "No route to host" },
-	{ EINPROGRESS, EINPROGRESS_BIONIC, "Operation now in progress" },
-	{ EALREADY, EALREADY_BIONIC, "Operation already in progress" },
-	{ EDESTADDRREQ, EDESTADDRREQ_BIONIC, "Destination address required" },
-	{ EMSGSIZE, EMSGSIZE_BIONIC, "Message too long" },
-	{ EPROTONOSUPPORT, EPROTONOSUPPORT_BIONIC, "Protocol not supported" },
-	{ ESOCKTNOSUPPORT, ESOCKTNOSUPPORT_BIONIC, "Socket type not supported" },
-	{ EADDRNOTAVAIL, EADDRNOTAVAIL_BIONIC, "Cannot assign requested address" },
-	{ ENETRESET, ENETRESET_BIONIC, "Network dropped connection because of reset" },
-	{ EISCONN, EISCONN_BIONIC, "Transport endpoint is already connected" },
-	{ ENOTCONN, ENOTCONN_BIONIC, "Transport endpoint is not connected" },
-	{ ETOOMANYREFS, ETOOMANYREFS_BIONIC, "Too many references: cannot splice" },
-	{ EUSERS, EUSERS_BIONIC, "Too many users" },
-	{ EDQUOT, EDQUOT_BIONIC, "Quota exceeded" },
-	{ ESTALE, ESTALE_BIONIC, "Stale NFS file handle" },
-	{ ENOTSUP, ENOTSUP_BIONIC, "Operation not supported" },
-	{ EILSEQ, EILSEQ_BIONIC, "Illegal byte sequence" },
-	{ EOVERFLOW, EOVERFLOW_BIONIC, "Value too large for defined data type" },
-	{ ECANCELED, ECANCELED_BIONIC, "Operation Canceled" },
-	{ ENOTRECOVERABLE, ENOTRECOVERABLE_BIONIC, "State not recoverable" },
-	{ EOWNERDEAD, EOWNERDEAD_BIONIC, "Owner died" },
-};
+// X(newlib errno, bionic errno, bionic strerror)
+#define ERRNO_TABLE(X) \
+	X(0, 0, "Success")                                                                \
+	X(EPERM, EPERM_BIONIC, "Operation not permitted")                                 \
+	X(ENOENT, ENOENT_BIONIC, "No such file or directory")                             \
+	X(ESRCH, ESRCH_BIONIC, "No such process")                                         \
+	X(EINTR, EINTR_BIONIC, "Interrupted system call")                                 \
+	X(EIO, EIO_BIONIC, "I/O error")                                                   \
+	X(ENXIO, ENXIO_BIONIC, "No such device or address")                               \
+	X(E2BIG, E2BIG_BIONIC, "Argument list too long")                                  \
+	X(ENOEXEC, ENOEXEC_BIONIC, "Exec format error")                                   \
+	X(EBADF, EBADF_BIONIC, "Bad file descriptor")                                     \
+	X(ECHILD, ECHILD_BIONIC, "No child processes")                                    \
+	X(EAGAIN, EAGAIN_BIONIC, "Try again")                                             \
+	X(ENOMEM, ENOMEM_BIONIC, "Out of memory")                                         \
+	X(EACCES, EACCES_BIONIC, "Permission denied")                                     \
+	X(EFAULT, EFAULT_BIONIC, "Bad address")                                           \
+	X(ENOTBLK, ENOTBLK_BIONIC, "Block device required")                               \
+	X(EBUSY, EBUSY_BIONIC, "Device or resource busy")                                 \
+	X(EEXIST, EEXIST_BIONIC, "File exists")                                           \
+	X(EXDEV, EXDEV_BIONIC, "Cross-device link")                                       \
+	X(ENODEV, ENODEV_BIONIC, "No such device")                                        \
+	X(ENOTDIR, ENOTDIR_BIONIC, "Not a directory")                                     \
+	X(EISDIR, EISDIR_BIONIC, "Is a directory")                                        \
+	X(EINVAL, EINVAL_BIONIC, "Invalid argument")                                      \
+	X(ENFILE, ENFILE_BIONIC, "File table overflow")                                   \
+	X(EMFILE, EMFILE_BIONIC, "Too many open files")                                   \
+	X(ENOTTY, ENOTTY_BIONIC, "Inappropriate ioctl for device")                        \
+	X(ETXTBSY, ETXTBSY_BIONIC, "Text file busy")                                      \
+	X(EFBIG, EFBIG_BIONIC, "File too large")                                          \
+	X(ENOSPC, ENOSPC_BIONIC, "No space left on device")                               \
+	X(ESPIPE, ESPIPE_BIONIC, "Illegal seek")                                          \
+	X(EROFS, EROFS_BIONIC, "Read-only file system")                                   \
+	X(EMLINK, EMLINK_BIONIC, "Too many links")                                        \
+	X(EPIPE, EPIPE_BIONIC, "Broken pipe")                                             \
+	X(EDOM, EDOM_BIONIC, "Math argument out of domain of func")                       \
+	X(ERANGE, ERANGE_BIONIC, "Math result not representable")                         \
+	X(ENOMSG, ENOMSG_BIONIC, "No message of desired type")                            \
+	X(EIDRM, EIDRM_BIONIC, "Identifier removed")                                      \
+	X(EDEADLK, EDEADLK_BIONIC, "Resource deadlock would occur")                       \
+	X(ENOLCK, ENOLCK_BIONIC, "No record locks available")                             \
+	X(ENOSTR, ENOSTR_BIONIC, "Device not a stream")                                   \
+	X(ENODATA, ENODATA_BIONIC, "No data available")                                   \
+	X(ETIME, ETIME_BIONIC, "Timer expired")                                           \
+	X(ENOSR, ENOSR_BIONIC, "Out of streams resources")                                \
+	X(EREMOTE, EREMOTE_BIONIC, "Object is remote")                                    \
+	X(ENOLINK, ENOLINK_BIONIC, "Link has been severed")                               \
+	X(EPROTO, EPROTO_BIONIC, "Protocol error")                                        \
+	X(EMULTIHOP, EMULTIHOP_BIONIC, "Multihop attempted")                              \
+	X(EBADMSG, EBADMSG_BIONIC, "Not a data message")                                  \
+	/* EFTYPE is only for newlib internal usage */                                    \
+	X(ENOSYS, ENOSYS_BIONIC, "Function not implemented")                              \
+	X(ENOTEMPTY, ENOTEMPTY_BIONIC, "Directory not empty")                             \
+	X(ENAMETOOLONG, ENAMETOOLONG_BIONIC, "File name too long")                        \
+	X(ELOOP, ELOOP_BIONIC, "Too many symbolic links encountered")                     \
+	X(EOPNOTSUPP, EOPNOTSUPP_BIONIC, "Operation not supported on transport endpoint") \
+	X(EPFNOSUPPORT, EPFNOSUPPORT_BIONIC, "Protocol family not supported")             \
+	X(ECONNRESET, ECONNRESET_BIONIC, "Connection reset by peer")                      \
+	X(ENOBUFS, ENOBUFS_BIONIC, "No buffer space available")                           \
+	X(EAFNOSUPPORT, EAFNOSUPPORT_BIONIC, "Address family not supported by protocol")  \
+	X(EPROTOTYPE, EPROTOTYPE_BIONIC, "Protocol wrong type for socket")                \
+	X(ENOTSOCK, ENOTSOCK_BIONIC, "Socket operation on non-socket")                    \
+	X(ENOPROTOOPT, ENOPROTOOPT_BIONIC, "Protocol not available")                      \
+	X(ESHUTDOWN, ESHUTDOWN_BIONIC, "Cannot send after transport endpoint shutdown")   \
+	X(ECONNREFUSED, ECONNREFUSED_BIONIC, "Connection refused")                        \
+	X(EADDRINUSE, EADDRINUSE_BIONIC, "Address already in use")                        \
+	X(ECONNABORTED, ECONNABORTED_BIONIC, "Software caused connection abort")          \
+	X(ENETUNREACH, ENETUNREACH_BIONIC, "Network is unreachable")                      \
+	X(ENETDOWN, ENETDOWN_BIONIC, "Network is down")                                   \
+	X(ETIMEDOUT, ETIMEDOUT_BIONIC, "Connection timed out")                            \
+	X(EHOSTDOWN, EHOSTDOWN_BIONIC, "Host is down")                                    \
+	X(EHOSTUNREACH, EHOSTUNREACH_BIONIC, "No route to host")                          \
+	X(EINPROGRESS, EINPROGRESS_BIONIC, "Operation now in progress")                   \
+	X(EALREADY, EALREADY_BIONIC, "Operation already in progress")                     \
+	X(EDESTADDRREQ, EDESTADDRREQ_BIONIC, "Destination address required")              \
+	X(EMSGSIZE, EMSGSIZE_BIONIC, "Message too long")                                  \
+	X(EPROTONOSUPPORT, EPROTONOSUPPORT_BIONIC, "Protocol not supported")              \
+	X(ESOCKTNOSUPPORT, ESOCKTNOSUPPORT_BIONIC, "Socket type not supported")           \
+	X(EADDRNOTAVAIL, EADDRNOTAVAIL_BIONIC, "Cannot assign requested address")         \
+	X(ENETRESET, ENETRESET_BIONIC, "Network dropped connection because of reset")     \
+	X(EISCONN, EISCONN_BIONIC, "Transport endpoint is already connected")             \
+	X(ENOTCONN, ENOTCONN_BIONIC, "Transport endpoint is not connected")               \
+	X(ETOOMANYREFS, ETOOMANYREFS_BIONIC, "Too many references: cannot splice")        \
+	X(EUSERS, EUSERS_BIONIC, "Too many users")                                        \
+	X(EDQUOT, EDQUOT_BIONIC, "Quota exceeded")                                        \
+	X(ESTALE, ESTALE_BIONIC, "Stale NFS file handle")                                 \
+	/* ENOTSUP: bionic has it as EOPNOTSUPP, see ERRNO_ALIASES */                     \
+	X(EILSEQ, EILSEQ_BIONIC, "Illegal byte sequence")                                 \
+	X(EOVERFLOW, EOVERFLOW_BIONIC, "Value too large for defined data type")           \
+	X(ECANCELED, ECANCELED_BIONIC, "Operation Canceled")                              \
+	X(ENOTRECOVERABLE, ENOTRECOVERABLE_BIONIC, "State not recoverable")               \
+	X(EOWNERDEAD, EOWNERDEAD_BIONIC, "Owner died")
+
+// newlib errnos that bionic folds into one of the above. They translate to
+// bionic, but the bionic value translates back to the entry above.
+// X(newlib errno, bionic errno)
+#define ERRNO_ALIASES(X) \
+	X(ENOTSUP, EOPNOTSUPP_BIONIC)
+
+// Both errno sets fit in a byte. Only 0 translates to 0, so a 0 for any
+// other value means the value is unknown.
+#define ERRNO_MAX 256
+
+#define X(newlib, bionic, str) [newlib] = bionic,
+#define ALIAS(newlib, bionic) [newlib] = bionic,
+static const uint8_t errno_newlib_to_bionic[ERRNO_MAX] = { ERRNO_TABLE(X) ERRNO_ALIASES(ALIAS) };
+#undef ALIAS
+#undef X
+
+#define X(newlib, bionic, str) [bionic] = newlib,
+static const uint8_t errno_bionic_to_newlib[ERRNO_MAX] = { ERRNO_TABLE(X) };
+#undef X
+
+#define X(newlib, bionic, str) [bionic] = str,
+static const char * const errno_strings[ERRNO_MAX] = { ERRNO_TABLE(X) };
+#undef X
+
+// The game's errno: the translation of newlib's errno at the last
+// __errno() call, and what it was then.
+static __thread int errno_bionic = 0;
+static __thread int errno_bionic_given = 0;
+static __thread int errno_newlib_seen = 0;
+
+static inline int translate_newlib(int e) {
+	int b = ((unsigned) e < ERRNO_MAX) ? errno_newlib_to_bionic[e] : 0;
+	if (b == 0 && e != 0)
+		logv_error("[errno]: Unexpected newlib errno %i, will return 0 instead of translation", e);
+	return b;
+}
+
+static inline const char * bionic_strerror(int error_number) {
+	return ((unsigned) error_number < ERRNO_MAX) ? errno_strings[error_number] : NULL;
+}
 
 int * __errno_soloader(void) {
 	int e = errno;
 
-	for (int i = 0; i < sizeof(errno_translation) / sizeof(errno_translation[0]); ++i) {
-		if (e == errno_translation[i].errno_newlib)
-			return (int *) &errno_translation[i].errno_bionic;
+	// The game stored to errno (e.g. errno = 0 before strtol()) and nothing
+	// in newlib has set it since: pass the store on. A newlib call that
+	// sets errno to the very value it had before goes unnoticed.
+	if (errno_bionic != errno_bionic_given && e == errno_newlib_seen) {
+		int n = ((unsigned) errno_bionic < ERRNO_MAX) ? errno_bionic_to_newlib[errno_bionic] : 0;
+		if (n != 0 || errno_bionic == 0)
+			e = errno = n;
 	}
 
-	logv_error("[errno]: Unexpected newlib errno %i, will return 0 instead of translation", e);
-	return (int *) &errno_translation[0].errno_bionic;
+	errno_newlib_seen = e;
+	errno_bionic = errno_bionic_given = translate_newlib(e);
+	return &errno_bionic;
+}
+
+int errno_to_bionic(int newlib_errno) {
+	return translate_newlib(newlib_errno);
 }
 
 char * strerror_soloader(int error_number) {
-	for (int i = 0; i < sizeof(errno_translation) / sizeof(errno_translation[0]); ++i) {
-		if (error_number == errno_translation[i].errno_bionic)
-			return (char *) errno_translation[i].strerror;
+	const char * err = bionic_strerror(error_number);
+
+	if (err == NULL) {
+		logv_error("[strerror]: Unexpected bionic errno %i, will return 'Success' instead of translation", error_number);
+		err = errno_strings[0];
 	}
 
-	logv_error("[strerror]: Unexpected bionic errno %i, will return 'Success' instead of translation", error_number);
-	return (char *) errno_translation[0].strerror;
+	return (char *) err;
 }
 
 int strerror_r_soloader(int error_number, char* buf, size_t buf_len) {
-	const char * err = NULL;
-
-	for (int i = 0; i < sizeof(errno_translation) / sizeof(errno_translation[0]); ++i) {
-		if (error_number == errno_translation[i].errno_bionic)
-			err = errno_translation[i].strerror;
-	}
+	const char * err = bionic_strerror(error_number);
 
 	if (err == NULL) {
 		logv_error("[strerror_r]: Unexpected bionic errno %i, will return 'Success' instead of translation", error_number);
-		err = errno_translation[0].strerror;
+		err = errno_strings[0];
 	}
 
 	size_t length = strlcpy(buf, err, buf_len);
@@ -15,6 +15,14 @@
 #include <stddef.h>
 
 int * __errno_soloader(void);
+
+/*
+ * Translates a newlib errno value to bionic's, for error codes that are
+ * returned rather than set in errno (the pthread functions). Values bionic
+ * has no equivalent for are logged and give 0.
+ */
+int errno_to_bionic(int newlib_errno);
+
 char * strerror_soloader(int error_number);
 int strerror_r_soloader(int error_number, char* buf, size_t buf_len);
 
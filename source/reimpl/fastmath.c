@@ -0,0 +1,340 @@
+/*
+ * reimpl/fastmath.c
+ *
+ * Float math replacements, see fastmath.h.
+ *
+ * Built with -fno-fast-math: the range reductions depend on the exact
+ * evaluation order, and the special value checks on NaN and infinity
+ * comparisons working.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/fastmath.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define PI      3.14159265358979311600e+00
+#define PIO2    1.57079632679489655800e+00
+#define PIO6    5.23598775598298815658e-01
+#define INVPIO2 6.36619772367581382433e-01
+#define SQRT3   1.73205080756887719318e+00
+#define LN2     6.93147180559945286227e-01
+#define LOG2E   1.44269504088896338700e+00
+
+// pi/2 in two parts, the first with 33 bits so k * PIO2_1 is exact for
+// k < 2^20
+#define PIO2_1  1.57079632673412561417e+00
+#define PIO2_1T 6.07710050650619224932e-11
+
+// Adding and subtracting this rounds a double below 2^51 to an integer
+#define ROUNDER 0x1.8p52
+
+static inline uint32_t float_bits(float x) {
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+static inline float bits_float(uint32_t u) {
+    float x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+static inline double bits_double(uint64_t u) {
+    double x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+/*
+ * Precise tier: double evaluation. The polynomials are truncated series
+ * whose error is far below a float ULP; what remains is the final rounding.
+ */
+
+// sin and cos on [-pi/4, pi/4]
+static inline double sin_d(double r) {
+    double z = r * r;
+    return r + r * z * (-1.0 / 6 + z * (1.0 / 120 + z * (-1.0 / 5040 + z * (1.0 / 362880 + z * (-1.0 / 39916800)))));
+}
+
+static inline double cos_d(double r) {
+    double z = r * r;
+    return 1.0 + z * (-1.0 / 2 + z * (1.0 / 24 + z * (-1.0 / 720 + z * (1.0 / 40320 + z * (-1.0 / 3628800 + z * (1.0 / 479001600))))));
+}
+
+// x - q * pi/2, |x| < 2^20
+static inline double reduce_pio2_d(float x, int *q) {
+    double k = ((double) x * INVPIO2 + ROUNDER) - ROUNDER;
+    *q = (int) k;
+    return ((double) x - k * PIO2_1) - k * PIO2_1T;
+}
+
+float fastmath_sinf_precise(float x) {
+    if (!(fabsf(x) < 0x1p20f) || x == 0.0f) // sin(-0) is -0
+        return sinf(x);
+
+    int q;
+    double r = reduce_pio2_d(x, &q);
+    switch (q & 3) {
+        case 0: return (float) sin_d(r);
+        case 1: return (float) cos_d(r);
+        case 2: return (float) -sin_d(r);
+        default: return (float) -cos_d(r);
+    }
+}
+
+float fastmath_cosf_precise(float x) {
+    if (!(fabsf(x) < 0x1p20f))
+        return cosf(x);
+
+    int q;
+    double r = reduce_pio2_d(x, &q);
+    switch (q & 3) {
+        case 0: return (float) cos_d(r);
+        case 1: return (float) -sin_d(r);
+        case 2: return (float) -cos_d(r);
+        default: return (float) sin_d(r);
+    }
+}
+
+void fastmath_sincosf_precise(float x, float *s, float *c) {
+    if (!(fabsf(x) < 0x1p20f) || x == 0.0f) { // sin(-0) is -0
+        sincosf(x, s, c);
+        return;
+    }
+
+    int q;
+    double r = reduce_pio2_d(x, &q);
+    double sr = sin_d(r), cr = cos_d(r);
+    switch (q & 3) {
+        case 0: *s = (float) sr;  *c = (float) cr;  break;
+        case 1: *s = (float) cr;  *c = (float) -sr; break;
+        case 2: *s = (float) -sr; *c = (float) -cr; break;
+        default: *s = (float) -cr; *c = (float) sr; break;
+    }
+}
+
+// e^t for |t| < 104, relative error ~1e-11
+static inline double exp_d(double t) {
+    double k = (t * LOG2E + ROUNDER) - ROUNDER;
+    double r = t - k * LN2;
+    double p = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 + r * (1.0 / 120 + r * (1.0 / 720
+               + r * (1.0 / 5040 + r * (1.0 / 40320 + r * (1.0 / 362880)))))))));
+    return p * bits_double((uint64_t) (1023 + (int) k) << 52);
+}
+
+// ln(x) for finite x > 0, relative error ~1e-16
+static inline double log_d(float x) {
+    uint32_t u = float_bits(x);
+    int e = 0;
+    if (u < 0x00800000) { // subnormal
+        u = float_bits(x * 0x1p23f);
+        e = -23;
+    }
+    e += (int) (u >> 23) - 127;
+    double m = bits_float((u & 0x007FFFFF) | 0x3F800000); // [1, 2)
+    if (m > 1.41421356237309514547) {
+        m *= 0.5;
+        e++;
+    }
+
+    // ln(m) = 2 atanh(s), s = (m - 1) / (m + 1), |s| < 0.172
+    double f = m - 1.0;
+    double s = f / (2.0 + f);
+    double z = s * s;
+    double p = 1.0 + z * (1.0 / 3 + z * (1.0 / 5 + z * (1.0 / 7 + z * (1.0 / 9 + z * (1.0 / 11 + z * (1.0 / 13
+               + z * (1.0 / 15 + z * (1.0 / 17 + z * (1.0 / 19)))))))));
+    return e * LN2 + 2.0 * s * p;
+}
+
+float fastmath_expf_precise(float x) {
+    if (x > 89.0f)
+        return HUGE_VALF;
+    if (x < -104.0f)
+        return 0.0f;
+    if (x != x)
+        return x + x;
+    return (float) exp_d(x);
+}
+
+float fastmath_logf_precise(float x) {
+    if (x > 0.0f && x < INFINITY)
+        return (float) log_d(x);
+    return logf(x);
+}
+
+float fastmath_powf_precise(float x, float y) {
+    if (!(x > 0.0f && x < INFINITY) || !(fabsf(y) < INFINITY))
+        return powf(x, y);
+
+    double t = y * log_d(x);
+    if (t > 89.0)
+        return HUGE_VALF;
+    if (t < -104.0)
+        return 0.0f;
+    return (float) exp_d(t);
+}
+
+// atan(a), a >= 0 or NaN
+static inline double atan_d(double a) {
+    int invert = a > 1.0;
+    if (invert)
+        a = 1.0 / a;
+
+    // atan(a) = pi/6 + atan(t), |t| <= 2 - sqrt(3)
+    double base = 0.0;
+    if (a > 0.26794919243112270) {
+        a = (a * SQRT3 - 1.0) / (SQRT3 + a);
+        base = PIO6;
+    }
+    double z = a * a;
+    double r = base + a + a * z * (-1.0 / 3 + z * (1.0 / 5 + z * (-1.0 / 7 + z * (1.0 / 9 + z * (-1.0 / 11
+               + z * (1.0 / 13 + z * (-1.0 / 15)))))));
+    return invert ? PIO2 - r : r;
+}
+
+float fastmath_atanf_precise(float x) {
+    double r = atan_d(fabs((double) x));
+    return (float) (signbit(x) ? -r : r);
+}
+
+float fastmath_atan2f_precise(float y, float x) {
+    if (!(fabsf(x) < INFINITY && fabsf(y) < INFINITY) || x == 0.0f || y == 0.0f)
+        return atan2f(y, x);
+
+    double r = atan_d(fabs((double) y / x));
+    if (x < 0.0f)
+        r = PI - r;
+    return (float) (y < 0.0f ? -r : r);
+}
+
+/*
+ * Fast tier: float evaluation, after cephes.
+ */
+
+static inline float sin_f(float r) {
+    float z = r * r;
+    return ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+}
+
+static inline float cos_f(float r) {
+    float z = r * r;
+    return ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+}
+
+// The reduction stays in double: in float, results near the zeros of sin
+// and cos lose most of their bits.
+
+float fastmath_sinf_fast(float x) {
+    if (!(fabsf(x) < 0x1p20f) || x == 0.0f) // sin(-0) is -0
+        return sinf(x);
+
+    int q;
+    float r = (float) reduce_pio2_d(x, &q);
+    float s = (q & 1) ? cos_f(r) : sin_f(r);
+    return (q & 2) ? -s : s;
+}
+
+float fastmath_cosf_fast(float x) {
+    if (!(fabsf(x) < 0x1p20f))
+        return cosf(x);
+
+    int q;
+    float r = (float) reduce_pio2_d(x, &q);
+    float c = (q & 1) ? sin_f(r) : cos_f(r);
+    return ((q + 1) & 2) ? -c : c;
+}
+
+void fastmath_sincosf_fast(float x, float *s, float *c) {
+    if (!(fabsf(x) < 0x1p20f) || x == 0.0f) { // sin(-0) is -0
+        sincosf(x, s, c);
+        return;
+    }
+
+    int q;
+    float r = (float) reduce_pio2_d(x, &q);
+    float sr = sin_f(r), cr = cos_f(r);
+    float sv = (q & 1) ? cr : sr;
+    float cv = (q & 1) ? sr : cr;
+    *s = (q & 2) ? -sv : sv;
+    *c = ((q + 1) & 2) ? -cv : cv;
+}
+
+float fastmath_expf_fast(float x) {
+    if (x > 88.72283905206835f)
+        return HUGE_VALF;
+    if (!(x >= -87.33654475055310f)) // and NaN
+        return expf(x);
+
+    float k = (float) (int) (x * (float) LOG2E + (x < 0.0f ? -0.5f : 0.5f));
+    float r = (x - k * 0.693359375f) + k * 2.12194440e-4f;
+    float z = r * r;
+    float p = (((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r + 4.1665795894e-2f) * r
+               + 1.6666665459e-1f) * r + 5.0000001201e-1f) * z + r + 1.0f;
+
+    // k is in [-126, 128]; 2^128 isn't a float, so scale in two steps
+    int n = (int) k;
+    return p * bits_float((uint32_t) (127 + n / 2) << 23) * bits_float((uint32_t) (127 + n - n / 2) << 23);
+}
+
+float fastmath_logf_fast(float x) {
+    uint32_t u = float_bits(x);
+    if (u - 0x00800000 >= 0x7F800000 - 0x00800000) // <= 0, subnormal, inf, NaN
+        return logf(x);
+
+    // x = m * 2^e, m in [sqrt(1/2), sqrt(2))
+    int e = (int) (u >> 23) - 126;
+    float m = bits_float((u & 0x007FFFFF) | 0x3F000000); // [0.5, 1)
+    if (m < 0.707106781186547524f) {
+        e--;
+        m = m + m - 1.0f;
+    } else {
+        m = m - 1.0f;
+    }
+
+    float z = m * m;
+    float y = ((((((((7.0376836292e-2f * m - 1.1514610310e-1f) * m + 1.1676998740e-1f) * m - 1.2420140846e-1f) * m
+                 + 1.4249322787e-1f) * m - 1.6668057665e-1f) * m + 2.0000714765e-1f) * m - 2.4999993993e-1f) * m
+              + 3.3333331174e-1f) * m * z;
+    float fe = (float) e;
+    y += -2.12194440e-4f * fe;
+    y += -0.5f * z;
+    return (m + y) + 0.693359375f * fe;
+}
+
+// atan(a), a >= 0 or NaN
+static inline float atan_f(float a) {
+    float base = 0.0f;
+    if (a > 2.414213562373095f) {
+        base = (float) PIO2;
+        a = -1.0f / a;
+    } else if (a > 0.4142135623730950f) {
+        base = (float) (PIO2 / 2);
+        a = (a - 1.0f) / (a + 1.0f);
+    }
+    float z = a * a;
+    return base + (((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * a + a;
+}
+
+float fastmath_atanf_fast(float x) {
+    float r = atan_f(fabsf(x));
+    return signbit(x) ? -r : r;
+}
+
+float fastmath_atan2f_fast(float y, float x) {
+    if (!(fabsf(x) < INFINITY && fabsf(y) < INFINITY) || x == 0.0f || y == 0.0f)
+        return atan2f(y, x);
+
+    float r = atan_f(fabsf(y / x));
+    if (x < 0.0f)
+        r = (float) PI - r;
+    return y < 0.0f ? -r : r;
+}
+
+float fastmath_sqrtf_vfp(float x) {
+    return __builtin_sqrtf(x);
+}
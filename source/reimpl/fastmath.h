@@ -0,0 +1,148 @@
+/*
+ * reimpl/fastmath.h
+ *
+ * Replacements for the hot float math imports. Each function can be
+ * switched from newlib to one of two tiers at build time, with
+ * -DFAST_MATH="sinf=precise;atan2f=fast;...":
+ *
+ *   precise  evaluated in double on the VFP, then rounded: within 0.6 ULP
+ *   fast     cephes polynomials in float: a few ULP, cheaper
+ *
+ * Arguments outside the ranges below, and special values, go to newlib.
+ *
+ * Max error against glibc's double functions, in ULP of the float result,
+ * over every 37th float (sinf..atanf) or 30M random pairs (atan2f, powf),
+ * as tests/fastmath_ulp_test.c measures it:
+ *
+ *   function  precise  fast   handled here
+ *   sinf      0.56     1.51   0 < |x| < 2^20
+ *   cosf      0.56     1.54   |x| < 2^20
+ *   sincosf   0.56     1.54   0 < |x| < 2^20
+ *   expf      0.50     0.97   all; fast: x >= -87.3
+ *   logf      0.50     0.79   x > 0, finite; fast: normal x
+ *   powf      0.50     -      x > 0, finite; y finite
+ *   atanf     0.50     3.33   all
+ *   atan2f    0.50     3.45   x, y finite and nonzero
+ *   sqrtf     0.50            all, with the VFP vsqrt in either tier
+ *
+ * Cost per call next to glibc's float functions, in ns on an x86 host, as
+ * tests/fastmath_bench.c measures it, and the tier to pick from that:
+ *
+ *   function  libm   precise  fast   use
+ *   sinf      6.5    5.9      10.1   precise
+ *   cosf      7.7    6.2      10.4   precise
+ *   sincosf   14.0   9.9      7.8    fast
+ *   expf      4.6    7.4      8.6    newlib
+ *   logf      5.2    11.2     7.8    newlib
+ *   powf      7.3    26.1     -      newlib
+ *   atanf     9.5    6.7      3.7    fast
+ *   atan2f    29.8   13.0     7.4    fast
+ *   sqrtf     3.1    3.1             newlib
+ *
+ * glibc's expf, logf and powf are table driven and newlib's are not, so
+ * "newlib" above only means that no tier beat glibc on the host. Every
+ * choice in the last column still wants a run of fastmath_bench on the
+ * Vita before a game build relies on it.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_FASTMATH_H
+#define SOLOADER_FASTMATH_H
+
+#include <math.h>
+
+#define FASTMATH_PRECISE 1
+#define FASTMATH_FAST 2
+
+float fastmath_sinf_precise(float x);
+float fastmath_sinf_fast(float x);
+float fastmath_cosf_precise(float x);
+float fastmath_cosf_fast(float x);
+void fastmath_sincosf_precise(float x, float *s, float *c);
+void fastmath_sincosf_fast(float x, float *s, float *c);
+float fastmath_expf_precise(float x);
+float fastmath_expf_fast(float x);
+float fastmath_logf_precise(float x);
+float fastmath_logf_fast(float x);
+float fastmath_powf_precise(float x, float y);
+float fastmath_atanf_precise(float x);
+float fastmath_atanf_fast(float x);
+float fastmath_atan2f_precise(float y, float x);
+float fastmath_atan2f_fast(float y, float x);
+float fastmath_sqrtf_vfp(float x);
+
+// What the dynlib table maps each import to
+
+#if FASTMATH_SINF == FASTMATH_PRECISE
+#define fastmath_sinf fastmath_sinf_precise
+#elif FASTMATH_SINF == FASTMATH_FAST
+#define fastmath_sinf fastmath_sinf_fast
+#else
+#define fastmath_sinf sinf
+#endif
+
+#if FASTMATH_COSF == FASTMATH_PRECISE
+#define fastmath_cosf fastmath_cosf_precise
+#elif FASTMATH_COSF == FASTMATH_FAST
+#define fastmath_cosf fastmath_cosf_fast
+#else
+#define fastmath_cosf cosf
+#endif
+
+#if FASTMATH_SINCOSF == FASTMATH_PRECISE
+#define fastmath_sincosf fastmath_sincosf_precise
+#elif FASTMATH_SINCOSF == FASTMATH_FAST
+#define fastmath_sincosf fastmath_sincosf_fast
+#else
+#define fastmath_sincosf sincosf
+#endif
+
+#if FASTMATH_EXPF == FASTMATH_PRECISE
+#define fastmath_expf fastmath_expf_precise
+#elif FASTMATH_EXPF == FASTMATH_FAST
+#define fastmath_expf fastmath_expf_fast
+#else
+#define fastmath_expf expf
+#endif
+
+#if FASTMATH_LOGF == FASTMATH_PRECISE
+#define fastmath_logf fastmath_logf_precise
+#elif FASTMATH_LOGF == FASTMATH_FAST
+#define fastmath_logf fastmath_logf_fast
+#else
+#define fastmath_logf logf
+#endif
+
+#if FASTMATH_POWF == FASTMATH_PRECISE
+#define fastmath_powf fastmath_powf_precise
+#elif FASTMATH_POWF == FASTMATH_FAST
+#error "powf has no fast tier, use FAST_MATH=powf=precise"
+#else
+#define fastmath_powf powf
+#endif
+
+#if FASTMATH_ATANF == FASTMATH_PRECISE
+#define fastmath_atanf fastmath_atanf_precise
+#elif FASTMATH_ATANF == FASTMATH_FAST
+#define fastmath_atanf fastmath_atanf_fast
+#else
+#define fastmath_atanf atanf
+#endif
+
+#if FASTMATH_ATAN2F == FASTMATH_PRECISE
+#define fastmath_atan2f fastmath_atan2f_precise
+#elif FASTMATH_ATAN2F == FASTMATH_FAST
+#define fastmath_atan2f fastmath_atan2f_fast
+#else
+#define fastmath_atan2f atan2f
+#endif
+
+#if FASTMATH_SQRTF == FASTMATH_PRECISE || FASTMATH_SQRTF == FASTMATH_FAST
+#define fastmath_sqrtf fastmath_sqrtf_vfp
+#else
+#define fastmath_sqrtf sqrtf
+#endif
+
+#endif // SOLOADER_FASTMATH_H
@@ -0,0 +1,116 @@
+/*
+ * reimpl/futex.c
+ *
+ * Futex-style wait/wake, see futex.h.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/futex.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+
+static atomic_uint futex_next_thread_id = 1;
+static __thread uint16_t futex_self_id = 0;
+
+uint16_t futex_thread_id(void) {
+    if (futex_self_id == 0) {
+        uint16_t id;
+        do {
+            id = (uint16_t) atomic_fetch_add(&futex_next_thread_id, 1);
+        } while (id == 0);
+        futex_self_id = id;
+    }
+    return futex_self_id;
+}
+
+#ifdef __vita__
+
+#include <psp2/kernel/threadmgr.h>
+
+#include "utils/lazy_init.h"
+
+#define FUTEX_BUCKETS 128 // power of two
+
+// A waiter checks the word and goes to sleep under the bucket lock, and a
+// waker takes the same lock after changing the word, so no wakeup is lost.
+// Addresses share buckets, so every wake is a broadcast and waiters recheck.
+typedef struct {
+    SceKernelLwMutexWork lock;
+    SceKernelLwCondWork cond;
+    int waiters;
+} futex_bucket;
+
+static futex_bucket futex_buckets[FUTEX_BUCKETS];
+static lazy_init_state futex_buckets_state = 0;
+
+static futex_bucket *bucket_of(volatile int *addr) {
+    if (lazy_init_claim(&futex_buckets_state)) {
+        for (int i = 0; i < FUTEX_BUCKETS; i++) {
+            sceKernelCreateLwMutex(&futex_buckets[i].lock, "futex_lock", 0, 0, NULL);
+            sceKernelCreateLwCond(&futex_buckets[i].cond, "futex_cond", 0, &futex_buckets[i].lock, NULL);
+        }
+        lazy_init_done(&futex_buckets_state);
+    }
+
+    uintptr_t a = (uintptr_t) addr;
+    return &futex_buckets[((a >> 2) ^ (a >> 9)) & (FUTEX_BUCKETS - 1)];
+}
+
+int futex_wait(volatile int *addr, int expected, uint64_t timeout_us) {
+    futex_bucket *b = bucket_of(addr);
+    int ret = 0;
+
+    sceKernelLockLwMutex(&b->lock, 1, NULL);
+    if (atomic_load((_Atomic int *) addr) == expected) {
+        b->waiters++;
+        if (timeout_us == FUTEX_WAIT_FOREVER) {
+            sceKernelWaitLwCond(&b->cond, NULL);
+        } else {
+            SceUInt32 timeout = timeout_us > 0xFFFFFFFF ? 0xFFFFFFFF : (SceUInt32) timeout_us;
+            if (timeout == 0 || sceKernelWaitLwCond(&b->cond, &timeout) == (int) SCE_KERNEL_ERROR_WAIT_TIMEOUT)
+                ret = ETIMEDOUT;
+        }
+        b->waiters--;
+    }
+    sceKernelUnlockLwMutex(&b->lock, 1);
+
+    return ret;
+}
+
+void futex_wake(volatile int *addr, int count) {
+    futex_bucket *b = bucket_of(addr);
+
+    sceKernelLockLwMutex(&b->lock, 1, NULL);
+    if (b->waiters > 0)
+        sceKernelSignalLwCondAll(&b->cond);
+    sceKernelUnlockLwMutex(&b->lock, 1);
+}
+
+#else // Linux, for testing
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+int futex_wait(volatile int *addr, int expected, uint64_t timeout_us) {
+    struct timespec ts, *pts = NULL;
+    if (timeout_us != FUTEX_WAIT_FOREVER) {
+        ts.tv_sec = timeout_us / 1000000;
+        ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        pts = &ts;
+    }
+
+    if (syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, pts, NULL, 0) < 0 && errno == ETIMEDOUT)
+        return ETIMEDOUT;
+    return 0;
+}
+
+void futex_wake(volatile int *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * reimpl/futex.h
+ *
+ * Futex-style wait/wake on a 32-bit word, the only kernel primitive the
+ * bionic mutex, condvar and semaphore emulation needs. On the Vita it is
+ * a hashed table of LwMutex/LwCond pairs; elsewhere it is the Linux futex
+ * syscall, so the algorithms built on top can be tested on a PC.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_FUTEX_H
+#define SOLOADER_FUTEX_H
+
+#include <stdint.h>
+
+#define FUTEX_WAIT_FOREVER UINT64_MAX
+
+/*
+ * Sleeps while *addr == expected, for at most `timeout_us`. May wake up
+ * spuriously. Returns 0 when woken (or if *addr != expected to begin with),
+ * or ETIMEDOUT.
+ */
+int futex_wait(volatile int *addr, int expected, uint64_t timeout_us);
+
+/* Wakes up to `count` threads sleeping on `addr`. */
+void futex_wake(volatile int *addr, int count);
+
+/*
+ * A small nonzero id of the calling thread, for mutex owner fields. Ids are
+ * handed out in order and only repeat after 65535 threads.
+ */
+uint16_t futex_thread_id(void);
+
+#endif // SOLOADER_FUTEX_H
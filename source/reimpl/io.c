@@ -13,6 +13,7 @@
 
 #include "reimpl/io.h"
 
+#include <errno.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/unistd.h>
@@ -22,28 +23,139 @@
 
 #ifdef USE_SCELIBC_IO
 #include <libc_bridge/libc_bridge.h>
+#include <fios/fios.h>
 #endif
 
+#include "reimpl/path_cache.h"
+#include "utils/iotrace.h"
+#include "utils/lazy_init.h"
 #include "utils/logger.h"
 #include "utils/utils.h"
 
 // Includes the following inline utilities:
 // int oflags_newlib_to_oflags_musl(int flags);
-// dirent64_bionic * dirent_newlib_to_dirent_bionic(struct dirent* dirent_newlib);
 // void stat_newlib_to_stat_bionic(struct stat * src, stat64_bionic * dst);
 #include "_struct_converters.c"
 
+#if defined(USE_SCELIBC_IO) && defined(FIOS_CACHE_MODEL)
+#define CACHE_MODEL
+#endif
+
+// Open files are only tracked when something needs their reads: without
+// either, fread() is a plain bridge call.
+#if defined(CACHE_MODEL) || defined(IO_TRACE)
+#define TRACK_FILES
+#endif
+
+#ifdef TRACK_FILES
+// Files whose reads are fed to the FIOS cache model (see
+// fios_cache_account()) and/or the I/O trace, with the path they were
+// opened with.
+#define TRACKED_FILES_MAX 64
+
+typedef struct tracked_file {
+    FILE *f;
+    char *path;
+    uint32_t trace_id;
+} tracked_file;
+
+static tracked_file tracked_files[TRACKED_FILES_MAX];
+static lazy_lwmutex tracked_files_lock = LAZY_LWMUTEX_INITIALIZER("tracked_files_lock");
+
+static void tracked_file_add(FILE *f, const char *path, uint32_t trace_id) {
+#ifndef IO_TRACE
+    if (!fios_cache_covers(path))
+        return;
+#endif
+    if (!f)
+        return;
+
+    lazy_lwmutex_lock(&tracked_files_lock);
+    for (int i = 0; i < TRACKED_FILES_MAX; i++) {
+        if (!tracked_files[i].f) {
+            tracked_files[i].f = f;
+            tracked_files[i].path = strdup(path);
+            tracked_files[i].trace_id = trace_id;
+            break;
+        }
+    }
+    lazy_lwmutex_unlock(&tracked_files_lock);
+}
+
+// Returns the trace id of `f`, or 0.
+static uint32_t tracked_file_remove(FILE *f) {
+    uint32_t trace_id = 0;
+    lazy_lwmutex_lock(&tracked_files_lock);
+    for (int i = 0; i < TRACKED_FILES_MAX; i++) {
+        if (tracked_files[i].f == f) {
+            trace_id = tracked_files[i].trace_id;
+            free(tracked_files[i].path);
+            tracked_files[i].f = NULL;
+            tracked_files[i].path = NULL;
+            break;
+        }
+    }
+    lazy_lwmutex_unlock(&tracked_files_lock);
+    return trace_id;
+}
+
+static long file_tell(FILE *f) {
+    #ifdef USE_SCELIBC_IO
+        return sceLibcBridge_ftell(f);
+    #else
+        return ftell(f);
+    #endif
+}
+
+// Returns the entry of `f`, or NULL if it isn't tracked. Only valid until
+// `f` is closed.
+static const tracked_file *tracked_file_find(FILE *f) {
+    const tracked_file *found = NULL;
+    lazy_lwmutex_lock(&tracked_files_lock);
+    for (int i = 0; i < TRACKED_FILES_MAX; i++) {
+        if (tracked_files[i].f == f) {
+            found = &tracked_files[i];
+            break;
+        }
+    }
+    lazy_lwmutex_unlock(&tracked_files_lock);
+    return found;
+}
+#endif
+
+static bool fmode_writes(const char *mode) {
+    return strpbrk(mode, "wa+") != NULL;
+}
+
+static bool oflags_write(int flags) {
+    return (flags & (O_WRONLY | O_RDWR | O_CREAT | O_TRUNC | O_APPEND)) != 0;
+}
+
 FILE *fopen_soloader(char *fname, char *mode) {
-    if (strcmp(fname, "/proc/cpuinfo") == 0) {
-        return fopen_soloader("app0:/cpuinfo", mode);
-    } else if (strcmp(fname, "/proc/meminfo") == 0) {
-        return fopen_soloader("app0:/meminfo", mode);
+    const char *path = path_cache_resolve(fname);
+    bool writes = fmode_writes(mode);
+
+    if (!writes && path_cache_known_missing(fname)) {
+        errno = ENOENT;
+        logv_debug("[io] fopen(%s, %s): known missing", fname, mode);
+        return NULL;
     }
 
+    uint64_t start = iotrace_now();
+
     #ifdef USE_SCELIBC_IO
-        FILE* ret = sceLibcBridge_fopen(fname, mode);
+        FILE* ret = sceLibcBridge_fopen(path, mode);
     #else
-        FILE* ret = fopen(fname, mode);
+        FILE* ret = fopen(path, mode);
+    #endif
+
+    if (ret && writes)
+        path_cache_write_open(ret, false, fname);
+
+    #ifdef TRACK_FILES
+        uint32_t trace_id = iotrace_path_id(fname);
+        iotrace_record(IOTRACE_OP_OPEN, trace_id, 0, ret != NULL, start);
+        tracked_file_add(ret, fname, trace_id);
     #endif
 
     logv_debug("[io] fopen(%s, %s): 0x%x", fname, mode, ret);
@@ -51,15 +163,61 @@ FILE *fopen_soloader(char *fname, char *mode) {
     return ret;
 }
 
+FILE *freopen_soloader(char *fname, char *mode, FILE *f) {
+    bool writes = fmode_writes(mode);
+
+    // `f` is closed whatever happens next. Without a new path it stays on the
+    // same file, and so keeps its place among the write handles.
+    #ifdef TRACK_FILES
+        uint32_t old_trace_id = tracked_file_remove(f);
+        iotrace_record(IOTRACE_OP_CLOSE, old_trace_id, 0, 0, iotrace_now());
+    #endif
+    if (fname)
+        path_cache_write_close(f, false);
+
+    const char *path = fname ? path_cache_resolve(fname) : NULL;
+    uint64_t start = iotrace_now();
+
+    #ifdef USE_SCELIBC_IO
+        FILE* ret = sceLibcBridge_freopen(path, mode, f);
+    #else
+        FILE* ret = freopen(path, mode, f);
+    #endif
+
+    if (fname && ret && writes)
+        path_cache_write_open(ret, false, fname);
+    else if (!fname && !ret)
+        path_cache_write_close(f, false);
+
+    #ifdef TRACK_FILES
+        if (fname) {
+            uint32_t trace_id = iotrace_path_id(fname);
+            iotrace_record(IOTRACE_OP_OPEN, trace_id, 0, ret != NULL, start);
+            tracked_file_add(ret, fname, trace_id);
+        }
+    #endif
+
+    logv_debug("[io] freopen(%s, %s, 0x%x): 0x%x", fname ? fname : "NULL", mode, f, ret);
+
+    return ret;
+}
+
 int open_soloader(char *_fname, int flags) {
-    if (strcmp(_fname, "/proc/cpuinfo") == 0) {
-        return open_soloader("app0:/cpuinfo", flags);
-    } else if (strcmp(_fname, "/proc/meminfo") == 0) {
-        return open_soloader("app0:/meminfo", flags);
+    const char *path = path_cache_resolve(_fname);
+    flags = oflags_newlib_to_oflags_musl(flags);
+    bool writes = oflags_write(flags);
+
+    if (!writes && path_cache_known_missing(_fname)) {
+        errno = ENOENT;
+        logv_debug("[io] open(%s, %x): known missing", _fname, flags);
+        return -1;
     }
 
-    flags = oflags_newlib_to_oflags_musl(flags);
-    int ret = open(_fname, flags);
+    uint64_t start = iotrace_now();
+    int ret = open(path, flags);
+    if (ret >= 0 && writes)
+        path_cache_write_open((const void *) (intptr_t) ret, true, _fname);
+    iotrace_record(IOTRACE_OP_OPEN, iotrace_path_id(_fname), 0, ret >= 0, start);
     logv_debug("[io] open(%s, %x): %i", _fname, flags, ret);
     return ret;
 }
@@ -75,68 +233,174 @@ int fstat_soloader(int fd, void *statbuf) {
 }
 
 int stat_soloader(char *_pathname, stat64_bionic *statbuf) {
-    struct stat st;
-    int res = stat(_pathname, &st);
-
-    if (res == 0)
-        stat_newlib_to_stat_bionic(&st, statbuf);
-
+    int res = path_cache_stat(_pathname, statbuf);
     logv_debug("[io] stat(%s): %i", _pathname, res);
     return res;
 }
 
 int fclose_soloader(FILE * f) {
+    #ifdef TRACK_FILES
+        uint32_t trace_id = tracked_file_remove(f);
+        iotrace_record(IOTRACE_OP_CLOSE, trace_id, 0, 0, iotrace_now());
+    #endif
+
     #ifdef USE_SCELIBC_IO
         int ret = sceLibcBridge_fclose(f);
     #else
         int ret = fclose(f);
     #endif
 
+    path_cache_write_close(f, false);
+
     logv_debug("[io] fclose(0x%x): %i", f, ret);
     return ret;
 }
 
+size_t fread_soloader(void *ptr, size_t size, size_t nmemb, FILE *f) {
+    #ifdef TRACK_FILES
+        const tracked_file *tracked = tracked_file_find(f);
+        uint64_t start = iotrace_now();
+        long offset = tracked ? file_tell(f) : 0;
+    #endif
+
+    #ifdef USE_SCELIBC_IO
+        size_t ret = sceLibcBridge_fread(ptr, size, nmemb, f);
+    #else
+        size_t ret = fread(ptr, size, nmemb, f);
+    #endif
+
+    #ifdef TRACK_FILES
+        if (tracked && offset >= 0) {
+        #ifdef CACHE_MODEL
+            if (ret > 0)
+                fios_cache_account(tracked->path, (uint64_t) offset, ret * size);
+        #endif
+            iotrace_record(IOTRACE_OP_READ, tracked->trace_id, (uint64_t) offset, ret * size, start);
+        }
+    #endif
+
+    return ret;
+}
+
+int fseek_soloader(FILE *f, long offset, int whence) {
+    #ifdef IO_TRACE
+        uint64_t start = iotrace_now();
+    #endif
+
+    #ifdef USE_SCELIBC_IO
+        int ret = sceLibcBridge_fseek(f, offset, whence);
+    #else
+        int ret = fseek(f, offset, whence);
+    #endif
+
+    #ifdef IO_TRACE
+        const tracked_file *tracked = tracked_file_find(f);
+        if (tracked && ret == 0)
+            iotrace_record(IOTRACE_OP_SEEK, tracked->trace_id, (uint64_t) file_tell(f), 0, start);
+    #endif
+
+    return ret;
+}
+
 int close_soloader(int fd) {
     int ret = close(fd);
+    path_cache_write_close((const void *) (intptr_t) fd, true);
     logv_debug("[io] close(fd#%i): %i", fd, ret);
     return ret;
 }
 
-DIR* opendir_soloader(char* _pathname) {
-    DIR* ret = opendir(_pathname);
-    logv_debug("[io] opendir(\"%s\"): 0x%x", _pathname, ret);
+int access_soloader(char *_pathname, int mode) {
+    int ret;
+    if ((mode & (W_OK | X_OK)) == 0) {
+        // Existence / readability checks: answered by the stat cache
+        stat64_bionic st;
+        ret = path_cache_stat(_pathname, &st);
+    } else {
+        ret = access(path_cache_resolve(_pathname), mode);
+    }
+    logv_debug("[io] access(%s, %i): %i", _pathname, mode, ret);
     return ret;
 }
 
-struct dirent * readdir_soloader(DIR * dir) {
-    struct dirent* ret = readdir(dir);
-    log_debug("[io] readdir()");
+int mkdir_soloader(char *_pathname, mode_t mode) {
+    int ret = mkdir(_pathname, mode);
+    path_cache_invalidate(_pathname);
+    logv_debug("[io] mkdir(%s): %i", _pathname, ret);
     return ret;
 }
 
-int readdir_r_soloader(DIR *dirp, dirent64_bionic *entry, dirent64_bionic **result) {
-    struct dirent dirent_tmp;
-    struct dirent* pdirent_tmp;
+int rmdir_soloader(char *_pathname) {
+    int ret = rmdir(_pathname);
+    path_cache_invalidate_tree(_pathname);
+    logv_debug("[io] rmdir(%s): %i", _pathname, ret);
+    return ret;
+}
 
-    int ret = readdir_r(dirp, &dirent_tmp, &pdirent_tmp);
+int unlink_soloader(char *_pathname) {
+    int ret = unlink(_pathname);
+    path_cache_invalidate(_pathname);
+    logv_debug("[io] unlink(%s): %i", _pathname, ret);
+    return ret;
+}
 
-    if (ret == 0) {
-        dirent64_bionic* entry_tmp = dirent_newlib_to_dirent_bionic(&dirent_tmp);
-        memcpy(entry, entry_tmp, sizeof(dirent64_bionic));
-        *result = (pdirent_tmp != NULL) ? entry : NULL;
-        free(entry_tmp);
-    }
+int remove_soloader(char *_pathname) {
+    int ret = remove(_pathname);
+    path_cache_invalidate_tree(_pathname);
+    logv_debug("[io] remove(%s): %i", _pathname, ret);
+    return ret;
+}
 
-    log_debug("[io] readdir_r()");
+int rename_soloader(char *_old, char *_new) {
+    int ret = rename(_old, _new);
+    path_cache_invalidate_tree(_old);
+    path_cache_invalidate_tree(_new);
+    logv_debug("[io] rename(%s, %s): %i", _old, _new, ret);
     return ret;
 }
 
-int closedir_soloader(DIR* dir) {
-    int ret = closedir(dir);
-    logv_debug("[io] closedir(0x%x): %i", dir, ret);
+int truncate_soloader(char *_pathname, off_t length) {
+    int ret = truncate(_pathname, length);
+    path_cache_invalidate(_pathname);
+    logv_debug("[io] truncate(%s): %i", _pathname, ret);
     return ret;
 }
 
+path_cache_dir* opendir_soloader(char* _pathname) {
+    path_cache_dir* ret = path_cache_opendir(_pathname);
+    logv_debug("[io] opendir(\"%s\"): 0x%x", _pathname, ret);
+    return ret;
+}
+
+dirent64_bionic * readdir_soloader(path_cache_dir * dir) {
+    const dirent64_bionic* next = path_cache_readdir(dir);
+    log_debug("[io] readdir()");
+    if (!next)
+        return NULL;
+
+    dir->entry = *next;
+    return &dir->entry;
+}
+
+int readdir_r_soloader(path_cache_dir *dirp, dirent64_bionic *entry, dirent64_bionic **result) {
+    const dirent64_bionic* next = path_cache_readdir(dirp);
+
+    if (next) {
+        *entry = *next;
+        *result = entry;
+    } else {
+        *result = NULL;
+    }
+
+    log_debug("[io] readdir_r()");
+    return 0;
+}
+
+int closedir_soloader(path_cache_dir* dir) {
+    path_cache_closedir(dir);
+    logv_debug("[io] closedir(0x%x)", dir);
+    return 0;
+}
+
 int fcntl_soloader(int fd, int cmd, ...) {
     logv_debug("[io] fcntl(fd#%i, cmd#%i)", fd, cmd);
     return 0;
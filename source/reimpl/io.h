@@ -65,20 +65,34 @@ typedef struct __attribute__((__packed__)) dirent64_bionic {
     char d_name[256]; // 256 bytes // offset 0x13
 } dirent64_bionic;
 
+typedef struct path_cache_dir path_cache_dir;
+
 int open_soloader(char *fname, int flags);
 FILE *fopen_soloader(char *fname, char *mode);
-DIR* opendir_soloader(char* name);
+FILE *freopen_soloader(char *fname, char *mode, FILE *f);
+path_cache_dir* opendir_soloader(char* name);
 
 int stat_soloader(char *pathname, stat64_bionic *statbuf);
 int fstat_soloader(int fd, void *statbuf);
 
-struct dirent * readdir_soloader(DIR * dir);
-int readdir_r_soloader(DIR *dirp, dirent64_bionic *entry, dirent64_bionic **result);
+dirent64_bionic * readdir_soloader(path_cache_dir * dir);
+int readdir_r_soloader(path_cache_dir *dirp, dirent64_bionic *entry, dirent64_bionic **result);
+
+size_t fread_soloader(void *ptr, size_t size, size_t nmemb, FILE *f);
+int fseek_soloader(FILE *f, long offset, int whence);
 
 int close_soloader(int fd);
 int fclose_soloader(FILE* f);
-int closedir_soloader(DIR* dir);
+int closedir_soloader(path_cache_dir* dir);
 
 int fcntl_soloader(int fd, int cmd, ...);
 
+int access_soloader(char *pathname, int mode);
+int mkdir_soloader(char *pathname, mode_t mode);
+int rmdir_soloader(char *pathname);
+int unlink_soloader(char *pathname);
+int remove_soloader(char *pathname);
+int rename_soloader(char *oldpath, char *newpath);
+int truncate_soloader(char *pathname, off_t length);
+
 #endif // SOLOADER_IO_H
\ No newline at end of file
@@ -13,23 +13,235 @@
 
 #include "reimpl/mem.h"
 
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <psp2/kernel/sysmem.h>
+
+#include "utils/lazy_init.h"
+#include "utils/logger.h"
+
+typedef struct mapping {
+    uint8_t *base;
+    size_t length;       // page-aligned
+    SceUID block;        // memory block backing the mapping, or -1: heap
+    size_t live_pages;
+    uint32_t *unmapped;  // bitmap of unmapped pages
+} mapping;
+
+static mapping *mappings = NULL;
+static int mapping_count = 0;
+static int mapping_capacity = 0;
+
+static lazy_lwmutex mappings_lock = LAZY_LWMUTEX_INITIALIZER("mappings_lock");
+
+static void lock() {
+    lazy_lwmutex_lock(&mappings_lock);
+}
+
+static void unlock() {
+    lazy_lwmutex_unlock(&mappings_lock);
+}
 
 void *sceClibMemclr(void *dst, SceSize len) {
     return sceClibMemset(dst, 0, len);
 }
 
+static size_t page_align(size_t length) {
+    return (length + MMAP_PAGE_SIZE - 1) & ~(size_t) (MMAP_PAGE_SIZE - 1);
+}
+
+// Returns page-aligned memory, and whether it is known to be zeroed.
+static void *region_alloc(size_t size, SceUID *block, bool *zeroed) {
+    *block = -1;
+    *zeroed = false;
+
+    if (size >= MMAP_BLOCK_THRESHOLD) {
+        SceUID uid = sceKernelAllocMemBlock("mmap", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, size, NULL);
+        void *base;
+        if (uid >= 0 && sceKernelGetMemBlockBase(uid, &base) >= 0) {
+            *block = uid;
+            *zeroed = true;
+            return base;
+        }
+        if (uid >= 0)
+            sceKernelFreeMemBlock(uid);
+        logv_debug("[mem] no memory block for %u bytes, using the heap", size);
+    }
+
+    return memalign(MMAP_PAGE_SIZE, size);
+}
+
+static void region_free(void *base, SceUID block) {
+    if (block >= 0)
+        sceKernelFreeMemBlock(block);
+    else
+        free(base);
+}
+
+// Reads `length` bytes of `fd` at `offs` into `dst` without moving the file
+// position, and zeroes the rest up to `size`. Returns -1 with errno set.
+static int map_file(uint8_t *dst, size_t length, size_t size, bool zeroed, int fd, off_t offs) {
+    size_t got = 0;
+    while (got < length) {
+        ssize_t n = pread(fd, dst + got, length - got, offs + (off_t) got);
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        got += n;
+    }
+
+    if (!zeroed)
+        sceClibMemset(dst + got, 0, size - got);
+    return 0;
+}
+
+// Called with the lock held.
+static mapping *mapping_find(const void *addr) {
+    for (int i = 0; i < mapping_count; i++) {
+        mapping *m = &mappings[i];
+        if ((const uint8_t *) addr >= m->base && (const uint8_t *) addr < m->base + m->length)
+            return m;
+    }
+    return NULL;
+}
+
+static bool mapping_add(uint8_t *base, size_t size, SceUID block) {
+    size_t pages = size / MMAP_PAGE_SIZE;
+    uint32_t *unmapped = calloc((pages + 31) / 32, sizeof(uint32_t));
+    if (!unmapped)
+        return false;
+
+    lock();
+    if (mapping_count == mapping_capacity) {
+        int capacity = mapping_capacity ? mapping_capacity * 2 : 32;
+        mapping *grown = realloc(mappings, capacity * sizeof(mapping));
+        if (!grown) {
+            unlock();
+            free(unmapped);
+            return false;
+        }
+        mappings = grown;
+        mapping_capacity = capacity;
+    }
+    mapping *m = &mappings[mapping_count++];
+    m->base = base;
+    m->length = size;
+    m->block = block;
+    m->live_pages = pages;
+    m->unmapped = unmapped;
+    unlock();
+    return true;
+}
+
+static void *mmap_fixed(uint8_t *addr, size_t length, size_t size, int flags, int fd, off_t offs) {
+    if (((uintptr_t) addr & (MMAP_PAGE_SIZE - 1)) != 0) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    lock();
+    mapping *m = mapping_find(addr);
+    if (!m || addr + size > m->base + m->length) {
+        unlock();
+        logv_error("[mem] mmap(0x%x, %u): MAP_FIXED outside of a mapping", addr, length);
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    size_t first = (addr - m->base) / MMAP_PAGE_SIZE;
+    for (size_t p = first; p < first + size / MMAP_PAGE_SIZE; p++) {
+        if (m->unmapped[p / 32] & (1u << (p % 32))) {
+            m->unmapped[p / 32] &= ~(1u << (p % 32));
+            m->live_pages++;
+        }
+    }
+    unlock();
+
+    if (flags & MAP_ANONYMOUS) {
+        sceClibMemset(addr, 0, size);
+    } else if (map_file(addr, length, size, false, fd, offs) < 0) {
+        return MAP_FAILED;
+    }
+    return addr;
+}
+
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offs) {
-    if (length <= 0) {
+    if (length == 0 || (offs & (MMAP_PAGE_SIZE - 1)) != 0) {
+        errno = EINVAL;
         return MAP_FAILED;
     }
-    void* ret= malloc(length);
-    memset(ret, 0, length);
-    return ret;
+
+    size_t size = page_align(length);
+
+    if (flags & MAP_FIXED)
+        return mmap_fixed(addr, length, size, flags, fd, offs);
+
+    if (!(flags & MAP_ANONYMOUS) && (flags & MAP_SHARED) && (prot & PROT_WRITE))
+        logv_warn("[mem] mmap(fd#%i): shared writable mapping, writes won't reach the file", fd);
+
+    SceUID block;
+    bool zeroed;
+    uint8_t *base = region_alloc(size, &block, &zeroed);
+    if (!base) {
+        errno = ENOMEM;
+        return MAP_FAILED;
+    }
+
+    if (flags & MAP_ANONYMOUS) {
+        if (!zeroed)
+            sceClibMemset(base, 0, size);
+    } else if (map_file(base, length, size, zeroed, fd, offs) < 0) {
+        int err = errno;
+        region_free(base, block);
+        errno = err;
+        return MAP_FAILED;
+    }
+
+    if (!mapping_add(base, size, block)) {
+        region_free(base, block);
+        errno = ENOMEM;
+        return MAP_FAILED;
+    }
+
+    logv_debug("[mem] mmap(%u, prot %x, flags %x, fd#%i, %u): 0x%x", length, prot, flags, fd, (uint32_t) offs, base);
+    return base;
 }
 
 int munmap(void *addr, size_t length) {
-    if (addr) free(addr);
+    uint8_t *start = addr;
+    if (((uintptr_t) start & (MMAP_PAGE_SIZE - 1)) != 0 || length == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint8_t *end = start + page_align(length);
+
+    lock();
+    for (int i = mapping_count - 1; i >= 0; i--) {
+        mapping *m = &mappings[i];
+        uint8_t *from = start > m->base ? start : m->base;
+        uint8_t *to = end < m->base + m->length ? end : m->base + m->length;
+        if (from >= to)
+            continue;
+
+        for (size_t p = (from - m->base) / MMAP_PAGE_SIZE; p < (size_t) (to - m->base) / MMAP_PAGE_SIZE; p++) {
+            if (!(m->unmapped[p / 32] & (1u << (p % 32)))) {
+                m->unmapped[p / 32] |= 1u << (p % 32);
+                m->live_pages--;
+            }
+        }
+
+        if (m->live_pages == 0) {
+            region_free(m->base, m->block);
+            free(m->unmapped);
+            *m = mappings[--mapping_count];
+        }
+    }
+    unlock();
+
     return 0;
 }
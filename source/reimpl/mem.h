@@ -20,10 +20,33 @@
 
 #define MAP_FAILED (void*)-1
 
+// Linux ABI values, as passed by the game
+#define PROT_READ     0x1
+#define PROT_WRITE    0x2
+#define MAP_SHARED    0x01
+#define MAP_PRIVATE   0x02
+#define MAP_FIXED     0x10
+#define MAP_ANONYMOUS 0x20
+
+#define MMAP_PAGE_SIZE 4096
+
+// Anonymous mappings this big come from their own memory block, which the
+// kernel hands out zeroed, instead of the heap
+#define MMAP_BLOCK_THRESHOLD (1 * 1024 * 1024)
+
 void *sceClibMemclr(void *dst, SceSize len);
 
+/*
+ * mmap() emulation. Mappings are page-aligned; anonymous ones are zeroed,
+ * file-backed ones are filled with a single read of the file, and never
+ * written back. MAP_FIXED only works inside an existing mapping.
+ */
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offs);
 
+/*
+ * Unmaps whole pages. The memory of a mapping is released once all of its
+ * pages are unmapped.
+ */
 int munmap(void *addr, size_t length);
 
 #endif // SOLOADER_MEMORY_H
@@ -0,0 +1,346 @@
+/*
+ * reimpl/path_cache.c
+ *
+ * Path rewrites and a cache of stat() results for the IO wrappers.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/path_cache.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Includes the following inline utilities:
+// void dirent_newlib_to_dirent_bionic(struct dirent* src, dirent64_bionic* dst);
+// void stat_newlib_to_stat_bionic(struct stat * src, stat64_bionic * dst);
+#include "_struct_converters.c"
+
+#include "utils/lazy_init.h"
+
+#define PATH_CACHE_MAX 1024
+#define PATH_CACHE_BUCKETS 2048 // power of two
+#define WRITE_HANDLES_MAX 32
+
+static const struct {
+    const char *from;
+    const char *to;
+} path_rewrites[] = {
+    { "/proc/cpuinfo", "app0:/cpuinfo" },
+    { "/proc/meminfo", "app0:/meminfo" },
+};
+
+enum {
+    PATH_UNKNOWN,
+    PATH_EXISTS,
+    PATH_MISSING,
+};
+
+typedef struct dir_listing {
+    int refs;            // the cache's own reference plus open handles
+    uint32_t generation; // dir_generation when it was read
+    int count;
+    dirent64_bionic *entries;
+} dir_listing;
+
+typedef struct path_entry {
+    uint32_t hash;
+    char *path;
+    const char *rewrite; // or NULL
+    int state;
+    int writers;         // open write handles; nothing is cached meanwhile
+    stat64_bionic st;    // if PATH_EXISTS
+    dir_listing *listing; // or NULL
+} path_entry;
+
+typedef struct write_handle {
+    const void *handle;
+    bool is_fd;
+    path_entry *entry;
+} write_handle;
+
+// Entries are never removed, so pointers to them stay valid.
+static path_entry path_entries[PATH_CACHE_MAX];
+static uint16_t path_buckets[PATH_CACHE_BUCKETS]; // index + 1, 0: empty
+static int path_count = 0;
+static write_handle write_handles[WRITE_HANDLES_MAX];
+
+// Bumped whenever a file may have been created, removed or renamed, which
+// makes every cached listing stale.
+static uint32_t dir_generation = 0;
+
+static lazy_lwmutex path_cache_lock = LAZY_LWMUTEX_INITIALIZER("path_cache_lock");
+
+static void lock() {
+    lazy_lwmutex_lock(&path_cache_lock);
+}
+
+static void unlock() {
+    lazy_lwmutex_unlock(&path_cache_lock);
+}
+
+static uint32_t path_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static const char *find_rewrite(const char *path) {
+    for (size_t i = 0; i < sizeof(path_rewrites) / sizeof(path_rewrites[0]); i++) {
+        if (strcmp(path, path_rewrites[i].from) == 0)
+            return path_rewrites[i].to;
+    }
+    return NULL;
+}
+
+// Returns the entry of `path`, interning it if `create` is set and there is
+// room left. Called with the lock held.
+static path_entry *lookup(const char *path, bool create) {
+    uint32_t hash = path_hash(path);
+
+    for (uint32_t b = hash;; b++) {
+        uint16_t slot = path_buckets[b & (PATH_CACHE_BUCKETS - 1)];
+        if (slot == 0) {
+            if (!create || path_count == PATH_CACHE_MAX)
+                return NULL;
+
+            char *copy = strdup(path);
+            if (!copy)
+                return NULL;
+
+            path_entry *e = &path_entries[path_count++];
+            e->hash = hash;
+            e->path = copy;
+            e->rewrite = find_rewrite(path);
+            e->state = PATH_UNKNOWN;
+            e->writers = 0;
+            e->listing = NULL;
+            path_buckets[b & (PATH_CACHE_BUCKETS - 1)] = path_count;
+            return e;
+        }
+
+        path_entry *e = &path_entries[slot - 1];
+        if (e->hash == hash && strcmp(e->path, path) == 0)
+            return e;
+    }
+}
+
+const char *path_cache_resolve(const char *path) {
+    lock();
+    path_entry *e = lookup(path, true);
+    const char *rewrite = e ? e->rewrite : find_rewrite(path);
+    unlock();
+
+    return rewrite ? rewrite : path;
+}
+
+int path_cache_stat(const char *path, stat64_bionic *statbuf) {
+    lock();
+    path_entry *e = lookup(path, true);
+    int state = (e && e->writers == 0) ? e->state : PATH_UNKNOWN;
+    if (state == PATH_EXISTS)
+        *statbuf = e->st;
+    unlock();
+
+    if (state == PATH_EXISTS)
+        return 0;
+    if (state == PATH_MISSING) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    const char *real = (e && e->rewrite) ? e->rewrite : path;
+    struct stat st;
+    int res = stat(real, &st);
+    int err = errno;
+
+    if (res == 0)
+        stat_newlib_to_stat_bionic(&st, statbuf);
+
+    if (e && (res == 0 || err == ENOENT)) {
+        lock();
+        if (e->writers == 0) {
+            e->state = (res == 0) ? PATH_EXISTS : PATH_MISSING;
+            if (res == 0)
+                e->st = *statbuf;
+        }
+        unlock();
+    }
+
+    errno = err;
+    return res;
+}
+
+bool path_cache_known_missing(const char *path) {
+    lock();
+    path_entry *e = lookup(path, false);
+    bool missing = e && e->writers == 0 && e->state == PATH_MISSING;
+    unlock();
+    return missing;
+}
+
+void path_cache_invalidate(const char *path) {
+    lock();
+    path_entry *e = lookup(path, false);
+    if (e)
+        e->state = PATH_UNKNOWN;
+    dir_generation++;
+    unlock();
+}
+
+void path_cache_invalidate_tree(const char *path) {
+    size_t len = strlen(path);
+    while (len > 1 && path[len - 1] == '/')
+        len--;
+
+    lock();
+    for (int i = 0; i < path_count; i++) {
+        path_entry *e = &path_entries[i];
+        if (strncmp(e->path, path, len) == 0 && (e->path[len] == '\0' || e->path[len] == '/'))
+            e->state = PATH_UNKNOWN;
+    }
+    dir_generation++;
+    unlock();
+}
+
+void path_cache_write_open(const void *handle, bool is_fd, const char *path) {
+    lock();
+    path_entry *e = lookup(path, true);
+    if (e) {
+        bool added = false;
+        e->state = PATH_UNKNOWN;
+        dir_generation++;
+        for (int i = 0; i < WRITE_HANDLES_MAX && e->writers >= 0; i++) {
+            if (!write_handles[i].entry) {
+                write_handles[i].handle = handle;
+                write_handles[i].is_fd = is_fd;
+                write_handles[i].entry = e;
+                e->writers++;
+                added = true;
+                break;
+            }
+        }
+        // Out of slots: we won't see this writer close, so never cache this
+        // path again.
+        if (!added)
+            e->writers = -1;
+    }
+    unlock();
+}
+
+void path_cache_write_close(const void *handle, bool is_fd) {
+    lock();
+    for (int i = 0; i < WRITE_HANDLES_MAX; i++) {
+        write_handle *w = &write_handles[i];
+        if (w->entry && w->handle == handle && w->is_fd == is_fd) {
+            w->entry->state = PATH_UNKNOWN;
+            if (w->entry->writers > 0)
+                w->entry->writers--;
+            w->entry = NULL;
+            break;
+        }
+    }
+    unlock();
+}
+
+// Called with the lock held.
+static void listing_release(dir_listing *l) {
+    if (--l->refs == 0) {
+        free(l->entries);
+        free(l);
+    }
+}
+
+static dir_listing *listing_read(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir)
+        return NULL;
+
+    dir_listing *l = calloc(1, sizeof(dir_listing));
+    int capacity = 0;
+    struct dirent *d;
+
+    while (l && (d = readdir(dir)) != NULL) {
+        if (l->count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            dirent64_bionic *entries = realloc(l->entries, capacity * sizeof(dirent64_bionic));
+            if (!entries) {
+                free(l->entries);
+                free(l);
+                l = NULL;
+                break;
+            }
+            l->entries = entries;
+        }
+        dirent_newlib_to_dirent_bionic(d, &l->entries[l->count++]);
+    }
+
+    closedir(dir);
+    if (!l)
+        errno = ENOMEM;
+    return l;
+}
+
+path_cache_dir *path_cache_opendir(const char *path) {
+    path_cache_dir *dir = calloc(1, sizeof(path_cache_dir));
+    if (!dir) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    lock();
+    path_entry *e = lookup(path, true);
+    uint32_t generation = dir_generation;
+    dir_listing *l = NULL;
+    if (e && e->listing && e->listing->generation == generation) {
+        l = e->listing;
+        l->refs++;
+    }
+    unlock();
+
+    if (!l) {
+        l = listing_read((e && e->rewrite) ? e->rewrite : path);
+        if (!l) {
+            free(dir);
+            return NULL;
+        }
+        l->refs = 1;
+        l->generation = generation;
+
+        lock();
+        if (e && generation == dir_generation) {
+            if (e->listing)
+                listing_release(e->listing);
+            e->listing = l;
+            l->refs++;
+        }
+        unlock();
+    }
+
+    dir->listing = l;
+    return dir;
+}
+
+const dirent64_bionic *path_cache_readdir(path_cache_dir *dir) {
+    if (dir->pos >= dir->listing->count)
+        return NULL;
+    return &dir->listing->entries[dir->pos++];
+}
+
+void path_cache_closedir(path_cache_dir *dir) {
+    if (!dir)
+        return;
+
+    lock();
+    listing_release(dir->listing);
+    unlock();
+    free(dir);
+}
@@ -0,0 +1,68 @@
+/*
+ * reimpl/path_cache.h
+ *
+ * Path rewrites and a cache of stat() results and directory listings for the
+ * IO wrappers, keyed by interned path. Entries are invalidated by the
+ * wrappers that modify the filesystem; paths with files open for writing are
+ * never cached.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_PATH_CACHE_H
+#define SOLOADER_PATH_CACHE_H
+
+#include <stdbool.h>
+
+#include "reimpl/io.h"
+
+/*
+ * Returns the path to use for `path`: the rewrite target of Linux-only
+ * paths like /proc/cpuinfo, or `path` itself.
+ */
+const char *path_cache_resolve(const char *path);
+
+/* stat() through the cache. Returns 0, or -1 with errno set. */
+int path_cache_stat(const char *path, stat64_bionic *statbuf);
+
+/* Whether `path` is known not to exist, without touching the filesystem. */
+bool path_cache_known_missing(const char *path);
+
+/* Forgets what is known about `path`. */
+void path_cache_invalidate(const char *path);
+
+/*
+ * Forgets what is known about `path` and everything below it, for renames
+ * and removals that may have taken a directory along.
+ */
+void path_cache_invalidate_tree(const char *path);
+
+/*
+ * A file handle (FILE* or fd) was opened for writing on `path`; stats of it
+ * bypass the cache until path_cache_write_close() is called for the handle.
+ */
+void path_cache_write_open(const void *handle, bool is_fd, const char *path);
+void path_cache_write_close(const void *handle, bool is_fd);
+
+struct dir_listing;
+
+/* A directory being enumerated; what opendir_soloader() hands out as DIR*. */
+struct path_cache_dir {
+    struct dir_listing *listing;
+    int pos;
+    dirent64_bionic entry; // readdir() result
+};
+
+/*
+ * Opens a snapshot of the entries of `path`, shared with other handles while
+ * nothing in the filesystem changes. Returns NULL with errno set on failure.
+ */
+path_cache_dir *path_cache_opendir(const char *path);
+
+/* The next entry of `dir`, or NULL at the end. */
+const dirent64_bionic *path_cache_readdir(path_cache_dir *dir);
+
+void path_cache_closedir(path_cache_dir *dir);
+
+#endif // SOLOADER_PATH_CACHE_H
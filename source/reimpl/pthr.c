@@ -15,12 +15,21 @@
 
 #include "reimpl/pthr.h"
 
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <psp2/kernel/clib.h>
 #include <psp2/kernel/threadmgr.h>
 #include <stdatomic.h>
 
+#include <so_util/so_util.h>
+
+#include "reimpl/errno.h"
+#include "reimpl/futex.h"
+#include "reimpl/pthr_sync.h"
+#include "reimpl/thread_policy.h"
 #include "utils/utils.h"
 #include "utils/logger.h"
 
@@ -42,281 +51,360 @@ enum {
 
 #define PTHR_INLINE static inline __attribute__((always_inline))
 
-void * initializedObjects[512] = {0};
-static SceKernelLwMutexWork pthr_mutex;
-static volatile short int pthr_mutex_inited = 0;
-
-#define PTHR_LOCK \
-    if (!pthr_mutex_inited) { \
-        int ret = sceKernelCreateLwMutex(&pthr_mutex, "log_lock", 0, 0, NULL); \
-        if (ret < 0) { \
-            sceClibPrintf("Error: failed to create pthr mutex: 0x%x\n", ret); \
-            return 0; \
-        } \
-        pthr_mutex_inited = 1; \
-    } \
-    sceKernelLockLwMutex(&pthr_mutex, 1, NULL);
-
-#define PTHR_UNLOCK \
-    if (pthr_mutex_inited) { \
-        sceKernelUnlockLwMutex(&pthr_mutex, 1); \
-    }
+#ifndef MAX_TASK_COMM_LEN
+#define MAX_TASK_COMM_LEN 16
+#endif
 
-int isObjectInitialized(const void * mut) {
-    PTHR_LOCK
-    for (int i = 0; i < 512; ++i) {
-        if (initializedObjects[i] == mut) {
-            PTHR_UNLOCK
-            return 1;
-        }
+#define PTHR_DEFAULT_STACK_SIZE (512 * 1024)
+#define PTHR_MAX_THREADS 64
+
+extern so_module so_mod;
+
+// Threads created by the game, for the placement policy and stats
+typedef struct {
+    int used;
+    unsigned serial;   // tells reuses of the slot apart
+    pthread_t thread;  // 0 until pthread_create() returns
+    SceUID uid;        // 0 until the thread runs
+    char name[MAX_TASK_COMM_LEN];
+    uintptr_t entry;
+    uintptr_t creator;
+    const thread_rule * rule;
+    int sched_policy;   // as the game set them, Linux values
+    int sched_priority;
+    int priority;       // the game's, as a Vita priority, or THREAD_PRIORITY_DEFAULT
+    void *(*start)(void *);
+    void * param;
+} pthr_thread;
+
+static pthr_thread pthr_threads[PTHR_MAX_THREADS];
+static SceKernelLwMutexWork pthr_threads_lock;
+static volatile int pthr_threads_ready = 0;
+static unsigned pthr_threads_serial = 0;
+
+// null check for `attr` must be performed before this
+PTHR_INLINE int _attr_t_static_init(pthread_attr_t_bionic * attr) {
+    if (attr->magic != 0x42424242) {
+        attr->magic = 0x42424242;
+        attr->real_ptr = malloc(sizeof(pthread_attr_t));
+        return pthread_attr_init(attr->real_ptr);
     }
-    PTHR_UNLOCK
     return 0;
 }
 
-int rememberObject(void * mut) {
-    PTHR_LOCK
-    for (int i = 0; i < 512; ++i) {
-        if (initializedObjects[i] == 0) {
-            initializedObjects[i] = mut;
-            PTHR_UNLOCK
+PTHR_INLINE int _mutex_kind(const pthread_mutexattr_t * attr) {
+    int kind = PTHREAD_MUTEX_NORMAL;
+    if (attr)
+        pthread_mutexattr_gettype((pthread_mutexattr_t *) attr, &kind);
+
+    if (kind == PTHREAD_MUTEX_RECURSIVE) return PTHR_MUTEX_RECURSIVE;
+    if (kind == PTHREAD_MUTEX_ERRORCHECK) return PTHR_MUTEX_ERRORCHECK;
+    return PTHR_MUTEX_NORMAL;
+}
+
+static int _lookup_symbol(const char * symbol, uintptr_t * addr, size_t * size) {
+    for (int i = 0; i < so_mod.num_dynsym; i++) {
+        const Elf32_Sym * sym = &so_mod.dynsym[i];
+        if (sym->st_value && strcmp(so_mod.dynstr + sym->st_name, symbol) == 0) {
+            *addr = so_mod.text_base + sym->st_value;
+            *size = sym->st_size;
             return 1;
         }
     }
-    PTHR_UNLOCK
     return 0;
 }
 
-int forgetObject(const void * mut) {
-    PTHR_LOCK
-    for (int i = 0; i < 512; ++i) {
-        if (initializedObjects[i] == mut) {
-            initializedObjects[i] = 0;
-            PTHR_UNLOCK
-            return 1;
+static void _threads_lock() {
+    if (!pthr_threads_ready) {
+        // The first thread is created from the main thread, before any
+        // other could race us here
+        sceKernelCreateLwMutex(&pthr_threads_lock, "pthr_threads_lock", 0, 0, NULL);
+        thread_policy_resolve(thread_policy_rules, thread_policy_rule_count, _lookup_symbol);
+        pthr_threads_ready = 1;
+    }
+    sceKernelLockLwMutex(&pthr_threads_lock, 1, NULL);
+}
+
+static void _threads_unlock() {
+    sceKernelUnlockLwMutex(&pthr_threads_lock, 1);
+}
+
+// Called with the lock held. Slots of threads that left through
+// pthread_exit() are reclaimed once the kernel no longer knows them.
+static pthr_thread * _thread_alloc() {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < PTHR_MAX_THREADS; i++) {
+            pthr_thread * t = &pthr_threads[i];
+            if (pass == 1 && t->used && t->uid) {
+                SceKernelThreadInfo info;
+                info.size = sizeof(info);
+                if (sceKernelGetThreadInfo(t->uid, &info) < 0)
+                    t->used = 0;
+            }
+            if (!t->used) {
+                memset(t, 0, sizeof(*t));
+                t->used = 1;
+                t->serial = ++pthr_threads_serial;
+                return t;
+            }
         }
     }
-    PTHR_UNLOCK
-    return 0;
+    return NULL;
 }
 
-// null check for `attr` must be performed before this
-PTHR_INLINE int _attr_t_static_init(pthread_attr_t_bionic * attr) {
-    if (attr->magic != 0x42424242) {
-        attr->magic = 0x42424242;
-        attr->real_ptr = malloc(sizeof(pthread_attr_t));
-        return pthread_attr_init(attr->real_ptr);
+// Called with the lock held
+static pthr_thread * _thread_find(pthread_t thread) {
+    SceUID self = thread == pthread_self() ? sceKernelGetThreadId() : 0;
+    for (int i = 0; i < PTHR_MAX_THREADS; i++) {
+        pthr_thread * t = &pthr_threads[i];
+        if (t->used && (t->thread == thread || (self && t->uid == self)))
+            return t;
     }
-    return 0;
+    return NULL;
 }
 
-// null check for `mutex` param must be performed before this, `attr` is fine as null
-PTHR_INLINE int _mutex_t_static_init(pthread_mutex_t_bionic * mutex, const pthread_mutexattr_t * attr) {
-    int ret = 0, kind = PTHREAD_MUTEX_NORMAL;
+// A rule's priority wins over the one the game asked for
+static void _thread_apply(SceUID uid, const thread_rule * rule, int priority) {
+    if (!uid) return;
 
-    if (isObjectInitialized(mutex)) {
-        //logv_debug("mutex already initialized: %p", mutex);
-        return ret;
-    }
+    if (rule && rule->priority != THREAD_PRIORITY_DEFAULT)
+        priority = rule->priority;
 
-    if (attr) {
-        pthread_mutexattr_gettype((pthread_mutexattr_t *) attr, &kind);
-    } else {
-        if (* (int *) mutex == BIONIC_PTHREAD_MUTEX_INITIALIZER) kind = PTHREAD_MUTEX_NORMAL;
-        else if (* (int *) mutex == BIONIC_PTHREAD_RECURSIVE_MUTEX_INITIALIZER) kind = PTHREAD_MUTEX_RECURSIVE;
-        else if (* (int *) mutex == BIONIC_PTHREAD_ERRORCHECK_MUTEX_INITIALIZER) kind = PTHREAD_MUTEX_ERRORCHECK;
-    }
+    if (rule && rule->cpu != THREAD_CPU_ANY)
+        sceKernelChangeThreadCpuAffinityMask(uid, SCE_KERNEL_CPU_MASK_USER_0 << rule->cpu);
+    if (priority != THREAD_PRIORITY_DEFAULT)
+        sceKernelChangeThreadPriority(uid, priority);
 
-    pthread_mutex_t mut;
-    mutex->real_ptr = malloc(sizeof(pthread_mutex_t));
-    sceClibMemcpy(mutex->real_ptr, &mut, sizeof(pthread_mutex_t));
+    if (rule)
+        logv_debug("thread 0x%x: rule \"%s\", cpu %i, priority %i", uid, rule->pattern, rule->cpu, priority);
+}
 
-    pthread_mutexattr_t mutattr;
-    pthread_mutexattr_init(&mutattr);
-    pthread_mutexattr_settype(&mutattr, kind);
-    ret = pthread_mutex_init(mutex->real_ptr, &mutattr);
-    pthread_mutexattr_destroy(&mutattr);
+static void * _thread_start(void * arg) {
+    pthr_thread * t = arg;
 
-    if (ret == 0) {
-        rememberObject(mutex);
-    } else {
-        logv_error("mutex initialization for %p has failed", mutex);
-    }
+    _threads_lock();
+    t->uid = sceKernelGetThreadId();
+    const thread_rule * rule = t->rule;
+    int priority = t->priority;
+    void *(*start)(void *) = t->start;
+    void * param = t->param;
+    _threads_unlock();
+
+    _thread_apply(sceKernelGetThreadId(), rule, priority);
+    void * ret = start(param);
+
+    _threads_lock();
+    t->used = 0;
+    _threads_unlock();
 
     return ret;
 }
 
-// null check for `cond` param must be performed before this, `attr` is fine as null
-PTHR_INLINE int _cond_t_static_init(pthread_cond_t_bionic * cond, const pthread_condattr_t * attr) {
-    int ret = 0;
-
-    if (isObjectInitialized(cond)) {
-        //logv_debug("cond already initialized: %p", cond);
-        return ret;
+int pthread_create_soloader(pthread_t *thread, const pthread_attr_t_bionic *attr, void *(*start)(void *), void *param) {
+    int ret;
+    uintptr_t creator = (uintptr_t) __builtin_return_address(0);
+
+    _threads_lock();
+    const thread_rule * rule = thread_policy_match(thread_policy_rules, thread_policy_rule_count,
+                                                   NULL, (uintptr_t) start, creator);
+    pthr_thread * t = _thread_alloc();
+    unsigned serial = t ? t->serial : 0;
+    if (t) {
+        t->entry = (uintptr_t) start;
+        t->creator = creator;
+        t->rule = rule;
+        t->priority = THREAD_PRIORITY_DEFAULT;
+        t->start = start;
+        t->param = param;
     }
+    _threads_unlock();
 
-    pthread_cond_t c;
-    cond->real_ptr = malloc(sizeof(pthread_cond_t));
-    sceClibMemcpy(cond->real_ptr, &c, sizeof(pthread_cond_t));
+    if (!t)
+        logv_error("too many threads, 0x%x runs without policy", start);
 
-    ret = pthread_cond_init(cond->real_ptr, attr);
+    pthread_attr_t a;
+    pthread_attr_t * real_attr = &a;
+    size_t stack_size = 0;
 
-    if (ret == 0) {
-        rememberObject(cond);
+    if (!attr) {
+        pthread_attr_init(&a);
     } else {
-        logv_error("cond initialization for %p has failed", cond);
+        _attr_t_static_init((pthread_attr_t_bionic *) attr);
+        real_attr = attr->real_ptr;
+        pthread_attr_getstacksize(real_attr, &stack_size);
     }
 
-    return ret;
+    if (rule && rule->stack_size != THREAD_STACK_DEFAULT)
+        stack_size = rule->stack_size;
+    else if (stack_size < PTHR_DEFAULT_STACK_SIZE)
+        stack_size = PTHR_DEFAULT_STACK_SIZE;
+    pthread_attr_setstacksize(real_attr, stack_size);
+
+    if (t) {
+        ret = pthread_create(thread, real_attr, _thread_start, t);
+        // The thread may have finished, and its slot been reused, already
+        _threads_lock();
+        if (t->used && t->serial == serial) {
+            if (ret == 0)
+                t->thread = *thread;
+            else
+                t->used = 0;
+        }
+        _threads_unlock();
+    } else {
+        ret = pthread_create(thread, real_attr, start, param);
+    }
+
+    if (!attr)
+        pthread_attr_destroy(&a);
+
+    return errno_to_bionic(ret);
 }
 
-int pthread_create_soloader(pthread_t *thread, const pthread_attr_t_bionic *attr, void *(*start)(void *), void *param) {
-    int ret;
+int pthr_get_thread_stats(pthr_thread_stats * out, int max) {
+    int n = 0;
 
-    if (!attr) {
-        pthread_attr_t a;
-        pthread_attr_init(&a);
-        pthread_attr_setstacksize(&a, 512 * 1024);
-        ret = pthread_create(thread, &a, start, param);
-        pthread_attr_destroy(&a);
-    } else{
-        _attr_t_static_init((pthread_attr_t_bionic *) attr);
-        pthread_attr_setstacksize(attr->real_ptr, 512 * 1024);
-        ret = pthread_create(thread, attr->real_ptr, start, param);
+    _threads_lock();
+    for (int i = 0; i < PTHR_MAX_THREADS && n < max; i++) {
+        pthr_thread * t = &pthr_threads[i];
+        if (!t->used || !t->uid) continue;
+
+        SceKernelThreadInfo info;
+        info.size = sizeof(info);
+        if (sceKernelGetThreadInfo(t->uid, &info) < 0) continue;
+
+        pthr_thread_stats * s = &out[n++];
+        memcpy(s->name, t->name, sizeof(s->name));
+        s->uid = t->uid;
+        s->entry = t->entry;
+        s->rule = t->rule ? t->rule->pattern : NULL;
+        s->priority = info.currentPriority;
+        s->affinity = info.currentCpuAffinityMask;
+        s->last_cpu = info.lastExecutedCpuId;
+        memcpy(&s->cpu_time_us, &info.runClocks, sizeof(s->cpu_time_us));
     }
+    _threads_unlock();
 
-    return ret;
+    return n;
+}
+
+void pthr_log_thread_stats() {
+    pthr_thread_stats stats[PTHR_MAX_THREADS];
+    int n = pthr_get_thread_stats(stats, PTHR_MAX_THREADS);
+
+    for (int i = 0; i < n; i++) {
+        logv_info("thread 0x%x \"%s\" (0x%x, rule %s): %llu ms cpu, priority %i, affinity 0x%x, last on cpu %i",
+                  stats[i].uid, stats[i].name, stats[i].entry, stats[i].rule ? stats[i].rule : "-",
+                  stats[i].cpu_time_us / 1000, stats[i].priority, stats[i].affinity, stats[i].last_cpu);
+    }
 }
 
 int pthread_mutexattr_init_soloader(pthread_mutexattr_t *attr)
 {
-    return pthread_mutexattr_init(attr);
+    return errno_to_bionic(pthread_mutexattr_init(attr));
 }
 
 int pthread_mutexattr_settype_soloader(pthread_mutexattr_t *attr, int type)
 {
-    return pthread_mutexattr_settype(attr, type);
+    return errno_to_bionic(pthread_mutexattr_settype(attr, type));
 }
 
 int pthread_mutexattr_destroy_soloader(pthread_mutexattr_t *attr)
 {
-    return pthread_mutexattr_destroy(attr);
+    return errno_to_bionic(pthread_mutexattr_destroy(attr));
 }
 
 int pthread_kill_soloader(pthread_t thread, int sig)
 {
-    return pthread_kill(thread, sig);
+    return errno_to_bionic(pthread_kill(thread, sig));
 }
 
 int pthread_mutex_init_soloader(pthread_mutex_t_bionic *uid, const pthread_mutexattr_t *attr)
 {
     if (!uid) return EINVAL;
-    return _mutex_t_static_init(uid, attr);
+    pthr_mutex_init(&uid->value, _mutex_kind(attr));
+    return 0;
 }
 
 int pthread_mutex_destroy_soloader(pthread_mutex_t_bionic *mutex)
 {
     if (!mutex) return 0;
-    forgetObject(mutex);
-    int ret = pthread_mutex_destroy(mutex->real_ptr);
-    if (mutex->real_ptr) free(mutex->real_ptr);
-    mutex->real_ptr = 0x0;
-    return ret;
+    return errno_to_bionic(pthr_mutex_destroy(&mutex->value));
 }
 
 int pthread_mutex_lock_soloader(pthread_mutex_t_bionic *mutex)
 {
     if (!mutex) return EINVAL;
-    _mutex_t_static_init(mutex, NULL);
-    return pthread_mutex_lock(mutex->real_ptr);
+    return errno_to_bionic(pthr_mutex_lock(&mutex->value, FUTEX_WAIT_FOREVER));
 }
 
 int pthread_mutex_trylock_soloader(pthread_mutex_t_bionic *mutex)
 {
     if (!mutex) return EINVAL;
-    _mutex_t_static_init(mutex, NULL);
-    return pthread_mutex_trylock(mutex->real_ptr);
+    return errno_to_bionic(pthr_mutex_trylock(&mutex->value));
 }
 
 int pthread_mutex_unlock_soloader(pthread_mutex_t_bionic *mutex)
 {
     if (!mutex) return EINVAL;
-    if (!mutex->real_ptr) return EINVAL;
-    return pthread_mutex_unlock(mutex->real_ptr);
+    return errno_to_bionic(pthr_mutex_unlock(&mutex->value));
 }
 
 int pthread_join_soloader(pthread_t thread, void **value_ptr)
 {
-    return pthread_join(thread, value_ptr);
+    return errno_to_bionic(pthread_join(thread, value_ptr));
 }
 
 int pthread_condattr_init_soloader(pthread_condattr_t *attr)
 {
     if (!attr) return EINVAL;
-    return pthread_condattr_init(attr);
+    return errno_to_bionic(pthread_condattr_init(attr));
 }
 
 int pthread_condattr_destroy_soloader(pthread_condattr_t *attr)
 {
     if (!attr) return EINVAL;
-    return pthread_condattr_destroy(attr);
+    return errno_to_bionic(pthread_condattr_destroy(attr));
 }
 
 int pthread_cond_init_soloader(pthread_cond_t_bionic *cond,
                                const pthread_condattr_t *attr)
 {
     if (!cond) return EINVAL;
-
-    return _cond_t_static_init(cond, attr);
+    pthr_cond_init(&cond->value);
+    return 0;
 }
 
 int pthread_cond_destroy_soloader(pthread_cond_t_bionic *cond)
 {
-    if (!cond) return 0;
-    forgetObject(cond);
-    int ret = pthread_cond_destroy(cond->real_ptr);
-    if (cond->real_ptr) free(cond->real_ptr);
-    cond->real_ptr = 0x0;
-    return ret;
+    return 0;
 }
 
 int pthread_cond_signal_soloader(pthread_cond_t_bionic *cond)
 {
     if (!cond) return EINVAL;
-
-    _cond_t_static_init(cond, NULL);
-
-    return pthread_cond_signal(cond->real_ptr);
+    pthr_cond_signal(&cond->value);
+    return 0;
 }
 
 int pthread_cond_timedwait_soloader(pthread_cond_t_bionic *cond, pthread_mutex_t_bionic *mutex, struct timespec *abstime)
 {
     if (!cond || !mutex) return EINVAL;
-
-    _cond_t_static_init(cond, NULL);
-    _mutex_t_static_init(mutex, NULL);
-
-    return pthread_cond_timedwait(cond->real_ptr, mutex->real_ptr, abstime);
+    return errno_to_bionic(pthr_cond_wait(&cond->value, &mutex->value, pthr_sync_deadline(abstime)));
 }
 
 
 int pthread_cond_wait_soloader(pthread_cond_t_bionic *cond, pthread_mutex_t_bionic *mutex)
 {
     if (!cond || !mutex) return EINVAL;
-
-    _cond_t_static_init(cond, NULL);
-    _mutex_t_static_init(mutex, NULL);
-
-    return pthread_cond_wait(cond->real_ptr, mutex->real_ptr);
+    return errno_to_bionic(pthr_cond_wait(&cond->value, &mutex->value, FUTEX_WAIT_FOREVER));
 }
 
 int pthread_cond_broadcast_soloader(pthread_cond_t_bionic *cond)
 {
     if (!cond) return EINVAL;
-
-    _cond_t_static_init(cond, NULL);
-
-    return pthread_cond_broadcast(cond->real_ptr);
+    pthr_cond_broadcast(&cond->value);
+    return 0;
 }
 
 int pthread_attr_init_soloader(pthread_attr_t_bionic *attr)
@@ -351,21 +439,57 @@ int pthread_attr_setstacksize_soloader(pthread_attr_t_bionic *attr, size_t stack
     return pthread_attr_setstacksize(attr->real_ptr, stacksize);
 }
 
+// Policies and priorities come in Linux terms, newlib would misread them
 int pthread_setschedparam_soloader(pthread_t thread, int policy,
                                    const struct sched_param *param)
 {
-   return pthread_setschedparam(thread, policy, param);
+    if (!param) return EINVAL;
+
+    int priority = thread_policy_priority(policy, param->sched_priority);
+    if (priority < 0) return EINVAL;
+
+    _threads_lock();
+    pthr_thread * t = _thread_find(thread);
+    const thread_rule * rule = NULL;
+    SceUID uid = thread == pthread_self() ? sceKernelGetThreadId() : 0;
+    if (t) {
+        t->sched_policy = policy;
+        t->sched_priority = param->sched_priority;
+        t->priority = priority;
+        rule = t->rule;
+        uid = t->uid; // or the thread applies it itself when it starts
+    }
+    _threads_unlock();
+
+    if (!t && !uid)
+        logv_debug("thread 0x%x: not created by the game, priority %i ignored", thread, priority);
+    _thread_apply(uid, rule, priority);
+
+    return 0;
 }
 
 int pthread_getschedparam_soloader(pthread_t thread, int *policy,
                                    struct sched_param *param)
 {
-    return pthread_getschedparam(thread, policy, param);
+    if (!policy || !param) return EINVAL;
+
+    *policy = THREAD_SCHED_OTHER;
+    param->sched_priority = 0;
+
+    _threads_lock();
+    pthr_thread * t = _thread_find(thread);
+    if (t) {
+        *policy = t->sched_policy;
+        param->sched_priority = t->sched_priority;
+    }
+    _threads_unlock();
+
+    return 0;
 }
 
 int pthread_detach_soloader(pthread_t thread)
 {
-    return pthread_detach(thread);
+    return errno_to_bionic(pthread_detach(thread));
 }
 
 int pthread_equal_soloader(const pthread_t t1, const pthread_t t2)
@@ -390,10 +514,6 @@ int pthread_once_soloader(volatile int *once_control, void (*init_routine)(void)
     return 0;
 }
 
-#ifndef MAX_TASK_COMM_LEN
-#define MAX_TASK_COMM_LEN 16
-#endif
-
 int pthread_setname_np_soloader(pthread_t thread, const char* thread_name) {
     if (thread == 0 || thread_name == NULL) {
         return EINVAL;
@@ -403,63 +523,91 @@ int pthread_setname_np_soloader(pthread_t thread, const char* thread_name) {
         return ERANGE;
     }
 
-    sceClibPrintf("PTHREAD: pthread_setname_np with name %s for thread:0x%x\n", thread_name, pthread_self());
+    sceClibPrintf("PTHREAD: pthread_setname_np with name %s for thread:0x%x\n", thread_name, thread);
+
+    // Names usually come after creation, so the policy is matched again
+    _threads_lock();
+    pthr_thread * t = _thread_find(thread);
+    const thread_rule * rule = NULL;
+    SceUID uid = 0;
+    int priority = THREAD_PRIORITY_DEFAULT;
+    if (t) {
+        memcpy(t->name, thread_name, thread_name_len + 1);
+        priority = t->priority;
+        rule = thread_policy_match(thread_policy_rules, thread_policy_rule_count,
+                                   t->name, t->entry, t->creator);
+        if (rule != t->rule) {
+            t->rule = rule;
+            uid = t->uid; // or the thread applies it itself when it starts
+        }
+    }
+    _threads_unlock();
+
+    _thread_apply(uid, rule, priority);
 
     return 0;
 }
 
-int sem_destroy_soloader(int * uid) {
-    if (sceKernelDeleteSema(*uid) < 0)
-        return -1;
+int sem_destroy_soloader(int * sem) {
     return 0;
 }
 
-int sem_getvalue_soloader (int * uid, int * sval) {
-    SceKernelSemaInfo info;
-    info.size = sizeof(SceKernelSemaInfo);
-
-    if (sceKernelGetSemaInfo(*uid, &info) < 0) return -1;
-    if (!sval) sval = malloc(sizeof(int32_t));
-    *sval = info.currentCount;
+int sem_getvalue_soloader (int * sem, int * sval) {
+    if (!sem || !sval) {
+        errno = EINVAL;
+        return -1;
+    }
+    *sval = pthr_sem_getvalue(sem);
     return 0;
 }
 
-int sem_init_soloader (int * uid, int pshared, unsigned int value) {
-    *uid = sceKernelCreateSema("sema", 0, (int) value, 0x7fffffff, NULL);
-    if (*uid < 0)
+int sem_init_soloader (int * sem, int pshared, unsigned int value) {
+    int ret = pthr_sem_init(sem, value);
+    if (ret != 0) {
+        errno = ret;
         return -1;
+    }
     return 0;
 }
 
-int sem_post_soloader (int * uid) {
-    if (sceKernelSignalSema(*uid, 1) < 0)
+int sem_post_soloader (int * sem) {
+    int ret = pthr_sem_post(sem);
+    if (ret != 0) {
+        errno = ret;
         return -1;
+    }
     return 0;
 }
 
-int sem_timedwait_soloader (int * uid, const struct timespec * abstime) {
-    uint timeout = 1000;
-    if (sceKernelWaitSema(*uid, 1, &timeout) >= 0)
+int sem_timedwait_soloader (int * sem, const struct timespec * abstime) {
+    if (pthr_sem_trywait(sem) == 0)
         return 0;
-    if (!abstime) return -1;
-    long long now = (long long) current_timestamp_ms() * 1000; // us
-    long long _timeout = abstime->tv_sec * 1000 * 1000 + abstime->tv_nsec / 1000; // us
-    if (_timeout-now >= 0) return -1;
-    uint timeout_real = _timeout - now;
-    if (sceKernelWaitSema(*uid, 1, &timeout_real) < 0)
+    if (!abstime || abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000) {
+        errno = EINVAL;
+        return -1;
+    }
+    int ret = pthr_sem_wait(sem, pthr_sync_deadline(abstime));
+    if (ret != 0) {
+        errno = ret;
         return -1;
+    }
     return 0;
 }
 
-int sem_trywait_soloader (int * uid) {
-    uint timeout = 1000;
-    if (sceKernelWaitSema(*uid, 1, &timeout) < 0)
+int sem_trywait_soloader (int * sem) {
+    int ret = pthr_sem_trywait(sem);
+    if (ret != 0) {
+        errno = ret;
         return -1;
+    }
     return 0;
 }
 
-int sem_wait_soloader (int * uid) {
-    if (sceKernelWaitSema(*uid, 1, NULL) < 0)
+int sem_wait_soloader (int * sem) {
+    int ret = pthr_sem_wait(sem, FUTEX_WAIT_FOREVER);
+    if (ret != 0) {
+        errno = ret;
         return -1;
+    }
     return 0;
 }
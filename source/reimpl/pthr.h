@@ -18,6 +18,8 @@
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdint.h>
+#include <psp2/types.h>
 
 typedef struct
 {
@@ -29,14 +31,15 @@ typedef struct
     int32_t sched_priority;
 } pthread_attr_t_bionic;
 
+// Same as bionic: the whole object is one word, see reimpl/pthr_sync.h
 typedef struct
 {
-    pthread_mutex_t * real_ptr; // replaces `int volatile value;`
+    int volatile value;
 } pthread_mutex_t_bionic;
 
 typedef struct
 {
-    pthread_cond_t * real_ptr; // replaces `int volatile value;`
+    int volatile value;
 } pthread_cond_t_bionic;
 
 // pthread_t is same size on bionic and newlib
@@ -81,6 +84,24 @@ int pthread_attr_setstacksize_soloader(pthread_attr_t_bionic *attr, size_t stack
 
 int pthread_setname_np_soloader(pthread_t thread, const char* thread_name);
 
+typedef struct {
+    char name[16];
+    SceUID uid;
+    uintptr_t entry;
+    const char * rule; // pattern of the matching rule, or NULL
+    int priority;
+    int affinity;
+    int last_cpu;
+    uint64_t cpu_time_us;
+} pthr_thread_stats;
+
+/*
+ * Fills `out` with the running threads created by the game, placed by
+ * reimpl/thread_policy.c. Returns how many there are (at most `max`).
+ */
+int pthr_get_thread_stats(pthr_thread_stats * out, int max);
+void pthr_log_thread_stats();
+
 int sem_init_soloader (int * sem, int pshared, unsigned int value);
 int sem_destroy_soloader(int * sem);
 int sem_getvalue_soloader (int * sem, int * sval);
@@ -0,0 +1,281 @@
+/*
+ * reimpl/pthr_sync.c
+ *
+ * Mutexes, condition variables and semaphores in the bionic pthread
+ * words, see pthr_sync.h. The mutex is the three-state futex mutex from
+ * Drepper's "Futexes Are Tricky", with owner and counter fields for the
+ * recursive and errorcheck kinds.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/pthr_sync.h"
+#include "reimpl/futex.h"
+#include "utils/clock.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define MUTEX_STATE_MASK     0x0003
+#define MUTEX_LOCKED         0x0001
+#define MUTEX_CONTENDED      0x0002
+#define MUTEX_COUNTER_ONE    0x0004
+#define MUTEX_COUNTER_MASK   0x1FFC
+#define MUTEX_KIND_MASK      0xC000
+#define MUTEX_OWNER_SHIFT    16
+
+// Rounds of polling before a contended lock goes to sleep
+#define MUTEX_SPIN_COUNT 100
+
+#define WORD(p) ((_Atomic int *) (p))
+
+uint64_t pthr_sync_now(void) {
+    return clock_monotonic_us();
+}
+
+uint64_t pthr_sync_deadline(const struct timespec *abstime) {
+    if (!abstime)
+        return FUTEX_WAIT_FOREVER;
+
+    uint64_t now = pthr_sync_now();
+    if (abstime->tv_sec < 0)
+        return now;
+
+    uint64_t target = (uint64_t) abstime->tv_sec * 1000000 + abstime->tv_nsec / 1000;
+    uint64_t wall = clock_realtime_us();
+    return target > wall ? now + (target - wall) : now;
+}
+
+static uint64_t timeout_until(uint64_t deadline_us) {
+    if (deadline_us == FUTEX_WAIT_FOREVER)
+        return FUTEX_WAIT_FOREVER;
+    uint64_t now = pthr_sync_now();
+    return deadline_us > now ? deadline_us - now : 0;
+}
+
+static unsigned mutex_owner(int value) {
+    return (unsigned) value >> MUTEX_OWNER_SHIFT;
+}
+
+void pthr_mutex_init(volatile int *mutex, int kind) {
+    atomic_store_explicit(WORD(mutex), kind & MUTEX_KIND_MASK, memory_order_release);
+}
+
+// Handles relocking by the owner. Returns -1 when `value` is not ours.
+static int mutex_relock(volatile int *mutex, int value, unsigned self) {
+    int kind = value & MUTEX_KIND_MASK;
+    if (kind == PTHR_MUTEX_NORMAL || mutex_owner(value) != self)
+        return -1;
+    if (kind == PTHR_MUTEX_ERRORCHECK)
+        return EDEADLK;
+
+    // Only the owner touches the counter, but waiters may flip the state
+    for (;;) {
+        if ((value & MUTEX_COUNTER_MASK) == MUTEX_COUNTER_MASK)
+            return EAGAIN;
+        if (atomic_compare_exchange_weak_explicit(WORD(mutex), &value, value + MUTEX_COUNTER_ONE,
+                                                  memory_order_relaxed, memory_order_relaxed))
+            return 0;
+    }
+}
+
+int pthr_mutex_trylock(volatile int *mutex) {
+    int value = atomic_load_explicit(WORD(mutex), memory_order_relaxed);
+    int kind = value & MUTEX_KIND_MASK;
+    unsigned self = kind == PTHR_MUTEX_NORMAL ? 0 : futex_thread_id();
+
+    int unlocked = kind;
+    if (atomic_compare_exchange_strong_explicit(WORD(mutex), &unlocked,
+                                                kind | (int) (self << MUTEX_OWNER_SHIFT) | MUTEX_LOCKED,
+                                                memory_order_acquire, memory_order_relaxed))
+        return 0;
+
+    int ret = mutex_relock(mutex, unlocked, self);
+    return ret == 0 ? 0 : EBUSY;
+}
+
+int pthr_mutex_lock(volatile int *mutex, uint64_t deadline_us) {
+    int value = atomic_load_explicit(WORD(mutex), memory_order_relaxed);
+    int kind = value & MUTEX_KIND_MASK;
+    unsigned self = kind == PTHR_MUTEX_NORMAL ? 0 : futex_thread_id();
+    int owned = kind | (int) (self << MUTEX_OWNER_SHIFT);
+
+    // Fast path: uncontended
+    int unlocked = kind;
+    if (atomic_compare_exchange_strong_explicit(WORD(mutex), &unlocked, owned | MUTEX_LOCKED,
+                                                memory_order_acquire, memory_order_relaxed))
+        return 0;
+
+    int ret = mutex_relock(mutex, unlocked, self);
+    if (ret >= 0)
+        return ret;
+
+    for (int i = 0; i < MUTEX_SPIN_COUNT; i++) {
+        unlocked = kind;
+        if (atomic_compare_exchange_weak_explicit(WORD(mutex), &unlocked, owned | MUTEX_LOCKED,
+                                                  memory_order_acquire, memory_order_relaxed))
+            return 0;
+        if (unlocked & MUTEX_CONTENDED)
+            break;
+    }
+
+    // Slow path: mark the mutex contended and sleep. Whoever takes it from
+    // here takes it as contended, since there may be other sleepers.
+    for (;;) {
+        value = atomic_load_explicit(WORD(mutex), memory_order_relaxed);
+        if ((value & MUTEX_STATE_MASK) == 0) {
+            if (atomic_compare_exchange_weak_explicit(WORD(mutex), &value, owned | MUTEX_CONTENDED,
+                                                      memory_order_acquire, memory_order_relaxed))
+                return 0;
+            continue;
+        }
+        if ((value & MUTEX_STATE_MASK) == MUTEX_LOCKED) {
+            int contended = (value & ~MUTEX_STATE_MASK) | MUTEX_CONTENDED;
+            if (!atomic_compare_exchange_weak_explicit(WORD(mutex), &value, contended,
+                                                       memory_order_relaxed, memory_order_relaxed))
+                continue;
+            value = contended;
+        }
+
+        uint64_t timeout = timeout_until(deadline_us);
+        if (timeout == 0 || futex_wait(mutex, value, timeout) == ETIMEDOUT) {
+            if (timeout_until(deadline_us) == 0)
+                return ETIMEDOUT;
+        }
+    }
+}
+
+int pthr_mutex_unlock(volatile int *mutex) {
+    int value = atomic_load_explicit(WORD(mutex), memory_order_relaxed);
+    int kind = value & MUTEX_KIND_MASK;
+
+    if ((value & MUTEX_STATE_MASK) == 0)
+        return EPERM;
+
+    if (kind != PTHR_MUTEX_NORMAL) {
+        if (mutex_owner(value) != futex_thread_id())
+            return EPERM;
+        while (value & MUTEX_COUNTER_MASK) {
+            if (atomic_compare_exchange_weak_explicit(WORD(mutex), &value, value - MUTEX_COUNTER_ONE,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                return 0;
+        }
+    }
+
+    int old = atomic_exchange_explicit(WORD(mutex), kind, memory_order_release);
+    if ((old & MUTEX_STATE_MASK) == MUTEX_CONTENDED)
+        futex_wake(mutex, 1);
+    return 0;
+}
+
+int pthr_mutex_destroy(volatile int *mutex) {
+    int value = atomic_load_explicit(WORD(mutex), memory_order_relaxed);
+    return (value & MUTEX_STATE_MASK) ? EBUSY : 0;
+}
+
+void pthr_cond_init(volatile int *cond) {
+    atomic_store_explicit(WORD(cond), 0, memory_order_release);
+}
+
+int pthr_cond_wait(volatile int *cond, volatile int *mutex, uint64_t deadline_us) {
+    int seq = atomic_load_explicit(WORD(cond), memory_order_relaxed);
+
+    int ret = pthr_mutex_unlock(mutex);
+    if (ret != 0)
+        return ret;
+
+    uint64_t timeout = timeout_until(deadline_us);
+    int status = timeout == 0 ? ETIMEDOUT : futex_wait(cond, seq, timeout);
+
+    // The mutex must be held again whatever happened
+    pthr_mutex_lock(mutex, FUTEX_WAIT_FOREVER);
+    return status == ETIMEDOUT && timeout_until(deadline_us) == 0 ? ETIMEDOUT : 0;
+}
+
+void pthr_cond_signal(volatile int *cond) {
+    atomic_fetch_add_explicit(WORD(cond), 1, memory_order_release);
+    futex_wake(cond, 1);
+}
+
+void pthr_cond_broadcast(volatile int *cond) {
+    atomic_fetch_add_explicit(WORD(cond), 1, memory_order_release);
+    futex_wake(cond, INT_MAX);
+}
+
+int pthr_sem_init(volatile int *sem, unsigned int value) {
+    if (value > INT_MAX)
+        return EINVAL;
+    atomic_store_explicit(WORD(sem), (int) value, memory_order_release);
+    return 0;
+}
+
+// Takes one unit if there is any. Only a post that finds -1 wakes anybody,
+// so a thread that has slept must assume others still are: it leaves -1
+// behind instead of 0, and passes the wakeup on if units are left over from
+// posts that didn't wake anyone.
+static int sem_take(volatile int *sem, int slept) {
+    int value = atomic_load_explicit(WORD(sem), memory_order_relaxed);
+    while (value > 0) {
+        int next = (value == 1 && slept) ? -1 : value - 1;
+        if (atomic_compare_exchange_weak_explicit(WORD(sem), &value, next,
+                                                  memory_order_acquire, memory_order_relaxed)) {
+            if (slept && next > 0)
+                futex_wake(sem, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int pthr_sem_trywait(volatile int *sem) {
+    return sem_take(sem, 0) ? 0 : EAGAIN;
+}
+
+int pthr_sem_wait(volatile int *sem, uint64_t deadline_us) {
+    if (sem_take(sem, 0))
+        return 0;
+
+    for (;;) {
+        // Announce a sleeper, unless a post came in meanwhile
+        int value = atomic_load_explicit(WORD(sem), memory_order_relaxed);
+        if (value > 0) {
+            if (sem_take(sem, 1))
+                return 0;
+            continue;
+        }
+        if (value == 0 && !atomic_compare_exchange_weak_explicit(WORD(sem), &value, -1,
+                                                                 memory_order_relaxed, memory_order_relaxed))
+            continue;
+
+        uint64_t timeout = timeout_until(deadline_us);
+        if (timeout == 0)
+            return ETIMEDOUT;
+        futex_wait(sem, -1, timeout);
+
+        if (sem_take(sem, 1))
+            return 0;
+    }
+}
+
+int pthr_sem_post(volatile int *sem) {
+    int value = atomic_load_explicit(WORD(sem), memory_order_relaxed);
+    int next;
+    do {
+        if (value == INT_MAX)
+            return EOVERFLOW;
+        next = value < 0 ? 1 : value + 1;
+    } while (!atomic_compare_exchange_weak_explicit(WORD(sem), &value, next,
+                                                    memory_order_release, memory_order_relaxed));
+
+    if (value < 0)
+        futex_wake(sem, 1);
+    return 0;
+}
+
+int pthr_sem_getvalue(volatile int *sem) {
+    int value = atomic_load_explicit(WORD(sem), memory_order_relaxed);
+    return value < 0 ? 0 : value;
+}
@@ -0,0 +1,63 @@
+/*
+ * reimpl/pthr_sync.h
+ *
+ * Mutexes and condition variables that live entirely in the 4-byte bionic
+ * pthread_mutex_t / pthread_cond_t words, on top of reimpl/futex.h. There
+ * is nothing to allocate or register, and static initializers just work.
+ *
+ * Mutex word, bionic layout:
+ *   bits  0-1   state: 0 unlocked, 1 locked, 2 locked with waiters
+ *   bits  2-12  recursion counter (recursive mutexes)
+ *   bits 14-15  kind: PTHR_MUTEX_NORMAL/RECURSIVE/ERRORCHECK
+ *   bits 16-31  owner, futex_thread_id() (recursive and errorcheck)
+ *
+ * Condvar word: a sequence number bumped on every signal.
+ *
+ * Semaphore word: the count, or -1 for zero with possible sleepers.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_PTHR_SYNC_H
+#define SOLOADER_PTHR_SYNC_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Kinds, as in bionic's static initializers
+#define PTHR_MUTEX_NORMAL     0x0000
+#define PTHR_MUTEX_RECURSIVE  0x4000
+#define PTHR_MUTEX_ERRORCHECK 0x8000
+
+// `deadline_us` arguments are absolute pthr_sync_now() times, or
+// FUTEX_WAIT_FOREVER.
+
+/* The time base of deadlines: CLOCK_MONOTONIC, in microseconds. */
+uint64_t pthr_sync_now(void);
+
+/*
+ * Converts a POSIX CLOCK_REALTIME `abstime` (NULL: no timeout) to a
+ * deadline, so later changes of the wall clock don't affect the wait.
+ */
+uint64_t pthr_sync_deadline(const struct timespec *abstime);
+
+void pthr_mutex_init(volatile int *mutex, int kind);
+int pthr_mutex_lock(volatile int *mutex, uint64_t deadline_us);
+int pthr_mutex_trylock(volatile int *mutex);
+int pthr_mutex_unlock(volatile int *mutex);
+int pthr_mutex_destroy(volatile int *mutex);
+
+void pthr_cond_init(volatile int *cond);
+int pthr_cond_wait(volatile int *cond, volatile int *mutex, uint64_t deadline_us);
+void pthr_cond_signal(volatile int *cond);
+void pthr_cond_broadcast(volatile int *cond);
+
+/* These return 0 or an errno value, like the others. */
+int pthr_sem_init(volatile int *sem, unsigned int value);
+int pthr_sem_wait(volatile int *sem, uint64_t deadline_us);
+int pthr_sem_trywait(volatile int *sem);
+int pthr_sem_post(volatile int *sem);
+int pthr_sem_getvalue(volatile int *sem);
+
+#endif // SOLOADER_PTHR_SYNC_H
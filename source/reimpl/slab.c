@@ -0,0 +1,339 @@
+/*
+ * reimpl/slab.c
+ *
+ * Size-class slab allocator, see slab.h.
+ *
+ * Each thread keeps a short free list per class; refills and overflows
+ * move objects in batches to and from the class's central free list, which
+ * is refilled by carving a new slab out of the arena. A slab belongs to
+ * one class for good: it is never returned to the arena, and its objects
+ * only ever go back to that class's central list. The arena is one
+ * allocation from the newlib heap, so ownership of a pointer is a range
+ * check.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifdef SLAB_ALLOC
+
+#include "reimpl/slab.h"
+#include "reimpl/futex.h"
+#include "reimpl/pthr_sync.h"
+#include "utils/logger.h"
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAB_ARENA_PAGES (SLAB_ARENA_SIZE / SLAB_PAGE_SIZE)
+#define SLAB_NO_CLASS 0xFF
+
+// Thread cache: refill/flush this many objects at a time, keep up to twice
+#define SLAB_BATCH 32
+
+static const uint16_t slab_class_sizes[SLAB_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+};
+
+// Class of each size / 16, rounded up
+static uint8_t slab_class_of[SLAB_MAX_SIZE / 16 + 1];
+
+typedef struct slab_object {
+    struct slab_object *next;
+} slab_object;
+
+typedef struct {
+    volatile int lock; // pthr_sync mutex
+    slab_object *free;
+    uint32_t free_count;
+    uint32_t pages;
+    _Atomic uint64_t allocs;
+    _Atomic uint64_t frees;
+    _Atomic uint64_t requested;
+} slab_central;
+
+typedef struct {
+    slab_object *free[SLAB_CLASSES];
+    uint16_t count[SLAB_CLASSES];
+    int registered;
+} slab_cache;
+
+static uint8_t *slab_arena = NULL;
+static uint8_t slab_page_class[SLAB_ARENA_PAGES];
+static uint32_t slab_arena_used = 0; // pages, under slab_arena_lock
+static volatile int slab_arena_lock = 0;
+static _Atomic uint64_t slab_fallbacks = 0;
+
+static slab_central slab_centrals[SLAB_CLASSES];
+static __thread slab_cache slab_thread_cache;
+
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slab_cache_key;
+
+static void slab_cache_flush(void *arg);
+
+static void slab_init(void) {
+    for (int c = 0, s = 0; s <= SLAB_MAX_SIZE / 16; s++) {
+        while (slab_class_sizes[c] < s * 16)
+            c++;
+        slab_class_of[s] = c;
+    }
+    memset(slab_page_class, SLAB_NO_CLASS, sizeof(slab_page_class));
+    pthread_key_create(&slab_cache_key, slab_cache_flush);
+
+    slab_arena = memalign(SLAB_PAGE_SIZE, SLAB_ARENA_SIZE);
+    if (!slab_arena)
+        logv_error("[slab] can't reserve the %i MB arena, using newlib only", SLAB_ARENA_SIZE / 1024 / 1024);
+}
+
+static inline int slab_owns(const void *ptr) {
+    return slab_arena && (const uint8_t *) ptr >= slab_arena && (const uint8_t *) ptr < slab_arena + SLAB_ARENA_SIZE;
+}
+
+static inline int slab_class_of_ptr(const void *ptr) {
+    return slab_page_class[((const uint8_t *) ptr - slab_arena) / SLAB_PAGE_SIZE];
+}
+
+// Carves a new slab for class `c` into its central list. Called with the
+// central lock held.
+static int slab_grow(int c) {
+    pthr_mutex_lock(&slab_arena_lock, FUTEX_WAIT_FOREVER);
+    uint32_t page = slab_arena_used < SLAB_ARENA_PAGES ? slab_arena_used++ : SLAB_ARENA_PAGES;
+    if (page < SLAB_ARENA_PAGES)
+        slab_page_class[page] = c;
+    pthr_mutex_unlock(&slab_arena_lock);
+
+    if (page == SLAB_ARENA_PAGES)
+        return 0;
+
+    slab_central *central = &slab_centrals[c];
+    uint8_t *base = slab_arena + (size_t) page * SLAB_PAGE_SIZE;
+    size_t size = slab_class_sizes[c];
+    size_t n = SLAB_PAGE_SIZE / size;
+
+    for (size_t i = n; i-- > 0;) {
+        slab_object *o = (slab_object *) (base + i * size);
+        o->next = central->free;
+        central->free = o;
+    }
+    central->free_count += n;
+    central->pages++;
+    return 1;
+}
+
+// Moves up to SLAB_BATCH objects from the central list to the thread cache
+static int slab_refill(slab_cache *cache, int c) {
+    slab_central *central = &slab_centrals[c];
+
+    pthr_mutex_lock(&central->lock, FUTEX_WAIT_FOREVER);
+    if (!central->free && !slab_grow(c)) {
+        pthr_mutex_unlock(&central->lock);
+        return 0;
+    }
+
+    slab_object *first = central->free, *last = first;
+    int n = 1;
+    while (n < SLAB_BATCH && last->next) {
+        last = last->next;
+        n++;
+    }
+    central->free = last->next;
+    central->free_count -= n;
+    pthr_mutex_unlock(&central->lock);
+
+    last->next = cache->free[c];
+    cache->free[c] = first;
+    cache->count[c] += n;
+    return 1;
+}
+
+// Gives back the objects of class `c` beyond `keep`
+static void slab_release(slab_cache *cache, int c, int keep) {
+    if (cache->count[c] <= keep)
+        return;
+
+    slab_object *first = cache->free[c], *last = first;
+    int n = cache->count[c] - keep;
+    for (int i = 1; i < n; i++)
+        last = last->next;
+    cache->free[c] = last->next;
+    cache->count[c] = keep;
+
+    slab_central *central = &slab_centrals[c];
+    pthr_mutex_lock(&central->lock, FUTEX_WAIT_FOREVER);
+    last->next = central->free;
+    central->free = first;
+    central->free_count += n;
+    pthr_mutex_unlock(&central->lock);
+}
+
+// Thread exit: everything cached goes back to the central lists. Other
+// destructors may still free afterwards; that registers the cache again,
+// and pthreads then runs this once more.
+static void slab_cache_flush(void *arg) {
+    slab_cache *cache = arg;
+    cache->registered = 0;
+    for (int c = 0; c < SLAB_CLASSES; c++)
+        slab_release(cache, c, 0);
+}
+
+static inline slab_cache *slab_get_cache(void) {
+    slab_cache *cache = &slab_thread_cache;
+    if (!cache->registered) {
+        cache->registered = 1;
+        pthread_setspecific(slab_cache_key, cache);
+    }
+    return cache;
+}
+
+static void *slab_alloc_class(int c, size_t size) {
+    slab_cache *cache = slab_get_cache();
+    if (!cache->free[c] && !slab_refill(cache, c))
+        return NULL;
+
+    slab_object *o = cache->free[c];
+    cache->free[c] = o->next;
+    cache->count[c]--;
+
+    slab_central *central = &slab_centrals[c];
+    atomic_fetch_add_explicit(&central->allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&central->requested, size, memory_order_relaxed);
+    return o;
+}
+
+void *slab_malloc(size_t size) {
+    pthread_once(&slab_once, slab_init);
+
+    if (size <= SLAB_MAX_SIZE && slab_arena) {
+        void *p = slab_alloc_class(slab_class_of[(size + 15) / 16], size);
+        if (p)
+            return p;
+        atomic_fetch_add_explicit(&slab_fallbacks, 1, memory_order_relaxed);
+    }
+    return malloc(size);
+}
+
+void slab_free(void *ptr) {
+    if (!ptr)
+        return;
+    if (!slab_owns(ptr)) {
+        free(ptr);
+        return;
+    }
+
+    int c = slab_class_of_ptr(ptr);
+    slab_cache *cache = slab_get_cache();
+    slab_object *o = ptr;
+    o->next = cache->free[c];
+    cache->free[c] = o;
+    if (++cache->count[c] > 2 * SLAB_BATCH)
+        slab_release(cache, c, SLAB_BATCH);
+
+    atomic_fetch_add_explicit(&slab_centrals[c].frees, 1, memory_order_relaxed);
+}
+
+void *slab_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size)
+        return NULL;
+    void *p = slab_malloc(count * size);
+    if (p)
+        memset(p, 0, count * size);
+    return p;
+}
+
+void *slab_realloc(void *ptr, size_t size) {
+    if (!ptr)
+        return slab_malloc(size);
+    if (size == 0) {
+        slab_free(ptr);
+        return NULL;
+    }
+    if (!slab_owns(ptr))
+        return realloc(ptr, size);
+
+    size_t old = slab_class_sizes[slab_class_of_ptr(ptr)];
+    if (size <= old && size > old / 2)
+        return ptr;
+
+    void *p = slab_malloc(size);
+    if (p) {
+        memcpy(p, ptr, size < old ? size : old);
+        slab_free(ptr);
+    }
+    return p;
+}
+
+void *slab_memalign(size_t alignment, size_t size) {
+    if (alignment <= 16)
+        return slab_malloc(size);
+
+    // Power-of-two classes hold objects aligned to their size
+    if (alignment <= SLAB_MAX_SIZE && size <= alignment && (alignment & (alignment - 1)) == 0) {
+        pthread_once(&slab_once, slab_init);
+        void *p = slab_arena ? slab_alloc_class(slab_class_of[alignment / 16], size) : NULL;
+        if (p)
+            return p;
+    }
+    return memalign(alignment, size);
+}
+
+void *slab_new(size_t size) {
+    void *p = slab_malloc(size ? size : 1);
+    if (!p) {
+        logv_error("[slab] operator new(%u): out of memory", size);
+        abort();
+    }
+    return p;
+}
+
+void slab_get_stats(slab_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int c = 0; c < SLAB_CLASSES; c++) {
+        slab_central *central = &slab_centrals[c];
+        slab_class_stats *s = &stats->classes[c];
+        s->size = slab_class_sizes[c];
+        pthr_mutex_lock(&central->lock, FUTEX_WAIT_FOREVER);
+        s->pages = central->pages;
+        pthr_mutex_unlock(&central->lock);
+        s->allocs = atomic_load_explicit(&central->allocs, memory_order_relaxed);
+        s->frees = atomic_load_explicit(&central->frees, memory_order_relaxed);
+
+        stats->requested += atomic_load_explicit(&central->requested, memory_order_relaxed);
+        stats->rounded += s->allocs * s->size;
+        stats->live_bytes += (s->allocs - s->frees) * s->size;
+    }
+    pthr_mutex_lock(&slab_arena_lock, FUTEX_WAIT_FOREVER);
+    stats->arena_pages = slab_arena_used;
+    pthr_mutex_unlock(&slab_arena_lock);
+    stats->arena_bytes = slab_arena ? SLAB_ARENA_SIZE : 0;
+    stats->fallbacks = atomic_load_explicit(&slab_fallbacks, memory_order_relaxed);
+}
+
+void slab_log_stats(void) {
+    slab_stats stats;
+    slab_get_stats(&stats);
+
+    for (int c = 0; c < SLAB_CLASSES; c++) {
+        slab_class_stats *s = &stats.classes[c];
+        if (s->pages == 0)
+            continue;
+        uint64_t live = s->allocs - s->frees;
+        uint64_t capacity = (uint64_t) s->pages * (SLAB_PAGE_SIZE / s->size);
+        logv_info("[slab] %4u B: %3u slabs, %7llu live (%3llu%% full), %llu allocs, %llu frees",
+                  s->size, s->pages, live, capacity ? live * 100 / capacity : 0, s->allocs, s->frees);
+    }
+
+    uint64_t committed = (uint64_t) stats.arena_pages * SLAB_PAGE_SIZE;
+    logv_info("[slab] arena %u/%u slabs, %llu KB live of %llu KB; internal fragmentation %llu%%, external %llu%%, %llu newlib fallbacks",
+              stats.arena_pages, SLAB_ARENA_PAGES, stats.live_bytes / 1024, committed / 1024,
+              stats.rounded ? (stats.rounded - stats.requested) * 100 / stats.rounded : 0,
+              committed ? (committed - stats.live_bytes) * 100 / committed : 0,
+              stats.fallbacks);
+}
+
+#endif // SLAB_ALLOC
@@ -0,0 +1,59 @@
+/*
+ * reimpl/slab.h
+ *
+ * Size-class slab allocator for the game's malloc/free and operator
+ * new/delete, built in with -DSLAB_ALLOC=ON. Small blocks come from 64KB
+ * slabs in one arena, through per-thread caches; everything else, and
+ * everything once the arena is full, goes to newlib. Any pointer can be
+ * passed to slab_free()/slab_realloc(), whoever allocated it.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_SLAB_H
+#define SOLOADER_SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SLAB_ARENA_SIZE (32 * 1024 * 1024)
+#define SLAB_PAGE_SIZE (64 * 1024)
+#define SLAB_MAX_SIZE 2048
+#define SLAB_CLASSES 24
+
+void *slab_malloc(size_t size);
+void *slab_calloc(size_t count, size_t size);
+void *slab_realloc(void *ptr, size_t size);
+void *slab_memalign(size_t alignment, size_t size);
+void slab_free(void *ptr);
+
+/* operator new / new[]: never return NULL */
+void *slab_new(size_t size);
+
+typedef struct {
+    uint32_t size;       // object size of the class
+    uint32_t pages;      // slabs carved for it
+    uint64_t allocs;
+    uint64_t frees;
+} slab_class_stats;
+
+typedef struct {
+    slab_class_stats classes[SLAB_CLASSES];
+    uint32_t arena_pages;   // carved so far, of SLAB_ARENA_SIZE / SLAB_PAGE_SIZE
+    uint32_t arena_bytes;   // taken from newlib for the arena, 0 if it couldn't be
+    uint64_t fallbacks;     // small requests that went to newlib, arena full
+    uint64_t requested;     // bytes asked for by slab allocations, cumulative
+    uint64_t rounded;       // what they got after rounding up to the class
+    uint64_t live_bytes;    // objects currently allocated, in class sizes
+} slab_stats;
+
+void slab_get_stats(slab_stats *stats);
+
+/*
+ * Logs per-class usage and fragmentation: internal (lost to rounding up to
+ * the class size) and external (slab space not used by live objects).
+ */
+void slab_log_stats(void);
+
+#endif // SOLOADER_SLAB_H
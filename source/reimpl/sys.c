@@ -18,16 +18,84 @@
 #include <psp2/kernel/clib.h>
 #include <string.h>
 
+#include "utils/clock.h"
 #include "utils/utils.h"
 #include "utils/logger.h"
 
-int clock_gettime_soloader(__attribute__((unused)) int c, struct timespec *t) {
-    struct timeval now;
-    int rv = gettimeofday(&now, NULL);
-    if (rv)
-        return rv;
-    t->tv_sec = now.tv_sec;
-    t->tv_nsec = now.tv_usec * 1000;
+// Bionic clock ids; newlib numbers them differently.
+#define BIONIC_CLOCK_REALTIME           0
+#define BIONIC_CLOCK_MONOTONIC          1
+#define BIONIC_CLOCK_PROCESS_CPUTIME_ID 2
+#define BIONIC_CLOCK_THREAD_CPUTIME_ID  3
+#define BIONIC_CLOCK_MONOTONIC_RAW      4
+#define BIONIC_CLOCK_REALTIME_COARSE    5
+#define BIONIC_CLOCK_MONOTONIC_COARSE   6
+#define BIONIC_CLOCK_BOOTTIME           7
+
+// Returns the time of clock `c` in microseconds, or -1 if it isn't known.
+// The thread CPU-time clock is the calling thread's run time. The process
+// one counts wall time since the process started: the kernel has no cheap
+// per-process CPU time, and the games only use it to measure intervals.
+static int64_t clock_read_us(int c) {
+    switch (c) {
+        case BIONIC_CLOCK_REALTIME:
+        case BIONIC_CLOCK_REALTIME_COARSE:
+            return (int64_t) clock_realtime_us();
+        case BIONIC_CLOCK_MONOTONIC:
+        case BIONIC_CLOCK_MONOTONIC_RAW:
+        case BIONIC_CLOCK_MONOTONIC_COARSE:
+        case BIONIC_CLOCK_BOOTTIME:
+        case BIONIC_CLOCK_PROCESS_CPUTIME_ID:
+            return (int64_t) clock_monotonic_us();
+        case BIONIC_CLOCK_THREAD_CPUTIME_ID: {
+            SceKernelThreadInfo info;
+            info.size = sizeof(info);
+            if (sceKernelGetThreadInfo(sceKernelGetThreadId(), &info) < 0)
+                return -1;
+            uint64_t us;
+            memcpy(&us, &info.runClocks, sizeof(us));
+            return (int64_t) us;
+        }
+        default:
+            return -1;
+    }
+}
+
+int clock_gettime_soloader(int c, struct timespec *t) {
+    int64_t us = clock_read_us(c);
+    if (us < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!t) {
+        errno = EFAULT;
+        return -1;
+    }
+    t->tv_sec = us / 1000000;
+    t->tv_nsec = (us % 1000000) * 1000;
+    return 0;
+}
+
+int clock_getres_soloader(int c, struct timespec *res) {
+    if (clock_read_us(c) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (res) {
+        res->tv_sec = 0;
+        res->tv_nsec = CLOCK_RESOLUTION_NS;
+    }
+    return 0;
+}
+
+int gettimeofday_soloader(struct timeval *tv, void *tz) {
+    if (tv) {
+        uint64_t us = clock_realtime_us();
+        tv->tv_sec = us / 1000000;
+        tv->tv_usec = us % 1000000;
+    }
+    if (tz)
+        memset(tz, 0, 2 * sizeof(int)); // struct timezone: UTC, no DST
     return 0;
 }
 
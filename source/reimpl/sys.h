@@ -16,7 +16,14 @@
 
 #include <sys/time.h>
 
-int clock_gettime_soloader(__attribute__((unused)) int c, struct timespec *t);
+/*
+ * clock_gettime() and friends for bionic clock ids, on the loader's time base
+ * (see utils/clock.h): the monotonic clocks never jump, and all of them have a
+ * 1 µs resolution.
+ */
+int clock_gettime_soloader(int c, struct timespec *t);
+int clock_getres_soloader(int c, struct timespec *res);
+int gettimeofday_soloader(struct timeval *tv, void *tz);
 
 int nanosleep_soloader(const struct timespec *rqtp,
         __attribute__((unused)) struct timespec *rmtp);
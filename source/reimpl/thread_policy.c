@@ -0,0 +1,110 @@
+/*
+ * reimpl/thread_policy.c
+ *
+ * Thread placement rules and matching, see thread_policy.h. Nothing here
+ * depends on the Vita, so the matching can be tested on a PC.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/thread_policy.h"
+
+// The main (render) thread stays on core 0 with the default priority of
+// 160. Rules are tried in order. Threads can also be matched by symbol,
+// e.g. { THREAD_MATCH_ENTRY, "_ZN6Loader6threadEPv", ... }, for those the
+// game never names.
+thread_rule thread_policy_rules[] = {
+    // OpenSL ES buffer callbacks and the mixer: its own core, above the
+    // game threads, so audio doesn't crackle during loads
+    { THREAD_MATCH_NAME,    "*Audio*",  1, 96,  THREAD_STACK_DEFAULT },
+    { THREAD_MATCH_NAME,    "*Sound*",  1, 96,  THREAD_STACK_DEFAULT },
+    { THREAD_MATCH_NAME,    "OpenSL*",  1, 96,  THREAD_STACK_DEFAULT },
+
+    // Streaming and decompression: the spare core, below the game threads
+    { THREAD_MATCH_NAME,    "*Load*",   2, 170, THREAD_STACK_DEFAULT },
+    { THREAD_MATCH_NAME,    "*Stream*", 2, 170, THREAD_STACK_DEFAULT },
+};
+
+const int thread_policy_rule_count = sizeof(thread_policy_rules) / sizeof(thread_policy_rules[0]);
+
+static int glob_match(const char *pattern, const char *s) {
+    const char *star = NULL, *retry = NULL;
+
+    while (*s) {
+        if (*pattern == '*') {
+            star = ++pattern;
+            retry = s;
+        } else if (*pattern == '?' || *pattern == *s) {
+            pattern++;
+            s++;
+        } else if (star) {
+            pattern = star;
+            s = ++retry;
+        } else {
+            return 0;
+        }
+    }
+
+    while (*pattern == '*')
+        pattern++;
+    return *pattern == '\0';
+}
+
+void thread_policy_resolve(thread_rule *rules, int count, thread_symbol_lookup lookup) {
+    for (int i = 0; i < count; i++) {
+        thread_rule *r = &rules[i];
+        r->start = r->end = 0;
+        if (r->match == THREAD_MATCH_NAME)
+            continue;
+
+        uintptr_t addr;
+        size_t size;
+        if (lookup(r->pattern, &addr, &size)) {
+            r->start = addr;
+            // Entry points are compared exactly; creators by containment
+            r->end = addr + (size ? size : 1);
+        }
+    }
+}
+
+int thread_policy_priority(int policy, int sched_priority) {
+    switch (policy) {
+        case THREAD_SCHED_FIFO:
+        case THREAD_SCHED_RR:
+            if (sched_priority < 1 || sched_priority > 99)
+                return -1;
+            return THREAD_PRIORITY_NORMAL - (sched_priority * 64 + 98) / 99;
+        case THREAD_SCHED_OTHER:
+        case THREAD_SCHED_BATCH:
+        case THREAD_SCHED_IDLE:
+            if (sched_priority != 0)
+                return -1;
+            return policy == THREAD_SCHED_IDLE ? 191 : THREAD_PRIORITY_NORMAL;
+        default:
+            return -1;
+    }
+}
+
+const thread_rule *thread_policy_match(const thread_rule *rules, int count,
+                                       const char *name, uintptr_t entry, uintptr_t creator) {
+    for (int i = 0; i < count; i++) {
+        const thread_rule *r = &rules[i];
+        switch (r->match) {
+            case THREAD_MATCH_NAME:
+                if (name && glob_match(r->pattern, name))
+                    return r;
+                break;
+            case THREAD_MATCH_ENTRY:
+                // Thumb entry points have the low bit set
+                if (r->start && (entry & ~(uintptr_t) 1) == (r->start & ~(uintptr_t) 1))
+                    return r;
+                break;
+            case THREAD_MATCH_CREATOR:
+                if (r->start && creator >= r->start && creator < r->end)
+                    return r;
+                break;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,80 @@
+/*
+ * reimpl/thread_policy.h
+ *
+ * Placement policy for the threads the game creates: a table of rules,
+ * matched on the thread name, entry point or the function that created the
+ * thread, assigns a core, a priority and a stack size. pthr.c applies the
+ * result when the thread starts and again when it gets renamed.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_THREAD_POLICY_H
+#define SOLOADER_THREAD_POLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+    THREAD_MATCH_NAME,    // pattern: glob on the thread name, '*' and '?'
+    THREAD_MATCH_ENTRY,   // pattern: symbol of the start routine
+    THREAD_MATCH_CREATOR, // pattern: symbol of the function calling pthread_create
+};
+
+#define THREAD_CPU_ANY -1
+#define THREAD_PRIORITY_DEFAULT 0
+#define THREAD_STACK_DEFAULT 0
+
+// The Vita priority game threads start with
+#define THREAD_PRIORITY_NORMAL 160
+
+// Scheduling policies, Linux ABI values as passed by the game
+#define THREAD_SCHED_OTHER 0
+#define THREAD_SCHED_FIFO  1
+#define THREAD_SCHED_RR    2
+#define THREAD_SCHED_BATCH 3
+#define THREAD_SCHED_IDLE  5
+
+typedef struct thread_rule {
+    int match;
+    const char *pattern;
+    int cpu;           // 0-2, or THREAD_CPU_ANY
+    int priority;      // Vita priority, 64 (highest) - 191, or THREAD_PRIORITY_DEFAULT
+    size_t stack_size; // or THREAD_STACK_DEFAULT
+
+    // Address range of the symbol, filled in by thread_policy_resolve()
+    uintptr_t start;
+    uintptr_t end;
+} thread_rule;
+
+/* Looks up a symbol; returns 0 if it doesn't exist. */
+typedef int (*thread_symbol_lookup)(const char *symbol, uintptr_t *addr, size_t *size);
+
+/*
+ * Resolves the symbols of ENTRY and CREATOR rules in `rules`. Rules whose
+ * symbol is missing never match.
+ */
+void thread_policy_resolve(thread_rule *rules, int count, thread_symbol_lookup lookup);
+
+/*
+ * Returns the first rule of `rules` matching a thread, or NULL. `name` may
+ * be NULL (not named yet), `entry` and `creator` 0 (unknown).
+ */
+const thread_rule *thread_policy_match(const thread_rule *rules, int count,
+                                       const char *name, uintptr_t entry, uintptr_t creator);
+
+/*
+ * Translates the policy and sched_priority the game passes to
+ * pthread_setschedparam() to a Vita priority: realtime priorities 1-99 go
+ * to 159-96, above normal threads and up to the audio rules, SCHED_IDLE to
+ * the lowest, anything else to THREAD_PRIORITY_NORMAL. Returns -1 for what
+ * Linux would reject with EINVAL.
+ */
+int thread_policy_priority(int policy, int sched_priority);
+
+/* The rules used for the game, see thread_policy.c. */
+extern thread_rule thread_policy_rules[];
+extern const int thread_policy_rule_count;
+
+#endif // SOLOADER_THREAD_POLICY_H
@@ -0,0 +1,349 @@
+/*
+ * utils/allocprof.c
+ *
+ * Allocation profiler. See allocprof.h for the file format.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifdef ALLOC_PROFILER
+
+#include "utils/allocprof.h"
+#include "utils/logger.h"
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <psp2/io/fcntl.h>
+#include <psp2/kernel/processmgr.h>
+#include <psp2/kernel/threadmgr.h>
+
+#include <so_util/so_util.h>
+
+#ifdef SLAB_ALLOC
+#include "reimpl/slab.h"
+
+#define real_malloc slab_malloc
+#define real_calloc slab_calloc
+#define real_realloc slab_realloc
+#define real_memalign slab_memalign
+#define real_free slab_free
+#define real_new slab_new
+#define real_delete slab_free
+#else
+// operator new(unsigned int) / operator delete(void*). The array forms do
+// the same in the default runtime.
+void *_Znwj(size_t size);
+void _ZdlPv(void *ptr);
+
+#define real_malloc malloc
+#define real_calloc calloc
+#define real_realloc realloc
+#define real_memalign memalign
+#define real_free free
+#define real_new _Znwj
+#define real_delete _ZdlPv
+#endif
+
+#define ALLOCPROF_RING_SIZE 65536 // records, power of two
+#define ALLOCPROF_MARKS 16 // marks waiting for the writer, more are dropped
+#define ALLOCPROF_LABEL_MAX 64 // bytes, longer labels are cut
+#define ALLOCPROF_FLUSH_INTERVAL_US 50000
+#define ALLOCPROF_SNAPSHOT_INTERVAL 20 // flushes
+
+extern so_module so_mod;
+
+static SceKernelLwMutexWork allocprof_lock;
+static volatile int allocprof_ready = 0;
+static SceUID allocprof_fd = -1;
+static SceUID allocprof_wakeup;
+
+// Ring of pending records, guarded by allocprof_lock.
+static allocprofRecord allocprof_ring[ALLOCPROF_RING_SIZE];
+static uint32_t allocprof_head = 0;
+static uint32_t allocprof_count = 0;
+static uint32_t allocprof_dropped = 0;
+
+// Labels of the marks in the ring, whose records hold their index in `ptr`.
+// Guarded by allocprof_lock.
+static char allocprof_labels[ALLOCPROF_MARKS][ALLOCPROF_LABEL_MAX];
+static uint32_t allocprof_label_count = 0;
+
+// Only touched under allocprof_flush_lock.
+static SceKernelLwMutexWork allocprof_flush_lock;
+static allocprofRecord allocprof_out[ALLOCPROF_RING_SIZE];
+static char allocprof_out_labels[ALLOCPROF_MARKS][ALLOCPROF_LABEL_MAX];
+
+static inline uint32_t allocprof_now(void) {
+    return (uint32_t) (sceKernelGetProcessTimeWide() / 1000);
+}
+
+static inline uint32_t call_site(const void *ret) {
+    uintptr_t offset = (uintptr_t) ret - so_mod.text_base;
+    return offset < so_mod.text_size ? offset : 0;
+}
+
+// Called with allocprof_lock held. Returns whether the ring just got half full.
+static int push_locked(const allocprofRecord *r) {
+    if (allocprof_count < ALLOCPROF_RING_SIZE) {
+        allocprof_ring[allocprof_head] = *r;
+        allocprof_head = (allocprof_head + 1) & (ALLOCPROF_RING_SIZE - 1);
+        allocprof_count++;
+    } else {
+        allocprof_dropped++;
+    }
+    return allocprof_count == ALLOCPROF_RING_SIZE / 2;
+}
+
+static void record(int op, const void *ptr, uint32_t size, uint32_t site) {
+    if (!allocprof_ready)
+        return;
+
+    allocprofRecord r;
+    r.time = allocprof_now();
+    r.ptr = (uint32_t) (uintptr_t) ptr;
+    r.size = size;
+    r.siteOp = (site << 4) | op;
+
+    sceKernelLockLwMutex(&allocprof_lock, 1, NULL);
+    int half_full = push_locked(&r);
+    sceKernelUnlockLwMutex(&allocprof_lock, 1);
+
+    if (half_full)
+        sceKernelSignalSema(allocprof_wakeup, 1);
+}
+
+// Appends a record followed by `name` to `buf`, returns the bytes written.
+static size_t put_named(uint8_t *buf, int op, uint32_t time, uint32_t ptr, uint32_t size, const char *name) {
+    allocprofRecord r;
+    uint32_t len = strlen(name);
+    uint32_t padded = (len + sizeof(r) - 1) / sizeof(r) * sizeof(r);
+
+    r.time = time;
+    r.ptr = ptr;
+    r.size = size;
+    r.siteOp = (len << 4) | op;
+    memcpy(buf, &r, sizeof(r));
+    memcpy(buf + sizeof(r), name, len);
+    memset(buf + sizeof(r) + len, 0, padded - len);
+    return sizeof(r) + padded;
+}
+
+static size_t named_size(const char *name) {
+    return sizeof(allocprofRecord) + (strlen(name) + sizeof(allocprofRecord) - 1) / sizeof(allocprofRecord) * sizeof(allocprofRecord);
+}
+
+static void write_symbols(void) {
+    size_t total = 0;
+    for (int i = 0; i < so_mod.num_dynsym; i++) {
+        const Elf32_Sym *sym = &so_mod.dynsym[i];
+        if (sym->st_value && ELF32_ST_TYPE(sym->st_info) == STT_FUNC)
+            total += named_size(so_mod.dynstr + sym->st_name);
+    }
+
+    uint8_t *buf = malloc(total);
+    if (!buf) {
+        log_warn("[allocprof] no memory for the symbol table, call sites stay unnamed");
+        return;
+    }
+
+    size_t pos = 0;
+    for (int i = 0; i < so_mod.num_dynsym; i++) {
+        const Elf32_Sym *sym = &so_mod.dynsym[i];
+        if (sym->st_value && ELF32_ST_TYPE(sym->st_info) == STT_FUNC)
+            pos += put_named(buf + pos, ALLOCPROF_OP_SYMBOL, 0, sym->st_value & ~1, sym->st_size, so_mod.dynstr + sym->st_name);
+    }
+    sceIoWrite(allocprof_fd, buf, total);
+    free(buf);
+}
+
+// Called with allocprof_flush_lock held.
+static void flush_locked(void) {
+    sceKernelLockLwMutex(&allocprof_lock, 1, NULL);
+    uint32_t count = allocprof_count;
+    uint32_t start = (allocprof_head - count) & (ALLOCPROF_RING_SIZE - 1);
+    for (uint32_t i = 0; i < count; i++)
+        allocprof_out[i] = allocprof_ring[(start + i) & (ALLOCPROF_RING_SIZE - 1)];
+    allocprof_count = 0;
+    memcpy(allocprof_out_labels, allocprof_labels, allocprof_label_count * ALLOCPROF_LABEL_MAX);
+    allocprof_label_count = 0;
+
+    uint32_t dropped = allocprof_dropped;
+    allocprof_dropped = 0;
+    sceKernelUnlockLwMutex(&allocprof_lock, 1);
+
+    // Runs of records as they are, with the labels put in after the marks
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const allocprofRecord *r = &allocprof_out[i];
+        if ((r->siteOp & 0xF) != ALLOCPROF_OP_MARK)
+            continue;
+
+        if (i > run)
+            sceIoWrite(allocprof_fd, &allocprof_out[run], (i - run) * sizeof(allocprofRecord));
+        uint8_t buf[sizeof(allocprofRecord) + ALLOCPROF_LABEL_MAX];
+        size_t len = put_named(buf, ALLOCPROF_OP_MARK, r->time, 0, 0, allocprof_out_labels[r->ptr]);
+        sceIoWrite(allocprof_fd, buf, len);
+        run = i + 1;
+    }
+    if (count > run)
+        sceIoWrite(allocprof_fd, &allocprof_out[run], (count - run) * sizeof(allocprofRecord));
+
+    if (dropped > 0) {
+        allocprofRecord r = { allocprof_now(), 0, dropped, ALLOCPROF_OP_DROPPED };
+        sceIoWrite(allocprof_fd, &r, sizeof(r));
+        logv_warn("[allocprof] ring full, %u records dropped", dropped);
+    }
+}
+
+void allocprof_flush(void) {
+    if (!allocprof_ready)
+        return;
+
+    sceKernelLockLwMutex(&allocprof_flush_lock, 1, NULL);
+    flush_locked();
+    sceKernelUnlockLwMutex(&allocprof_flush_lock, 1);
+}
+
+static void snapshot(void) {
+    struct mallinfo mi = mallinfo();
+    allocprofRecord r[2] = { { allocprof_now(), mi.uordblks, mi.arena, ALLOCPROF_OP_SNAPSHOT } };
+    int n = 1;
+
+#ifdef SLAB_ALLOC
+    // newlib sees the slab arena as one block in use: count what the slabs
+    // hold instead, and the slabs on their own
+    slab_stats stats;
+    slab_get_stats(&stats);
+    if (mi.uordblks >= stats.arena_bytes)
+        r[0].ptr = mi.uordblks - stats.arena_bytes + (uint32_t) stats.live_bytes;
+    r[1] = (allocprofRecord) { r[0].time, (uint32_t) stats.live_bytes, stats.arena_pages * SLAB_PAGE_SIZE,
+                               ALLOCPROF_OP_SLAB };
+    n = 2;
+#endif
+
+    sceKernelLockLwMutex(&allocprof_flush_lock, 1, NULL);
+    flush_locked();
+    sceIoWrite(allocprof_fd, r, n * sizeof(allocprofRecord));
+    sceKernelUnlockLwMutex(&allocprof_flush_lock, 1);
+}
+
+static int allocprof_writer(SceSize args, void *argp) {
+    for (int n = 1;; n++) {
+        SceUInt timeout = ALLOCPROF_FLUSH_INTERVAL_US;
+        sceKernelWaitSema(allocprof_wakeup, 1, &timeout);
+        if (n % ALLOCPROF_SNAPSHOT_INTERVAL == 0)
+            snapshot();
+        else
+            allocprof_flush();
+    }
+    return 0;
+}
+
+void allocprof_init(void) {
+    if (allocprof_ready)
+        return;
+
+    allocprof_fd = sceIoOpen(ALLOCPROF_PATH, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+    if (allocprof_fd < 0) {
+        logv_error("[allocprof] can't create %s: 0x%x", ALLOCPROF_PATH, allocprof_fd);
+        return;
+    }
+
+    allocprofHeader header = { ALLOCPROF_MAGIC, ALLOCPROF_VERSION, sizeof(allocprofRecord), 1000000, 0 };
+    sceIoWrite(allocprof_fd, &header, sizeof(header));
+    write_symbols();
+
+    sceKernelCreateLwMutex(&allocprof_lock, "allocprof_lock", 0, 0, NULL);
+    sceKernelCreateLwMutex(&allocprof_flush_lock, "allocprof_flush_lock", 0, 0, NULL);
+    allocprof_wakeup = sceKernelCreateSema("allocprof wakeup", 0, 0, 1, NULL);
+
+    allocprof_ready = 1;
+
+    SceUID thid = sceKernelCreateThread("allocprof writer", &allocprof_writer, 0x10000100, 0x4000, 0, 0, NULL);
+    sceKernelStartThread(thid, 0, NULL);
+
+    logv_info("[allocprof] recording to %s", ALLOCPROF_PATH);
+}
+
+void allocprof_mark(const char *label) {
+    if (!allocprof_ready)
+        return;
+
+    // Queued with the other records, so that everything recorded before
+    // belongs to the previous phase; the writer thread puts the label in.
+    allocprofRecord r = { allocprof_now(), 0, 0, ALLOCPROF_OP_MARK };
+    int queued = 0;
+
+    sceKernelLockLwMutex(&allocprof_lock, 1, NULL);
+    if (allocprof_label_count < ALLOCPROF_MARKS) {
+        r.ptr = allocprof_label_count;
+        strlcpy(allocprof_labels[allocprof_label_count++], label, ALLOCPROF_LABEL_MAX);
+        push_locked(&r);
+        queued = 1;
+    }
+    sceKernelUnlockLwMutex(&allocprof_lock, 1);
+
+    if (!queued) {
+        logv_warn("[allocprof] too many marks waiting, %s dropped", label);
+        return;
+    }
+    sceKernelSignalSema(allocprof_wakeup, 1);
+    logv_info("[allocprof] mark: %s", label);
+}
+
+void *allocprof_malloc(size_t size) {
+    void *p = real_malloc(size);
+    if (p)
+        record(ALLOCPROF_OP_ALLOC, p, size, call_site(__builtin_return_address(0)));
+    return p;
+}
+
+void *allocprof_calloc(size_t count, size_t size) {
+    void *p = real_calloc(count, size);
+    if (p)
+        record(ALLOCPROF_OP_ALLOC, p, count * size, call_site(__builtin_return_address(0)));
+    return p;
+}
+
+void *allocprof_realloc(void *ptr, size_t size) {
+    // The old block is recorded as freed first: once realloc() has moved
+    // it, another thread may get the same address. If realloc() fails the
+    // block shows as freed, but then we're out of memory anyway.
+    uint32_t site = call_site(__builtin_return_address(0));
+    if (ptr)
+        record(ALLOCPROF_OP_FREE, ptr, 0, site);
+    void *p = real_realloc(ptr, size);
+    if (p)
+        record(ALLOCPROF_OP_ALLOC, p, size, site);
+    return p;
+}
+
+void *allocprof_memalign(size_t alignment, size_t size) {
+    void *p = real_memalign(alignment, size);
+    if (p)
+        record(ALLOCPROF_OP_ALLOC, p, size, call_site(__builtin_return_address(0)));
+    return p;
+}
+
+void allocprof_free(void *ptr) {
+    if (ptr)
+        record(ALLOCPROF_OP_FREE, ptr, 0, call_site(__builtin_return_address(0)));
+    real_free(ptr);
+}
+
+void *allocprof_new(size_t size) {
+    void *p = real_new(size);
+    record(ALLOCPROF_OP_NEW, p, size, call_site(__builtin_return_address(0)));
+    return p;
+}
+
+void allocprof_delete(void *ptr) {
+    if (ptr)
+        record(ALLOCPROF_OP_DELETE, ptr, 0, call_site(__builtin_return_address(0)));
+    real_delete(ptr);
+}
+
+#endif // ALLOC_PROFILER
@@ -0,0 +1,108 @@
+/*
+ * utils/allocprof.h
+ *
+ * Allocation profiler, built in with -DALLOC_PROFILER=ON. The game's
+ * malloc/free and operator new/delete imports go through allocprof_*(),
+ * which record each call into a ring buffer; a background thread appends
+ * them to ALLOCPROF_PATH along with a newlib heap snapshot every second.
+ * extras/scripts/allocprof_analyze.py reads the file back.
+ *
+ * File layout (little-endian):
+ *   allocprofHeader
+ *   allocprofRecord stream. ALLOCPROF_OP_SYMBOL and ALLOCPROF_OP_MARK
+ *   records are followed by `siteOp >> 4` bytes of name, padded with zeroes
+ *   to a multiple of sizeof(allocprofRecord). The function symbols of the
+ *   .so come first, so call sites can be mapped back to them.
+ *
+ * Call sites are return addresses relative to the .so load address, or 0
+ * for calls from elsewhere. realloc() is recorded as a free of the old
+ * block followed by an allocation of the new one.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_ALLOCPROF_H
+#define SOLOADER_ALLOCPROF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALLOCPROF_PATH DATA_PATH "allocprof.bin"
+#define ALLOCPROF_MAGIC 0x46505041 // "APPF"
+#define ALLOCPROF_VERSION 1
+
+enum {
+    ALLOCPROF_OP_ALLOC = 1,    // ptr, size
+    ALLOCPROF_OP_FREE = 2,     // ptr
+    ALLOCPROF_OP_NEW = 3,      // ptr, size
+    ALLOCPROF_OP_DELETE = 4,   // ptr
+    ALLOCPROF_OP_MARK = 5,     // followed by the label
+    ALLOCPROF_OP_SNAPSHOT = 6, // ptr: newlib heap bytes in use (with
+                               // SLAB_ALLOC, the arena counts as what the
+                               // slabs hold), size: newlib heap bytes claimed
+    ALLOCPROF_OP_DROPPED = 7,  // size: records lost because the ring was full
+    ALLOCPROF_OP_SYMBOL = 8,   // ptr: .so offset, size: symbol size,
+                               // followed by the name
+    ALLOCPROF_OP_SLAB = 9,     // SLAB_ALLOC only, after each snapshot:
+                               // ptr: bytes in live slab objects,
+                               // size: slab bytes carved from the arena
+};
+
+typedef struct allocprofHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t timeUnit; // ns per time unit
+    uint32_t reserved;
+} allocprofHeader;
+
+typedef struct allocprofRecord {
+    uint32_t time;   // process time, ms
+    uint32_t ptr;
+    uint32_t size;
+    uint32_t siteOp; // call site << 4 | ALLOCPROF_OP_*
+} allocprofRecord;
+
+#ifdef ALLOC_PROFILER
+
+/*
+ * Starts the writer thread; call once the .so is loaded and relocated.
+ * Calls made before are not recorded.
+ */
+void allocprof_init(void);
+
+/* Writes out everything recorded so far. */
+void allocprof_flush(void);
+
+/*
+ * Marks the beginning of a phase, e.g. a stage load, in the profile. Only
+ * queues the mark; the writer thread writes it out.
+ */
+void allocprof_mark(const char *label);
+
+void *allocprof_malloc(size_t size);
+void *allocprof_calloc(size_t count, size_t size);
+void *allocprof_realloc(void *ptr, size_t size);
+void *allocprof_memalign(size_t alignment, size_t size);
+void allocprof_free(void *ptr);
+void *allocprof_new(size_t size);
+void allocprof_delete(void *ptr);
+
+#else
+
+static inline void allocprof_init(void) {}
+static inline void allocprof_flush(void) {}
+static inline void allocprof_mark(const char *label) {}
+
+#endif
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // SOLOADER_ALLOCPROF_H
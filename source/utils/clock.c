@@ -0,0 +1,56 @@
+/*
+ * utils/clock.c
+ *
+ * The loader's time base, see clock.h.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "utils/clock.h"
+
+#include <stdatomic.h>
+#include <sys/time.h>
+
+// Wall-clock minus monotonic time, and the monotonic time it was taken at
+// (0: never). Racing resyncs are harmless, they measure the same thing.
+static _Atomic int64_t clock_realtime_offset = 0;
+static _Atomic uint64_t clock_realtime_synced = 0;
+
+#ifdef __vita__
+
+#include <psp2/kernel/processmgr.h>
+
+uint64_t clock_monotonic_us(void) {
+    return sceKernelGetProcessTimeWide();
+}
+
+#else
+
+#include <time.h>
+
+uint64_t clock_monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
+
+uint64_t clock_realtime_us(void) {
+    uint64_t now = clock_monotonic_us();
+    uint64_t synced = atomic_load_explicit(&clock_realtime_synced, memory_order_acquire);
+
+    if (synced == 0 || now - synced >= CLOCK_REALTIME_RESYNC_US) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        now = clock_monotonic_us();
+
+        int64_t offset = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec - (int64_t) now;
+        atomic_store_explicit(&clock_realtime_offset, offset, memory_order_relaxed);
+        atomic_store_explicit(&clock_realtime_synced, now ? now : 1, memory_order_release);
+        return now + offset;
+    }
+
+    return now + atomic_load_explicit(&clock_realtime_offset, memory_order_relaxed);
+}
@@ -0,0 +1,45 @@
+/*
+ * utils/clock.h
+ *
+ * The loader's time base. Monotonic time is the process tick counter
+ * (1 MHz), so it never jumps with wall-clock changes; clock_gettime(),
+ * ALooper, PseudoEpoll and the pthread timed waits all use it. Wall-clock
+ * time is monotonic time plus an offset that is re-read from the RTC at
+ * most once every CLOCK_REALTIME_RESYNC_US, so most reads cost no more
+ * than a monotonic one.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_CLOCK_H
+#define SOLOADER_CLOCK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLOCK_RESOLUTION_NS 1000
+#define CLOCK_REALTIME_RESYNC_US 1000000
+
+/* Time since the process started. */
+uint64_t clock_monotonic_us(void);
+
+static inline uint64_t clock_monotonic_ns(void) {
+    return clock_monotonic_us() * 1000;
+}
+
+static inline uint64_t clock_monotonic_ms(void) {
+    return clock_monotonic_us() / 1000;
+}
+
+/* Wall-clock time since the epoch. */
+uint64_t clock_realtime_us(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // SOLOADER_CLOCK_H
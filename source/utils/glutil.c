@@ -22,6 +22,7 @@
 #include <malloc.h>
 #include <string.h>
 #include <vitasdk.h>
+#include <AFakeNative/ALooper.h>
 
 #define GLSL_PATH DATA_PATH
 #define GXP_PATH "app0:shaders"
@@ -68,6 +69,13 @@ void gl_init() {
 
 void gl_swap() {
     vglSwapBuffers(GL_FALSE);
+    ALooper_onFrameSwap();
+}
+
+EGLBoolean eglSwapBuffers_soloader(EGLDisplay dpy, EGLSurface surface) {
+    EGLBoolean ret = eglSwapBuffers(dpy, surface);
+    ALooper_onFrameSwap();
+    return ret;
 }
 
 GLboolean skip_next_compile = GL_FALSE;
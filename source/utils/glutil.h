@@ -33,6 +33,7 @@ EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLC
 EGLBoolean eglDestroyContext (EGLDisplay dpy, EGLContext ctx);
 EGLBoolean eglDestroySurface (EGLDisplay dpy, EGLSurface surface);
 EGLBoolean eglTerminate(EGLDisplay dpy);
+EGLBoolean eglSwapBuffers_soloader(EGLDisplay dpy, EGLSurface surface);
 
 #define EGL_CONFIG_ID                     0x3028
 #define EGL_HEIGHT                        0x3056
@@ -12,7 +12,9 @@
 #include "utils/init.h"
 
 #include "utils/dialog.h"
+#include "utils/allocprof.h"
 #include "utils/glutil.h"
+#include "utils/iotrace.h"
 #include "utils/logger.h"
 #include "utils/utils.h"
 #include "utils/settings.h"
@@ -43,9 +45,21 @@ void soloader_init_all() {
     scePowerSetGpuClockFrequency(222);
     scePowerSetGpuXbarClockFrequency(166);
 
+    settings_load();
+    log_info("settings_load() passed.");
+
+    iotrace_init();
+
 #ifdef USE_SCELIBC_IO
-    fios_init();
-    log_info("fios init passed.");
+    fiosCacheConfig fiosCache = {
+        (size_t) setting_fiosCacheBlockKB * 1024,
+        setting_fiosCacheBlocks,
+        setting_fiosCachePaths
+    };
+    if (fios_init(&fiosCache) < 0)
+        log_error("fios init failed.");
+    else
+        log_info("fios init passed.");
 #endif
 
     if (!module_loaded("kubridge"))
@@ -61,9 +75,6 @@ void soloader_init_all() {
     if (so_file_load(&so_mod, SO_PATH, LOAD_ADDRESS) < 0)
         fatal_error("Error: could not load %s.", SO_PATH);
 
-    settings_load();
-    log_info("settings_load() passed.");
-
     so_relocate(&so_mod);
     log_info("so_relocate() passed.");
 
@@ -76,6 +87,8 @@ void soloader_init_all() {
     so_flush_caches(&so_mod);
     log_info("so_flush_caches() passed.");
 
+    allocprof_init();
+
     so_initialize(&so_mod);
     log_info("so_initialize() passed.");
 
@@ -0,0 +1,217 @@
+/*
+ * utils/iotrace.c
+ *
+ * Binary I/O trace recorder. See iotrace.h for the file format.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifdef IO_TRACE
+
+#include "utils/iotrace.h"
+#include "utils/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <psp2/io/fcntl.h>
+#include <psp2/kernel/processmgr.h>
+#include <psp2/kernel/threadmgr.h>
+
+#define IOTRACE_RING_SIZE 8192 // records, power of two
+#define IOTRACE_MAX_NAMES 4096
+#define IOTRACE_NAME_BUCKETS 8192 // power of two
+#define IOTRACE_FLUSH_INTERVAL_US 50000
+
+static SceKernelLwMutexWork iotrace_lock;
+static volatile int iotrace_ready = 0;
+static SceUID iotrace_fd = -1;
+static SceUID iotrace_wakeup;
+
+// Ring of pending records, guarded by iotrace_lock.
+static iotraceRecord iotrace_ring[IOTRACE_RING_SIZE];
+static uint32_t iotrace_head = 0;
+static uint32_t iotrace_count = 0;
+static uint32_t iotrace_dropped = 0;
+
+// Interned names, guarded by iotrace_lock. Id n is iotrace_names[n - 1].
+static char *iotrace_names[IOTRACE_MAX_NAMES];
+static uint32_t iotrace_name_hashes[IOTRACE_MAX_NAMES];
+static uint16_t iotrace_buckets[IOTRACE_NAME_BUCKETS]; // id, 0: empty
+static uint32_t iotrace_name_count = 0;
+static uint32_t iotrace_names_written = 0;
+
+// Only touched by the writer (and iotrace_flush, under iotrace_flush_lock).
+static SceKernelLwMutexWork iotrace_flush_lock;
+static iotraceRecord iotrace_out[IOTRACE_RING_SIZE];
+
+static uint32_t name_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint64_t iotrace_now(void) {
+    return sceKernelGetProcessTimeWide();
+}
+
+static void write_name(uint32_t id, const char *name) {
+    iotraceRecord r;
+    uint32_t len = strlen(name);
+    uint32_t padded = (len + sizeof(r) - 1) / sizeof(r) * sizeof(r);
+    char *buf = calloc(1, padded + sizeof(r));
+
+    memset(&r, 0, sizeof(r));
+    r.pathOp = (id << 8) | IOTRACE_OP_NAME;
+    r.size = len;
+    memcpy(buf, &r, sizeof(r));
+    memcpy(buf + sizeof(r), name, len);
+    sceIoWrite(iotrace_fd, buf, sizeof(r) + padded);
+    free(buf);
+}
+
+void iotrace_flush(void) {
+    if (!iotrace_ready)
+        return;
+
+    sceKernelLockLwMutex(&iotrace_flush_lock, 1, NULL);
+
+    sceKernelLockLwMutex(&iotrace_lock, 1, NULL);
+    uint32_t count = iotrace_count;
+    uint32_t start = (iotrace_head - count) & (IOTRACE_RING_SIZE - 1);
+    for (uint32_t i = 0; i < count; i++)
+        iotrace_out[i] = iotrace_ring[(start + i) & (IOTRACE_RING_SIZE - 1)];
+    iotrace_count = 0;
+
+    uint32_t dropped = iotrace_dropped;
+    iotrace_dropped = 0;
+
+    // Names never change once interned, so they can be written unlocked.
+    uint32_t names_from = iotrace_names_written;
+    uint32_t names_to = iotrace_name_count;
+    iotrace_names_written = names_to;
+    sceKernelUnlockLwMutex(&iotrace_lock, 1);
+
+    for (uint32_t id = names_from + 1; id <= names_to; id++)
+        write_name(id, iotrace_names[id - 1]);
+
+    if (count > 0)
+        sceIoWrite(iotrace_fd, iotrace_out, count * sizeof(iotraceRecord));
+
+    if (dropped > 0) {
+        iotraceRecord r;
+        memset(&r, 0, sizeof(r));
+        r.time = iotrace_now();
+        r.pathOp = IOTRACE_OP_DROPPED;
+        r.size = dropped;
+        sceIoWrite(iotrace_fd, &r, sizeof(r));
+        logv_warn("[iotrace] ring full, %u records dropped", dropped);
+    }
+
+    sceKernelUnlockLwMutex(&iotrace_flush_lock, 1);
+}
+
+static int iotrace_writer(SceSize args, void *argp) {
+    for (;;) {
+        SceUInt timeout = IOTRACE_FLUSH_INTERVAL_US;
+        sceKernelWaitSema(iotrace_wakeup, 1, &timeout);
+        iotrace_flush();
+    }
+    return 0;
+}
+
+void iotrace_init(void) {
+    if (iotrace_ready)
+        return;
+
+    iotrace_fd = sceIoOpen(IOTRACE_PATH, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+    if (iotrace_fd < 0) {
+        logv_error("[iotrace] can't create %s: 0x%x", IOTRACE_PATH, iotrace_fd);
+        return;
+    }
+
+    iotraceHeader header = { IOTRACE_MAGIC, IOTRACE_VERSION, sizeof(iotraceRecord), 1000, 0 };
+    sceIoWrite(iotrace_fd, &header, sizeof(header));
+
+    sceKernelCreateLwMutex(&iotrace_lock, "iotrace_lock", 0, 0, NULL);
+    sceKernelCreateLwMutex(&iotrace_flush_lock, "iotrace_flush_lock", 0, 0, NULL);
+    iotrace_wakeup = sceKernelCreateSema("iotrace wakeup", 0, 0, 1, NULL);
+
+    iotrace_ready = 1;
+
+    SceUID thid = sceKernelCreateThread("iotrace writer", &iotrace_writer, 0x10000100, 0x4000, 0, 0, NULL);
+    sceKernelStartThread(thid, 0, NULL);
+
+    logv_info("[iotrace] recording to %s", IOTRACE_PATH);
+}
+
+uint32_t iotrace_path_id(const char *path) {
+    if (!iotrace_ready || !path)
+        return 0;
+
+    uint32_t hash = name_hash(path);
+    uint32_t id = 0;
+
+    sceKernelLockLwMutex(&iotrace_lock, 1, NULL);
+    for (uint32_t b = hash;; b++) {
+        uint32_t candidate = iotrace_buckets[b & (IOTRACE_NAME_BUCKETS - 1)];
+        if (candidate == 0) {
+            if (iotrace_name_count < IOTRACE_MAX_NAMES) {
+                char *copy = strdup(path);
+                if (copy) {
+                    iotrace_names[iotrace_name_count] = copy;
+                    iotrace_name_hashes[iotrace_name_count] = hash;
+                    id = ++iotrace_name_count;
+                    iotrace_buckets[b & (IOTRACE_NAME_BUCKETS - 1)] = id;
+                }
+            }
+            break;
+        }
+        if (iotrace_name_hashes[candidate - 1] == hash && strcmp(iotrace_names[candidate - 1], path) == 0) {
+            id = candidate;
+            break;
+        }
+    }
+    sceKernelUnlockLwMutex(&iotrace_lock, 1);
+
+    return id;
+}
+
+void iotrace_record(int op, uint32_t pathId, uint64_t offset, uint32_t size, uint64_t start) {
+    if (!iotrace_ready)
+        return;
+
+    iotraceRecord r;
+    r.time = start;
+    r.offset = offset;
+    r.thread = sceKernelGetThreadId();
+    r.pathOp = (pathId << 8) | (op & 0xFF);
+    r.size = size;
+    r.latency = (uint32_t) (iotrace_now() - start);
+
+    sceKernelLockLwMutex(&iotrace_lock, 1, NULL);
+    if (iotrace_count < IOTRACE_RING_SIZE) {
+        iotrace_ring[iotrace_head] = r;
+        iotrace_head = (iotrace_head + 1) & (IOTRACE_RING_SIZE - 1);
+        iotrace_count++;
+    } else {
+        iotrace_dropped++;
+    }
+    int half_full = iotrace_count == IOTRACE_RING_SIZE / 2;
+    sceKernelUnlockLwMutex(&iotrace_lock, 1);
+
+    if (half_full)
+        sceKernelSignalSema(iotrace_wakeup, 1);
+}
+
+void iotrace_mark(const char *label) {
+    uint64_t now = iotrace_now();
+    iotrace_record(IOTRACE_OP_MARK, iotrace_path_id(label), 0, 0, now);
+    logv_info("[iotrace] mark: %s", label);
+}
+
+#endif // IO_TRACE
@@ -0,0 +1,93 @@
+/*
+ * utils/iotrace.h
+ *
+ * Binary I/O trace recorder, built in with -DIO_TRACE=ON. Records go into a
+ * ring buffer and a background thread appends them to IOTRACE_PATH, which
+ * extras/scripts/iotrace_analyze.py reads back.
+ *
+ * File layout (little-endian):
+ *   iotraceHeader
+ *   iotraceRecord stream. IOTRACE_OP_NAME records define the name of a path
+ *   id and are followed by `size` bytes of name, padded with zeroes to a
+ *   multiple of sizeof(iotraceRecord). A name is always written before the
+ *   first record that uses its id.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_IOTRACE_H
+#define SOLOADER_IOTRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOTRACE_PATH DATA_PATH "iotrace.bin"
+#define IOTRACE_MAGIC 0x52544F49 // "IOTR"
+#define IOTRACE_VERSION 1
+
+enum {
+    IOTRACE_OP_NAME = 0,
+    IOTRACE_OP_OPEN = 1,    // size: 1 if the open succeeded
+    IOTRACE_OP_CLOSE = 2,
+    IOTRACE_OP_READ = 3,    // offset, size: bytes read
+    IOTRACE_OP_SEEK = 4,    // offset: resulting position
+    IOTRACE_OP_MARK = 5,    // path id: the label
+    IOTRACE_OP_DROPPED = 6, // size: records lost because the ring was full
+};
+
+typedef struct iotraceHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t timeUnit; // ns per time unit
+    uint32_t reserved;
+} iotraceHeader;
+
+typedef struct iotraceRecord {
+    uint64_t time;     // process time at the start of the call, us
+    uint64_t offset;
+    uint32_t thread;
+    uint32_t pathOp;   // path id << 8 | IOTRACE_OP_*
+    uint32_t size;
+    uint32_t latency;  // us
+} iotraceRecord;
+
+#ifdef IO_TRACE
+
+/* Starts the writer thread. Records made before are dropped. */
+void iotrace_init(void);
+
+/* Writes out everything recorded so far. */
+void iotrace_flush(void);
+
+/* Interns `path`. Id 0 means unknown. */
+uint32_t iotrace_path_id(const char *path);
+
+uint64_t iotrace_now(void);
+
+/* Records an operation that started at `start` (from iotrace_now()). */
+void iotrace_record(int op, uint32_t pathId, uint64_t offset, uint32_t size, uint64_t start);
+
+/* Marks the beginning of a phase, e.g. a stage load, in the trace. */
+void iotrace_mark(const char *label);
+
+#else
+
+static inline void iotrace_init(void) {}
+static inline void iotrace_flush(void) {}
+static inline uint32_t iotrace_path_id(const char *path) { return 0; }
+static inline uint64_t iotrace_now(void) { return 0; }
+static inline void iotrace_record(int op, uint32_t pathId, uint64_t offset, uint32_t size, uint64_t start) {}
+static inline void iotrace_mark(const char *label) {}
+
+#endif
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // SOLOADER_IOTRACE_H
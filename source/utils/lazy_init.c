@@ -0,0 +1,39 @@
+/*
+ * utils/lazy_init.c
+ *
+ * Lazily created locks, see lazy_init.h.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "utils/lazy_init.h"
+
+bool lazy_init_claim(lazy_init_state *state) {
+    if (atomic_load_explicit(state, memory_order_acquire) == 2)
+        return false;
+
+    int expected = 0;
+    if (atomic_compare_exchange_strong(state, &expected, 1))
+        return true;
+
+    while (atomic_load_explicit(state, memory_order_acquire) != 2)
+        sceKernelDelayThread(100);
+    return false;
+}
+
+void lazy_init_done(lazy_init_state *state) {
+    atomic_store_explicit(state, 2, memory_order_release);
+}
+
+void lazy_lwmutex_lock(lazy_lwmutex *m) {
+    if (lazy_init_claim(&m->state)) {
+        sceKernelCreateLwMutex(&m->work, m->name, 0, 0, NULL);
+        lazy_init_done(&m->state);
+    }
+    sceKernelLockLwMutex(&m->work, 1, NULL);
+}
+
+void lazy_lwmutex_unlock(lazy_lwmutex *m) {
+    sceKernelUnlockLwMutex(&m->work, 1);
+}
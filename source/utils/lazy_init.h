@@ -0,0 +1,42 @@
+/*
+ * utils/lazy_init.h
+ *
+ * One-time initialization of the loader's global locks, which are first
+ * needed from whichever game thread gets there first: the first caller runs
+ * the initialization while the others wait for it to finish.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_LAZY_INIT_H
+#define SOLOADER_LAZY_INIT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <psp2/kernel/threadmgr.h>
+
+typedef atomic_int lazy_init_state; // 0: none, 1: initializing, 2: ready
+
+/*
+ * Returns true for the one caller that must initialize and then call
+ * lazy_init_done(). Everyone else gets false once that has happened.
+ */
+bool lazy_init_claim(lazy_init_state *state);
+
+void lazy_init_done(lazy_init_state *state);
+
+/* An LwMutex created on its first lock. */
+typedef struct lazy_lwmutex {
+    SceKernelLwMutexWork work;
+    lazy_init_state state;
+    const char *name;
+} lazy_lwmutex;
+
+#define LAZY_LWMUTEX_INITIALIZER(lock_name) { .state = 0, .name = (lock_name) }
+
+void lazy_lwmutex_lock(lazy_lwmutex *m);
+
+void lazy_lwmutex_unlock(lazy_lwmutex *m);
+
+#endif // SOLOADER_LAZY_INIT_H
@@ -11,6 +11,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "settings.h"
 
@@ -18,24 +19,48 @@
 
 int  setting_sampleSetting;
 bool setting_sampleSetting2;
+bool setting_framePacing;
+int  setting_fiosCacheBlockKB;
+int  setting_fiosCacheBlocks;
+char setting_fiosCachePaths[256];
 
 void settings_reset() {
     setting_sampleSetting  = 1;
     setting_sampleSetting2 = true;
+    setting_framePacing    = false;
+    setting_fiosCacheBlockKB = 128;
+    setting_fiosCacheBlocks  = 64;
+    strcpy(setting_fiosCachePaths, DATA_PATH);
 }
 
 void settings_load() {
     settings_reset();
 
-    char buffer[30];
+    // "<name> <value>" per line. The value is everything after the first
+    // space and may be empty.
+    char line[30 + 256 + 2];
     int value;
 
     FILE *config = fopen(CONFIG_FILE_PATH, "r");
 
     if (config) {
-        while (EOF != fscanf(config, "%[^ ] %d\n", buffer, &value)) {
+        while (fgets(line, sizeof(line), config)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            char *buffer = line;
+            char *string = strchr(line, ' ');
+            if (string) *string++ = '\0';
+            else string = line + strlen(line);
+
+            value = atoi(string);
             if 		(strcmp("setting_sampleSetting", buffer) == 0) 	setting_sampleSetting  = (int)value;
             else if (strcmp("setting_sampleSetting2", buffer) == 0) setting_sampleSetting2 = (bool)value;
+            else if (strcmp("setting_framePacing", buffer) == 0) 	setting_framePacing    = (bool)value;
+            else if (strcmp("setting_fiosCacheBlockKB", buffer) == 0) setting_fiosCacheBlockKB = (int)value;
+            else if (strcmp("setting_fiosCacheBlocks", buffer) == 0) setting_fiosCacheBlocks  = (int)value;
+            else if (strcmp("setting_fiosCachePaths", buffer) == 0) {
+                strncpy(setting_fiosCachePaths, string, sizeof(setting_fiosCachePaths) - 1);
+                setting_fiosCachePaths[sizeof(setting_fiosCachePaths) - 1] = '\0';
+            }
         }
         fclose(config);
     }
@@ -47,6 +72,10 @@ void settings_save() {
     if (config) {
         fprintf(config, "%s %d\n", "setting_sampleSetting", (int)(setting_sampleSetting));
         fprintf(config, "%s %d\n", "setting_sampleSetting2", (int)(setting_sampleSetting2));
+        fprintf(config, "%s %d\n", "setting_framePacing", (int)(setting_framePacing));
+        fprintf(config, "%s %d\n", "setting_fiosCacheBlockKB", setting_fiosCacheBlockKB);
+        fprintf(config, "%s %d\n", "setting_fiosCacheBlocks", setting_fiosCacheBlocks);
+        fprintf(config, "%s %s\n", "setting_fiosCachePaths", setting_fiosCachePaths);
         fclose(config);
     }
 }
@@ -19,6 +19,13 @@ extern "C" {
 
 extern int  setting_sampleSetting;
 extern bool setting_sampleSetting2;
+extern bool setting_framePacing;
+
+// FIOS2 RAM cache geometry; setting_fiosCachePaths is a ';'-separated list
+// of path prefixes. 0 blocks disables the cache.
+extern int  setting_fiosCacheBlockKB;
+extern int  setting_fiosCacheBlocks;
+extern char setting_fiosCachePaths[256];
 
 void settings_load();
 void settings_save();
@@ -12,6 +12,8 @@
 
 #include "utils/utils.h"
 #include "logger.h"
+#include "reimpl/path_cache.h"
+#include "utils/clock.h"
 
 #include <psp2/io/stat.h>
 #include <psp2/ctrl.h>
@@ -25,7 +27,6 @@
 #include <string.h>
 #include <sys/dirent.h>
 #include <sys/stat.h>
-#include <sys/time.h>
 
 #include <falso_jni/FalsoJNI.h>
 #include <sha1/sha1.h>
@@ -67,9 +68,7 @@ bool string_ends_with(const char * str, const char * suffix) {
 }
 
 uint64_t current_timestamp_ms() {
-    struct timeval te;
-    gettimeofday(&te, NULL);
-    return (te.tv_sec*1000LL + te.tv_usec/1000);
+    return clock_realtime_us() / 1000;
 }
 
 void str_remove(char *str, const char *sub) {
@@ -120,12 +119,8 @@ void str_prepend(char* s, const char* t) {
 }
 
 bool is_dir(char* path) {
-    DIR* filetest = opendir(path);
-    if (filetest != NULL) {
-        closedir(filetest);
-        return true;
-    }
-    return false;
+    stat64_bionic st;
+    return path_cache_stat(path, &st) == 0 && S_ISDIR(st.st_mode);
 }
 
 char * get_string_sha1(uint8_t* buf, long size) {
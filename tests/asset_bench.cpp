@@ -0,0 +1,281 @@
+/*
+ * tests/asset_bench.cpp
+ *
+ * Opens and reads a generated set of assets through AAssetManager as loose
+ * files, from an archive stored as is and from a deflate-compressed one, and
+ * reports opens/s and MB/s for each. The archives are written here in the
+ * layout of utils/asset_pack.h. For loose files it also times the stat() and
+ * fopen() that every AAssetManager_open does on its own. The archive is
+ * loaded once per process, so each layout runs in a child.
+ *
+ * On the host everything comes from the page cache: this measures the CPU
+ * cost of each path (index lookup, stat, inflate), not memory card latency.
+ *
+ * Usage: asset_bench [passes over the asset set]
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "AFakeNative/AAssetManager.h"
+#include "AFakeNative/utils/asset_pack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "test.h"
+
+#define ASSETS_PATH DATA_PATH "assets/"
+#define BENCH_DIR "bench/"
+#define PLAIN_PAK DATA_PATH "bench_plain.pak"
+#define DEFLATE_PAK DATA_PATH "bench_deflate.pak"
+
+#define CHUNK_SIZE (64 * 1024)
+#define READ_SIZE (64 * 1024)
+
+// Many small assets and a few large ones, like a game's data
+static const int SMALL_COUNT = 96;
+static const size_t SMALL_SIZE = 8 * 1024;
+static const int LARGE_COUNT = 8;
+static const size_t LARGE_SIZE = 1024 * 1024;
+
+typedef struct benchAsset {
+    std::string name; // relative to assets/
+    std::vector<uint8_t> data;
+    uint32_t hash;
+} benchAsset;
+
+static std::vector<benchAsset> g_assets;
+static uint64_t g_totalBytes = 0;
+
+static uint32_t fnv1a(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Text-like bytes, which deflate to about two thirds
+static void fillAsset(std::vector<uint8_t>& data, uint32_t seed) {
+    static const char alphabet[] = "etaoin shrdlu,.\n0123456789ETAOIN";
+    uint32_t state = seed * 2654435761u + 1;
+    for (auto& b : data) {
+        state = state * 1103515245 + 12345;
+        b = (uint8_t) alphabet[(state >> 16) % (sizeof(alphabet) - 1)];
+    }
+}
+
+static void writeFile(const std::string& path, const void *data, size_t size) {
+    FILE *f = fopen(path.c_str(), "wb");
+    CHECK(f != nullptr);
+    CHECK_EQ(fwrite(data, 1, size, f), size);
+    fclose(f);
+}
+
+static void makeAssets() {
+    mkdir(ASSETS_PATH BENCH_DIR, 0755);
+    for (int i = 0; i < SMALL_COUNT + LARGE_COUNT; i++) {
+        benchAsset a;
+        char name[64];
+        snprintf(name, sizeof(name), BENCH_DIR "%s%03d.bin", i < SMALL_COUNT ? "small" : "large", i);
+        a.name = name;
+        a.hash = fnv1a(name);
+        a.data.resize(i < SMALL_COUNT ? SMALL_SIZE : LARGE_SIZE);
+        fillAsset(a.data, (uint32_t) i);
+        writeFile(ASSETS_PATH + a.name, a.data.data(), a.data.size());
+        g_totalBytes += a.data.size();
+        g_assets.push_back(std::move(a));
+    }
+}
+
+// Independently deflated chunks, as pack_assets.py --compress stores them
+static std::vector<uint8_t> deflateAsset(const std::vector<uint8_t>& data) {
+    uint32_t chunkCount = (uint32_t) ((data.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    assetPackChunkHeader header = { CHUNK_SIZE, chunkCount };
+    std::vector<uint32_t> offsets(chunkCount + 1);
+    std::vector<uint8_t> chunks;
+
+    offsets[0] = (uint32_t) (sizeof(header) + sizeof(uint32_t) * offsets.size());
+    for (uint32_t i = 0; i < chunkCount; i++) {
+        size_t len = std::min((size_t) CHUNK_SIZE, data.size() - (size_t) i * CHUNK_SIZE);
+        uLongf packedSize = compressBound(len);
+        std::vector<uint8_t> packed(packedSize);
+        CHECK_EQ(compress(packed.data(), &packedSize, data.data() + (size_t) i * CHUNK_SIZE, len), Z_OK);
+        chunks.insert(chunks.end(), packed.begin(), packed.begin() + (long) packedSize);
+        offsets[i + 1] = offsets[0] + (uint32_t) chunks.size();
+    }
+
+    std::vector<uint8_t> stored(offsets[0]);
+    memcpy(stored.data(), &header, sizeof(header));
+    memcpy(stored.data() + sizeof(header), offsets.data(), sizeof(uint32_t) * offsets.size());
+    stored.insert(stored.end(), chunks.begin(), chunks.end());
+    return stored;
+}
+
+static void writePak(const char *path, bool compress) {
+    std::vector<const benchAsset *> order;
+    for (const auto& a : g_assets) order.push_back(&a);
+    std::sort(order.begin(), order.end(), [](const benchAsset *a, const benchAsset *b) {
+        return a->hash != b->hash ? a->hash < b->hash : a->name < b->name;
+    });
+
+    std::string names;
+    std::vector<assetPackEntry> entries(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        entries[i] = {};
+        entries[i].hash = order[i]->hash;
+        entries[i].nameOffset = (uint32_t) names.size();
+        names += order[i]->name;
+        names += '\0';
+    }
+
+    assetPackHeader header = { ASSET_PACK_MAGIC, ASSET_PACK_VERSION, (uint32_t) entries.size(),
+                               (uint32_t) names.size() };
+    std::vector<uint8_t> data;
+    uint64_t base = (sizeof(header) + sizeof(assetPackEntry) * entries.size() + names.size() + 15) & ~15ull;
+    for (size_t i = 0; i < order.size(); i++) {
+        std::vector<uint8_t> stored = compress ? deflateAsset(order[i]->data) : order[i]->data;
+        data.resize((data.size() + 15) & ~(size_t) 15);
+        entries[i].offset = base + data.size();
+        entries[i].size = (uint32_t) order[i]->data.size();
+        entries[i].storedSize = (uint32_t) stored.size();
+        entries[i].compression = compress ? ASSET_PACK_COMPRESSION_DEFLATE : ASSET_PACK_COMPRESSION_NONE;
+        data.insert(data.end(), stored.begin(), stored.end());
+    }
+
+    std::vector<uint8_t> pak(base);
+    memcpy(pak.data(), &header, sizeof(header));
+    memcpy(pak.data() + sizeof(header), entries.data(), sizeof(assetPackEntry) * entries.size());
+    memcpy(pak.data() + sizeof(header) + sizeof(assetPackEntry) * entries.size(), names.data(), names.size());
+    pak.insert(pak.end(), data.begin(), data.end());
+    writeFile(path, pak.data(), pak.size());
+    printf("%s: %.2f MB\n", path, (double) pak.size() / 1e6);
+}
+
+static double usPerOpen(uint64_t ns, long passes) {
+    return (double) ns / 1e3 / ((double) passes * (double) g_assets.size());
+}
+
+static double megabytesPerSecond(uint64_t ns, long passes) {
+    return (double) g_totalBytes * (double) passes / ((double) ns / 1e9) / 1e6;
+}
+
+static void benchLayout(const char *layout, long passes) {
+    AAssetManager *mgr = AAssetManager_create();
+    CHECK(mgr != nullptr);
+    std::vector<uint8_t> buf(READ_SIZE);
+
+    uint64_t start = test_now_ns();
+    for (long p = 0; p < passes; p++) {
+        for (const auto& a : g_assets) {
+            AAsset *asset = AAssetManager_open(mgr, a.name.c_str(), AASSET_MODE_UNKNOWN);
+            CHECK(asset != nullptr);
+            AAsset_close(asset);
+        }
+    }
+    uint64_t openNs = test_now_ns() - start;
+
+    start = test_now_ns();
+    for (long p = 0; p < passes; p++) {
+        for (const auto& a : g_assets) {
+            AAsset *asset = AAssetManager_open(mgr, a.name.c_str(), AASSET_MODE_STREAMING);
+            CHECK(asset != nullptr);
+            size_t done = 0;
+            int n;
+            while ((n = AAsset_read(asset, buf.data(), buf.size())) > 0) {
+                CHECK(memcmp(buf.data(), a.data.data() + done, (size_t) n) == 0);
+                done += (size_t) n;
+            }
+            CHECK_EQ(done, a.data.size());
+            AAsset_close(asset);
+        }
+    }
+    uint64_t readNs = test_now_ns() - start;
+
+    start = test_now_ns();
+    for (long p = 0; p < passes; p++) {
+        for (const auto& a : g_assets) {
+            AAsset *asset = AAssetManager_open(mgr, a.name.c_str(), AASSET_MODE_BUFFER);
+            CHECK(asset != nullptr);
+            const void *data = AAsset_getBuffer(asset);
+            CHECK(data != nullptr && memcmp(data, a.data.data(), a.data.size()) == 0);
+            AAsset_close(asset);
+        }
+    }
+    uint64_t bufferNs = test_now_ns() - start;
+
+    printf("%-12s %10.1f %10.1f %10.1f %12.1f\n", layout, usPerOpen(openNs, passes),
+           (double) g_assets.size() * (double) passes / ((double) openNs / 1e9),
+           megabytesPerSecond(readNs, passes), megabytesPerSecond(bufferNs, passes));
+}
+
+// Layouts run in a child: asset_pack_init() keeps the first archive it loads
+static void runLayout(const char *layout, const char *pak, long passes) {
+    fflush(stdout);
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+        if (pak) CHECK(asset_pack_init(pak));
+        benchLayout(layout, passes);
+        fflush(stdout);
+        _exit(0);
+    }
+
+    int status;
+    CHECK_EQ(waitpid(pid, &status, 0), pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+// What a loose open costs before AAssetManager does anything of its own
+static void benchLooseOpen(long passes) {
+    uint64_t statNs = 0, fopenNs = 0;
+    for (long p = 0; p < passes; p++) {
+        for (const auto& a : g_assets) {
+            std::string path = ASSETS_PATH + a.name;
+            struct stat st{};
+            uint64_t start = test_now_ns();
+            CHECK_EQ(stat(path.c_str(), &st), 0);
+            uint64_t opened = test_now_ns();
+            FILE *f = fopen(path.c_str(), "r");
+            CHECK(f != nullptr);
+            fclose(f);
+            statNs += opened - start;
+            fopenNs += test_now_ns() - opened;
+        }
+    }
+    printf("loose open: stat %.1f us, fopen+fclose %.1f us\n", usPerOpen(statNs, passes),
+           usPerOpen(fopenNs, passes));
+}
+
+static void removeAssets() {
+    for (const auto& a : g_assets) unlink((ASSETS_PATH + a.name).c_str());
+    rmdir(ASSETS_PATH BENCH_DIR);
+    unlink(PLAIN_PAK);
+    unlink(DEFLATE_PAK);
+}
+
+int main(int argc, char **argv) {
+    long passes = bench_iterations(argc, argv, 20);
+
+    makeAssets();
+    printf("%zu assets, %.2f MB\n", g_assets.size(), (double) g_totalBytes / 1e6);
+    writePak(PLAIN_PAK, false);
+    writePak(DEFLATE_PAK, true);
+
+    benchLooseOpen(passes);
+    printf("%-12s %10s %10s %10s %12s\n", "", "us/open", "opens/s", "read MB/s", "buffer MB/s");
+    runLayout("loose", nullptr, passes);
+    runLayout("pak", PLAIN_PAK, passes);
+    runLayout("pak deflate", DEFLATE_PAK, passes);
+
+    removeAssets();
+    return 0;
+}
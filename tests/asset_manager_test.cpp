@@ -0,0 +1,235 @@
+/*
+ * tests/asset_manager_test.cpp
+ *
+ * AAsset lengths, positions, getBuffer and asset directories on loose files:
+ * the samples in tests/data/assets, copied next to the test, and a larger
+ * file generated here so that sequential reads go through read-ahead. Then a
+ * prefetch landing on an asset that is already open.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "AFakeNative/AAssetManager.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "test.h"
+
+#define ASSETS_PATH DATA_PATH "assets/"
+
+static const char HELLO[] = "Hello from the assets directory.\n";
+static const size_t HELLO_LEN = sizeof(HELLO) - 1;
+
+// Several read-ahead chunks and a partial one.
+static const size_t BIG_LEN = 3 * 128 * 1024 + 1000;
+
+// Over the 32 MB prefetch budget on its own
+static const size_t HUGE_LEN = 33 * 1024 * 1024;
+
+static uint8_t bigByte(size_t i) {
+    return (uint8_t) (i * 7 + (i >> 11));
+}
+
+static void writeBigAsset() {
+    FILE *f = fopen(ASSETS_PATH "big.bin", "wb");
+    CHECK(f != nullptr);
+    for (size_t i = 0; i < BIG_LEN; i++) fputc(bigByte(i), f);
+    fclose(f);
+}
+
+static void testLengths(AAssetManager *mgr) {
+    AAsset *a = AAssetManager_open(mgr, "hello.txt", AASSET_MODE_UNKNOWN);
+    CHECK(a != nullptr);
+    CHECK_EQ(AAsset_getLength(a), HELLO_LEN);
+    CHECK_EQ(AAsset_getLength64(a), HELLO_LEN);
+    CHECK_EQ(AAsset_getRemainingLength(a), HELLO_LEN);
+
+    char buf[64] = {};
+    CHECK_EQ(AAsset_read(a, buf, 5), 5);
+    CHECK(memcmp(buf, "Hello", 5) == 0);
+    CHECK_EQ(AAsset_getRemainingLength64(a), HELLO_LEN - 5);
+    CHECK_EQ(AAsset_getLength(a), HELLO_LEN);
+
+    // Seeks return the new position and are checked against the length.
+    CHECK_EQ(AAsset_seek(a, -1, SEEK_END), HELLO_LEN - 1);
+    CHECK_EQ(AAsset_getRemainingLength(a), 1);
+    CHECK_EQ(AAsset_seek64(a, 2, SEEK_CUR), -1);
+    CHECK_EQ(AAsset_seek(a, 6, SEEK_SET), 6);
+    CHECK_EQ(AAsset_read(a, buf, sizeof(buf)), HELLO_LEN - 6);
+    CHECK(memcmp(buf, HELLO + 6, HELLO_LEN - 6) == 0);
+    CHECK_EQ(AAsset_read(a, buf, sizeof(buf)), 0);
+    CHECK_EQ(AAsset_getRemainingLength(a), 0);
+    AAsset_close(a);
+
+    CHECK(AAssetManager_open(mgr, "missing.txt", AASSET_MODE_UNKNOWN) == nullptr);
+    CHECK(AAssetManager_open(mgr, "fonts", AASSET_MODE_UNKNOWN) == nullptr);
+}
+
+// Waits until the I/O thread has loaded `bytes` in prefetches overall
+static void waitPrefetchBytes(uint64_t bytes, AAssetIoStats *stats) {
+    uint64_t start = test_now_ns();
+    AAssetManager_getIoStats(stats);
+    while (stats->prefetchBytes < bytes) {
+        CHECK(test_now_ns() - start < 10000000000ull);
+        usleep(1000);
+        AAssetManager_getIoStats(stats);
+    }
+}
+
+static void testGetBuffer(AAssetManager *mgr) {
+    AAsset *a = AAssetManager_open(mgr, "hello.txt", AASSET_MODE_BUFFER);
+    AAsset *b = AAssetManager_open(mgr, "hello.txt", AASSET_MODE_UNKNOWN);
+    CHECK(a != nullptr && b != nullptr);
+    CHECK(!AAsset_isAllocated(a));
+
+    char buf[8];
+    CHECK_EQ(AAsset_read(a, buf, 3), 3);
+
+    // The whole file, wherever the asset was positioned.
+    auto *data = (const char *) AAsset_getBuffer(a);
+    CHECK(data != nullptr);
+    CHECK(memcmp(data, HELLO, HELLO_LEN) == 0);
+    CHECK(AAsset_isAllocated(a));
+    CHECK_EQ(AAsset_getRemainingLength(a), HELLO_LEN - 3);
+
+    // Reads after that are served from the buffer, from the same position.
+    CHECK_EQ(AAsset_read(a, buf, 2), 2);
+    CHECK(memcmp(buf, "lo", 2) == 0);
+
+    // Other assets of the same file share it, and it outlives the first one.
+    CHECK(AAsset_getBuffer(b) == data);
+    AAsset_close(a);
+    CHECK(memcmp(AAsset_getBuffer(b), HELLO, HELLO_LEN) == 0);
+    AAsset_close(b);
+
+    AAsset *empty = AAssetManager_open(mgr, "empty.bin", AASSET_MODE_BUFFER);
+    CHECK(empty != nullptr);
+    CHECK_EQ(AAsset_getLength(empty), 0);
+    CHECK(AAsset_getBuffer(empty) != nullptr);
+    CHECK_EQ(AAsset_read(empty, buf, sizeof(buf)), 0);
+    AAsset_close(empty);
+}
+
+static void testBigAsset(AAssetManager *mgr, int mode) {
+    AAsset *a = AAssetManager_open(mgr, "big.bin", mode);
+    CHECK(a != nullptr);
+    CHECK_EQ(AAsset_getLength64(a), BIG_LEN);
+
+    std::vector<uint8_t> buf(4096);
+    size_t pos = 0;
+    int n;
+    while ((n = AAsset_read(a, buf.data(), buf.size())) > 0) {
+        for (int i = 0; i < n; i++) CHECK_EQ(buf[i], bigByte(pos + i));
+        pos += n;
+        CHECK_EQ(AAsset_getRemainingLength64(a), BIG_LEN - pos);
+    }
+    CHECK_EQ(n, 0);
+    CHECK_EQ(pos, BIG_LEN);
+
+    // Back to the middle of a chunk, then the whole buffer.
+    CHECK_EQ(AAsset_seek64(a, 200000, SEEK_SET), 200000);
+    CHECK_EQ(AAsset_read(a, buf.data(), 10), 10);
+    CHECK_EQ(buf[0], bigByte(200000));
+    auto *data = (const uint8_t *) AAsset_getBuffer(a);
+    CHECK(data != nullptr);
+    for (size_t i = 0; i < BIG_LEN; i++) CHECK_EQ(data[i], bigByte(i));
+    AAsset_close(a);
+}
+
+static void testFileDescriptor(AAssetManager *mgr) {
+    AAsset *a = AAssetManager_open(mgr, "hello.txt", AASSET_MODE_UNKNOWN);
+    CHECK(a != nullptr);
+    off_t start = -1, length = -1;
+    int fd = AAsset_openFileDescriptor(a, &start, &length);
+    CHECK(fd >= 0);
+    CHECK_EQ(start, 0);
+    CHECK_EQ(length, HELLO_LEN);
+    char buf[HELLO_LEN];
+    CHECK_EQ(pread(fd, buf, HELLO_LEN, start), HELLO_LEN);
+    CHECK(memcmp(buf, HELLO, HELLO_LEN) == 0);
+    close(fd);
+    AAsset_close(a);
+}
+
+static void testPrefetchAfterOpen(AAssetManager *mgr) {
+    AAsset *a = AAssetManager_open(mgr, "hello.txt", AASSET_MODE_BUFFER);
+    CHECK(a != nullptr);
+
+    // The prefetch lands after the open, then getBuffer takes it over
+    AAssetIoStats stats;
+    AAssetManager_getIoStats(&stats);
+    uint64_t hits = stats.prefetchHits;
+    AAssetManager_prefetch(mgr, "hello.txt");
+    waitPrefetchBytes(stats.prefetchBytes + HELLO_LEN, &stats);
+    auto *data = (const char *) AAsset_getBuffer(a);
+    CHECK(data != nullptr);
+    CHECK(memcmp(data, HELLO, HELLO_LEN) == 0);
+    AAssetManager_getIoStats(&stats);
+    CHECK_EQ(stats.prefetchHits, hits + 1);
+
+    // A prefetch over the budget evicts nothing the open asset uses
+    FILE *f = fopen(ASSETS_PATH "huge.bin", "wb");
+    CHECK(f != nullptr);
+    std::vector<uint8_t> chunk(1024 * 1024, 0x5A);
+    for (size_t i = 0; i < HUGE_LEN / chunk.size(); i++) {
+        CHECK_EQ(fwrite(chunk.data(), 1, chunk.size(), f), chunk.size());
+    }
+    fclose(f);
+    uint64_t evicted = stats.prefetchEvicted;
+    AAssetManager_prefetch(mgr, "huge.bin");
+    waitPrefetchBytes(stats.prefetchBytes + HUGE_LEN, &stats);
+    unlink(ASSETS_PATH "huge.bin");
+    CHECK_EQ(stats.prefetchEvicted, evicted);
+    CHECK(AAsset_getBuffer(a) == data);
+    CHECK(memcmp(data, HELLO, HELLO_LEN) == 0);
+
+    AAsset_close(a);
+}
+
+static std::vector<std::string> listDir(AAssetManager *mgr, const char *name) {
+    std::vector<std::string> names;
+    AAssetDir *d = AAssetManager_openDir(mgr, name);
+    CHECK(d != nullptr);
+    const char *n;
+    while ((n = AAssetDir_getNextFileName(d)) != nullptr) names.emplace_back(n);
+    CHECK(AAssetDir_getNextFileName(d) == nullptr);
+
+    // Rewinding lists the same names again.
+    AAssetDir_rewind(d);
+    for (const std::string& s : names) CHECK(s == AAssetDir_getNextFileName(d));
+    AAssetDir_close(d);
+    return names;
+}
+
+static void testOpenDir(AAssetManager *mgr) {
+    // Files only, sorted; subdirectories are left out.
+    std::vector<std::string> root = listDir(mgr, "");
+    CHECK_EQ(root.size(), 3);
+    CHECK(root[0] == "big.bin" && root[1] == "empty.bin" && root[2] == "hello.txt");
+
+    std::vector<std::string> fonts = listDir(mgr, "fonts");
+    CHECK_EQ(fonts.size(), 2);
+    CHECK(fonts[0] == "a.fnt" && fonts[1] == "b.fnt");
+
+    CHECK_EQ(listDir(mgr, "fonts/extra").size(), 1);
+    CHECK_EQ(listDir(mgr, "nope").size(), 0);
+}
+
+int main() {
+    writeBigAsset();
+    AAssetManager *mgr = AAssetManager_create();
+    CHECK(mgr != nullptr);
+
+    testLengths(mgr);
+    testGetBuffer(mgr);
+    testBigAsset(mgr, AASSET_MODE_UNKNOWN);
+    testBigAsset(mgr, AASSET_MODE_STREAMING);
+    testFileDescriptor(mgr);
+    testPrefetchAfterOpen(mgr);
+    testOpenDir(mgr);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * tests/clock_test.c
+ *
+ * clock_gettime(), clock_getres() and gettimeofday() as the game calls them,
+ * with bionic clock ids, on the loader's time base: every id bionic has
+ * reads, anything else fails with EINVAL, the monotonic clocks never go
+ * back, the wall clock agrees with the host's, and the thread CPU-time
+ * clock counts the calling thread's work but not its sleep. Also prints
+ * what a read of each kind costs.
+ *
+ * Usage: clock_test [reads per timing]
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/sys.h"
+#include "utils/clock.h"
+
+#include <errno.h>
+#include <time.h>
+
+#include "test.h"
+
+// Bionic's numbering, as the game passes it
+#define BIONIC_CLOCK_REALTIME           0
+#define BIONIC_CLOCK_MONOTONIC          1
+#define BIONIC_CLOCK_THREAD_CPUTIME_ID  3
+#define BIONIC_CLOCK_BOOTTIME           7
+
+static int64_t to_us(const struct timespec *t) {
+    return (int64_t) t->tv_sec * 1000000 + t->tv_nsec / 1000;
+}
+
+static int64_t read_us(int c) {
+    struct timespec t;
+    CHECK_EQ(clock_gettime_soloader(c, &t), 0);
+    CHECK(t.tv_nsec >= 0 && t.tv_nsec < 1000000000);
+    return to_us(&t);
+}
+
+static void test_ids(void) {
+    struct timespec t, res;
+
+    for (int c = BIONIC_CLOCK_REALTIME; c <= BIONIC_CLOCK_BOOTTIME; c++) {
+        CHECK_EQ(clock_gettime_soloader(c, &t), 0);
+        CHECK_EQ(clock_getres_soloader(c, &res), 0);
+        CHECK_EQ(res.tv_sec, 0);
+        CHECK_EQ(res.tv_nsec, CLOCK_RESOLUTION_NS);
+    }
+
+    int bad[] = { -1, 8, 11, 1000 };
+    for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        errno = 0;
+        CHECK_EQ(clock_gettime_soloader(bad[i], &t), -1);
+        CHECK_EQ(errno, EINVAL);
+        errno = 0;
+        CHECK_EQ(clock_getres_soloader(bad[i], &res), -1);
+        CHECK_EQ(errno, EINVAL);
+    }
+
+    errno = 0;
+    CHECK_EQ(clock_gettime_soloader(BIONIC_CLOCK_MONOTONIC, NULL), -1);
+    CHECK_EQ(errno, EFAULT);
+}
+
+static void test_monotonic(void) {
+    int64_t last = read_us(BIONIC_CLOCK_MONOTONIC);
+    for (int i = 0; i < 100000; i++) {
+        int64_t now = read_us(BIONIC_CLOCK_MONOTONIC);
+        CHECK(now >= last);
+        last = now;
+    }
+}
+
+static void test_realtime(void) {
+    struct timespec host;
+    clock_gettime(CLOCK_REALTIME, &host);
+    int64_t ours = read_us(BIONIC_CLOCK_REALTIME);
+    CHECK(ours - to_us(&host) < 100000 && to_us(&host) - ours < 100000);
+
+    struct timeval tv;
+    CHECK_EQ(gettimeofday_soloader(&tv, NULL), 0);
+    int64_t tv_us = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+    CHECK(tv_us >= ours && tv_us - ours < 100000);
+}
+
+static void test_thread_cputime(void) {
+    int64_t start = read_us(BIONIC_CLOCK_THREAD_CPUTIME_ID);
+    struct timespec sleep = { 0, 200 * 1000000 };
+    nanosleep(&sleep, NULL);
+    int64_t slept = read_us(BIONIC_CLOCK_THREAD_CPUTIME_ID);
+    CHECK(slept - start < 50 * 1000);
+
+    volatile uint64_t spin = 0;
+    uint64_t until = clock_monotonic_us() + 100 * 1000;
+    while (clock_monotonic_us() < until) spin++;
+    int64_t busy = read_us(BIONIC_CLOCK_THREAD_CPUTIME_ID);
+    CHECK(busy - slept >= 50 * 1000);
+}
+
+static double ns_per_read(int c, long reads) {
+    struct timespec t;
+    uint64_t start = test_now_ns();
+    for (long i = 0; i < reads; i++) clock_gettime_soloader(c, &t);
+    return (double) (test_now_ns() - start) / (double) reads;
+}
+
+int main(int argc, char **argv) {
+    long reads = bench_iterations(argc, argv, 1000000);
+
+    test_ids();
+    test_monotonic();
+    test_realtime();
+    test_thread_cputime();
+
+    printf("ns/read: monotonic %.1f, realtime %.1f, thread cputime %.1f\n",
+           ns_per_read(BIONIC_CLOCK_MONOTONIC, reads), ns_per_read(BIONIC_CLOCK_REALTIME, reads),
+           ns_per_read(BIONIC_CLOCK_THREAD_CPUTIME_ID, reads));
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * tests/controls_sampling_test.cpp
+ *
+ * Replays a recorded pad buffer through the input thread. The trace has a
+ * press that happened before the thread started, which must not reach the
+ * game, then presses spread over ticks whose driver buffers overlap and
+ * wrap around. Also checks the sampling helpers on their own. controls.cpp is
+ * built into this file; the test provides the pad and touch drivers.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "AFakeNative/utils/controls.cpp"
+
+#include <atomic>
+#include <unistd.h>
+#include <vector>
+
+#include "test.h"
+
+#define TRACE_BUFFER INPUT_SAMPLE_BUFFER
+
+// Driver ring buffer as sceCtrlPeekBufferPositiveExt2 returned it on each
+// call, by timestamp and buttons. The first call is the one the input thread
+// makes before its first tick.
+struct TraceSample {
+    uint64_t timeStamp;
+    unsigned int buttons;
+};
+
+static TraceSample trace[][TRACE_BUFFER] = {
+    // Before start: CROSS pressed and released, the game must not see it.
+    {
+        { 1000, 0 }, { 1001, 0 }, { 1002, 0 }, { 1003, 0 },
+        { 1004, 0 }, { 1005, SCE_CTRL_CROSS }, { 1006, SCE_CTRL_CROSS }, { 1007, SCE_CTRL_CROSS },
+        { 1008, 0 }, { 1009, 0 }, { 1010, 0 }, { 1011, 0 },
+        { 1012, 0 }, { 1013, 0 }, { 1014, 0 }, { 1015, 0 },
+    },
+    // The ring wrapped: eight new samples at the front, CIRCLE tapped.
+    {
+        { 1016, 0 }, { 1017, 0 }, { 1018, SCE_CTRL_CIRCLE }, { 1019, SCE_CTRL_CIRCLE },
+        { 1020, SCE_CTRL_CIRCLE }, { 1021, 0 }, { 1022, 0 }, { 1023, 0 },
+        { 1008, 0 }, { 1009, 0 }, { 1010, 0 }, { 1011, 0 },
+        { 1012, 0 }, { 1013, 0 }, { 1014, 0 }, { 1015, 0 },
+    },
+    // Nothing new since the last tick.
+    {
+        { 1016, 0 }, { 1017, 0 }, { 1018, SCE_CTRL_CIRCLE }, { 1019, SCE_CTRL_CIRCLE },
+        { 1020, SCE_CTRL_CIRCLE }, { 1021, 0 }, { 1022, 0 }, { 1023, 0 },
+        { 1008, 0 }, { 1009, 0 }, { 1010, 0 }, { 1011, 0 },
+        { 1012, 0 }, { 1013, 0 }, { 1014, 0 }, { 1015, 0 },
+    },
+    // Eight more, SQUARE goes down and stays down.
+    {
+        { 1016, 0 }, { 1017, 0 }, { 1018, SCE_CTRL_CIRCLE }, { 1019, SCE_CTRL_CIRCLE },
+        { 1020, SCE_CTRL_CIRCLE }, { 1021, 0 }, { 1022, 0 }, { 1023, 0 },
+        { 1024, 0 }, { 1025, 0 }, { 1026, 0 }, { 1027, 0 },
+        { 1028, 0 }, { 1029, 0 }, { 1030, SCE_CTRL_SQUARE }, { 1031, SCE_CTRL_SQUARE },
+    },
+};
+
+static const int TRACE_CALLS = sizeof(trace) / sizeof(trace[0]);
+static int traceCall = 0;
+static std::atomic<bool> traceDone(false);
+
+int sceCtrlSetSamplingModeExt(SceCtrlPadInputMode) {
+    return 0;
+}
+
+int sceCtrlPeekBufferPositiveExt2(int, SceCtrlData *pad_data, int count) {
+    if (traceCall == TRACE_CALLS) {
+        // Park the input thread, the trace is over.
+        traceDone = true;
+        for (;;) pause();
+    }
+    CHECK(count >= TRACE_BUFFER);
+    for (int i = 0; i < TRACE_BUFFER; i++) {
+        SceCtrlData s = {};
+        s.timeStamp = trace[traceCall][i].timeStamp;
+        s.buttons = trace[traceCall][i].buttons;
+        s.lx = s.ly = s.rx = s.ry = 128;
+        pad_data[i] = s;
+    }
+    traceCall++;
+    return TRACE_BUFFER;
+}
+
+int sceTouchSetSamplingState(SceUInt32, SceTouchSamplingState) {
+    return 0;
+}
+
+int sceTouchPeek(SceUInt32, SceTouchData *, SceUInt32) {
+    return 0;
+}
+
+static void testNewSamplesInOrder() {
+    const TraceSample *wrapped = trace[1];
+    int order[TRACE_BUFFER];
+
+    CHECK_EQ(newSamplesInOrder(wrapped, TRACE_BUFFER, 1015, order), 8);
+    for (int i = 0; i < 8; i++) CHECK_EQ(order[i], i);
+
+    // Everything newer than 1011, oldest first, across the wrap.
+    CHECK_EQ(newSamplesInOrder(wrapped, TRACE_BUFFER, 1011, order), 12);
+    for (int i = 1; i < 12; i++) {
+        CHECK(wrapped[order[i - 1]].timeStamp < wrapped[order[i]].timeStamp);
+    }
+    CHECK_EQ(wrapped[order[0]].timeStamp, 1012);
+
+    CHECK_EQ(newSamplesInOrder(wrapped, TRACE_BUFFER, 1023, order), 0);
+    CHECK_EQ(newestSampleStamp(wrapped, TRACE_BUFFER), 1023);
+    CHECK_EQ(newestSampleStamp(wrapped, 0), 0);
+}
+
+static void testSampleTime() {
+    // The newest sample is "now", older ones are back-dated by their age.
+    CHECK_EQ(sampleTime(1023, 1023, 5000000), 5000000);
+    CHECK_EQ(sampleTime(1016, 1023, 5000000), 5000000 - 7000);
+}
+
+static void testNextSampleDelay() {
+    // Not aligned to frames: one full period.
+    CHECK_EQ(nextSampleDelay(100000, 8333, 0), 8333);
+    // Swap time from the future (clock race): one full period.
+    CHECK_EQ(nextSampleDelay(100000, 8333, 100500), 8333);
+    // Aligned: the next whole period after the last swap.
+    CHECK_EQ(nextSampleDelay(100000, 8333, 100000), 8333);
+    CHECK_EQ(nextSampleDelay(100000, 8333, 99000), 7333);
+    CHECK_EQ(nextSampleDelay(100000, 8333, 100000 - 8333 * 3 - 10), 8323);
+}
+
+struct Key {
+    int32_t keycode;
+    int32_t action;
+    int64_t time;
+};
+
+static void testReplay() {
+    AInputQueue *queue = AInputQueue_create();
+    CHECK(queue != nullptr);
+    while (!traceDone) usleep(1000);
+
+    std::vector<Key> keys;
+    AInputEvent *event;
+    while (AInputQueue_getEvent(queue, &event) == 0) {
+        CHECK_EQ(AInputEvent_getType(event), AINPUT_EVENT_TYPE_KEY);
+        keys.push_back({ AKeyEvent_getKeyCode(event), AKeyEvent_getAction(event), AKeyEvent_getEventTime(event) });
+        AInputQueue_finishEvent(queue, event, 1);
+    }
+
+    CHECK_EQ(keys.size(), 3);
+    CHECK_EQ(keys[0].keycode, AKEYCODE_BUTTON_B);
+    CHECK_EQ(keys[0].action, AKEY_EVENT_ACTION_DOWN);
+    CHECK_EQ(keys[1].keycode, AKEYCODE_BUTTON_B);
+    CHECK_EQ(keys[1].action, AKEY_EVENT_ACTION_UP);
+    CHECK_EQ(keys[2].keycode, AKEYCODE_BUTTON_X);
+    CHECK_EQ(keys[2].action, AKEY_EVENT_ACTION_DOWN);
+
+    // Press and release came in one batch: 3 samples, 3 µs apart.
+    CHECK_EQ(keys[1].time - keys[0].time, 3000);
+    CHECK(keys[2].time > keys[1].time);
+}
+
+int main() {
+    testNewSamplesInOrder();
+    testSampleTime();
+    testNextSampleDelay();
+    testReplay();
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * tests/dirent_test.c
+ *
+ * dirent_newlib_to_dirent_bionic() and the bionic dirent layout the game
+ * reads, on hand-made newlib entries and on a directory listed through
+ * opendir_soloader().
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/io.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "reimpl/_struct_converters.c"
+
+#define ASSETS DATA_PATH "assets/"
+
+static void test_layout(void) {
+    // What bionic's struct dirent looks like on 32-bit ARM.
+    CHECK_EQ(offsetof(dirent64_bionic, d_ino), 0x0);
+    CHECK_EQ(offsetof(dirent64_bionic, d_off), 0x2);
+    CHECK_EQ(offsetof(dirent64_bionic, d_reclen), 0xA);
+    CHECK_EQ(offsetof(dirent64_bionic, d_type), 0x12);
+    CHECK_EQ(offsetof(dirent64_bionic, d_name), 0x13);
+    CHECK_EQ(sizeof(dirent64_bionic), 0x13 + 256);
+}
+
+static void test_convert(void) {
+    struct dirent d;
+    dirent64_bionic b;
+
+    memset(&d, 0, sizeof(d));
+    memset(&b, 0x55, sizeof(b));
+    d.d_stat.st_mode = SCE_S_IFDIR | 0777;
+    strcpy(d.d_name, "saves");
+    dirent_newlib_to_dirent_bionic(&d, &b);
+    CHECK_EQ(b.d_type, DT_DIR);
+    CHECK(strcmp(b.d_name, "saves") == 0);
+    CHECK_EQ(b.d_ino, 0);
+    CHECK_EQ(b.d_off, 0);
+    CHECK_EQ(b.d_reclen, sizeof(dirent64_bionic));
+
+    d.d_stat.st_mode = SCE_S_IFREG | 0666;
+    strcpy(d.d_name, "save.dat");
+    dirent_newlib_to_dirent_bionic(&d, &b);
+    CHECK_EQ(b.d_type, DT_REG);
+    CHECK(strcmp(b.d_name, "save.dat") == 0);
+
+    // A name filling the whole newlib buffer still comes out terminated.
+    memset(d.d_name, 'x', sizeof(d.d_name));
+    dirent_newlib_to_dirent_bionic(&d, &b);
+    CHECK_EQ(strlen(b.d_name), sizeof(b.d_name) - 1);
+}
+
+static void test_listing(void) {
+    path_cache_dir *dir = opendir_soloader(ASSETS "fonts");
+    CHECK(dir != NULL);
+
+    int files = 0, dirs = 0;
+    dirent64_bionic *e;
+    while ((e = readdir_soloader(dir)) != NULL) {
+        if (strcmp(e->d_name, "extra") == 0) {
+            CHECK_EQ(e->d_type, DT_DIR);
+            dirs++;
+        } else {
+            CHECK(strcmp(e->d_name, "a.fnt") == 0 || strcmp(e->d_name, "b.fnt") == 0);
+            CHECK_EQ(e->d_type, DT_REG);
+            files++;
+        }
+        CHECK_EQ(e->d_reclen, sizeof(dirent64_bionic));
+    }
+    CHECK_EQ(files, 2);
+    CHECK_EQ(dirs, 1);
+    closedir_soloader(dir);
+
+    // readdir_r sees the same entries.
+    dir = opendir_soloader(ASSETS "fonts");
+    dirent64_bionic entry, *result;
+    int n = 0;
+    while (readdir_r_soloader(dir, &entry, &result) == 0 && result) {
+        CHECK(result == &entry);
+        n++;
+    }
+    CHECK_EQ(n, 3);
+    closedir_soloader(dir);
+
+    CHECK(opendir_soloader(ASSETS "missing") == NULL);
+}
+
+int main() {
+    test_layout();
+    test_convert();
+    test_listing();
+    return 0;
+}
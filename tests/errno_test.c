@@ -0,0 +1,131 @@
+/*
+ * tests/errno_test.c
+ *
+ * Errno translation with newlib's values (host/newlib/sys/errno.h): every
+ * newlib errno the table knows reads back as its bionic value, and a game
+ * store of that value reaches newlib as the same newlib errno. ENOTSUP is
+ * the one alias: bionic has it as EOPNOTSUPP, which translates back to
+ * newlib's EOPNOTSUPP. Then the stores the game makes itself, per thread,
+ * and strerror.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/errno.h"
+#include "reimpl/_errno_bionic.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/errno.h>
+
+#include "test.h"
+
+#define ERRNO_MAX 256
+#define NEWLIB_ERRNO_LAST 142 // EOWNERDEAD
+
+// The newlib errno a game store of `bionic` becomes. Starts from 0: storing
+// the value the game just read changes nothing.
+static int store(int bionic) {
+    errno = 0;
+    *__errno_soloader() = bionic;
+    __errno_soloader();
+    return errno;
+}
+
+static void test_round_trip(void) {
+    int known = 0;
+    int newlib_of[ERRNO_MAX] = { 0 };
+
+    for (int n = 1; n <= NEWLIB_ERRNO_LAST; n++) {
+        errno = n;
+        int b = *__errno_soloader();
+        if (b == 0)
+            continue;
+        known++;
+        CHECK(b > 0 && b < ERRNO_MAX);
+
+        // One newlib errno per bionic one, but for the alias
+        if (n != ENOTSUP) {
+            CHECK_EQ(newlib_of[b], 0);
+            newlib_of[b] = n;
+        }
+
+        CHECK_EQ(store(b), n == ENOTSUP ? EOPNOTSUPP : n);
+        CHECK(strcmp(strerror_soloader(b), "Success") != 0);
+    }
+    printf("%d newlib errnos translated\n", known);
+
+    // Where newlib and bionic differ, and the alias both ways
+    errno = EOPNOTSUPP;
+    CHECK_EQ(*__errno_soloader(), EOPNOTSUPP_BIONIC);
+    errno = ENOTSUP;
+    CHECK_EQ(*__errno_soloader(), EOPNOTSUPP_BIONIC);
+    CHECK_EQ(store(ENOTSUP_BIONIC), EOPNOTSUPP);
+    CHECK_EQ(strcmp(strerror_soloader(EOPNOTSUPP_BIONIC), "Operation not supported on transport endpoint"), 0);
+    errno = ETIMEDOUT;
+    CHECK_EQ(*__errno_soloader(), ETIMEDOUT_BIONIC);
+    CHECK_EQ(store(ECANCELED_BIONIC), ECANCELED);
+    CHECK_EQ(store(EOWNERDEAD_BIONIC), EOWNERDEAD);
+
+    // EFTYPE is newlib's own
+    errno = EFTYPE;
+    CHECK_EQ(*__errno_soloader(), 0);
+}
+
+static void *set_eio(void *arg) {
+    errno = EIO;
+    return (void *) (long) *__errno_soloader();
+}
+
+static void test_game_stores(void) {
+    // errno = 0 before strtol(), and nothing sets it: stays 0 both ways
+    errno = ENOENT;
+    int *p = __errno_soloader();
+    CHECK_EQ(*p, ENOENT_BIONIC);
+    *p = 0;
+    CHECK_EQ(*__errno_soloader(), 0);
+    CHECK_EQ(errno, 0);
+
+    // Stored 0, then newlib sets ERANGE: newlib wins
+    errno = EINVAL;
+    p = __errno_soloader();
+    *p = 0;
+    errno = ERANGE;
+    CHECK_EQ(*__errno_soloader(), ERANGE_BIONIC);
+
+    // A bionic value newlib doesn't know is dropped
+    *__errno_soloader() = 200;
+    CHECK_EQ(*__errno_soloader(), ERANGE_BIONIC);
+    CHECK_EQ(errno, ERANGE);
+
+    // Each thread has its own
+    CHECK_EQ(store(EAGAIN_BIONIC), EAGAIN);
+    pthread_t t;
+    void *ret;
+    CHECK_EQ(pthread_create(&t, NULL, set_eio, NULL), 0);
+    pthread_join(t, &ret);
+    CHECK_EQ((long) ret, EIO_BIONIC);
+    CHECK_EQ(*__errno_soloader(), EAGAIN_BIONIC);
+}
+
+static void test_strerror(void) {
+    char buf[64];
+
+    CHECK_EQ(strcmp(strerror_soloader(ENOENT_BIONIC), "No such file or directory"), 0);
+    CHECK_EQ(strcmp(strerror_soloader(0), "Success"), 0);
+    CHECK_EQ(strcmp(strerror_soloader(9999), "Success"), 0);
+    CHECK_EQ(strcmp(strerror_soloader(-1), "Success"), 0);
+
+    CHECK_EQ(strerror_r_soloader(ENOENT_BIONIC, buf, sizeof(buf)), 0);
+    CHECK_EQ(strcmp(buf, "No such file or directory"), 0);
+    CHECK_EQ(strerror_r_soloader(ENOENT_BIONIC, buf, 8), ERANGE_BIONIC);
+    CHECK_EQ(strcmp(buf, "No such"), 0);
+}
+
+int main() {
+    test_round_trip();
+    test_game_stores();
+    test_strerror();
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * tests/fastmath_bench.c
+ *
+ * Cost per call of each tier of reimpl/fastmath.c next to the C library's
+ * float function, over arguments in the range a game passes them (angles of
+ * a few turns, exponents of a few tens) and inside what fastmath handles
+ * itself. Each function runs over the same table of arguments for every
+ * tier, and the results are summed so that none of the calls is dropped.
+ * The fastest of 5 runs counts, which keeps scheduler noise out.
+ *
+ * On the host this compares against glibc's libm with the host's FPU: the
+ * numbers rank the tiers against each other, not against newlib on the
+ * Vita's VFP, where the recommendations in fastmath.h still need checking.
+ *
+ * Usage: fastmath_bench [passes over the argument table]
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/fastmath.h"
+
+#include "test.h"
+
+#define ARGS 4096
+#define REPEATS 5
+
+static float args_x[ARGS];
+static float args_y[ARGS];
+static volatile float sink;
+
+static uint32_t random_state = 12345;
+
+static float random_float(float lo, float hi) {
+    random_state = random_state * 1103515245 + 12345;
+    return lo + (hi - lo) * (float) (random_state >> 8) / (float) (1 << 24);
+}
+
+static void fill(float x_lo, float x_hi, float y_lo, float y_hi) {
+    for (int i = 0; i < ARGS; i++) {
+        args_x[i] = random_float(x_lo, x_hi);
+        args_y[i] = random_float(y_lo, y_hi);
+    }
+}
+
+static double per_call(uint64_t best, long passes) {
+    return (double) best / ((double) passes * ARGS);
+}
+
+// ns per call of `f`, over every argument `passes` times
+static double time_unary(float (*f)(float), long passes) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < REPEATS; r++) {
+        float sum = 0.0f;
+        uint64_t start = test_now_ns();
+        for (long p = 0; p < passes; p++)
+            for (int i = 0; i < ARGS; i++) sum += f(args_x[i]);
+        uint64_t elapsed = test_now_ns() - start;
+        sink = sum;
+        if (elapsed < best) best = elapsed;
+    }
+    return per_call(best, passes);
+}
+
+static double time_binary(float (*f)(float, float), long passes) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < REPEATS; r++) {
+        float sum = 0.0f;
+        uint64_t start = test_now_ns();
+        for (long p = 0; p < passes; p++)
+            for (int i = 0; i < ARGS; i++) sum += f(args_x[i], args_y[i]);
+        uint64_t elapsed = test_now_ns() - start;
+        sink = sum;
+        if (elapsed < best) best = elapsed;
+    }
+    return per_call(best, passes);
+}
+
+static double time_sincos(void (*f)(float, float *, float *), long passes) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < REPEATS; r++) {
+        float sum = 0.0f;
+        uint64_t start = test_now_ns();
+        for (long p = 0; p < passes; p++) {
+            for (int i = 0; i < ARGS; i++) {
+                float s, c;
+                f(args_x[i], &s, &c);
+                sum += s + c;
+            }
+        }
+        uint64_t elapsed = test_now_ns() - start;
+        sink = sum;
+        if (elapsed < best) best = elapsed;
+    }
+    return per_call(best, passes);
+}
+
+// A tier the function doesn't have is printed as "-"
+static void report(const char *name, double libm, double precise, double fast) {
+    printf("%-10s %10.2f", name, libm);
+    if (precise > 0) printf(" %10.2f %7.2fx", precise, libm / precise);
+    else printf(" %10s %8s", "-", "");
+    if (fast > 0) printf(" %10.2f %7.2fx\n", fast, libm / fast);
+    else printf(" %10s\n", "-");
+}
+
+// The C library's, through a pointer like the tiers, so no call is inlined
+static float libm_sinf(float x) { return sinf(x); }
+static float libm_cosf(float x) { return cosf(x); }
+static void libm_sincosf(float x, float *s, float *c) { sincosf(x, s, c); }
+static float libm_expf(float x) { return expf(x); }
+static float libm_logf(float x) { return logf(x); }
+static float libm_powf(float x, float y) { return powf(x, y); }
+static float libm_atanf(float x) { return atanf(x); }
+static float libm_atan2f(float y, float x) { return atan2f(y, x); }
+static float libm_sqrtf(float x) { return sqrtf(x); }
+
+int main(int argc, char **argv) {
+    long passes = bench_iterations(argc, argv, 400);
+
+    printf("%-10s %10s %10s %8s %10s %8s\n", "ns/call", "libm", "precise", "speedup", "fast", "speedup");
+
+    fill(-20.0f, 20.0f, 0.0f, 0.0f);
+    report("sinf", time_unary(libm_sinf, passes), time_unary(fastmath_sinf_precise, passes),
+           time_unary(fastmath_sinf_fast, passes));
+    report("cosf", time_unary(libm_cosf, passes), time_unary(fastmath_cosf_precise, passes),
+           time_unary(fastmath_cosf_fast, passes));
+    report("sincosf", time_sincos(libm_sincosf, passes), time_sincos(fastmath_sincosf_precise, passes),
+           time_sincos(fastmath_sincosf_fast, passes));
+
+    fill(-40.0f, 40.0f, 0.0f, 0.0f);
+    report("expf", time_unary(libm_expf, passes), time_unary(fastmath_expf_precise, passes),
+           time_unary(fastmath_expf_fast, passes));
+
+    fill(1e-3f, 1e4f, 0.0f, 0.0f);
+    report("logf", time_unary(libm_logf, passes), time_unary(fastmath_logf_precise, passes),
+           time_unary(fastmath_logf_fast, passes));
+    report("sqrtf", time_unary(libm_sqrtf, passes), time_unary(fastmath_sqrtf_vfp, passes), 0);
+
+    fill(1e-2f, 100.0f, -4.0f, 4.0f);
+    report("powf", time_binary(libm_powf, passes), time_binary(fastmath_powf_precise, passes), 0);
+
+    fill(-50.0f, 50.0f, -50.0f, 50.0f);
+    report("atanf", time_unary(libm_atanf, passes), time_unary(fastmath_atanf_precise, passes),
+           time_unary(fastmath_atanf_fast, passes));
+    report("atan2f", time_binary(libm_atan2f, passes), time_binary(fastmath_atan2f_precise, passes),
+           time_binary(fastmath_atan2f_fast, passes));
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * tests/fastmath_ulp_test.c
+ *
+ * Measures the error of reimpl/fastmath.c against glibc's double functions,
+ * in ULP of the float result, and holds both tiers to the table in
+ * fastmath.h. Sweeps every stride-th float of both signs for the one
+ * argument functions and random pairs for atan2f and powf. With the
+ * default stride of 37 this is the run the table comes from. Special
+ * values and arguments outside the handled ranges must give exactly what
+ * the C library's float functions give.
+ *
+ * Usage: fastmath_ulp_test [stride]
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/fastmath.h"
+
+#include <float.h>
+#include <string.h>
+
+#include "test.h"
+
+static float from_bits(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static uint32_t to_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+// Error of `got` in ULP of the float nearest to `ref`. NaN, infinities and
+// overflow must match exactly; a mismatch counts as a huge error.
+static double ulp_error(float got, double ref) {
+    if (isnan(ref))
+        return isnan(got) ? 0.0 : 1e9;
+    if (isinf(ref) || fabs(ref) > FLT_MAX)
+        return got == (float) ref ? 0.0 : 1e9;
+    if (isinf(got) || isnan(got))
+        return 1e9;
+
+    int exp;
+    frexpf((float) ref == 0.0f ? FLT_TRUE_MIN : (float) ref, &exp);
+    double ulp = ldexp(1.0, exp - FLT_MANT_DIG);
+    if (ulp < FLT_TRUE_MIN)
+        ulp = FLT_TRUE_MIN;
+    return fabs((double) got - ref) / ulp;
+}
+
+// Prints the worst case, at `x` or at (`x`, `y`) for pairs
+static void check_bound(const char *name, double worst, double bound, float x, float y) {
+    printf("%-16s %6.3f ULP (bound %.2f) at %a", name, worst, bound, x);
+    printf(isnan(y) ? "\n" : ", %a\n", y);
+    // The table rounds to two decimals
+    if (worst >= bound + 0.005) {
+        fprintf(stderr, "%s: over its bound\n", name);
+        exit(1);
+    }
+}
+
+typedef float (*float_fn)(float);
+typedef double (*double_fn)(double);
+
+static void sweep(const char *name, float_fn f, double_fn ref, double bound, uint32_t stride) {
+    double worst = 0.0;
+    float worst_x = 0.0f;
+    for (uint64_t u = 0; u <= 0xFFFFFFFFu; u += stride) {
+        float x = from_bits((uint32_t) u);
+        double e = ulp_error(f(x), ref(x));
+        if (e > worst) {
+            worst = e;
+            worst_x = x;
+        }
+    }
+    check_bound(name, worst, bound, worst_x, NAN);
+}
+
+static float sincos_sin_precise(float x) {
+    float s, c;
+    fastmath_sincosf_precise(x, &s, &c);
+    return s;
+}
+
+static float sincos_cos_precise(float x) {
+    float s, c;
+    fastmath_sincosf_precise(x, &s, &c);
+    return c;
+}
+
+static float sincos_sin_fast(float x) {
+    float s, c;
+    fastmath_sincosf_fast(x, &s, &c);
+    return s;
+}
+
+static float sincos_cos_fast(float x) {
+    float s, c;
+    fastmath_sincosf_fast(x, &s, &c);
+    return c;
+}
+
+static uint32_t random_state = 1;
+
+static uint32_t next_random(void) {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+static uint32_t random_bits(void) {
+    return next_random() << 16 ^ next_random();
+}
+
+static void test_pairs(long pairs) {
+    double worst[3] = { 0.0 };
+    float worst_a[3] = { 0.0f }, worst_b[3] = { 0.0f };
+
+    for (long i = 0; i < pairs; i++) {
+        float y = from_bits(random_bits()), x = from_bits(random_bits());
+        double ref = atan2(y, x);
+        double e[3];
+        e[0] = ulp_error(fastmath_atan2f_precise(y, x), ref);
+        e[1] = ulp_error(fastmath_atan2f_fast(y, x), ref);
+
+        // Finite bases across the whole range, exponents that keep the
+        // result mostly finite; every other pair a base near 1 with any
+        // exponent
+        float base = from_bits(random_bits() % 0x7F800000);
+        float power = (float) ((int) (next_random() % 20001) - 10000) / 97.0f;
+        if (i & 1) {
+            base = from_bits((random_bits() & 0x007FFFFF) | 0x3F000000) * (float) (1 + next_random() % 1000);
+            power = from_bits(random_bits());
+            if (!(fabsf(power) < 1e6f))
+                power = 1.5f;
+        }
+        e[2] = ulp_error(fastmath_powf_precise(base, power), pow(base, power));
+
+        float a[3] = { y, y, base }, b[3] = { x, x, power };
+        for (int k = 0; k < 3; k++) {
+            if (e[k] > worst[k]) {
+                worst[k] = e[k];
+                worst_a[k] = a[k];
+                worst_b[k] = b[k];
+            }
+        }
+    }
+
+    check_bound("atan2f precise", worst[0], 0.6, worst_a[0], worst_b[0]);
+    check_bound("atan2f fast", worst[1], 3.45, worst_a[1], worst_b[1]);
+    check_bound("powf precise", worst[2], 0.6, worst_a[2], worst_b[2]);
+}
+
+// Bit for bit what the C library gives, NaN for NaN
+#define CHECK_SAME(got, want)                                                       \
+    do {                                                                            \
+        float g_ = (got), w_ = (want);                                              \
+        if (!(isnan(g_) && isnan(w_)) && to_bits(g_) != to_bits(w_)) {              \
+            fprintf(stderr, "%s:%d: %s: %a, expected %a\n", __FILE__, __LINE__, #got, \
+                    g_, w_);                                                        \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+static const float specials[] = {
+    0.0f, -0.0f, INFINITY, -INFINITY, NAN, -NAN, FLT_TRUE_MIN, -FLT_TRUE_MIN, FLT_MIN, -FLT_MIN,
+    FLT_MAX, -FLT_MAX, 0x1p20f, -0x1p20f, 0x1p40f, -0x1p40f,
+};
+
+// Past expf's overflow and, for the fast tier, underflow limits
+static const float exp_limits[] = { 88.8f, 89.0f, -87.5f, -88.8f, -104.0f, -110.0f };
+
+static void test_specials(void) {
+    const int count = sizeof(specials) / sizeof(specials[0]);
+
+    for (int i = 0; i < count; i++) {
+        float x = specials[i], s, c;
+
+        CHECK_SAME(fastmath_sinf_precise(x), sinf(x));
+        CHECK_SAME(fastmath_sinf_fast(x), sinf(x));
+        CHECK_SAME(fastmath_cosf_precise(x), cosf(x));
+        CHECK_SAME(fastmath_cosf_fast(x), cosf(x));
+        fastmath_sincosf_precise(x, &s, &c);
+        CHECK_SAME(s, sinf(x));
+        CHECK_SAME(c, cosf(x));
+        fastmath_sincosf_fast(x, &s, &c);
+        CHECK_SAME(s, sinf(x));
+        CHECK_SAME(c, cosf(x));
+        CHECK_SAME(fastmath_expf_precise(x), expf(x));
+        CHECK_SAME(fastmath_expf_fast(x), expf(x));
+        CHECK_SAME(fastmath_logf_precise(x), logf(x));
+        CHECK_SAME(fastmath_logf_fast(x), logf(x));
+        CHECK_SAME(fastmath_atanf_precise(x), atanf(x));
+        CHECK_SAME(fastmath_atanf_fast(x), atanf(x));
+        CHECK_SAME(fastmath_sqrtf_vfp(x), sqrtf(x));
+
+        for (int j = 0; j < count; j++) {
+            float y = specials[j];
+            CHECK_SAME(fastmath_powf_precise(x, y), powf(x, y));
+            if (!isfinite(x) || !isfinite(y) || x == 0.0f || y == 0.0f) {
+                CHECK_SAME(fastmath_atan2f_precise(y, x), atan2f(y, x));
+                CHECK_SAME(fastmath_atan2f_fast(y, x), atan2f(y, x));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(exp_limits) / sizeof(exp_limits[0]); i++) {
+        CHECK_SAME(fastmath_expf_fast(exp_limits[i]), expf(exp_limits[i]));
+        if (exp_limits[i] > 0.0f || exp_limits[i] < -104.0f)
+            CHECK_SAME(fastmath_expf_precise(exp_limits[i]), expf(exp_limits[i]));
+    }
+
+    // One to any power, and minus one to an infinite one
+    CHECK_SAME(fastmath_powf_precise(1.0f, NAN), 1.0f);
+    CHECK_SAME(fastmath_powf_precise(1.0f, INFINITY), 1.0f);
+    CHECK_SAME(fastmath_powf_precise(-1.0f, -INFINITY), 1.0f);
+
+    // Negative bases go to the C library, odd integer exponents included
+    CHECK_SAME(fastmath_powf_precise(-2.0f, 3.0f), -8.0f);
+    CHECK_SAME(fastmath_powf_precise(-2.0f, 0.5f), powf(-2.0f, 0.5f));
+}
+
+int main(int argc, char **argv) {
+    uint32_t stride = (uint32_t) bench_iterations(argc, argv, 37);
+
+    test_specials();
+
+    sweep("sinf precise", fastmath_sinf_precise, sin, 0.6, stride);
+    sweep("sinf fast", fastmath_sinf_fast, sin, 1.51, stride);
+    sweep("cosf precise", fastmath_cosf_precise, cos, 0.6, stride);
+    sweep("cosf fast", fastmath_cosf_fast, cos, 1.54, stride);
+    sweep("sincosf precise", sincos_sin_precise, sin, 0.6, stride);
+    sweep("sincosf precise", sincos_cos_precise, cos, 0.6, stride);
+    sweep("sincosf fast", sincos_sin_fast, sin, 1.54, stride);
+    sweep("sincosf fast", sincos_cos_fast, cos, 1.54, stride);
+    sweep("expf precise", fastmath_expf_precise, exp, 0.6, stride);
+    sweep("expf fast", fastmath_expf_fast, exp, 0.97, stride);
+    sweep("logf precise", fastmath_logf_precise, log, 0.6, stride);
+    sweep("logf fast", fastmath_logf_fast, log, 0.79, stride);
+    sweep("atanf precise", fastmath_atanf_precise, atan, 0.6, stride);
+    sweep("atanf fast", fastmath_atanf_fast, atan, 3.33, stride);
+    sweep("sqrtf", fastmath_sqrtf_vfp, sqrt, 0.5, stride);
+
+    // 30M pairs at the default stride
+    test_pairs((long) (0x100000000 / stride / 4));
+    return 0;
+}
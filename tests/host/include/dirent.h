@@ -0,0 +1,11 @@
+/*
+ * Host stand-in: newlib's <dirent.h> is <sys/dirent.h>, so host builds get
+ * the Vita entry layout too. See tests/host/include/sys/dirent.h.
+ */
+
+#ifndef HOST_DIRENT_H
+#define HOST_DIRENT_H
+
+#include <sys/dirent.h>
+
+#endif // HOST_DIRENT_H
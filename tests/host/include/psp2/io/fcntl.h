@@ -0,0 +1,37 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. See tests/host/vita_host.c.
+ */
+
+#ifndef HOST_PSP2_IO_FCNTL_H
+#define HOST_PSP2_IO_FCNTL_H
+
+#include <psp2/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_O_RDONLY 0x0001
+#define SCE_O_WRONLY 0x0002
+#define SCE_O_RDWR   (SCE_O_RDONLY | SCE_O_WRONLY)
+#define SCE_O_APPEND 0x0100
+#define SCE_O_CREAT  0x0200
+#define SCE_O_TRUNC  0x0400
+
+#define SCE_SEEK_SET 0
+#define SCE_SEEK_CUR 1
+#define SCE_SEEK_END 2
+
+SceUID sceIoOpen(const char *file, int flags, int mode);
+int sceIoClose(SceUID fd);
+int sceIoRead(SceUID fd, void *data, SceSize size);
+int sceIoWrite(SceUID fd, const void *data, SceSize size);
+int sceIoPread(SceUID fd, void *data, SceSize size, SceOff offset);
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PSP2_IO_FCNTL_H
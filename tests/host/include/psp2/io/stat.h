@@ -0,0 +1,39 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. See tests/host/vita_host.c.
+ */
+
+#ifndef HOST_PSP2_IO_STAT_H
+#define HOST_PSP2_IO_STAT_H
+
+#include <psp2/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The Vita's own file type bits, not the POSIX ones.
+#define SCE_S_IFMT  0xF000
+#define SCE_S_IFLNK 0x4000
+#define SCE_S_IFDIR 0x1000
+#define SCE_S_IFREG 0x2000
+
+#define SCE_S_ISLNK(m) (((m) & SCE_S_IFMT) == SCE_S_IFLNK)
+#define SCE_S_ISREG(m) (((m) & SCE_S_IFMT) == SCE_S_IFREG)
+#define SCE_S_ISDIR(m) (((m) & SCE_S_IFMT) == SCE_S_IFDIR)
+
+typedef struct SceIoStat {
+    SceMode st_mode;
+    unsigned int st_attr;
+    SceOff st_size;
+    // st_ctime, st_atime and st_mtime, which glibc's <sys/stat.h> defines
+    // as macros.
+    SceDateTime st_times[3];
+    unsigned int st_private[6];
+} SceIoStat;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PSP2_IO_STAT_H
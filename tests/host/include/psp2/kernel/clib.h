@@ -0,0 +1,30 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. See tests/host/vita_host.c.
+ */
+
+#ifndef HOST_PSP2_KERNEL_CLIB_H
+#define HOST_PSP2_KERNEL_CLIB_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <psp2/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int sceClibPrintf(const char *fmt, ...);
+int sceClibSnprintf(char *dst, size_t len, const char *fmt, ...);
+int sceClibVsnprintf(char *dst, size_t len, const char *fmt, va_list args);
+void *sceClibMemcpy(void *dst, const void *src, size_t len);
+void *sceClibMemmove(void *dst, const void *src, size_t len);
+void *sceClibMemset(void *dst, int ch, size_t len);
+int sceClibStrcmp(const char *s1, const char *s2);
+void sceClibAbort(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PSP2_KERNEL_CLIB_H
@@ -0,0 +1,22 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. See tests/host/vita_host.c.
+ */
+
+#ifndef HOST_PSP2_KERNEL_PROCESSMGR_H
+#define HOST_PSP2_KERNEL_PROCESSMGR_H
+
+#include <psp2/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SceUInt64 sceKernelGetProcessTimeWide(void);
+SceUInt32 sceKernelGetProcessTimeLow(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PSP2_KERNEL_PROCESSMGR_H
@@ -0,0 +1,25 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. See tests/host/vita_host.c.
+ */
+
+#ifndef HOST_PSP2_KERNEL_SYSMEM_H
+#define HOST_PSP2_KERNEL_SYSMEM_H
+
+#include <psp2/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_KERNEL_MEMBLOCK_TYPE_USER_RW 0x0c20d060
+
+SceUID sceKernelAllocMemBlock(const char *name, int type, SceSize size, void *opt);
+int sceKernelFreeMemBlock(SceUID uid);
+int sceKernelGetMemBlockBase(SceUID uid, void **base);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PSP2_KERNEL_SYSMEM_H
@@ -0,0 +1,110 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. See tests/host/vita_host.c.
+ */
+
+#ifndef HOST_PSP2_KERNEL_THREADMGR_H
+#define HOST_PSP2_KERNEL_THREADMGR_H
+
+#include <psp2/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_KERNEL_ERROR_WAIT_TIMEOUT 0x80028005
+#define SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID 0x80028041
+
+#define SCE_KERNEL_LW_MUTEX_ATTR_RECURSIVE 0x00000002
+
+#define SCE_KERNEL_THREAD_CPU_AFFINITY_MASK_DEFAULT 0
+#define SCE_KERNEL_CPU_MASK_USER_0 0x00010000
+#define SCE_KERNEL_CPU_MASK_USER_1 0x00020000
+#define SCE_KERNEL_CPU_MASK_USER_2 0x00040000
+#define SCE_KERNEL_CPU_MASK_USER_ALL \
+    (SCE_KERNEL_CPU_MASK_USER_0 | SCE_KERNEL_CPU_MASK_USER_1 | SCE_KERNEL_CPU_MASK_USER_2)
+
+typedef int (*SceKernelThreadEntry)(SceSize args, void *argp);
+
+typedef struct SceKernelLwMutexWork {
+    SceInt64 data[4];
+} SceKernelLwMutexWork;
+
+typedef struct SceKernelLwCondWork {
+    SceInt64 data[4];
+} SceKernelLwCondWork;
+
+typedef struct SceKernelThreadInfo {
+    SceSize size;
+    SceUID processId;
+    char name[32];
+    SceUInt attr;
+    SceUInt status;
+    SceKernelThreadEntry entry;
+    void *stack;
+    SceInt32 stackSize;
+    SceInt32 initPriority;
+    SceInt32 currentPriority;
+    SceInt32 initCpuAffinityMask;
+    SceInt32 currentCpuAffinityMask;
+    SceInt32 currentCpuId;
+    SceInt32 lastExecutedCpuId;
+    SceUInt waitType;
+    SceUID waitId;
+    SceInt32 exitStatus;
+    SceKernelSysClock runClocks;
+    SceUInt intrPreemptCount;
+    SceUInt threadPreemptCount;
+    SceUInt threadReleaseCount;
+    SceInt32 changeCpuCount;
+    SceInt32 fNotifyCallback;
+    SceInt32 reserved;
+} SceKernelThreadInfo;
+
+int sceKernelCreateLwMutex(SceKernelLwMutexWork *work, const char *name, unsigned int attr,
+                           int initCount, const void *opt);
+int sceKernelDeleteLwMutex(SceKernelLwMutexWork *work);
+int sceKernelLockLwMutex(SceKernelLwMutexWork *work, int lockCount, unsigned int *timeout);
+int sceKernelTryLockLwMutex(SceKernelLwMutexWork *work, int lockCount);
+int sceKernelUnlockLwMutex(SceKernelLwMutexWork *work, int unlockCount);
+
+int sceKernelCreateLwCond(SceKernelLwCondWork *work, const char *name, unsigned int attr,
+                          SceKernelLwMutexWork *mutex, const void *opt);
+int sceKernelDeleteLwCond(SceKernelLwCondWork *work);
+int sceKernelWaitLwCond(SceKernelLwCondWork *work, unsigned int *timeout);
+int sceKernelSignalLwCond(SceKernelLwCondWork *work);
+int sceKernelSignalLwCondAll(SceKernelLwCondWork *work);
+
+SceUID sceKernelCreateSema(const char *name, SceUInt attr, int initVal, int maxVal, void *opt);
+int sceKernelDeleteSema(SceUID semaid);
+int sceKernelSignalSema(SceUID semaid, int signal);
+int sceKernelWaitSema(SceUID semaid, int signal, SceUInt *timeout);
+int sceKernelPollSema(SceUID semaid, int signal);
+
+SceUID sceKernelCreateMsgPipe(const char *name, int type, int attr, unsigned int bufSize, void *opt);
+int sceKernelDeleteMsgPipe(SceUID uid);
+int sceKernelSendMsgPipe(SceUID uid, const void *message, unsigned int size, int mode,
+                         void *result, unsigned int *timeout);
+int sceKernelReceiveMsgPipe(SceUID uid, void *message, SceSize size, int mode,
+                            void *result, unsigned int *timeout);
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority,
+                             SceSize stackSize, SceUInt attr, int cpuAffinityMask, const void *option);
+int sceKernelStartThread(SceUID thid, SceSize arglen, void *argp);
+int sceKernelExitDeleteThread(int status);
+int sceKernelWaitThreadEnd(SceUID thid, int *stat, SceUInt *timeout);
+int sceKernelDeleteThread(SceUID thid);
+SceUID sceKernelGetThreadId(void);
+int sceKernelGetThreadInfo(SceUID thid, SceKernelThreadInfo *info);
+int sceKernelChangeThreadPriority(SceUID thid, int priority);
+int sceKernelChangeThreadCpuAffinityMask(SceUID thid, int mask);
+int sceKernelGetThreadCpuAffinityMask(SceUID thid);
+
+int sceKernelDelayThread(SceUInt delay);
+int sceKernelDelayThreadCB(SceUInt delay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PSP2_KERNEL_THREADMGR_H
@@ -0,0 +1,12 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. No test reads the motion
+ * sensors yet.
+ */
+
+#ifndef HOST_PSP2_MOTION_H
+#define HOST_PSP2_MOTION_H
+
+#include <psp2/types.h>
+
+#endif // HOST_PSP2_MOTION_H
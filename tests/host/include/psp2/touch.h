@@ -0,0 +1,51 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. Tests that read the touch
+ * panels provide sceTouch* themselves.
+ */
+
+#ifndef HOST_PSP2_TOUCH_H
+#define HOST_PSP2_TOUCH_H
+
+#include <psp2/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCE_TOUCH_MAX_REPORT 8
+
+typedef enum SceTouchPortType {
+    SCE_TOUCH_PORT_FRONT = 0,
+    SCE_TOUCH_PORT_BACK  = 1,
+} SceTouchPortType;
+
+typedef enum SceTouchSamplingState {
+    SCE_TOUCH_SAMPLING_STATE_STOP  = 0,
+    SCE_TOUCH_SAMPLING_STATE_START = 1,
+} SceTouchSamplingState;
+
+typedef struct SceTouchReport {
+    SceUInt8 id;
+    SceUInt8 force;
+    SceInt16 x;
+    SceInt16 y;
+    SceInt8 reserved[8];
+    SceUInt16 info;
+} SceTouchReport;
+
+typedef struct SceTouchData {
+    SceUInt64 timeStamp;
+    SceUInt32 status;
+    SceUInt32 reportNum;
+    SceTouchReport report[SCE_TOUCH_MAX_REPORT];
+} SceTouchData;
+
+int sceTouchSetSamplingState(SceUInt32 port, SceTouchSamplingState state);
+int sceTouchPeek(SceUInt32 port, SceTouchData *pData, SceUInt32 nBufs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PSP2_TOUCH_H
@@ -0,0 +1,38 @@
+/*
+ * Host stand-in for the VitaSDK header of the same name, just enough for the
+ * loader sources built by tests/CMakeLists.txt. See tests/host/vita_host.c.
+ */
+
+#ifndef HOST_PSP2_TYPES_H
+#define HOST_PSP2_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int8_t SceInt8;
+typedef uint8_t SceUInt8;
+typedef int16_t SceInt16;
+typedef uint16_t SceUInt16;
+typedef int SceUID;
+typedef int SceInt;
+typedef unsigned int SceUInt;
+typedef int32_t SceInt32;
+typedef uint32_t SceUInt32;
+typedef int64_t SceInt64;
+typedef uint64_t SceUInt64;
+typedef unsigned int SceSize;
+typedef int64_t SceOff;
+typedef uint64_t SceKernelSysClock;
+typedef int SceMode;
+
+typedef struct SceDateTime {
+    unsigned short year;
+    unsigned short month;
+    unsigned short day;
+    unsigned short hour;
+    unsigned short minute;
+    unsigned short second;
+    unsigned int microsecond;
+} SceDateTime;
+
+#endif // HOST_PSP2_TYPES_H
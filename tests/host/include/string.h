@@ -0,0 +1,18 @@
+/*
+ * newlib's <string.h> has the BSD strlcpy(), which glibc only gained in
+ * 2.38. tests/host/vita_host.c provides it for older ones.
+ */
+
+#ifndef HOST_STRING_H
+#define HOST_STRING_H
+
+#include_next <string.h>
+
+#if !__GLIBC_PREREQ(2, 38)
+#ifdef __cplusplus
+extern "C"
+#endif
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+#endif // HOST_STRING_H
@@ -0,0 +1,35 @@
+/*
+ * Host stand-in for the Vita newlib header of the same name: directory
+ * entries carry an SceIoStat, which the loader converts to bionic dirents.
+ * opendir() and friends are implemented in tests/host/vita_host.c and, like
+ * on the Vita, don't list "." and "..".
+ */
+
+#ifndef HOST_SYS_DIRENT_H
+#define HOST_SYS_DIRENT_H
+
+#include <psp2/io/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dirent {
+    SceIoStat d_stat;
+    char d_name[256];
+    void *d_private;
+    int dir_default;
+};
+
+typedef struct host_dir DIR;
+
+DIR *opendir(const char *dirname);
+struct dirent *readdir(DIR *dirp);
+int closedir(DIR *dirp);
+void rewinddir(DIR *dirp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_SYS_DIRENT_H
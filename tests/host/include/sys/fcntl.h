@@ -0,0 +1,12 @@
+/*
+ * newlib's <sys/fcntl.h> also provides the <sys/types.h> types, which some
+ * loader headers rely on.
+ */
+
+#ifndef HOST_SYS_FCNTL_H
+#define HOST_SYS_FCNTL_H
+
+#include <sys/types.h>
+#include <fcntl.h>
+
+#endif // HOST_SYS_FCNTL_H
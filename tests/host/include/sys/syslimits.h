@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for the newlib header of the same name.
+ */
+
+#ifndef HOST_SYS_SYSLIMITS_H
+#define HOST_SYS_SYSLIMITS_H
+
+#include <limits.h>
+
+#endif // HOST_SYS_SYSLIMITS_H
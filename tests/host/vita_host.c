@@ -0,0 +1,754 @@
+/*
+ * tests/host/vita_host.c
+ *
+ * The parts of the Vita kernel and SceLibKernel that the loader sources
+ * under test call, implemented on POSIX so they can run on a Linux host.
+ * They follow the Vita semantics the loader relies on (recursive LwMutex
+ * attribute, timeouts in microseconds, SCE_KERNEL_ERROR_WAIT_TIMEOUT), not
+ * the full API.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#define _GNU_SOURCE
+
+#include <psp2/kernel/clib.h>
+#include <psp2/kernel/processmgr.h>
+#include <psp2/kernel/sysmem.h>
+#include <psp2/kernel/threadmgr.h>
+#include <psp2/io/fcntl.h>
+#include <psp2/io/stat.h>
+#include <sys/dirent.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HOST_MAX_OBJECTS 1024
+#define HOST_MAX_THREADS 256
+
+#define SCE_KERNEL_ERROR_ERROR 0x80020001
+
+static pthread_mutex_t host_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Absolute CLOCK_REALTIME time `timeout_us` from now, for pthread timed waits.
+static struct timespec abstime_in(unsigned int timeout_us) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_us / 1000000;
+    ts.tv_nsec += (long) (timeout_us % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+// ---------------------------------------------------------------- clib
+
+int sceClibPrintf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int ret = vprintf(fmt, args);
+    va_end(args);
+    return ret;
+}
+
+int sceClibSnprintf(char *dst, size_t len, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int ret = vsnprintf(dst, len, fmt, args);
+    va_end(args);
+    return ret;
+}
+
+int sceClibVsnprintf(char *dst, size_t len, const char *fmt, va_list args) {
+    return vsnprintf(dst, len, fmt, args);
+}
+
+void *sceClibMemcpy(void *dst, const void *src, size_t len) {
+    return memcpy(dst, src, len);
+}
+
+void *sceClibMemmove(void *dst, const void *src, size_t len) {
+    return memmove(dst, src, len);
+}
+
+void *sceClibMemset(void *dst, int ch, size_t len) {
+    return memset(dst, ch, len);
+}
+
+int sceClibStrcmp(const char *s1, const char *s2) {
+    return strcmp(s1, s2);
+}
+
+void sceClibAbort(void) {
+    abort();
+}
+
+// ---------------------------------------------------------------- time
+
+SceUInt64 sceKernelGetProcessTimeWide(void) {
+    return now_us(CLOCK_MONOTONIC);
+}
+
+SceUInt32 sceKernelGetProcessTimeLow(void) {
+    return (SceUInt32) now_us(CLOCK_MONOTONIC);
+}
+
+int sceKernelDelayThread(SceUInt delay) {
+    return usleep(delay);
+}
+
+int sceKernelDelayThreadCB(SceUInt delay) {
+    return usleep(delay);
+}
+
+// ---------------------------------------------------------------- LwMutex, LwCond
+
+// The work areas only hold a pointer to the host object.
+typedef struct host_lw_mutex {
+    pthread_mutex_t mutex;
+} host_lw_mutex;
+
+typedef struct host_lw_cond {
+    pthread_cond_t cond;
+    host_lw_mutex *mutex;
+} host_lw_cond;
+
+int sceKernelCreateLwMutex(SceKernelLwMutexWork *work, const char *name, unsigned int attr,
+                           int initCount, const void *opt) {
+    (void) name; (void) opt;
+    host_lw_mutex *m = malloc(sizeof(host_lw_mutex));
+    pthread_mutexattr_t ma;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_settype(&ma, (attr & SCE_KERNEL_LW_MUTEX_ATTR_RECURSIVE)
+                                   ? PTHREAD_MUTEX_RECURSIVE : PTHREAD_MUTEX_ERRORCHECK);
+    pthread_mutex_init(&m->mutex, &ma);
+    pthread_mutexattr_destroy(&ma);
+    for (int i = 0; i < initCount; i++)
+        pthread_mutex_lock(&m->mutex);
+
+    memset(work, 0, sizeof(*work));
+    memcpy(work, &m, sizeof(m));
+    return 0;
+}
+
+static host_lw_mutex *lw_mutex(SceKernelLwMutexWork *work) {
+    host_lw_mutex *m;
+    memcpy(&m, work, sizeof(m));
+    return m;
+}
+
+int sceKernelDeleteLwMutex(SceKernelLwMutexWork *work) {
+    host_lw_mutex *m = lw_mutex(work);
+    pthread_mutex_destroy(&m->mutex);
+    free(m);
+    memset(work, 0, sizeof(*work));
+    return 0;
+}
+
+int sceKernelLockLwMutex(SceKernelLwMutexWork *work, int lockCount, unsigned int *timeout) {
+    host_lw_mutex *m = lw_mutex(work);
+    for (int i = 0; i < lockCount; i++) {
+        int res;
+        if (timeout) {
+            struct timespec ts = abstime_in(*timeout);
+            res = pthread_mutex_timedlock(&m->mutex, &ts);
+        } else {
+            res = pthread_mutex_lock(&m->mutex);
+        }
+        if (res == ETIMEDOUT)
+            return (int) SCE_KERNEL_ERROR_WAIT_TIMEOUT;
+        if (res)
+            return (int) SCE_KERNEL_ERROR_ERROR;
+    }
+    return 0;
+}
+
+int sceKernelTryLockLwMutex(SceKernelLwMutexWork *work, int lockCount) {
+    host_lw_mutex *m = lw_mutex(work);
+    for (int i = 0; i < lockCount; i++) {
+        if (pthread_mutex_trylock(&m->mutex))
+            return (int) SCE_KERNEL_ERROR_ERROR;
+    }
+    return 0;
+}
+
+int sceKernelUnlockLwMutex(SceKernelLwMutexWork *work, int unlockCount) {
+    host_lw_mutex *m = lw_mutex(work);
+    for (int i = 0; i < unlockCount; i++) {
+        if (pthread_mutex_unlock(&m->mutex))
+            return (int) SCE_KERNEL_ERROR_ERROR;
+    }
+    return 0;
+}
+
+int sceKernelCreateLwCond(SceKernelLwCondWork *work, const char *name, unsigned int attr,
+                          SceKernelLwMutexWork *mutex, const void *opt) {
+    (void) name; (void) attr; (void) opt;
+    host_lw_cond *c = malloc(sizeof(host_lw_cond));
+    pthread_cond_init(&c->cond, NULL);
+    c->mutex = lw_mutex(mutex);
+
+    memset(work, 0, sizeof(*work));
+    memcpy(work, &c, sizeof(c));
+    return 0;
+}
+
+static host_lw_cond *lw_cond(SceKernelLwCondWork *work) {
+    host_lw_cond *c;
+    memcpy(&c, work, sizeof(c));
+    return c;
+}
+
+int sceKernelDeleteLwCond(SceKernelLwCondWork *work) {
+    host_lw_cond *c = lw_cond(work);
+    pthread_cond_destroy(&c->cond);
+    free(c);
+    memset(work, 0, sizeof(*work));
+    return 0;
+}
+
+int sceKernelWaitLwCond(SceKernelLwCondWork *work, unsigned int *timeout) {
+    host_lw_cond *c = lw_cond(work);
+    if (!timeout)
+        return pthread_cond_wait(&c->cond, &c->mutex->mutex) ? (int) SCE_KERNEL_ERROR_ERROR : 0;
+
+    struct timespec ts = abstime_in(*timeout);
+    int res = pthread_cond_timedwait(&c->cond, &c->mutex->mutex, &ts);
+    if (res == ETIMEDOUT)
+        return (int) SCE_KERNEL_ERROR_WAIT_TIMEOUT;
+    return res ? (int) SCE_KERNEL_ERROR_ERROR : 0;
+}
+
+int sceKernelSignalLwCond(SceKernelLwCondWork *work) {
+    return pthread_cond_signal(&lw_cond(work)->cond);
+}
+
+int sceKernelSignalLwCondAll(SceKernelLwCondWork *work) {
+    return pthread_cond_broadcast(&lw_cond(work)->cond);
+}
+
+// ---------------------------------------------------------------- Sema, MsgPipe
+
+// Semaphores and message pipes share one table of ids.
+typedef struct host_object {
+    int used;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;            // sema: current value
+    int max;              // sema: maximum value
+    unsigned char *buf;   // msgpipe: FIFO bytes
+    unsigned int size;    // msgpipe: capacity
+    unsigned int fill;    // msgpipe: bytes queued
+} host_object;
+
+static host_object objects[HOST_MAX_OBJECTS];
+
+static SceUID object_create(void) {
+    pthread_mutex_lock(&host_lock);
+    for (int i = 0; i < HOST_MAX_OBJECTS; i++) {
+        if (!objects[i].used) {
+            memset(&objects[i], 0, sizeof(host_object));
+            objects[i].used = 1;
+            pthread_mutex_init(&objects[i].lock, NULL);
+            pthread_cond_init(&objects[i].cond, NULL);
+            pthread_mutex_unlock(&host_lock);
+            return 0x10000 + i;
+        }
+    }
+    pthread_mutex_unlock(&host_lock);
+    return (SceUID) SCE_KERNEL_ERROR_ERROR;
+}
+
+static host_object *object_get(SceUID uid) {
+    int i = uid - 0x10000;
+    if (i < 0 || i >= HOST_MAX_OBJECTS || !objects[i].used)
+        return NULL;
+    return &objects[i];
+}
+
+static int object_delete(SceUID uid) {
+    host_object *o = object_get(uid);
+    if (!o)
+        return (int) SCE_KERNEL_ERROR_ERROR;
+    pthread_mutex_destroy(&o->lock);
+    pthread_cond_destroy(&o->cond);
+    free(o->buf);
+    pthread_mutex_lock(&host_lock);
+    o->used = 0;
+    pthread_mutex_unlock(&host_lock);
+    return 0;
+}
+
+SceUID sceKernelCreateSema(const char *name, SceUInt attr, int initVal, int maxVal, void *opt) {
+    (void) name; (void) attr; (void) opt;
+    SceUID uid = object_create();
+    host_object *o = object_get(uid);
+    if (o) {
+        o->count = initVal;
+        o->max = maxVal;
+    }
+    return uid;
+}
+
+int sceKernelDeleteSema(SceUID semaid) {
+    return object_delete(semaid);
+}
+
+int sceKernelSignalSema(SceUID semaid, int signal) {
+    host_object *o = object_get(semaid);
+    if (!o)
+        return (int) SCE_KERNEL_ERROR_ERROR;
+
+    pthread_mutex_lock(&o->lock);
+    int res = 0;
+    if (o->count + signal > o->max) {
+        res = (int) SCE_KERNEL_ERROR_ERROR;
+    } else {
+        o->count += signal;
+        pthread_cond_broadcast(&o->cond);
+    }
+    pthread_mutex_unlock(&o->lock);
+    return res;
+}
+
+int sceKernelWaitSema(SceUID semaid, int signal, SceUInt *timeout) {
+    host_object *o = object_get(semaid);
+    if (!o)
+        return (int) SCE_KERNEL_ERROR_ERROR;
+
+    struct timespec ts;
+    if (timeout)
+        ts = abstime_in(*timeout);
+
+    pthread_mutex_lock(&o->lock);
+    int res = 0;
+    while (o->count < signal && res == 0)
+        res = timeout ? pthread_cond_timedwait(&o->cond, &o->lock, &ts)
+                      : pthread_cond_wait(&o->cond, &o->lock);
+    if (o->count >= signal) {
+        o->count -= signal;
+        res = 0;
+    }
+    pthread_mutex_unlock(&o->lock);
+    return res == ETIMEDOUT ? (int) SCE_KERNEL_ERROR_WAIT_TIMEOUT : res;
+}
+
+int sceKernelPollSema(SceUID semaid, int signal) {
+    host_object *o = object_get(semaid);
+    if (!o)
+        return (int) SCE_KERNEL_ERROR_ERROR;
+
+    pthread_mutex_lock(&o->lock);
+    int res = (int) SCE_KERNEL_ERROR_ERROR;
+    if (o->count >= signal) {
+        o->count -= signal;
+        res = 0;
+    }
+    pthread_mutex_unlock(&o->lock);
+    return res;
+}
+
+// Message pipes only implement the non-blocking byte stream pseudo_pipe
+// uses: sends fail when the pipe is full, receives return what is there and
+// report the bytes left in `result`.
+SceUID sceKernelCreateMsgPipe(const char *name, int type, int attr, unsigned int bufSize, void *opt) {
+    (void) name; (void) type; (void) attr; (void) opt;
+    SceUID uid = object_create();
+    host_object *o = object_get(uid);
+    if (o) {
+        o->buf = malloc(bufSize);
+        o->size = bufSize;
+    }
+    return uid;
+}
+
+int sceKernelDeleteMsgPipe(SceUID uid) {
+    return object_delete(uid);
+}
+
+int sceKernelSendMsgPipe(SceUID uid, const void *message, unsigned int size, int mode,
+                         void *result, unsigned int *timeout) {
+    (void) mode; (void) result; (void) timeout;
+    host_object *o = object_get(uid);
+    if (!o)
+        return (int) SCE_KERNEL_ERROR_ERROR;
+
+    pthread_mutex_lock(&o->lock);
+    int res = (int) SCE_KERNEL_ERROR_ERROR;
+    if (o->size - o->fill >= size) {
+        memcpy(o->buf + o->fill, message, size);
+        o->fill += size;
+        res = 0;
+    }
+    pthread_mutex_unlock(&o->lock);
+    return res;
+}
+
+int sceKernelReceiveMsgPipe(SceUID uid, void *message, SceSize size, int mode,
+                            void *result, unsigned int *timeout) {
+    (void) mode; (void) timeout;
+    host_object *o = object_get(uid);
+    if (!o)
+        return (int) SCE_KERNEL_ERROR_ERROR;
+
+    pthread_mutex_lock(&o->lock);
+    if (size > o->fill)
+        size = o->fill;
+    memcpy(message, o->buf, size);
+    memmove(o->buf, o->buf + size, o->fill - size);
+    o->fill -= size;
+    if (result)
+        *(size_t *) result = o->fill;
+    pthread_mutex_unlock(&o->lock);
+    return 0;
+}
+
+// ---------------------------------------------------------------- threads
+
+typedef struct host_thread {
+    int used;
+    pthread_t pthread;
+    int started;
+    SceKernelThreadEntry entry;
+    char name[32];
+    int priority;
+    int affinity;
+    SceSize arglen;
+    void *argp;
+    int exit_status;
+} host_thread;
+
+static host_thread threads[HOST_MAX_THREADS];
+static __thread SceUID current_thid = 0;
+
+#define THID_BASE 0x40010000
+
+// Registers threads the loader didn't create itself (main, plain pthreads)
+// on first use, so every thread has an id.
+static SceUID thread_register_self(void) {
+    pthread_mutex_lock(&host_lock);
+    for (int i = 0; i < HOST_MAX_THREADS; i++) {
+        if (!threads[i].used) {
+            memset(&threads[i], 0, sizeof(host_thread));
+            threads[i].used = 1;
+            threads[i].started = 1;
+            threads[i].pthread = pthread_self();
+            threads[i].priority = 0x10000100;
+            snprintf(threads[i].name, sizeof(threads[i].name), "host_thread_%d", i);
+            current_thid = THID_BASE + i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&host_lock);
+    return current_thid;
+}
+
+static host_thread *thread_get(SceUID thid) {
+    if (thid == 0)
+        thid = sceKernelGetThreadId();
+    int i = thid - THID_BASE;
+    if (i < 0 || i >= HOST_MAX_THREADS || !threads[i].used)
+        return NULL;
+    return &threads[i];
+}
+
+SceUID sceKernelGetThreadId(void) {
+    return current_thid ? current_thid : thread_register_self();
+}
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority,
+                             SceSize stackSize, SceUInt attr, int cpuAffinityMask, const void *option) {
+    (void) stackSize; (void) attr; (void) option;
+    pthread_mutex_lock(&host_lock);
+    for (int i = 0; i < HOST_MAX_THREADS; i++) {
+        if (!threads[i].used) {
+            memset(&threads[i], 0, sizeof(host_thread));
+            threads[i].used = 1;
+            threads[i].entry = entry;
+            threads[i].priority = initPriority;
+            threads[i].affinity = cpuAffinityMask;
+            snprintf(threads[i].name, sizeof(threads[i].name), "%s", name ? name : "");
+            pthread_mutex_unlock(&host_lock);
+            return THID_BASE + i;
+        }
+    }
+    pthread_mutex_unlock(&host_lock);
+    return (SceUID) SCE_KERNEL_ERROR_ERROR;
+}
+
+static void *thread_trampoline(void *arg) {
+    host_thread *t = arg;
+    current_thid = THID_BASE + (SceUID) (t - threads);
+    t->exit_status = t->entry(t->arglen, t->argp);
+    return NULL;
+}
+
+int sceKernelStartThread(SceUID thid, SceSize arglen, void *argp) {
+    host_thread *t = thread_get(thid);
+    if (!t || t->started)
+        return (int) SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+
+    // Like the kernel, hand the entry point its own copy of the arguments.
+    t->arglen = arglen;
+    t->argp = NULL;
+    if (argp && arglen) {
+        t->argp = malloc(arglen);
+        memcpy(t->argp, argp, arglen);
+    }
+    t->started = 1;
+    return pthread_create(&t->pthread, NULL, thread_trampoline, t) ? (int) SCE_KERNEL_ERROR_ERROR : 0;
+}
+
+int sceKernelExitDeleteThread(int status) {
+    host_thread *t = thread_get(0);
+    if (t) {
+        t->exit_status = status;
+        pthread_detach(t->pthread);
+        free(t->argp);
+        t->used = 0;
+    }
+    pthread_exit(NULL);
+}
+
+int sceKernelWaitThreadEnd(SceUID thid, int *stat, SceUInt *timeout) {
+    (void) timeout;
+    host_thread *t = thread_get(thid);
+    if (!t)
+        return (int) SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+    pthread_join(t->pthread, NULL);
+    if (stat)
+        *stat = t->exit_status;
+    return 0;
+}
+
+int sceKernelDeleteThread(SceUID thid) {
+    host_thread *t = thread_get(thid);
+    if (!t)
+        return (int) SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+    free(t->argp);
+    t->used = 0;
+    return 0;
+}
+
+int sceKernelGetThreadInfo(SceUID thid, SceKernelThreadInfo *info) {
+    host_thread *t = thread_get(thid);
+    if (!t)
+        return (int) SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+
+    memset(info, 0, sizeof(*info));
+    info->size = sizeof(*info);
+    snprintf(info->name, sizeof(info->name), "%s", t->name);
+    info->entry = t->entry;
+    info->initPriority = t->priority;
+    info->currentPriority = t->priority;
+    info->initCpuAffinityMask = t->affinity;
+    info->currentCpuAffinityMask = t->affinity;
+
+    clockid_t clock;
+    if (t->started && pthread_getcpuclockid(t->pthread, &clock) == 0)
+        info->runClocks = now_us(clock);
+    return 0;
+}
+
+int sceKernelChangeThreadPriority(SceUID thid, int priority) {
+    host_thread *t = thread_get(thid);
+    if (!t)
+        return (int) SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+    t->priority = priority;
+    return 0;
+}
+
+int sceKernelChangeThreadCpuAffinityMask(SceUID thid, int mask) {
+    host_thread *t = thread_get(thid);
+    if (!t)
+        return (int) SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+    t->affinity = mask;
+    return 0;
+}
+
+int sceKernelGetThreadCpuAffinityMask(SceUID thid) {
+    host_thread *t = thread_get(thid);
+    return t ? t->affinity : (int) SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+}
+
+// ---------------------------------------------------------------- memory
+
+#define HOST_MAX_BLOCKS 256
+
+static void *blocks[HOST_MAX_BLOCKS];
+
+SceUID sceKernelAllocMemBlock(const char *name, int type, SceSize size, void *opt) {
+    (void) name; (void) type; (void) opt;
+    void *base = aligned_alloc(4096, (size + 4095) & ~(SceSize) 4095);
+    if (!base)
+        return (SceUID) SCE_KERNEL_ERROR_ERROR;
+
+    pthread_mutex_lock(&host_lock);
+    for (int i = 0; i < HOST_MAX_BLOCKS; i++) {
+        if (!blocks[i]) {
+            blocks[i] = base;
+            pthread_mutex_unlock(&host_lock);
+            return 0x20000 + i;
+        }
+    }
+    pthread_mutex_unlock(&host_lock);
+    free(base);
+    return (SceUID) SCE_KERNEL_ERROR_ERROR;
+}
+
+int sceKernelFreeMemBlock(SceUID uid) {
+    int i = uid - 0x20000;
+    if (i < 0 || i >= HOST_MAX_BLOCKS || !blocks[i])
+        return (int) SCE_KERNEL_ERROR_ERROR;
+    pthread_mutex_lock(&host_lock);
+    free(blocks[i]);
+    blocks[i] = NULL;
+    pthread_mutex_unlock(&host_lock);
+    return 0;
+}
+
+int sceKernelGetMemBlockBase(SceUID uid, void **base) {
+    int i = uid - 0x20000;
+    if (i < 0 || i >= HOST_MAX_BLOCKS || !blocks[i])
+        return (int) SCE_KERNEL_ERROR_ERROR;
+    *base = blocks[i];
+    return 0;
+}
+
+// ---------------------------------------------------------------- io
+
+SceUID sceIoOpen(const char *file, int flags, int mode) {
+    int oflags = 0;
+    switch (flags & SCE_O_RDWR) {
+        case SCE_O_WRONLY: oflags = O_WRONLY; break;
+        case SCE_O_RDWR: oflags = O_RDWR; break;
+        default: oflags = O_RDONLY; break;
+    }
+    if (flags & SCE_O_APPEND) oflags |= O_APPEND;
+    if (flags & SCE_O_CREAT) oflags |= O_CREAT;
+    if (flags & SCE_O_TRUNC) oflags |= O_TRUNC;
+
+    int fd = open(file, oflags, mode ? mode : 0666);
+    return fd >= 0 ? fd : (SceUID) (0x80010000 | errno);
+}
+
+int sceIoClose(SceUID fd) {
+    return close(fd) ? (int) (0x80010000 | errno) : 0;
+}
+
+int sceIoRead(SceUID fd, void *data, SceSize size) {
+    ssize_t n = read(fd, data, size);
+    return n >= 0 ? (int) n : (int) (0x80010000 | errno);
+}
+
+int sceIoWrite(SceUID fd, const void *data, SceSize size) {
+    ssize_t n = write(fd, data, size);
+    return n >= 0 ? (int) n : (int) (0x80010000 | errno);
+}
+
+int sceIoPread(SceUID fd, void *data, SceSize size, SceOff offset) {
+    ssize_t n = pread(fd, data, size, offset);
+    return n >= 0 ? (int) n : (int) (0x80010000 | errno);
+}
+
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence) {
+    off_t pos = lseek(fd, offset, whence == SCE_SEEK_END ? SEEK_END : whence == SCE_SEEK_CUR ? SEEK_CUR : SEEK_SET);
+    return pos >= 0 ? pos : (SceOff) (int) (0x80010000 | errno);
+}
+
+// ---------------------------------------------------------------- newlib dirent
+
+// Read straight from the kernel: glibc's opendir() is what this replaces.
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+struct host_dir {
+    int fd;
+    char buf[4096];
+    int len;
+    int pos;
+    struct dirent entry;
+};
+
+DIR *opendir(const char *dirname) {
+    int fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    DIR *d = calloc(1, sizeof(DIR));
+    if (!d) {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    d->fd = fd;
+    return d;
+}
+
+struct dirent *readdir(DIR *d) {
+    for (;;) {
+        if (d->pos >= d->len) {
+            long n = syscall(SYS_getdents64, d->fd, d->buf, sizeof(d->buf));
+            if (n <= 0) return NULL;
+            d->len = (int) n;
+            d->pos = 0;
+        }
+
+        struct linux_dirent64 *e = (struct linux_dirent64 *) (d->buf + d->pos);
+        d->pos += e->d_reclen;
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+
+        struct stat st;
+        if (fstatat(d->fd, e->d_name, &st, 0) != 0) continue;
+
+        memset(&d->entry, 0, sizeof(d->entry));
+        d->entry.d_stat.st_mode = (S_ISDIR(st.st_mode) ? SCE_S_IFDIR : SCE_S_IFREG) | (st.st_mode & 0777);
+        d->entry.d_stat.st_size = st.st_size;
+        snprintf(d->entry.d_name, sizeof(d->entry.d_name), "%s", e->d_name);
+        return &d->entry;
+    }
+}
+
+void rewinddir(DIR *d) {
+    lseek(d->fd, 0, SEEK_SET);
+    d->len = d->pos = 0;
+}
+
+int closedir(DIR *d) {
+    int ret = close(d->fd);
+    free(d);
+    return ret;
+}
+
+#if !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
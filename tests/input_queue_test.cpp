@@ -0,0 +1,137 @@
+/*
+ * tests/input_queue_test.cpp
+ *
+ * What AInputQueue does when the game stops reading events: moves get
+ * coalesced or dropped, key and pointer down/up events are all delivered, in
+ * order. AInput.cpp is built into this file to reach the queue internals;
+ * controls_init() is stubbed so no input thread runs.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "AFakeNative/AInput.cpp"
+
+#include "test.h"
+
+void controls_init(AInputQueue *) {}
+
+static int64_t seq = 0;
+
+static void enqueueKey(AInputQueue *queue, int action) {
+    inputEvent e = {};
+    e.source = AINPUT_SOURCE_GAMEPAD;
+    e.type = AINPUT_EVENT_TYPE_KEY;
+    e.action = action;
+    e.keycode = AKEYCODE_BUTTON_A;
+    e.event_time = ++seq;
+    AInputQueue_enqueueEvent(queue, AInputEvent_create(&e));
+}
+
+static void enqueuePointer(AInputQueue *queue, int action) {
+    inputEvent e = {};
+    e.source = AINPUT_SOURCE_TOUCHSCREEN;
+    e.type = AINPUT_EVENT_TYPE_MOTION;
+    e.motion_action = action;
+    e.motion_ptrcount = 1;
+    e.event_time = ++seq;
+    AInputQueue_enqueueEvent(queue, AInputEvent_create(&e));
+}
+
+struct Read {
+    int64_t time;
+    bool move;
+};
+
+static std::vector<Read> drain(AInputQueue *queue) {
+    std::vector<Read> events;
+    AInputEvent *event;
+    while (AInputQueue_getEvent(queue, &event) == 0) {
+        events.push_back({ AMotionEvent_getEventTime(event), isMoveEvent(reinterpret_cast<inputEvent *>(event)) });
+        AInputQueue_finishEvent(queue, event, 1);
+    }
+    return events;
+}
+
+static size_t countMoves(const std::vector<Read>& events) {
+    size_t n = 0;
+    for (const Read& r : events) n += r.move;
+    return n;
+}
+
+static void checkOrdered(const std::vector<Read>& events) {
+    for (size_t i = 1; i < events.size(); i++) {
+        CHECK(events[i - 1].time < events[i].time);
+    }
+}
+
+// A queue full of transitions grows instead of dropping one, and a move that
+// arrives then is the one dropped.
+static void testFullOfTransitions(AInputQueue *queue) {
+    const int presses = INPUT_QUEUE_CAPACITY;
+    for (int i = 0; i < presses; i++) {
+        enqueueKey(queue, AKEY_EVENT_ACTION_DOWN);
+        enqueueKey(queue, AKEY_EVENT_ACTION_UP);
+    }
+    enqueuePointer(queue, AMOTION_EVENT_ACTION_MOVE);
+    enqueuePointer(queue, AMOTION_EVENT_ACTION_DOWN);
+    enqueuePointer(queue, AMOTION_EVENT_ACTION_UP);
+
+    std::vector<Read> events = drain(queue);
+    CHECK_EQ(events.size(), (size_t) presses * 2 + 2);
+    CHECK_EQ(countMoves(events), 0);
+    checkOrdered(events);
+}
+
+// Moves between transitions can't be coalesced; once the queue is full the
+// oldest of them make room for whatever comes next.
+static void testOldestMoveEvicted(AInputQueue *queue) {
+    // Reset the ring to its first slots; it may have grown above.
+    drain(queue);
+    const size_t capacity = reinterpret_cast<inputQueue *>(queue)->mPendingCapacity;
+    for (size_t i = 0; i < capacity / 2; i++) {
+        enqueuePointer(queue, AMOTION_EVENT_ACTION_MOVE);
+        enqueueKey(queue, (i % 2) ? AKEY_EVENT_ACTION_UP : AKEY_EVENT_ACTION_DOWN);
+    }
+    int64_t firstMove = seq - (int64_t) capacity + 1;
+
+    enqueueKey(queue, AKEY_EVENT_ACTION_DOWN);
+    enqueuePointer(queue, AMOTION_EVENT_ACTION_MOVE);
+    enqueueKey(queue, AKEY_EVENT_ACTION_UP);
+
+    std::vector<Read> events = drain(queue);
+    CHECK_EQ(events.size(), capacity);
+    CHECK_EQ(countMoves(events), capacity / 2 - 2);
+    CHECK_EQ(events.size() - countMoves(events), capacity / 2 + 2);
+    checkOrdered(events);
+    // The first two moves are gone, the last one made it.
+    CHECK(events[0].time == firstMove + 1 && !events[0].move);
+    CHECK(events[events.size() - 2].move);
+}
+
+// Consecutive moves of the same pointers still collapse into one event.
+static void testMovesCoalesce(AInputQueue *queue) {
+    enqueuePointer(queue, AMOTION_EVENT_ACTION_DOWN);
+    for (int i = 0; i < 1000; i++) {
+        enqueuePointer(queue, AMOTION_EVENT_ACTION_MOVE);
+    }
+    enqueuePointer(queue, AMOTION_EVENT_ACTION_UP);
+
+    std::vector<Read> events = drain(queue);
+    CHECK_EQ(events.size(), 3);
+    CHECK(events[1].move);
+    CHECK_EQ(events[1].time, seq - 1);
+}
+
+int main() {
+    AInputQueue *queue = AInputQueue_create();
+    CHECK(queue != nullptr);
+
+    testFullOfTransitions(queue);
+    testOldestMoveEvicted(queue);
+    testMovesCoalesce(queue);
+
+    // Everything was handed back to the pool.
+    CHECK_EQ(g_eventPoolFreeCount, INPUT_EVENT_POOL_SIZE);
+    return 0;
+}
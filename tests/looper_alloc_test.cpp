@@ -0,0 +1,122 @@
+/*
+ * tests/looper_alloc_test.cpp
+ *
+ * Counts heap allocations made while a looper polls a callback fd, a
+ * non-callback fd and due messages, and checks that there are none once the
+ * looper is warmed up.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "AFakeNative/ALooper.h"
+#include "AFakeNative/PseudoEpoll.h"
+#include "AFakeNative/polling/pseudo_eventfd.h"
+
+#include "test.h"
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t align, size_t size);
+
+// operator new goes through malloc, so this sees C++ allocations too.
+static bool counting = false;
+static long allocations = 0;
+
+extern "C" void *malloc(size_t size) {
+    if (counting) allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    if (counting) allocations++;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    if (counting) allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t align, size_t size) {
+    if (counting) allocations++;
+    return __libc_memalign(align, size);
+}
+
+static const int IDENT = 7;
+static const int WARMUP = 64;
+static const int POLLS = 10000;
+
+static int callbacks = 0;
+static int messages = 0;
+
+static int onInput(int fd, int events, void *) {
+    CHECK(events & ALOOPER_EVENT_INPUT);
+    uint64_t value;
+    CHECK_EQ(pseudo_read(fd, &value, sizeof(value)), sizeof(value));
+    callbacks++;
+    return 1;
+}
+
+static void onMessage(int, void *) {
+    messages++;
+}
+
+static void signal(int fd) {
+    uint64_t one = 1;
+    CHECK_EQ(pseudo_write(fd, &one, sizeof(one)), sizeof(one));
+}
+
+// One cycle of what a game's main loop sees: input on the callback fd, the
+// app glue fd ready, a message posted for the next poll.
+static void cycle(ALooper *looper, int callbackFd, int identFd) {
+    signal(callbackFd);
+    signal(identFd);
+    CHECK_EQ(ALooper_sendMessage(looper, onMessage, 0, nullptr), 1);
+
+    int fd = -1, events = 0;
+    void *data = nullptr;
+    bool sawIdent = false;
+    for (;;) {
+        int res = ALooper_pollOnce(0, &fd, &events, &data);
+        if (res == IDENT) {
+            CHECK_EQ(fd, identFd);
+            uint64_t value;
+            CHECK_EQ(pseudo_read(identFd, &value, sizeof(value)), sizeof(value));
+            sawIdent = true;
+        } else if (res == ALOOPER_POLL_TIMEOUT) {
+            break;
+        } else {
+            CHECK(res == ALOOPER_POLL_CALLBACK || res == ALOOPER_POLL_WAKE);
+        }
+    }
+    CHECK(sawIdent);
+}
+
+int main() {
+    ALooper *looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+    CHECK(looper != nullptr);
+
+    int callbackFd = pseudo_eventfd(0, PSEUDO_EFD_NONBLOCK);
+    int identFd = pseudo_eventfd(0, PSEUDO_EFD_NONBLOCK);
+    CHECK(callbackFd >= 0 && identFd >= 0);
+    CHECK_EQ(ALooper_addFd(looper, callbackFd, 0, ALOOPER_EVENT_INPUT, onInput, nullptr), 1);
+    CHECK_EQ(ALooper_addFd(looper, identFd, IDENT, ALOOPER_EVENT_INPUT, nullptr, nullptr), 1);
+
+    for (int i = 0; i < WARMUP; i++) {
+        cycle(looper, callbackFd, identFd);
+    }
+
+    counting = true;
+    for (int i = 0; i < POLLS; i++) {
+        cycle(looper, callbackFd, identFd);
+    }
+    counting = false;
+
+    CHECK_EQ(callbacks, WARMUP + POLLS);
+    CHECK_EQ(messages, WARMUP + POLLS);
+    printf("%ld allocations in %d poll cycles\n", (long) allocations, POLLS);
+    CHECK_EQ(allocations, 0);
+    return 0;
+}
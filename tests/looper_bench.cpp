@@ -0,0 +1,87 @@
+/*
+ * tests/looper_bench.cpp
+ *
+ * Enqueue and dispatch throughput of the ALooper message queue at several
+ * queue depths, with messages due in random order. Also checks that they are
+ * delivered by due time, and in send order for equal due times.
+ *
+ * Usage: looper_bench [rounds]
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "AFakeNative/ALooper.h"
+#include "AFakeNative/AFakeNative_Utils.h"
+
+#include <vector>
+
+#include "test.h"
+
+struct Sent {
+    uint64_t uptime;
+    int what;
+};
+
+static std::vector<Sent> sent;
+static int delivered = 0;
+static uint64_t lastUptime = 0;
+static int lastWhat = -1;
+
+static void handler(int what, void *) {
+    const Sent& s = sent[what];
+    CHECK(s.uptime >= lastUptime);
+    if (s.uptime == lastUptime) CHECK(what > lastWhat);
+    lastUptime = s.uptime;
+    lastWhat = what;
+    delivered++;
+}
+
+int main(int argc, char **argv) {
+    long rounds = bench_iterations(argc, argv, 200);
+    const int depths[] = { 1, 16, 256, 4096 };
+
+    ALooper *looper = ALooper_prepare(0);
+    CHECK(looper != nullptr);
+    srand(1);
+
+    printf("%8s %14s %14s\n", "depth", "enqueue ns/msg", "dispatch ns/msg");
+    for (int depth : depths) {
+        uint64_t enqueueNs = 0, dispatchNs = 0;
+        sent.resize(depth);
+
+        for (long r = 0; r < rounds; r++) {
+            // Due times spread over the last second, with duplicates.
+            uint64_t now = AFN_timeMillis();
+            for (int i = 0; i < depth; i++) {
+                sent[i].uptime = now - 1000 + rand() % 1000;
+                sent[i].what = i;
+            }
+
+            uint64_t t0 = test_now_ns();
+            for (int i = 0; i < depth; i++) {
+                CHECK_EQ(ALooper_sendMessageAtTime(looper, sent[i].uptime, handler, i, nullptr), 1);
+            }
+            uint64_t t1 = test_now_ns();
+
+            delivered = 0;
+            lastUptime = 0;
+            lastWhat = -1;
+            while (delivered < depth) {
+                CHECK_EQ(ALooper_pollOnce(0, nullptr, nullptr, nullptr), ALOOPER_POLL_CALLBACK);
+            }
+            uint64_t t2 = test_now_ns();
+
+            enqueueNs += t1 - t0;
+            dispatchNs += t2 - t1;
+        }
+
+        printf("%8d %14.1f %14.1f\n", depth,
+               (double) enqueueNs / ((double) rounds * depth),
+               (double) dispatchNs / ((double) rounds * depth));
+    }
+
+    // Nothing left over.
+    CHECK_EQ(ALooper_pollOnce(0, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * tests/looper_pacing_test.cpp
+ *
+ * Frame pacing deadlines and ALooper_pollAll() timeouts against a fake
+ * clock. The test provides clock_monotonic_us() and wraps usleep(), which
+ * PseudoEpoll sleeps with, so time only moves when the looper waits or a
+ * callback pretends to work. ALooper.cpp is built into this file to reach
+ * framePacedTimeout() and the pacing state.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "AFakeNative/ALooper.cpp"
+
+#include <unistd.h>
+
+#include "test.h"
+
+// PseudoEpoll polls in 10 ms steps but cuts the last one short, so waits
+// end on their deadline. The slack only covers millisecond rounding; a
+// whole step late would miss most of a 16 ms frame.
+static const uint64_t WAIT_SLACK_MS = 1;
+
+static uint64_t fake_us = 1000000;
+
+extern "C" uint64_t clock_monotonic_us(void) {
+    return fake_us;
+}
+
+extern "C" int __wrap_usleep(useconds_t us) {
+    fake_us += us;
+    return 0;
+}
+
+static uint64_t now_ms() {
+    return fake_us / 1000;
+}
+
+static void advance_ms(uint64_t ms) {
+    fake_us += ms * 1000;
+}
+
+static void testFramePacedTimeout() {
+    // No frame presented yet: don't hold the poll.
+    CHECK_EQ(framePacedTimeout(5000, 0, 16, 4), 0);
+
+    // 16 ms frames, 4 ms of work + FRAME_PACING_MARGIN: return 10 ms after the swap.
+    CHECK_EQ(framePacedTimeout(5000, 5000, 16, 4), 10);
+    CHECK_EQ(framePacedTimeout(5003, 5000, 16, 4), 7);
+    CHECK_EQ(framePacedTimeout(5010, 5000, 16, 4), 0);
+    CHECK_EQ(framePacedTimeout(5030, 5000, 16, 4), 0);
+
+    // Work that doesn't fit in a frame leaves no time to wait.
+    CHECK_EQ(framePacedTimeout(5000, 5000, 16, 14), 0);
+    CHECK_EQ(framePacedTimeout(5000, 5000, 16, 20), 0);
+}
+
+static int busyFd;
+static int busyCallbacks;
+
+// Always ready again, and takes 3 ms to handle.
+static int onBusy(int fd, int, void *) {
+    uint64_t value = 1;
+    pseudo_read(fd, &value, sizeof(value));
+    pseudo_write(fd, &value, sizeof(value));
+    advance_ms(3);
+    busyCallbacks++;
+    return 1;
+}
+
+static int messagesSeen;
+
+static void onMessage(int, void *) {
+    messagesSeen++;
+}
+
+static void testPollAllTimeout(ALooper *looper) {
+    // Nothing happens: times out once.
+    uint64_t start = now_ms();
+    CHECK_EQ(ALooper_pollAll(50, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    uint64_t elapsed = now_ms() - start;
+    CHECK(elapsed >= 50 && elapsed <= 50 + WAIT_SLACK_MS);
+
+    // A message due in the middle is delivered, and the wait after it only
+    // covers what is left of the timeout. Posting it wakes the looper first.
+    start = now_ms();
+    messagesSeen = 0;
+    ALooper_sendMessageAtTime(looper, start + 30, onMessage, 0, nullptr);
+    CHECK_EQ(ALooper_pollOnce(0, nullptr, nullptr, nullptr), ALOOPER_POLL_WAKE);
+    CHECK_EQ(ALooper_pollAll(50, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    elapsed = now_ms() - start;
+    CHECK_EQ(messagesSeen, 1);
+    CHECK(elapsed >= 50 && elapsed <= 50 + WAIT_SLACK_MS);
+
+    // A callback that is always ready used to keep pollAll() going forever.
+    busyFd = pseudo_eventfd(1, PSEUDO_EFD_NONBLOCK);
+    CHECK(busyFd >= 0);
+    CHECK_EQ(ALooper_addFd(looper, busyFd, 0, ALOOPER_EVENT_INPUT, onBusy, nullptr), 1);
+    start = now_ms();
+    busyCallbacks = 0;
+    CHECK_EQ(ALooper_pollAll(50, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    elapsed = now_ms() - start;
+    CHECK(busyCallbacks >= 50 / 3);
+    CHECK(elapsed >= 50 && elapsed < 50 + 3);
+    CHECK_EQ(ALooper_removeFd(looper, busyFd), 1);
+}
+
+static void onOtherMessage(int, void *) {
+    messagesSeen++;
+}
+
+static void testRemoveMessages(ALooper *looper) {
+    auto *self = (internal_ALooper *) looper;
+    uint64_t start = now_ms();
+
+    // Removing the head moves the next wakeup to the new head, removing
+    // the rest clears it.
+    ALooper_sendMessageAtTime(looper, start + 30, onMessage, 0, nullptr);
+    ALooper_sendMessageAtTime(looper, start + 60, onOtherMessage, 0, nullptr);
+    CHECK_EQ(self->mNextMessageUptime, start + 30);
+    CHECK_EQ(ALooper_removeMessages(looper, onMessage, -1), 1);
+    CHECK_EQ(self->mNextMessageUptime, start + 60);
+    CHECK_EQ(ALooper_removeMessages(looper, onOtherMessage, -1), 1);
+    CHECK_EQ(self->mNextMessageUptime, (uint64_t) LLONG_MAX);
+
+    // So the looper sleeps for the whole timeout instead of waking at 30 ms
+    CHECK_EQ(ALooper_pollOnce(0, nullptr, nullptr, nullptr), ALOOPER_POLL_WAKE);
+    start = now_ms();
+    CHECK_EQ(ALooper_pollOnce(50, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    CHECK(now_ms() - start >= 50);
+}
+
+static void testFramePacing() {
+    ALooper_setFramePacing(1);
+
+    // Two swaps 16 ms apart, the interval estimate stays at 16 ms.
+    ALooper_onFrameSwap();
+    advance_ms(16);
+    ALooper_onFrameSwap();
+    CHECK_EQ(gFrameIntervalMillis, 16);
+    CHECK_EQ(ALooper_getLastFrameSwapMillis(), now_ms());
+
+    // No work measured yet: a non-blocking poll is held until
+    // FRAME_PACING_MARGIN before the next swap.
+    uint64_t swap = now_ms();
+    advance_ms(1);
+    CHECK_EQ(ALooper_pollAll(0, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    uint64_t deadline = swap + 16 - FRAME_PACING_MARGIN;
+    CHECK(now_ms() >= deadline && now_ms() <= deadline + WAIT_SLACK_MS);
+
+    // The game then works 6 ms before presenting: the next poll leaves room for it.
+    advance_ms(6);
+    ALooper_onFrameSwap();
+    CHECK_EQ(gFrameWorkMillis, 6);
+    swap = now_ms();
+    CHECK_EQ(ALooper_pollAll(0, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    deadline = swap + gFrameIntervalMillis - 6 - FRAME_PACING_MARGIN;
+    CHECK(now_ms() >= deadline && now_ms() <= deadline + WAIT_SLACK_MS);
+
+    // A shorter timeout from the game still wins.
+    advance_ms(6);
+    ALooper_onFrameSwap();
+    swap = now_ms();
+    CHECK_EQ(ALooper_pollAll(1, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    CHECK(now_ms() - swap <= 1 + WAIT_SLACK_MS);
+
+    // Disabled again, a non-blocking poll returns right away.
+    ALooper_setFramePacing(0);
+    swap = now_ms();
+    CHECK_EQ(ALooper_pollAll(0, nullptr, nullptr, nullptr), ALOOPER_POLL_TIMEOUT);
+    CHECK_EQ(now_ms(), swap);
+}
+
+int main() {
+    ALooper *looper = ALooper_prepare(0);
+    CHECK(looper != nullptr);
+
+    testFramePacedTimeout();
+    testPollAllTimeout(looper);
+    testRemoveMessages(looper);
+    testFramePacing();
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * tests/mmap_test.c
+ *
+ * The mmap()/munmap() emulation: partial unmaps, MAP_FIXED inside a
+ * mapping, file-backed mappings with a zeroed tail, and when the memory
+ * behind a mapping is given back. Memory block and heap releases are
+ * observed by wrapping sceKernelAllocMemBlock/sceKernelFreeMemBlock and
+ * free() at link time.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/mem.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <psp2/kernel/sysmem.h>
+
+#include "test.h"
+
+#define PAGE MMAP_PAGE_SIZE
+#define ANON (MAP_PRIVATE | MAP_ANONYMOUS)
+#define DATA_FILE DATA_PATH "mmap_test.bin"
+
+SceUID __real_sceKernelAllocMemBlock(const char *name, int type, SceSize size, void *opt);
+int __real_sceKernelFreeMemBlock(SceUID uid);
+void __real_free(void *ptr);
+
+static int blocks_live = 0;
+static int fail_blocks = 0;
+static void *watched = NULL; // heap pointer whose release we wait for
+static int watched_freed = 0;
+
+SceUID __wrap_sceKernelAllocMemBlock(const char *name, int type, SceSize size, void *opt) {
+    if (fail_blocks)
+        return (SceUID) 0x80020001;
+    SceUID uid = __real_sceKernelAllocMemBlock(name, type, size, opt);
+    if (uid >= 0)
+        blocks_live++;
+    return uid;
+}
+
+int __wrap_sceKernelFreeMemBlock(SceUID uid) {
+    blocks_live--;
+    return __real_sceKernelFreeMemBlock(uid);
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr && ptr == watched)
+        watched_freed = 1;
+    __real_free(ptr);
+}
+
+static void watch(void *ptr) {
+    watched = ptr;
+    watched_freed = 0;
+}
+
+static void test_anonymous(void) {
+    // Small: from the heap, page aligned and zeroed.
+    uint8_t *a = mmap(NULL, 100, PROT_READ | PROT_WRITE, ANON, -1, 0);
+    CHECK(a != MAP_FAILED);
+    CHECK_EQ((uintptr_t) a & (PAGE - 1), 0);
+    for (int i = 0; i < PAGE; i++) CHECK_EQ(a[i], 0);
+    watch(a);
+    CHECK_EQ(munmap(a, 100), 0);
+    CHECK(watched_freed);
+
+    // Large: a memory block of its own.
+    uint8_t *b = mmap(NULL, 2 * MMAP_BLOCK_THRESHOLD, PROT_READ | PROT_WRITE, ANON, -1, 0);
+    CHECK(b != MAP_FAILED);
+    CHECK_EQ(blocks_live, 1);
+    CHECK_EQ(b[12345], 0);
+    CHECK_EQ(munmap(b, 2 * MMAP_BLOCK_THRESHOLD), 0);
+    CHECK_EQ(blocks_live, 0);
+
+    // No block left: the heap, zeroed by hand.
+    fail_blocks = 1;
+    uint8_t *c = mmap(NULL, 2 * MMAP_BLOCK_THRESHOLD, PROT_READ | PROT_WRITE, ANON, -1, 0);
+    fail_blocks = 0;
+    CHECK(c != MAP_FAILED);
+    CHECK_EQ(blocks_live, 0);
+    CHECK_EQ(c[2 * MMAP_BLOCK_THRESHOLD - 1], 0);
+    CHECK_EQ(munmap(c, 2 * MMAP_BLOCK_THRESHOLD), 0);
+
+    // Bad arguments.
+    CHECK(mmap(NULL, 0, PROT_READ, ANON, -1, 0) == MAP_FAILED);
+    CHECK_EQ(errno, EINVAL);
+    CHECK(mmap(NULL, PAGE, PROT_READ, ANON, -1, 5) == MAP_FAILED);
+    CHECK_EQ(errno, EINVAL);
+}
+
+// The memory is only released once every page of the mapping is unmapped,
+// in whatever order and however many times.
+static void test_partial_munmap(void) {
+    size_t size = 2 * MMAP_BLOCK_THRESHOLD;
+    uint8_t *b = mmap(NULL, size, PROT_READ | PROT_WRITE, ANON, -1, 0);
+    CHECK(b != MAP_FAILED);
+    CHECK_EQ(blocks_live, 1);
+
+    CHECK_EQ(munmap(b + size / 2, size / 2), 0);
+    CHECK_EQ(blocks_live, 1);
+    CHECK_EQ(munmap(b + size / 2, size / 2), 0);
+    CHECK_EQ(blocks_live, 1);
+    // Unaligned start: refused, nothing unmapped.
+    CHECK_EQ(munmap(b + 1, PAGE), -1);
+    CHECK_EQ(errno, EINVAL);
+    // A range running past the end of the mapping only unmaps what it covers.
+    CHECK_EQ(munmap(b + PAGE, size), 0);
+    CHECK_EQ(blocks_live, 1);
+    CHECK_EQ(munmap(b, PAGE), 0);
+    CHECK_EQ(blocks_live, 0);
+
+    // Heap mappings too, with the last page being a partial one.
+    uint8_t *h = mmap(NULL, 3 * PAGE + 10, PROT_READ | PROT_WRITE, ANON, -1, 0);
+    CHECK(h != MAP_FAILED);
+    watch(h);
+    CHECK_EQ(munmap(h + PAGE, 2 * PAGE), 0);
+    CHECK_EQ(munmap(h, PAGE), 0);
+    CHECK(!watched_freed);
+    CHECK_EQ(munmap(h + 3 * PAGE, 10), 0);
+    CHECK(watched_freed);
+}
+
+static int make_file(size_t length) {
+    int fd = open(DATA_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0);
+    for (size_t i = 0; i < length; i++) {
+        uint8_t v = (uint8_t) (i * 13);
+        CHECK_EQ(write(fd, &v, 1), 1);
+    }
+    return fd;
+}
+
+static void test_file_backed(void) {
+    const size_t file_len = 10000;
+    int fd = make_file(file_len);
+    CHECK_EQ(lseek(fd, 17, SEEK_SET), 17);
+
+    // From the second page of the file on: the data, then zeroes to the
+    // end of the last page. The file position is left alone.
+    uint8_t *f = mmap(NULL, 2 * PAGE, PROT_READ, MAP_PRIVATE, fd, PAGE);
+    CHECK(f != MAP_FAILED);
+    for (size_t i = 0; i < file_len - PAGE; i++) CHECK_EQ(f[i], (uint8_t) ((i + PAGE) * 13));
+    for (size_t i = file_len - PAGE; i < 2 * PAGE; i++) CHECK_EQ(f[i], 0);
+    CHECK_EQ(lseek(fd, 0, SEEK_CUR), 17);
+
+    // Length not a multiple of the page: the rest of the page is zeroed.
+    memset(f, 0xAA, 2 * PAGE);
+    CHECK(mmap(f, 100, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == f);
+    for (int i = 0; i < 100; i++) CHECK_EQ(f[i], (uint8_t) (i * 13));
+    for (int i = 100; i < PAGE; i++) CHECK_EQ(f[i], 0);
+    CHECK_EQ(f[PAGE], 0xAA);
+
+    CHECK(mmap(NULL, PAGE, PROT_READ, MAP_PRIVATE, 999, 0) == MAP_FAILED);
+    CHECK_EQ(errno, EBADF);
+
+    CHECK_EQ(munmap(f, 2 * PAGE), 0);
+    close(fd);
+    unlink(DATA_FILE);
+}
+
+static void test_map_fixed(void) {
+    uint8_t *m = mmap(NULL, 4 * PAGE, PROT_READ | PROT_WRITE, ANON, -1, 0);
+    CHECK(m != MAP_FAILED);
+    memset(m, 0xAA, 4 * PAGE);
+
+    // Replaces the pages it covers, leaves the others.
+    CHECK(mmap(m + PAGE, PAGE, PROT_READ | PROT_WRITE, ANON | MAP_FIXED, -1, 0) == m + PAGE);
+    CHECK_EQ(m[PAGE - 1], 0xAA);
+    CHECK_EQ(m[PAGE], 0);
+    CHECK_EQ(m[2 * PAGE - 1], 0);
+    CHECK_EQ(m[2 * PAGE], 0xAA);
+
+    // Not inside a mapping, straddling its end, or unaligned: refused.
+    CHECK(mmap((void *) 0x1000, PAGE, PROT_READ, ANON | MAP_FIXED, -1, 0) == MAP_FAILED);
+    CHECK_EQ(errno, EINVAL);
+    CHECK(mmap(m + 3 * PAGE, 2 * PAGE, PROT_READ, ANON | MAP_FIXED, -1, 0) == MAP_FAILED);
+    CHECK_EQ(errno, EINVAL);
+    CHECK(mmap(m + 1, PAGE, PROT_READ, ANON | MAP_FIXED, -1, 0) == MAP_FAILED);
+    CHECK_EQ(errno, EINVAL);
+
+    // A page unmapped and mapped again keeps the mapping alive.
+    watch(m);
+    CHECK_EQ(munmap(m, PAGE), 0);
+    CHECK(mmap(m, PAGE, PROT_READ | PROT_WRITE, ANON | MAP_FIXED, -1, 0) == m);
+    CHECK_EQ(munmap(m + PAGE, 3 * PAGE), 0);
+    CHECK(!watched_freed);
+    CHECK_EQ(m[0], 0);
+    CHECK_EQ(munmap(m, PAGE), 0);
+    CHECK(watched_freed);
+}
+
+int main() {
+    test_anonymous();
+    test_partial_munmap();
+    test_file_backed();
+    test_map_fixed();
+    return 0;
+}
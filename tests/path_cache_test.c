@@ -0,0 +1,133 @@
+/*
+ * tests/path_cache_test.c
+ *
+ * The stat cache behind the IO wrappers must not answer with what was true
+ * before the game changed the filesystem: files written through freopen(),
+ * and everything below a renamed or removed directory.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/io.h"
+#include "reimpl/path_cache.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test.h"
+
+#define ROOT DATA_PATH "path_cache/"
+
+static int exists(const char *path) {
+    stat64_bionic st;
+    return stat_soloader((char *) path, &st) == 0;
+}
+
+static long size_of(const char *path) {
+    stat64_bionic st;
+    CHECK_EQ(stat_soloader((char *) path, &st), 0);
+    return (long) st.st_size;
+}
+
+static void write_file(const char *path, const char *text) {
+    FILE *f = fopen_soloader((char *) path, "w");
+    CHECK(f != NULL);
+    fputs(text, f);
+    CHECK_EQ(fclose_soloader(f), 0);
+}
+
+static void test_freopen(void) {
+    // Known missing, then created by reopening another file onto it.
+    CHECK(!exists(ROOT "log.txt"));
+    write_file(ROOT "other.txt", "x");
+    FILE *f = fopen_soloader(ROOT "other.txt", "r");
+    CHECK(f != NULL);
+    f = freopen_soloader(ROOT "log.txt", "w", f);
+    CHECK(f != NULL);
+    CHECK(exists(ROOT "log.txt"));
+
+    // Written while open: stats go to the filesystem until it is closed.
+    fputs("hello", f);
+    fflush(f);
+    CHECK_EQ(size_of(ROOT "log.txt"), 5);
+    fputs(" world", f);
+    CHECK_EQ(fclose_soloader(f), 0);
+    CHECK_EQ(size_of(ROOT "log.txt"), 11);
+
+    // Reopened for writing again, on a path that had a cached size.
+    f = fopen_soloader(ROOT "other.txt", "r");
+    f = freopen_soloader(ROOT "log.txt", "a", f);
+    CHECK(f != NULL);
+    fputs("!", f);
+    CHECK_EQ(fclose_soloader(f), 0);
+    CHECK_EQ(size_of(ROOT "log.txt"), 12);
+}
+
+static void test_rename_dir(void) {
+    CHECK_EQ(mkdir_soloader(ROOT "save", 0777), 0);
+    write_file(ROOT "save/slot1", "data");
+    CHECK(exists(ROOT "save/slot1"));
+    CHECK(!exists(ROOT "backup/slot1"));
+    CHECK(!exists(ROOT "save2/x"));
+
+    // Both what was under the old name and what is now under the new one.
+    CHECK_EQ(rename_soloader(ROOT "save", ROOT "backup"), 0);
+    CHECK(!exists(ROOT "save/slot1"));
+    CHECK(exists(ROOT "backup/slot1"));
+    CHECK_EQ(size_of(ROOT "backup/slot1"), 4);
+
+    // A sibling sharing the name as a prefix is left alone.
+    CHECK_EQ(mkdir_soloader(ROOT "save2", 0777), 0);
+    write_file(ROOT "save2/x", "1");
+    CHECK(exists(ROOT "save2/x"));
+    CHECK_EQ(rename_soloader(ROOT "backup/", ROOT "save"), 0);
+    CHECK(exists(ROOT "save/slot1"));
+    CHECK(!exists(ROOT "backup/slot1"));
+    CHECK(exists(ROOT "save2/x"));
+}
+
+static void test_rmdir(void) {
+    CHECK_EQ(mkdir_soloader(ROOT "tmp", 0777), 0);
+    CHECK(exists(ROOT "tmp"));
+    CHECK_EQ(rmdir_soloader(ROOT "tmp"), 0);
+    CHECK(!exists(ROOT "tmp"));
+
+    // A directory renamed over an emptied one shows its files.
+    CHECK_EQ(mkdir_soloader(ROOT "a", 0777), 0);
+    CHECK(!exists(ROOT "a/f"));
+    CHECK_EQ(rmdir_soloader(ROOT "a"), 0);
+    CHECK_EQ(mkdir_soloader(ROOT "b", 0777), 0);
+    write_file(ROOT "b/f", "f");
+    CHECK_EQ(rename_soloader(ROOT "b", ROOT "a"), 0);
+    CHECK(exists(ROOT "a/f"));
+}
+
+// Leftovers from an earlier run.
+static void clean(void) {
+    const char *files[] = { "log.txt", "other.txt", "save/slot1", "backup/slot1", "save2/x", "a/f", "b/f" };
+    const char *dirs[] = { "save", "backup", "save2", "tmp", "a", "b", "" };
+    char path[256];
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        snprintf(path, sizeof(path), ROOT "%s", files[i]);
+        unlink(path);
+    }
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        snprintf(path, sizeof(path), ROOT "%s", dirs[i]);
+        rmdir(path);
+    }
+}
+
+int main() {
+    clean();
+    CHECK_EQ(mkdir(ROOT, 0777), 0);
+
+    test_freopen();
+    test_rename_dir();
+    test_rmdir();
+
+    clean();
+    return 0;
+}
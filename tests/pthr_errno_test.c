@@ -0,0 +1,71 @@
+/*
+ * tests/pthr_errno_test.c
+ *
+ * Return codes of the bionic mutex and condvar wrappers as the game sees
+ * them: the layer underneath returns newlib's errno values, which differ
+ * from bionic's for EDEADLK and ETIMEDOUT, and the wrappers must translate.
+ * Built for the Vita futex backend with newlib's errno values throughout,
+ * see tests/CMakeLists.txt.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/pthr.h"
+#include "reimpl/_errno_bionic.h"
+
+#include <pthread.h>
+#include <so_util/so_util.h>
+#include <sys/errno.h>
+
+#include "test.h"
+
+so_module so_mod;
+
+static void test_errorcheck_mutex(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutex_t_bionic m;
+
+    CHECK_EQ(pthread_mutexattr_init_soloader(&attr), 0);
+    CHECK_EQ(pthread_mutexattr_settype_soloader(&attr, PTHREAD_MUTEX_ERRORCHECK), 0);
+    CHECK_EQ(pthread_mutex_init_soloader(&m, &attr), 0);
+    CHECK_EQ(pthread_mutexattr_destroy_soloader(&attr), 0);
+
+    CHECK_EQ(pthread_mutex_unlock_soloader(&m), EPERM_BIONIC);
+    CHECK_EQ(pthread_mutex_lock_soloader(&m), 0);
+    CHECK_EQ(pthread_mutex_lock_soloader(&m), EDEADLK_BIONIC);
+    CHECK_EQ(pthread_mutex_trylock_soloader(&m), EBUSY_BIONIC);
+    CHECK_EQ(pthread_mutex_destroy_soloader(&m), EBUSY_BIONIC);
+    CHECK_EQ(pthread_mutex_unlock_soloader(&m), 0);
+    CHECK_EQ(pthread_mutex_destroy_soloader(&m), 0);
+}
+
+static void test_cond_timeout(void) {
+    pthread_mutex_t_bionic m;
+    pthread_cond_t_bionic c;
+    CHECK_EQ(pthread_mutex_init_soloader(&m, NULL), 0);
+    CHECK_EQ(pthread_cond_init_soloader(&c, NULL), 0);
+
+    struct timespec past = { 0, 0 };
+    struct timespec soon;
+    clock_gettime(CLOCK_REALTIME, &soon);
+    soon.tv_nsec += 10 * 1000000;
+    if (soon.tv_nsec >= 1000000000) {
+        soon.tv_sec++;
+        soon.tv_nsec -= 1000000000;
+    }
+
+    CHECK_EQ(pthread_mutex_lock_soloader(&m), 0);
+    CHECK_EQ(pthread_cond_timedwait_soloader(&c, &m, &past), ETIMEDOUT_BIONIC);
+    CHECK_EQ(pthread_cond_timedwait_soloader(&c, &m, &soon), ETIMEDOUT_BIONIC);
+    CHECK_EQ(pthread_mutex_unlock_soloader(&m), 0);
+}
+
+int main() {
+    // Otherwise the checks below would pass without any translation
+    CHECK(EDEADLK != EDEADLK_BIONIC && ETIMEDOUT != ETIMEDOUT_BIONIC);
+
+    test_errorcheck_mutex();
+    test_cond_timeout();
+    return 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * tests/pthr_sem_test.c
+ *
+ * Semaphores: sem_trywait never sleeps, sem_timedwait sleeps until its
+ * deadline and no longer, each post lets exactly one waiter through, and
+ * the -1 "zero with sleepers" state is entered and left without losing a
+ * wakeup. Ends with the throughput of a bounded buffer. Built once per
+ * futex backend, see tests/CMakeLists.txt.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/pthr.h"
+#include "reimpl/pthr_sync.h"
+#include "reimpl/futex.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <so_util/so_util.h>
+
+#include "test.h"
+
+#define THREADS 4
+#define ITERATIONS 50000
+#define BUFFER_SIZE 16
+
+so_module so_mod;
+
+static int word(int *sem) {
+    return atomic_load((_Atomic int *) sem);
+}
+
+static struct timespec realtime_in(uint64_t us) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += us / 1000000;
+    ts.tv_nsec += (us % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+// Waits until `n` threads sleep on `sem`: the word says -1, and the
+// threads have had time to get from announcing to sleeping.
+static void wait_sleepers(int *sem, atomic_int *started, int n) {
+    while (atomic_load(started) < n || word(sem) != -1) sched_yield();
+    struct timespec settle = { 0, 20 * 1000000 };
+    nanosleep(&settle, NULL);
+}
+
+static void test_trywait(void) {
+    int sem;
+    int sval;
+
+    CHECK_EQ(sem_init_soloader(&sem, 0, 0), 0);
+    uint64_t start = pthr_sync_now();
+    for (int i = 0; i < 1000; i++) {
+        errno = 0;
+        CHECK_EQ(sem_trywait_soloader(&sem), -1);
+        CHECK_EQ(errno, EAGAIN);
+    }
+    // Used to sleep 1 ms per call
+    CHECK(pthr_sync_now() - start < 100000);
+
+    CHECK_EQ(sem_post_soloader(&sem), 0);
+    CHECK_EQ(sem_post_soloader(&sem), 0);
+    CHECK_EQ(sem_getvalue_soloader(&sem, &sval), 0);
+    CHECK_EQ(sval, 2);
+    CHECK_EQ(sem_trywait_soloader(&sem), 0);
+    CHECK_EQ(sem_trywait_soloader(&sem), 0);
+    CHECK_EQ(sem_trywait_soloader(&sem), -1);
+    CHECK_EQ(word(&sem), 0);
+
+    errno = 0;
+    CHECK_EQ(sem_init_soloader(&sem, 0, (unsigned) INT_MAX + 1), -1);
+    CHECK_EQ(errno, EINVAL);
+    CHECK_EQ(sem_init_soloader(&sem, 0, INT_MAX), 0);
+    errno = 0;
+    CHECK_EQ(sem_post_soloader(&sem), -1);
+    CHECK_EQ(errno, EOVERFLOW);
+}
+
+static void test_timedwait(void) {
+    int sem;
+    CHECK_EQ(sem_init_soloader(&sem, 0, 1), 0);
+
+    // Available: taken whatever the deadline says, even an invalid one
+    struct timespec bad = { 0, 1000000000 };
+    CHECK_EQ(sem_timedwait_soloader(&sem, &bad), 0);
+    errno = 0;
+    CHECK_EQ(sem_timedwait_soloader(&sem, &bad), -1);
+    CHECK_EQ(errno, EINVAL);
+    CHECK_EQ(word(&sem), 0);
+
+    // Deadline in the past: fails right away
+    struct timespec past = { 1, 0 };
+    uint64_t start = pthr_sync_now();
+    errno = 0;
+    CHECK_EQ(sem_timedwait_soloader(&sem, &past), -1);
+    CHECK_EQ(errno, ETIMEDOUT);
+    CHECK(pthr_sync_now() - start < 100000);
+
+    // Deadline ahead: waits for all of it, then fails. It used to fail
+    // after 1 ms whenever time was left.
+    struct timespec ahead = realtime_in(30000);
+    start = pthr_sync_now();
+    errno = 0;
+    CHECK_EQ(sem_timedwait_soloader(&sem, &ahead), -1);
+    CHECK_EQ(errno, ETIMEDOUT);
+    uint64_t waited = pthr_sync_now() - start;
+    CHECK(waited >= 29000);
+    CHECK(waited < 1000000);
+
+    // A waiter that gave up may leave -1 behind; a post still counts
+    CHECK(word(&sem) == 0 || word(&sem) == -1);
+    CHECK_EQ(pthr_sem_getvalue(&sem), 0);
+    CHECK_EQ(sem_post_soloader(&sem), 0);
+    CHECK_EQ(word(&sem), 1);
+    ahead = realtime_in(1000000);
+    CHECK_EQ(sem_timedwait_soloader(&sem, &ahead), 0);
+    CHECK_EQ(word(&sem), 0);
+}
+
+static int post_sem;
+static atomic_int post_started = 0, post_passed = 0;
+
+static void *wait_post(void *arg) {
+    atomic_fetch_add(&post_started, 1);
+    CHECK_EQ(sem_wait_soloader(&post_sem), 0);
+    atomic_fetch_add(&post_passed, 1);
+    return NULL;
+}
+
+static void *timedwait_post(void *arg) {
+    atomic_fetch_add(&post_started, 1);
+    struct timespec deadline = realtime_in(10000000);
+    CHECK_EQ(sem_timedwait_soloader(&post_sem, &deadline), 0);
+    atomic_fetch_add(&post_passed, 1);
+    return NULL;
+}
+
+static void test_post_ordering(void) {
+    pthread_t t[THREADS];
+    struct timespec settle = { 0, 20 * 1000000 };
+
+    // One post, one waiter through, with the sleepers state kept for the
+    // others: the word goes -1 -> 1 -> -1.
+    CHECK_EQ(sem_init_soloader(&post_sem, 0, 0), 0);
+    for (int i = 0; i < THREADS; i++)
+        CHECK_EQ(pthread_create(&t[i], NULL, (i & 1) ? timedwait_post : wait_post, NULL), 0);
+    wait_sleepers(&post_sem, &post_started, THREADS);
+    CHECK_EQ(pthr_sem_getvalue(&post_sem), 0);
+
+    for (int i = 1; i <= THREADS; i++) {
+        CHECK_EQ(sem_post_soloader(&post_sem), 0);
+        while (atomic_load(&post_passed) < i) sched_yield();
+        nanosleep(&settle, NULL);
+        CHECK_EQ(atomic_load(&post_passed), i);
+        // The last one through can't know it was the last
+        CHECK_EQ(word(&post_sem), -1);
+    }
+    for (int i = 0; i < THREADS; i++) pthread_join(t[i], NULL);
+
+    // -1 with nobody asleep behaves as 0
+    CHECK_EQ(sem_trywait_soloader(&post_sem), -1);
+    CHECK_EQ(sem_post_soloader(&post_sem), 0);
+    CHECK_EQ(word(&post_sem), 1);
+    CHECK_EQ(sem_trywait_soloader(&post_sem), 0);
+    CHECK_EQ(word(&post_sem), 0);
+
+    // Posts in a burst, before any sleeper could run: only the first one
+    // wakes a thread, the woken ones pass the wakeup on.
+    atomic_store(&post_started, 0);
+    atomic_store(&post_passed, 0);
+    for (int i = 0; i < THREADS; i++) CHECK_EQ(pthread_create(&t[i], NULL, wait_post, NULL), 0);
+    wait_sleepers(&post_sem, &post_started, THREADS);
+    for (int i = 0; i < THREADS; i++) CHECK_EQ(sem_post_soloader(&post_sem), 0);
+    for (int i = 0; i < THREADS; i++) pthread_join(t[i], NULL);
+    CHECK_EQ(atomic_load(&post_passed), THREADS);
+    CHECK_EQ(pthr_sem_getvalue(&post_sem), 0);
+
+    // Posted before anybody waits: no sleep at all
+    CHECK_EQ(sem_post_soloader(&post_sem), 0);
+    uint64_t start = pthr_sync_now();
+    CHECK_EQ(sem_wait_soloader(&post_sem), 0);
+    CHECK(pthr_sync_now() - start < 100000);
+}
+
+// Bounded buffer, the shape of the game's loader and audio queues
+static int items, slots;
+static volatile int ring_lock = PTHR_MUTEX_NORMAL;
+static int ring[BUFFER_SIZE];
+static unsigned ring_head = 0, ring_tail = 0;
+static long sum_in = 0, sum_out = 0;
+
+static void *produce(void *arg) {
+    for (int i = 1; i <= ITERATIONS; i++) {
+        sem_wait_soloader(&slots);
+        pthr_mutex_lock(&ring_lock, FUTEX_WAIT_FOREVER);
+        ring[ring_head++ % BUFFER_SIZE] = i;
+        sum_in += i;
+        pthr_mutex_unlock(&ring_lock);
+        sem_post_soloader(&items);
+    }
+    return NULL;
+}
+
+static void *consume(void *arg) {
+    for (int i = 0; i < ITERATIONS; i++) {
+        sem_wait_soloader(&items);
+        pthr_mutex_lock(&ring_lock, FUTEX_WAIT_FOREVER);
+        sum_out += ring[ring_tail++ % BUFFER_SIZE];
+        pthr_mutex_unlock(&ring_lock);
+        sem_post_soloader(&slots);
+    }
+    return NULL;
+}
+
+static void test_throughput(void) {
+    pthread_t t[2 * THREADS];
+    CHECK_EQ(sem_init_soloader(&items, 0, 0), 0);
+    CHECK_EQ(sem_init_soloader(&slots, 0, BUFFER_SIZE), 0);
+
+    uint64_t start = test_now_ns();
+    for (int i = 0; i < THREADS; i++) {
+        CHECK_EQ(pthread_create(&t[i], NULL, produce, NULL), 0);
+        CHECK_EQ(pthread_create(&t[THREADS + i], NULL, consume, NULL), 0);
+    }
+    for (int i = 0; i < 2 * THREADS; i++) pthread_join(t[i], NULL);
+    uint64_t elapsed = test_now_ns() - start;
+
+    CHECK_EQ(sum_in, (long) THREADS * ITERATIONS * (ITERATIONS + 1) / 2);
+    CHECK_EQ(sum_out, sum_in);
+    CHECK_EQ(pthr_sem_getvalue(&items), 0);
+    CHECK_EQ(pthr_sem_getvalue(&slots), BUFFER_SIZE);
+
+    printf("%d producers, %d consumers: %.0f ns per item through %d slots\n",
+           THREADS, THREADS, (double) elapsed / (THREADS * ITERATIONS), BUFFER_SIZE);
+}
+
+int main() {
+    test_trywait();
+    test_timedwait();
+    test_post_ordering();
+    test_throughput();
+    return 0;
+}
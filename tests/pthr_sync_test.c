@@ -0,0 +1,278 @@
+/*
+ * tests/pthr_sync_test.c
+ *
+ * The mutexes and condvars of reimpl/pthr_sync.c, in words set up like the
+ * game's: bionic static initializers. Errorcheck and recursive kinds, timed
+ * waits, and threads hammering shared mutexes and a bounded queue. Built
+ * once per futex backend, see tests/CMakeLists.txt.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/pthr_sync.h"
+#include "reimpl/futex.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "test.h"
+
+#define THREADS 4
+#define ITERATIONS 20000
+#define QUEUE_SIZE 8
+
+#define FOREVER FUTEX_WAIT_FOREVER
+
+static void *try_lock(void *mutex) {
+    return (void *) (long) pthr_mutex_trylock(mutex);
+}
+
+static void *unlock(void *mutex) {
+    return (void *) (long) pthr_mutex_unlock(mutex);
+}
+
+static void *lock_briefly(void *mutex) {
+    long ret = pthr_mutex_lock(mutex, FOREVER);
+    if (ret == 0)
+        ret = pthr_mutex_unlock(mutex);
+    return (void *) ret;
+}
+
+// Runs `fn` on another thread and returns what it returned.
+static long on_other_thread(void *(*fn)(void *), volatile int *word) {
+    pthread_t t;
+    void *ret;
+    CHECK_EQ(pthread_create(&t, NULL, fn, (void *) word), 0);
+    pthread_join(t, &ret);
+    return (long) ret;
+}
+
+static void test_errorcheck(void) {
+    volatile int m = PTHR_MUTEX_ERRORCHECK;
+
+    CHECK_EQ(pthr_mutex_unlock(&m), EPERM);
+    CHECK_EQ(pthr_mutex_lock(&m, FOREVER), 0);
+    CHECK_EQ(pthr_mutex_lock(&m, FOREVER), EDEADLK);
+    CHECK_EQ(pthr_mutex_trylock(&m), EBUSY);
+
+    // Others can neither take it nor release it
+    CHECK_EQ(on_other_thread(try_lock, &m), EBUSY);
+    CHECK_EQ(on_other_thread(unlock, &m), EPERM);
+
+    CHECK_EQ(pthr_mutex_destroy(&m), EBUSY);
+    CHECK_EQ(pthr_mutex_unlock(&m), 0);
+    CHECK_EQ(pthr_mutex_unlock(&m), EPERM);
+    CHECK_EQ(pthr_mutex_destroy(&m), 0);
+    CHECK_EQ(m, PTHR_MUTEX_ERRORCHECK);
+
+    CHECK_EQ(on_other_thread(lock_briefly, &m), 0);
+}
+
+static void test_recursive(void) {
+    volatile int m = PTHR_MUTEX_RECURSIVE;
+
+    CHECK_EQ(pthr_mutex_lock(&m, FOREVER), 0);
+    CHECK_EQ(pthr_mutex_trylock(&m), 0);
+    CHECK_EQ(pthr_mutex_lock(&m, FOREVER), 0);
+    CHECK_EQ(on_other_thread(try_lock, &m), EBUSY);
+    CHECK_EQ(on_other_thread(unlock, &m), EPERM);
+
+    CHECK_EQ(pthr_mutex_unlock(&m), 0);
+    CHECK_EQ(pthr_mutex_unlock(&m), 0);
+    CHECK_EQ(on_other_thread(try_lock, &m), EBUSY);
+    CHECK_EQ(pthr_mutex_unlock(&m), 0);
+    CHECK_EQ(pthr_mutex_unlock(&m), EPERM);
+    CHECK_EQ(m, PTHR_MUTEX_RECURSIVE);
+
+    // The counter has 11 bits; past that, relocking fails instead of wrapping
+    int depth = 0;
+    while (pthr_mutex_lock(&m, FOREVER) == 0) depth++;
+    CHECK_EQ(depth, 2048);
+    CHECK_EQ(pthr_mutex_lock(&m, FOREVER), EAGAIN);
+    CHECK_EQ(pthr_mutex_trylock(&m), EBUSY);
+    while (depth-- > 0) CHECK_EQ(pthr_mutex_unlock(&m), 0);
+    CHECK_EQ(m, PTHR_MUTEX_RECURSIVE);
+
+    // Normal mutexes don't know their owner: relocking would deadlock
+    volatile int n = PTHR_MUTEX_NORMAL;
+    CHECK_EQ(pthr_mutex_lock(&n, FOREVER), 0);
+    CHECK_EQ(pthr_mutex_trylock(&n), EBUSY);
+    CHECK_EQ(pthr_mutex_unlock(&n), 0);
+}
+
+typedef struct {
+    volatile int *mutex;
+    uint64_t hold_us;
+    atomic_int locked;
+} holder;
+
+static void *hold(void *arg) {
+    holder *h = arg;
+    CHECK_EQ(pthr_mutex_lock(h->mutex, FOREVER), 0);
+    atomic_store(&h->locked, 1);
+    uint64_t until = pthr_sync_now() + h->hold_us;
+    while (pthr_sync_now() < until) sched_yield();
+    CHECK_EQ(pthr_mutex_unlock(h->mutex), 0);
+    return NULL;
+}
+
+static void test_timeouts(void) {
+    volatile int m = PTHR_MUTEX_NORMAL;
+    volatile int cv = 0;
+
+    // A held mutex: the wait ends at the deadline, not before
+    holder h = { &m, 200000, 0 };
+    pthread_t t;
+    CHECK_EQ(pthread_create(&t, NULL, hold, &h), 0);
+    while (!atomic_load(&h.locked)) sched_yield();
+    uint64_t start = pthr_sync_now();
+    CHECK_EQ(pthr_mutex_lock(&m, start + 20000), ETIMEDOUT);
+    CHECK(pthr_sync_now() - start >= 20000);
+    CHECK_EQ(pthr_mutex_lock(&m, start), ETIMEDOUT);
+
+    // Released before the deadline: taken
+    CHECK_EQ(pthr_mutex_lock(&m, pthr_sync_now() + 5000000), 0);
+    pthread_join(t, NULL);
+
+    // A condvar nobody signals times out with the mutex held again
+    start = pthr_sync_now();
+    CHECK_EQ(pthr_cond_wait(&cv, &m, start + 20000), ETIMEDOUT);
+    CHECK(pthr_sync_now() - start >= 20000);
+    CHECK_EQ(on_other_thread(try_lock, &m), EBUSY);
+    CHECK_EQ(pthr_cond_wait(&cv, &m, start), ETIMEDOUT);
+    CHECK_EQ(on_other_thread(try_lock, &m), EBUSY);
+    CHECK_EQ(pthr_mutex_unlock(&m), 0);
+
+    // Wall-clock deadlines: in the past means now, NULL means never
+    struct timespec past = { 1, 0 };
+    start = pthr_sync_now();
+    CHECK(pthr_sync_deadline(&past) <= pthr_sync_now());
+    CHECK(pthr_sync_deadline(&past) >= start);
+    CHECK_EQ(pthr_sync_deadline(NULL), FUTEX_WAIT_FOREVER);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    now.tv_sec += 10;
+    uint64_t deadline = pthr_sync_deadline(&now);
+    CHECK(deadline > start + 9000000 && deadline < pthr_sync_now() + 11000000);
+
+    // Waiting on a mutex we don't hold
+    CHECK_EQ(pthr_cond_wait(&cv, &m, FOREVER), EPERM);
+}
+
+static volatile int shared_normal = PTHR_MUTEX_NORMAL;
+static volatile int shared_recursive = PTHR_MUTEX_RECURSIVE;
+static long normal_count = 0, recursive_count = 0;
+
+static void *hammer(void *arg) {
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (i & 1) {
+            CHECK_EQ(pthr_mutex_lock(&shared_normal, FOREVER), 0);
+            normal_count++;
+            CHECK_EQ(pthr_mutex_unlock(&shared_normal), 0);
+        } else {
+            CHECK_EQ(pthr_mutex_lock(&shared_recursive, FOREVER), 0);
+            CHECK_EQ(pthr_mutex_lock(&shared_recursive, FOREVER), 0);
+            recursive_count++;
+            CHECK_EQ(pthr_mutex_unlock(&shared_recursive), 0);
+            CHECK_EQ(pthr_mutex_unlock(&shared_recursive), 0);
+        }
+    }
+    return NULL;
+}
+
+static void test_mutual_exclusion(void) {
+    pthread_t t[THREADS];
+    for (int i = 0; i < THREADS; i++) CHECK_EQ(pthread_create(&t[i], NULL, hammer, NULL), 0);
+    for (int i = 0; i < THREADS; i++) pthread_join(t[i], NULL);
+
+    CHECK_EQ(normal_count + recursive_count, (long) THREADS * ITERATIONS);
+    CHECK_EQ(shared_normal, PTHR_MUTEX_NORMAL);
+    CHECK_EQ(shared_recursive, PTHR_MUTEX_RECURSIVE);
+}
+
+// A bounded queue, as the game's loader and audio threads use them
+static volatile int queue_lock = PTHR_MUTEX_NORMAL;
+static volatile int not_empty = 0, not_full = 0;
+static int queue[QUEUE_SIZE];
+static int queue_head = 0, queue_len = 0;
+static long produced_sum = 0, consumed_sum = 0;
+
+static void *producer(void *arg) {
+    for (int i = 1; i <= ITERATIONS; i++) {
+        pthr_mutex_lock(&queue_lock, FOREVER);
+        while (queue_len == QUEUE_SIZE) pthr_cond_wait(&not_full, &queue_lock, FOREVER);
+        queue[(queue_head + queue_len++) % QUEUE_SIZE] = i;
+        produced_sum += i;
+        pthr_cond_signal(&not_empty);
+        pthr_mutex_unlock(&queue_lock);
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    for (int i = 0; i < ITERATIONS; i++) {
+        pthr_mutex_lock(&queue_lock, FOREVER);
+        while (queue_len == 0) pthr_cond_wait(&not_empty, &queue_lock, FOREVER);
+        consumed_sum += queue[queue_head];
+        queue_head = (queue_head + 1) % QUEUE_SIZE;
+        queue_len--;
+        pthr_cond_signal(&not_full);
+        pthr_mutex_unlock(&queue_lock);
+    }
+    return NULL;
+}
+
+static volatile int gate_lock = PTHR_MUTEX_NORMAL;
+static volatile int gate = 0;
+static int gate_open = 0, gate_waiting = 0, gate_passed = 0;
+
+static void *wait_gate(void *arg) {
+    pthr_mutex_lock(&gate_lock, FOREVER);
+    gate_waiting++;
+    while (!gate_open) pthr_cond_wait(&gate, &gate_lock, FOREVER);
+    gate_passed++;
+    pthr_mutex_unlock(&gate_lock);
+    return NULL;
+}
+
+static void test_producer_consumer(void) {
+    pthread_t t[2 * THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        CHECK_EQ(pthread_create(&t[i], NULL, producer, NULL), 0);
+        CHECK_EQ(pthread_create(&t[THREADS + i], NULL, consumer, NULL), 0);
+    }
+    for (int i = 0; i < 2 * THREADS; i++) pthread_join(t[i], NULL);
+
+    CHECK_EQ(queue_len, 0);
+    CHECK_EQ(produced_sum, (long) THREADS * ITERATIONS * (ITERATIONS + 1) / 2);
+    CHECK_EQ(consumed_sum, produced_sum);
+
+    // A broadcast lets every waiter through
+    for (int i = 0; i < THREADS; i++) CHECK_EQ(pthread_create(&t[i], NULL, wait_gate, NULL), 0);
+    for (;;) {
+        pthr_mutex_lock(&gate_lock, FOREVER);
+        int waiting = gate_waiting;
+        if (waiting == THREADS) {
+            gate_open = 1;
+            pthr_cond_broadcast(&gate);
+        }
+        pthr_mutex_unlock(&gate_lock);
+        if (waiting == THREADS) break;
+        sched_yield();
+    }
+    for (int i = 0; i < THREADS; i++) pthread_join(t[i], NULL);
+    CHECK_EQ(gate_passed, THREADS);
+}
+
+int main() {
+    test_errorcheck();
+    test_recursive();
+    test_timeouts();
+    test_mutual_exclusion();
+    test_producer_consumer();
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * tests/settings_test.c
+ *
+ * Parsing of the config file written by the companion app, in particular
+ * empty values and CRLF line ends.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "utils/settings.h"
+
+#include <string.h>
+
+#include "test.h"
+
+#define CONFIG_FILE_PATH DATA_PATH "config.txt"
+
+static void writeConfig(const char *text) {
+    FILE *f = fopen(CONFIG_FILE_PATH, "w");
+    CHECK(f != NULL);
+    fputs(text, f);
+    fclose(f);
+}
+
+int main() {
+    // An empty value right after a non-empty one stays empty.
+    writeConfig("setting_fiosCacheBlocks 12\n"
+                "setting_fiosCachePaths \n"
+                "setting_framePacing 1\n");
+    settings_load();
+    CHECK_EQ(setting_fiosCacheBlocks, 12);
+    CHECK_EQ(strlen(setting_fiosCachePaths), 0);
+    CHECK(setting_framePacing);
+
+    // Values keep their inner spaces, CR is not part of them, and a name
+    // without any value reads as empty.
+    writeConfig("setting_fiosCachePaths ux0:data/a b/;ux0:data/c/\r\n"
+                "setting_sampleSetting\r\n"
+                "setting_fiosCacheBlockKB 64");
+    settings_load();
+    CHECK(strcmp(setting_fiosCachePaths, "ux0:data/a b/;ux0:data/c/") == 0);
+    CHECK_EQ(setting_sampleSetting, 0);
+    CHECK_EQ(setting_fiosCacheBlockKB, 64);
+
+    // Whatever settings_save() writes reads back the same.
+    strcpy(setting_fiosCachePaths, "");
+    setting_fiosCacheBlocks = 3;
+    settings_save();
+    settings_load();
+    CHECK_EQ(strlen(setting_fiosCachePaths), 0);
+    CHECK_EQ(setting_fiosCacheBlocks, 3);
+
+    remove(CONFIG_FILE_PATH);
+    settings_load();
+    CHECK(strcmp(setting_fiosCachePaths, DATA_PATH) == 0);
+    return 0;
+}
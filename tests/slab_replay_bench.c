@@ -0,0 +1,187 @@
+/*
+ * tests/slab_replay_bench.c
+ *
+ * Replays the same allocation trace through the slab allocator and through
+ * the host C library's malloc. The trace is generated up front, per thread,
+ * with the mix the game's C++ code produces: mostly small objects, some
+ * growing buffers, a few blocks too big for the slabs, and objects freed on
+ * another thread than the one that allocated them. Every block is filled
+ * and checked before it is freed, and the slab stats must balance at the
+ * end. On the host the other allocator is glibc's, with its per-thread
+ * arenas, not the newlib heap the game falls back to on the Vita: the
+ * comparison says little about the gain there.
+ *
+ * Usage: slab_replay_bench [operations per thread]
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/slab.h"
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "test.h"
+
+#define THREADS 4
+#define SLOTS 4096  // live blocks per thread
+#define SHARED 1024 // blocks handed between threads
+
+enum {
+    OP_REPLACE, // free the slot's block, allocate a new one
+    OP_REALLOC,
+    OP_HANDOFF, // swap the slot's block with one another thread left
+};
+
+typedef struct {
+    uint8_t op;
+    uint16_t slot;
+    uint32_t size;
+} trace_event;
+
+// Blocks start with their size and a tag; the rest is a pattern of both
+typedef struct {
+    uint32_t size;
+    uint32_t tag;
+} block_header;
+
+typedef struct {
+    const char *name;
+    void *(*malloc)(size_t);
+    void *(*realloc)(void *, size_t);
+    void (*free)(void *);
+} allocator;
+
+static const allocator allocators[] = {
+    { "glibc", malloc, realloc, free },
+    { "slab", slab_malloc, slab_realloc, slab_free },
+};
+
+static trace_event *traces[THREADS];
+static long trace_length;
+static const allocator *current;
+static _Atomic(block_header *) shared[SHARED];
+
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static uint32_t random_size(uint32_t *state) {
+    uint32_t r = next_random(state) % 100;
+    uint32_t x = next_random(state);
+    if (r < 60) return 8 + x % 56;      // nodes, small strings
+    if (r < 85) return 64 + x % 448;    // containers, buffers
+    if (r < 97) return 512 + x % 1536;  // up to the largest class
+    return 2048 + x % 63 * 1024;        // newlib's
+}
+
+static void generate(int thread) {
+    uint32_t state = 1234 + thread;
+    trace_event *t = malloc(sizeof(trace_event) * trace_length);
+    CHECK(t != NULL);
+
+    for (long i = 0; i < trace_length; i++) {
+        uint32_t r = next_random(&state) % 100;
+        t[i].op = r < 80 ? OP_REPLACE : r < 92 ? OP_REALLOC : OP_HANDOFF;
+        t[i].slot = next_random(&state) % SLOTS;
+        t[i].size = random_size(&state);
+    }
+    traces[thread] = t;
+}
+
+static void fill(block_header *b, uint32_t size, uint32_t tag) {
+    b->size = size;
+    b->tag = tag;
+    memset(b + 1, (uint8_t) tag, (size < 64 ? size : 64) - sizeof(block_header));
+}
+
+// Checks the first `size` bytes of what fill() wrote
+static void verify_prefix(const block_header *b, uint32_t size) {
+    const uint8_t *p = (const uint8_t *) (b + 1);
+    size_t n = (size < 64 ? size : 64) - sizeof(block_header);
+    for (size_t i = 0; i < n; i++) CHECK_EQ(p[i], (uint8_t) b->tag);
+}
+
+static void verify(const block_header *b) {
+    if (b) verify_prefix(b, b->size);
+}
+
+static void release(block_header *b) {
+    verify(b);
+    current->free(b);
+}
+
+static void *replay(void *arg) {
+    int thread = (int) (long) arg;
+    block_header *slots[SLOTS] = { NULL };
+    uint32_t tag = thread << 24;
+
+    for (long i = 0; i < trace_length; i++) {
+        const trace_event *e = &traces[thread][i];
+        block_header **slot = &slots[e->slot];
+
+        switch (e->op) {
+            case OP_REPLACE:
+                release(*slot);
+                *slot = current->malloc(e->size);
+                CHECK(*slot != NULL);
+                fill(*slot, e->size, ++tag);
+                break;
+            case OP_REALLOC: {
+                verify(*slot);
+                uint32_t kept = *slot ? (*slot)->size : 0;
+                block_header *b = current->realloc(*slot, e->size);
+                CHECK(b != NULL);
+                if (kept) verify_prefix(b, kept < e->size ? kept : e->size);
+                fill(b, e->size, ++tag);
+                *slot = b;
+                break;
+            }
+            case OP_HANDOFF:
+                *slot = atomic_exchange(&shared[e->slot % SHARED], *slot);
+                break;
+        }
+    }
+
+    for (int i = 0; i < SLOTS; i++) release(slots[i]);
+    return NULL;
+}
+
+static double run(const allocator *a) {
+    pthread_t t[THREADS];
+    current = a;
+
+    uint64_t start = test_now_ns();
+    for (int i = 0; i < THREADS; i++) CHECK_EQ(pthread_create(&t[i], NULL, replay, (void *) (long) i), 0);
+    for (int i = 0; i < THREADS; i++) pthread_join(t[i], NULL);
+    for (int i = 0; i < SHARED; i++) release(atomic_exchange(&shared[i], NULL));
+    uint64_t elapsed = test_now_ns() - start;
+
+    return (double) elapsed / (THREADS * trace_length);
+}
+
+int main(int argc, char **argv) {
+    trace_length = bench_iterations(argc, argv, 2000000);
+    for (int i = 0; i < THREADS; i++) generate(i);
+
+    printf("%d threads, %ld operations each; glibc malloc, not the Vita's newlib heap\n",
+           THREADS, trace_length);
+    for (size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++)
+        printf("%6s: %7.1f ns/op\n", allocators[i].name, run(&allocators[i]));
+
+    // Everything went back, and the arena never ran out
+    slab_stats stats;
+    slab_get_stats(&stats);
+    CHECK_EQ(stats.live_bytes, 0);
+    CHECK(stats.arena_pages > 0);
+    CHECK_EQ(stats.fallbacks, 0);
+    printf("slab: %u of %d slabs carved, %llu%% lost to class rounding\n",
+           stats.arena_pages, SLAB_ARENA_SIZE / SLAB_PAGE_SIZE,
+           (unsigned long long) ((stats.rounded - stats.requested) * 100 / stats.rounded));
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * tests/test.h
+ *
+ * Checks and timing for the host tests and benchmarks. A failed CHECK
+ * prints the expression and exits with a non-zero status, which is all that
+ * ctest looks at.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#ifndef SOLOADER_TEST_H
+#define SOLOADER_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        exit(1); \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long _a = (long long) (a), _b = (long long) (b); \
+    if (_a != _b) { \
+        fprintf(stderr, "%s:%d: CHECK failed: %s == %s (%lld != %lld)\n", \
+                __FILE__, __LINE__, #a, #b, _a, _b); \
+        exit(1); \
+    } \
+} while (0)
+
+static inline uint64_t test_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Iteration count for benchmarks: argv[1] if given, `def` otherwise. ctest
+// runs them with a small count, as a smoke test.
+static inline long bench_iterations(int argc, char **argv, long def) {
+    return argc > 1 ? atol(argv[1]) : def;
+}
+
+#endif // SOLOADER_TEST_H
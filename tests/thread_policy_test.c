@@ -0,0 +1,247 @@
+/*
+ * tests/thread_policy_test.c
+ *
+ * Thread placement rules: name globs, entry and creator symbols, rule
+ * order, and the translation of the Linux priorities the game passes to
+ * pthread_setschedparam(). Then the same through pthr.c on running
+ * threads, where a matching rule's priority wins over the game's.
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ */
+
+#include "reimpl/pthr.h"
+#include "reimpl/thread_policy.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <psp2/kernel/threadmgr.h>
+#include <so_util/so_util.h>
+
+#include "test.h"
+
+so_module so_mod;
+
+static int name_matches(const char *pattern, const char *name) {
+    thread_rule rule = { THREAD_MATCH_NAME, pattern, THREAD_CPU_ANY, THREAD_PRIORITY_DEFAULT, THREAD_STACK_DEFAULT };
+    return thread_policy_match(&rule, 1, name, 0, 0) == &rule;
+}
+
+static void test_glob(void) {
+    CHECK(name_matches("*Audio*", "AudioThread"));
+    CHECK(name_matches("*Audio*", "FmodAudio"));
+    CHECK(name_matches("*Audio*", "Audio"));
+    CHECK(!name_matches("*Audio*", "audio"));
+    CHECK(!name_matches("*Audio*", "Aud"));
+
+    CHECK(name_matches("OpenSL*", "OpenSL"));
+    CHECK(name_matches("OpenSL*", "OpenSLES-cb"));
+    CHECK(!name_matches("OpenSL*", "XOpenSL"));
+
+    CHECK(name_matches("a?c", "abc"));
+    CHECK(!name_matches("a?c", "ac"));
+    CHECK(!name_matches("ab", "abc"));
+    CHECK(!name_matches("abc", "ab"));
+    CHECK(name_matches("*", ""));
+    CHECK(name_matches("**", "x"));
+    CHECK(name_matches("", ""));
+    CHECK(!name_matches("", "x"));
+
+    // A star has to give characters back when what follows fails later
+    CHECK(name_matches("*ab", "aab"));
+    CHECK(name_matches("a*b*c", "aXbYbZc"));
+    CHECK(name_matches("*Load*er", "LoadLoader"));
+    CHECK(!name_matches("a*b*c", "aXbYcZ"));
+}
+
+static int fake_lookup(const char *symbol, uintptr_t *addr, size_t *size) {
+    if (strcmp(symbol, "thread_main") == 0) {
+        *addr = 0x81001001; // Thumb
+        *size = 0x40;
+        return 1;
+    }
+    if (strcmp(symbol, "spawn_workers") == 0) {
+        *addr = 0x81002000;
+        *size = 0x100;
+        return 1;
+    }
+    if (strcmp(symbol, "sizeless") == 0) {
+        *addr = 0x81003000;
+        *size = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static void test_match(void) {
+    thread_rule rules[] = {
+        { THREAD_MATCH_ENTRY,   "thread_main",   0, 100, THREAD_STACK_DEFAULT },
+        { THREAD_MATCH_CREATOR, "spawn_workers", 1, 110, THREAD_STACK_DEFAULT },
+        { THREAD_MATCH_CREATOR, "sizeless",      1, 115, THREAD_STACK_DEFAULT },
+        { THREAD_MATCH_ENTRY,   "missing",       2, 120, THREAD_STACK_DEFAULT },
+        { THREAD_MATCH_NAME,    "Worker*",       2, 130, THREAD_STACK_DEFAULT },
+        { THREAD_MATCH_NAME,    "*",             THREAD_CPU_ANY, 140, THREAD_STACK_DEFAULT },
+    };
+    const int count = sizeof(rules) / sizeof(rules[0]);
+
+    // Symbol rules match nothing until resolved
+    CHECK(thread_policy_match(rules, 4, NULL, 0x81001001, 0x81002000) == NULL);
+    thread_policy_resolve(rules, count, fake_lookup);
+
+    // Entry points are compared without the Thumb bit
+    CHECK(thread_policy_match(rules, count, NULL, 0x81001001, 0) == &rules[0]);
+    CHECK(thread_policy_match(rules, count, NULL, 0x81001000, 0) == &rules[0]);
+    CHECK(thread_policy_match(rules, count, NULL, 0x81001004, 0) == NULL);
+
+    // Creators anywhere inside the function, or at a sizeless symbol
+    CHECK(thread_policy_match(rules, count, NULL, 0, 0x81002000) == &rules[1]);
+    CHECK(thread_policy_match(rules, count, NULL, 0, 0x810020FF) == &rules[1]);
+    CHECK(thread_policy_match(rules, count, NULL, 0, 0x81002100) == NULL);
+    CHECK(thread_policy_match(rules, count, NULL, 0, 0x81003000) == &rules[2]);
+    CHECK(thread_policy_match(rules, count, NULL, 0, 0x81003001) == NULL);
+
+    // Unresolved symbols never match, not even unknown (0) addresses
+    CHECK_EQ(rules[3].start, 0);
+    CHECK(thread_policy_match(rules, 4, NULL, 0, 0) == NULL);
+
+    // The first matching rule wins; no name, no name rule
+    CHECK(thread_policy_match(rules, count, "Worker1", 0x81001001, 0) == &rules[0]);
+    CHECK(thread_policy_match(rules, count, "Worker1", 0, 0) == &rules[4]);
+    CHECK(thread_policy_match(rules, count, "Main", 0, 0) == &rules[5]);
+    CHECK(thread_policy_match(rules, count, NULL, 0, 0) == NULL);
+}
+
+static void test_default_rules(void) {
+    const thread_rule *r;
+
+    r = thread_policy_match(thread_policy_rules, thread_policy_rule_count, "AudioThread", 0, 0);
+    CHECK(r != NULL);
+    CHECK_EQ(r->cpu, 1);
+    CHECK(r->priority < THREAD_PRIORITY_NORMAL);
+
+    r = thread_policy_match(thread_policy_rules, thread_policy_rule_count, "AssetLoader", 0, 0);
+    CHECK(r != NULL);
+    CHECK_EQ(r->cpu, 2);
+    CHECK(r->priority > THREAD_PRIORITY_NORMAL);
+
+    CHECK(thread_policy_match(thread_policy_rules, thread_policy_rule_count, "RenderThread", 0, 0) == NULL);
+}
+
+static void test_priority(void) {
+    CHECK_EQ(thread_policy_priority(THREAD_SCHED_OTHER, 0), THREAD_PRIORITY_NORMAL);
+    CHECK_EQ(thread_policy_priority(THREAD_SCHED_BATCH, 0), THREAD_PRIORITY_NORMAL);
+    CHECK_EQ(thread_policy_priority(THREAD_SCHED_IDLE, 0), 191);
+    CHECK_EQ(thread_policy_priority(THREAD_SCHED_FIFO, 1), 159);
+    CHECK_EQ(thread_policy_priority(THREAD_SCHED_RR, 99), 96);
+
+    // Higher Linux priorities are never lower Vita ones (lower numbers)
+    for (int p = 2; p <= 99; p++)
+        CHECK(thread_policy_priority(THREAD_SCHED_FIFO, p) <= thread_policy_priority(THREAD_SCHED_FIFO, p - 1));
+
+    CHECK_EQ(thread_policy_priority(THREAD_SCHED_FIFO, 0), -1);
+    CHECK_EQ(thread_policy_priority(THREAD_SCHED_RR, 100), -1);
+    CHECK_EQ(thread_policy_priority(THREAD_SCHED_OTHER, 1), -1);
+    CHECK_EQ(thread_policy_priority(4, 0), -1);
+    CHECK_EQ(thread_policy_priority(-1, 0), -1);
+}
+
+static atomic_int stop = 0;
+
+static void *idle(void *arg) {
+    while (!atomic_load(&stop)) sched_yield();
+    return NULL;
+}
+
+// Stats of the game thread `uid`
+static pthr_thread_stats stats_of(SceUID uid) {
+    pthr_thread_stats stats[8];
+    for (;;) {
+        int n = pthr_get_thread_stats(stats, 8);
+        for (int i = 0; i < n; i++) {
+            if (stats[i].uid == uid)
+                return stats[i];
+        }
+        sched_yield();
+    }
+}
+
+// Waits for a game thread other than `other` to run, returns its id
+static SceUID new_thread_uid(SceUID other) {
+    pthr_thread_stats stats[8];
+    for (;;) {
+        int n = pthr_get_thread_stats(stats, 8);
+        for (int i = 0; i < n; i++) {
+            if (stats[i].uid != other)
+                return stats[i].uid;
+        }
+        sched_yield();
+    }
+}
+
+static void test_setschedparam(void) {
+    pthread_t t1, t2;
+    struct sched_param param;
+    int policy;
+
+    CHECK_EQ(pthread_create_soloader(&t1, NULL, idle, NULL), 0);
+    SceUID uid1 = new_thread_uid(0);
+
+    // No rule: the game's priority, translated
+    param.sched_priority = 50;
+    CHECK_EQ(pthread_setschedparam_soloader(t1, THREAD_SCHED_FIFO, &param), 0);
+    CHECK_EQ(stats_of(uid1).priority, thread_policy_priority(THREAD_SCHED_FIFO, 50));
+    memset(&param, 0, sizeof(param));
+    CHECK_EQ(pthread_getschedparam_soloader(t1, &policy, &param), 0);
+    CHECK_EQ(policy, THREAD_SCHED_FIFO);
+    CHECK_EQ(param.sched_priority, 50);
+
+    // Renamed into a rule: the rule wins, now and on later requests
+    CHECK_EQ(pthread_setname_np_soloader(t1, "AudioMixer"), 0);
+    pthr_thread_stats s = stats_of(uid1);
+    CHECK(s.rule != NULL && strcmp(s.rule, "*Audio*") == 0);
+    CHECK_EQ(s.priority, 96);
+    CHECK_EQ(s.affinity, SCE_KERNEL_CPU_MASK_USER_1);
+    param.sched_priority = 0;
+    CHECK_EQ(pthread_setschedparam_soloader(t1, THREAD_SCHED_OTHER, &param), 0);
+    CHECK_EQ(stats_of(uid1).priority, 96);
+    CHECK_EQ(pthread_getschedparam_soloader(t1, &policy, &param), 0);
+    CHECK_EQ(policy, THREAD_SCHED_OTHER);
+
+    // Invalid requests change nothing
+    CHECK_EQ(pthread_create_soloader(&t2, NULL, idle, NULL), 0);
+    SceUID uid2 = new_thread_uid(uid1);
+    CHECK_EQ(pthread_setschedparam_soloader(t2, THREAD_SCHED_IDLE, &param), 0);
+    CHECK_EQ(stats_of(uid2).priority, 191);
+    param.sched_priority = 5;
+    CHECK_EQ(pthread_setschedparam_soloader(t2, THREAD_SCHED_OTHER, &param), EINVAL);
+    param.sched_priority = 0;
+    CHECK_EQ(pthread_setschedparam_soloader(t2, THREAD_SCHED_FIFO, &param), EINVAL);
+    CHECK_EQ(pthread_setschedparam_soloader(t2, 42, &param), EINVAL);
+    CHECK_EQ(pthread_setschedparam_soloader(t2, THREAD_SCHED_FIFO, NULL), EINVAL);
+    CHECK_EQ(stats_of(uid2).priority, 191);
+    CHECK_EQ(pthread_getschedparam_soloader(t2, &policy, &param), 0);
+    CHECK_EQ(policy, THREAD_SCHED_IDLE);
+
+    // Threads the game didn't create: only the calling one can be placed
+    param.sched_priority = 99;
+    CHECK_EQ(pthread_setschedparam_soloader(pthread_self(), THREAD_SCHED_RR, &param), 0);
+    SceKernelThreadInfo info;
+    info.size = sizeof(info);
+    CHECK_EQ(sceKernelGetThreadInfo(sceKernelGetThreadId(), &info), 0);
+    CHECK_EQ(info.currentPriority, 96);
+
+    atomic_store(&stop, 1);
+    pthread_join(t1, NULL);
+    pthread_join(t2, NULL);
+}
+
+int main() {
+    test_glob();
+    test_match();
+    test_default_rules();
+    test_priority();
+    test_setschedparam();
+    return 0;
+}